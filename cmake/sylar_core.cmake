@@ -1,20 +1,29 @@
 # sylar 框架核心库：只维护 libsylar.so 的源码清单、Ragel 生成和链接依赖。
 
+# 协程上下文后端：asm 为手写汇编切换（x86_64/aarch64），ucontext 为 glibc 实现
+set(SYLAR_FIBER_CONTEXT "asm" CACHE STRING "fiber context backend: asm or ucontext")
+set_property(CACHE SYLAR_FIBER_CONTEXT PROPERTY STRINGS asm ucontext)
+
 set(LIB_SRC
     sylar/log.cc
     sylar/util.cc
     sylar/config.cc
     sylar/thread.cc
     sylar/fiber.cc
+    sylar/fiber_context.cc
+    sylar/stack_allocator.cc
     sylar/scheduler.cc
     sylar/iomanager.cc
+    sylar/io_uring.cc
     sylar/timer.cc
     sylar/hook.cc
     sylar/fd_manager.cc
+    sylar/epoch.cc
     sylar/address.cc
     sylar/socket.cc
     sylar/bytearray.cc
     sylar/http/http.cc
+    sylar/http/http_header.cc
     sylar/http/http11_parser.rl.cc
     sylar/http/httpclient_parser.rl.cc
     sylar/http/http_parser.cc
@@ -24,6 +33,8 @@ set(LIB_SRC
     sylar/http/http_session.cc
     sylar/http/http_server.cc
     sylar/http/servlet.cc
+    sylar/http/servlet_router.cc
+    sylar/http/static_file_servlet.cc
     sylar/http/http_client.cc
     sylar/http/http_circuit_breaker.cc
     sylar/http/http_concurrency_limiter.cc
@@ -56,3 +67,11 @@ force_redefine_file_macro_for_sources(sylar)    #__FILE__重定义
 #add_library(sylar_static STATIC ${LIB_SRC})
 #SET_TARGET_PROPERTIES (sylar_static PROPERTIES OUTPUT_NAME "sylar")
 target_link_libraries(sylar PUBLIC yaml-cpp)
+# 日志轮转出来的文件用 zlib 压缩
+find_package(ZLIB REQUIRED)
+target_include_directories(sylar PRIVATE ${ZLIB_INCLUDE_DIRS})
+target_link_libraries(sylar PRIVATE ${ZLIB_LIBRARIES})
+if(SYLAR_FIBER_CONTEXT STREQUAL "ucontext")
+    # Fiber 的对象布局依赖这个宏，必须传递给所有链接 sylar 的目标
+    target_compile_definitions(sylar PUBLIC SYLAR_FIBER_CONTEXT_UCONTEXT)
+endif()
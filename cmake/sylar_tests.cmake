@@ -39,6 +39,37 @@ sylar_add_test_executable(test_module_lifecycle "tests/test_module_lifecycle.cc"
 
 sylar_add_test_executable(test_tls_client_options "tests/test_tls_client_options.cc")
 sylar_add_test_executable(test_module_config_timing "tests/test_module_config_timing.cc")
+sylar_add_test_executable(test_fiber_context "tests/test_fiber_context.cc")
+sylar_add_test_executable(bench_fiber_switch "tests/bench_fiber_switch.cc")
+sylar_add_test_executable(test_stack_allocator "tests/test_stack_allocator.cc")
+sylar_add_test_executable(test_shared_stack_fiber "tests/test_shared_stack_fiber.cc")
+sylar_add_test_executable(test_scheduler_work_stealing
+                          "tests/test_scheduler_work_stealing.cc")
+sylar_add_test_executable(test_task_queue "tests/test_task_queue.cc")
+sylar_add_test_executable(test_fiber_pool "tests/test_fiber_pool.cc")
+sylar_add_test_executable(test_iomanager_tickle "tests/test_iomanager_tickle.cc")
+sylar_add_test_executable(test_iomanager_uring "tests/test_iomanager_uring.cc")
+sylar_add_test_executable(test_timer_wheel "tests/test_timer_wheel.cc")
+sylar_add_test_executable(bench_timer "tests/bench_timer.cc")
+sylar_add_test_executable(test_coarse_clock "tests/test_coarse_clock.cc")
+sylar_add_test_executable(test_iomanager_wait_event "tests/test_iomanager_wait_event.cc")
+sylar_add_test_executable(test_fd_table "tests/test_fd_table.cc")
+sylar_add_test_executable(bench_fd_lookup "tests/bench_fd_lookup.cc")
+sylar_add_test_executable(test_tcp_server_reuseport "tests/test_tcp_server_reuseport.cc")
+sylar_add_test_executable(test_tcp_server_accept "tests/test_tcp_server_accept.cc")
+sylar_add_test_executable(test_http_session_pipeline "tests/test_http_session_pipeline.cc")
+sylar_add_test_executable(test_http_writev "tests/test_http_writev.cc")
+sylar_add_test_executable(test_http_header "tests/test_http_header.cc")
+sylar_add_test_executable(test_http_streaming "tests/test_http_streaming.cc")
+sylar_add_test_executable(test_servlet_router "tests/test_servlet_router.cc")
+sylar_add_test_executable(bench_servlet_dispatch "tests/bench_servlet_dispatch.cc")
+sylar_add_test_executable(test_static_file_servlet "tests/test_static_file_servlet.cc")
+sylar_add_test_executable(test_async_log_appender "tests/test_async_log_appender.cc")
+sylar_add_test_executable(test_log_format "tests/test_log_format.cc")
+sylar_add_test_executable(test_file_log_appender "tests/test_file_log_appender.cc")
+sylar_add_test_executable(test_binary_log_appender "tests/test_binary_log_appender.cc")
+sylar_add_test_executable(test_log_sampling "tests/test_log_sampling.cc")
+sylar_add_test_executable(bench_log "tests/bench_log.cc")
 
 sylar_register_unit_test(test_worker_group)
 sylar_register_unit_test(test_http_session_recv_error)
@@ -49,6 +80,31 @@ sylar_register_unit_test(test_candidate_selector)
 sylar_register_unit_test(test_module_lifecycle)
 sylar_register_unit_test(test_tls_client_options)
 sylar_register_unit_test(test_module_config_timing)
+sylar_register_unit_test(test_fiber_context)
+sylar_register_unit_test(test_stack_allocator)
+sylar_register_unit_test(test_shared_stack_fiber)
+sylar_register_unit_test(test_scheduler_work_stealing)
+sylar_register_unit_test(test_task_queue)
+sylar_register_unit_test(test_fiber_pool)
+sylar_register_unit_test(test_iomanager_tickle)
+sylar_register_unit_test(test_iomanager_uring)
+sylar_register_unit_test(test_timer_wheel)
+sylar_register_unit_test(test_coarse_clock)
+sylar_register_unit_test(test_iomanager_wait_event)
+sylar_register_unit_test(test_fd_table)
+sylar_register_unit_test(test_tcp_server_reuseport)
+sylar_register_unit_test(test_tcp_server_accept)
+sylar_register_unit_test(test_http_session_pipeline)
+sylar_register_unit_test(test_http_writev)
+sylar_register_unit_test(test_http_header)
+sylar_register_unit_test(test_http_streaming)
+sylar_register_unit_test(test_servlet_router)
+sylar_register_unit_test(test_static_file_servlet)
+sylar_register_unit_test(test_async_log_appender)
+sylar_register_unit_test(test_log_format)
+sylar_register_unit_test(test_file_log_appender)
+sylar_register_unit_test(test_binary_log_appender)
+sylar_register_unit_test(test_log_sampling)
 sylar_register_unit_test(test_ai_gateway_route_registry)
 sylar_register_unit_test(test_ai_gateway_protocol)
 sylar_register_unit_test(test_ai_gateway_servlet)
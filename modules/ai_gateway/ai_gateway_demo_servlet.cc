@@ -2,10 +2,8 @@
 
 #include "sylar/http/http.h"
 
-#include <fstream>
-#include <sstream>
 #include <string>
-#include <vector>
+#include <unistd.h>
 
 namespace sylar
 {
@@ -17,20 +15,6 @@ namespace
 
 const char *kDefaultDemoHtmlPath = "modules/ai_gateway/ai_gateway_demo.html";
 
-bool ReadTextFile(const std::string &path, std::string *content)
-{
-    std::ifstream input(path.c_str(), std::ios::in | std::ios::binary);
-    if (!input)
-    {
-        return false;
-    }
-
-    std::ostringstream ss;
-    ss << input.rdbuf();
-    *content = ss.str();
-    return true;
-}
-
 std::string BuildFallbackHtml()
 {
     return "<!doctype html><html><head><meta charset=\"utf-8\"><title>AI Gateway Demo</title>"
@@ -47,36 +31,33 @@ AiGatewayDemoServlet::AiGatewayDemoServlet()
 AiGatewayDemoServlet::AiGatewayDemoServlet(const std::string &html_path)
     : Servlet("ai_gateway_demo"), m_htmlPath(html_path.empty() ? kDefaultDemoHtmlPath : html_path)
 {
-}
-
-int32_t AiGatewayDemoServlet::handle(sylar::http::HttpRequest::ptr,
-                                     sylar::http::HttpResponse::ptr response,
-                                     sylar::http::HttpSession::ptr)
-{
-    std::string body;
-
     // 兼容从仓库根目录直接运行，以及 ctest 从 build/ 目录运行。
-    std::vector<std::string> candidates;
-    candidates.push_back(m_htmlPath);
-    candidates.push_back("../" + m_htmlPath);
-
+    const std::string candidates[] = {m_htmlPath, "../" + m_htmlPath};
     for (auto &path : candidates)
     {
-        if (ReadTextFile(path, &body))
+        if (access(path.c_str(), R_OK) == 0)
         {
+            m_file = std::make_shared<sylar::http::StaticFileServlet>(path);
+            m_file->setSingleFile(true);
+            m_file->setCacheControl("no-store");
             break;
         }
     }
+}
 
-    if (body.empty())
+int32_t AiGatewayDemoServlet::handle(sylar::http::HttpRequest::ptr request,
+                                     sylar::http::HttpResponse::ptr response,
+                                     sylar::http::HttpSession::ptr session)
+{
+    if (m_file)
     {
-        body = BuildFallbackHtml();
+        return m_file->handle(request, response, session);
     }
 
     response->setStatus(sylar::http::HttpStatus::OK);
     response->setHeader("Content-Type", "text/html; charset=utf-8");
     response->setHeader("Cache-Control", "no-store");
-    response->setBody(body);
+    response->setBody(BuildFallbackHtml());
     return 0;
 }
 
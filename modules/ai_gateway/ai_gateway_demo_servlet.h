@@ -2,6 +2,7 @@
 #define __SYLAR_AI_GATEWAY_DEMO_SERVLET_H__
 
 #include "sylar/http/servlet.h"
+#include "sylar/http/static_file_servlet.h"
 
 #include <string>
 
@@ -14,6 +15,7 @@ namespace ai_gateway
  * @brief AI Gateway 本地演示页面。
  *
  * 只负责返回静态 HTML，不处理网关请求转发，也不参与 provider 状态计算。
+ * 页面交给 StaticFileServlet 发，每次请求不再重新读文件；找不到页面时返回内置的提示页。
  */
 class AiGatewayDemoServlet : public sylar::http::Servlet
 {
@@ -27,6 +29,8 @@ public:
 
 private:
     std::string m_htmlPath;
+    // 构造时找到的页面文件，没找到为空
+    sylar::http::StaticFileServlet::ptr m_file;
 };
 
 } // namespace ai_gateway
@@ -116,13 +116,15 @@ int32_t AiGatewayServlet::handle(sylar::http::HttpRequest::ptr request,
     catch (const std::exception &e)
     {
         // 防止上游调用逻辑抛异常导致整个 Servlet 崩溃。
-        // 捕获标准异常并记录具体错误信息。
-        SYLAR_LOG_ERROR(g_logger) << "ai gateway upstream callback threw error=" << e.what();
+        // 捕获标准异常并记录具体错误信息。上游整体故障时每个请求都会走到这里，按调用点限流。
+        SYLAR_LOG_RATE_LIMITED(g_logger, sylar::LogLevel::ERROR, 10, 20)
+            << "ai gateway upstream callback threw error=" << e.what();
     }
     catch (...)
     {
         // 捕获非标准异常。
-        SYLAR_LOG_ERROR(g_logger) << "ai gateway upstream callback threw";
+        SYLAR_LOG_RATE_LIMITED(g_logger, sylar::LogLevel::ERROR, 10, 20)
+            << "ai gateway upstream callback threw";
     }
 
     if (trace_requested && m_compatibleUpstreamPost)
@@ -202,8 +204,8 @@ int32_t AiGatewayServlet::handle(sylar::http::HttpRequest::ptr request,
     {
         // 上游虽然返回了 200，但响应体格式不符合网关约定，
         // 对调用方仍然视为上游不可用。
-        SYLAR_LOG_ERROR(g_logger) << "ai gateway invalid upstream response error="
-                                  << provider_error;
+        SYLAR_LOG_RATE_LIMITED(g_logger, sylar::LogLevel::ERROR, 10, 20)
+            << "ai gateway invalid upstream response error=" << provider_error;
         writeError(response, sylar::http::HttpStatus::BAD_GATEWAY, "没有可用的上游模型服务",
                    "server_error", "UPSTREAM_UNAVAILABLE");
         return 0;
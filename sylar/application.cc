@@ -5,6 +5,7 @@
 #include "sylar/log.h"
 #include "sylar/module.h"
 #include "sylar/worker.h"
+#include <algorithm>
 #include <atomic>
 #include <unistd.h>
 
@@ -34,6 +35,11 @@ struct HttpServerConf
     std::string key_file;
     std::string accept_worker;
     std::string process_worker;
+    // 大于 0 时每个地址开这么多个 SO_REUSEPORT 监听 socket，每个一个单线程 reactor，
+    // 不再使用 accept_worker/process_worker；小于 0 表示按 CPU 个数
+    int reactors = 0;
+    // reactor 线程是否绑定 CPU
+    int reactor_cpu_affinity = 0;
 
     // 配置是否合法
     bool isValid() const
@@ -47,7 +53,8 @@ struct HttpServerConf
         return address == oth.address && keepalive == oth.keepalive && timeout == oth.timeout &&
                name == oth.name && ssl == oth.ssl && cert_file == oth.cert_file &&
                key_file == oth.key_file && accept_worker == oth.accept_worker &&
-               process_worker == oth.process_worker;
+               process_worker == oth.process_worker && reactors == oth.reactors &&
+               reactor_cpu_affinity == oth.reactor_cpu_affinity;
     }
 };
 
@@ -66,8 +73,11 @@ public:
         conf.ssl = node["ssl"].as<int>(conf.ssl);
         conf.cert_file = node["cert_file"].as<std::string>(conf.cert_file);
         conf.key_file = node["key_file"].as<std::string>(conf.key_file);
-        conf.accept_worker = node["accept_worker"].as<std::string>();
-        conf.process_worker = node["process_worker"].as<std::string>();
+        conf.accept_worker = node["accept_worker"].as<std::string>(conf.accept_worker);
+        conf.process_worker = node["process_worker"].as<std::string>(conf.process_worker);
+        conf.reactors = node["reactors"].as<int>(conf.reactors);
+        conf.reactor_cpu_affinity =
+            node["reactor_cpu_affinity"].as<int>(conf.reactor_cpu_affinity);
         if (node["address"].IsDefined())
         {
             for (size_t i = 0; i < node["address"].size(); ++i)
@@ -95,6 +105,8 @@ public:
         node["key_file"] = conf.key_file;
         node["accept_worker"] = conf.accept_worker;
         node["process_worker"] = conf.process_worker;
+        node["reactors"] = conf.reactors;
+        node["reactor_cpu_affinity"] = conf.reactor_cpu_affinity;
         for (auto &i : conf.address)
         {
             node["address"].push_back(i);
@@ -375,6 +387,16 @@ int Application::run_fiber()
                            return 0;
                        });
 
+        if (i.reactors != 0)
+        {
+            int reactors = i.reactors;
+            if (reactors < 0)
+            {
+                reactors = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+            }
+            server->setReusePort(reactors, i.reactor_cpu_affinity);
+        }
+
         std::vector<Address::ptr> fails;
         if (!server->bind(address, fails, i.ssl)) // 绑定地址
         {
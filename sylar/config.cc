@@ -9,6 +9,57 @@ namespace sylar
 {
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+namespace
+{
+
+// 只读的状态项，值由 getter 现算
+class StatusVar : public ConfigVarBase
+{
+public:
+    StatusVar(const std::string &name,
+              std::function<std::string()> getter,
+              const std::string &description)
+        : ConfigVarBase(name, description), m_getter(std::move(getter))
+    {
+    }
+
+    std::string toString() override
+    {
+        return m_getter();
+    }
+    bool fromString(const std::string &val) override
+    {
+        SYLAR_LOG_WARN(g_logger) << "config " << m_name << " is read-only status, ignore " << val;
+        return false;
+    }
+    std::string getTypeName() const override
+    {
+        return "status";
+    }
+
+private:
+    std::function<std::string()> m_getter;
+};
+
+} // namespace
+
+ConfigVarBase::ptr Config::AddStatus(const std::string &name,
+                                     std::function<std::string()> getter,
+                                     const std::string &description)
+{
+    ConfigVarBase::ptr var(new StatusVar(name, std::move(getter), description));
+    RWMutexType::WriteLock lock(GetMutex());
+    auto it = GetDatas().find(var->getName());
+    if (it != GetDatas().end())
+    {
+        SYLAR_LOG_ERROR(g_logger) << "AddStatus name=" << name << " exists";
+        return it->second;
+    }
+    GetDatas()[var->getName()] = var;
+    return var;
+}
+
 ConfigVarBase::ptr Config::LookupBase(const std::string &name)
 {
     RWMutexType::ReadLock lock(GetMutex());
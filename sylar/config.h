@@ -515,6 +515,14 @@ public:
 
     static ConfigVarBase::ptr LookupBase(const std::string &name);
 
+    /**
+     * @brief 注册一个只读的运行时状态项，和配置项一样能用 LookupBase/Visit 取到
+     * @details 每次 toString 都调用 getter 现算；配置文件里写了同名项也不会生效
+     */
+    static ConfigVarBase::ptr AddStatus(const std::string &name,
+                                        std::function<std::string()> getter,
+                                        const std::string &description = "");
+
     static void Visit(std::function<void(ConfigVarBase::ptr)> cb);
 
     /**
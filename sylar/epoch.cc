@@ -0,0 +1,189 @@
+#include "epoch.h"
+#include "mutex.h"
+#include <atomic>
+#include <vector>
+
+namespace sylar
+{
+
+namespace
+{
+// 每个线程一条记录，线程退出后留给后来的线程复用，不释放
+struct ThreadRecord
+{
+    /// 进入临界区时看到的全局纪元，0 表示不在临界区
+    std::atomic<uint64_t> epoch = {0};
+    std::atomic<bool> used = {false};
+    /// 嵌套层数，只有持有这条记录的线程访问
+    uint32_t depth = 0;
+    ThreadRecord *next = nullptr;
+    /// 让不同线程的 epoch 至少隔开一个缓存行
+    char pad[64];
+};
+
+struct Retired
+{
+    uint64_t epoch;
+    void *ptr;
+    Epoch::Deleter deleter;
+};
+
+struct RecordHolder
+{
+    ThreadRecord *record = nullptr;
+    ~RecordHolder()
+    {
+        if (record)
+        {
+            record->epoch.store(0, std::memory_order_release);
+            record->depth = 0;
+            record->used.store(false, std::memory_order_release);
+            record = nullptr;
+        }
+    }
+};
+
+std::atomic<ThreadRecord *> s_records = {nullptr};
+std::atomic<uint64_t> s_epoch = {1};
+thread_local RecordHolder t_holder;
+
+// 可能在其他静态对象构造时就用到，放到函数里保证先初始化
+Mutex &GetRetireMutex()
+{
+    static Mutex s_mutex;
+    return s_mutex;
+}
+
+std::vector<Retired> &GetRetired()
+{
+    static std::vector<Retired> s_retired;
+    return s_retired;
+}
+
+ThreadRecord *GetRecord()
+{
+    if (t_holder.record)
+    {
+        return t_holder.record;
+    }
+    for (ThreadRecord *r = s_records.load(std::memory_order_acquire); r; r = r->next)
+    {
+        bool expected = false;
+        if (!r->used.load(std::memory_order_relaxed) &&
+            r->used.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        {
+            t_holder.record = r;
+            return r;
+        }
+    }
+    ThreadRecord *r = new ThreadRecord;
+    r->used.store(true, std::memory_order_relaxed);
+    ThreadRecord *head = s_records.load(std::memory_order_relaxed);
+    do
+    {
+        r->next = head;
+    } while (!s_records.compare_exchange_weak(head, r, std::memory_order_release));
+    t_holder.record = r;
+    return r;
+}
+
+// 调用者持有 GetRetireMutex()，可以释放的对象移到 out 里，解锁后再调用删除函数
+void CollectLocked(std::vector<Retired> &out)
+{
+    //和读者进入临界区时的屏障配对：摘下对象之后才检查读者的纪元
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t global = s_epoch.load(std::memory_order_relaxed);
+    bool advance = true;
+    for (ThreadRecord *r = s_records.load(std::memory_order_acquire); r; r = r->next)
+    {
+        uint64_t e = r->epoch.load(std::memory_order_acquire);
+        if (e && e != global)
+        {
+            advance = false;
+            break;
+        }
+    }
+    if (advance)
+    {
+        ++global;
+        s_epoch.store(global, std::memory_order_release);
+    }
+    std::vector<Retired> &retired = GetRetired();
+    size_t keep = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (retired[i].epoch + 2 <= global)
+        {
+            out.push_back(retired[i]);
+        }
+        else
+        {
+            retired[keep++] = retired[i];
+        }
+    }
+    retired.resize(keep);
+}
+
+void Free(const std::vector<Retired> &items)
+{
+    for (auto &i : items)
+    {
+        i.deleter(i.ptr);
+    }
+}
+} // namespace
+
+void Epoch::Enter()
+{
+    ThreadRecord *r = GetRecord();
+    if (r->depth++ == 0)
+    {
+        r->epoch.store(s_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        //之后对共享指针的读取不能提前到登记纪元之前
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void Epoch::Leave()
+{
+    ThreadRecord *r = t_holder.record;
+    if (--r->depth == 0)
+    {
+        r->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void Epoch::Retire(void *ptr, Deleter deleter)
+{
+    std::vector<Retired> items;
+    {
+        Mutex::Lock lock(GetRetireMutex());
+        Retired r;
+        r.epoch = s_epoch.load(std::memory_order_relaxed);
+        r.ptr = ptr;
+        r.deleter = deleter;
+        GetRetired().push_back(r);
+        CollectLocked(items);
+    }
+    Free(items);
+}
+
+size_t Epoch::Reclaim()
+{
+    std::vector<Retired> items;
+    size_t left = 0;
+    {
+        Mutex::Lock lock(GetRetireMutex());
+        CollectLocked(items);
+        left = GetRetired().size();
+    }
+    Free(items);
+    return left;
+}
+
+uint64_t Epoch::GetEpoch()
+{
+    return s_epoch.load(std::memory_order_relaxed);
+}
+
+} // namespace sylar
@@ -0,0 +1,61 @@
+#ifndef __SYLAR_EPOCH_H__
+#define __SYLAR_EPOCH_H__
+
+#include "noncopyable.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace sylar
+{
+
+/**
+ * @brief 基于纪元的延迟回收
+ *
+ * 读者用 EpochGuard 包住对共享指针的访问，进出只写本线程自己的一个变量，不加锁；
+ * 写者把已经从共享结构上摘下来的对象交给 Retire，全局纪元前进两次之后
+ * （期间每个还在临界区里的读者都已经离开过）才真正释放。
+ * 临界区里不能阻塞或者让出协程，否则会拖住回收。
+ */
+class Epoch
+{
+public:
+    typedef void (*Deleter)(void *);
+
+    static void Enter();
+    static void Leave();
+
+    // ptr 已经不能再被新的读者看到
+    static void Retire(void *ptr, Deleter deleter);
+    template <class T> static void Retire(T *ptr)
+    {
+        Retire(ptr, &Delete<T>);
+    }
+
+    // 尝试推进纪元并释放可以释放的对象，返回还在等待释放的个数
+    static size_t Reclaim();
+    static uint64_t GetEpoch();
+
+private:
+    template <class T> static void Delete(void *ptr)
+    {
+        delete (T *)ptr;
+    }
+};
+
+// 作用域内的读临界区，可以嵌套
+class EpochGuard : Noncopyable
+{
+public:
+    EpochGuard()
+    {
+        Epoch::Enter();
+    }
+    ~EpochGuard()
+    {
+        Epoch::Leave();
+    }
+};
+
+} // namespace sylar
+
+#endif
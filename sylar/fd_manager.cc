@@ -1,4 +1,5 @@
 #include "sylar/fd_manager.h"
+#include "epoch.h"
 #include "hook.h"
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -13,6 +14,22 @@ FdCtx::FdCtx(int fd)
     init();
 }
 
+FdCtx::FdCtx(int fd, bool nonblock_socket)
+    : m_fd(fd), m_isInit(false), m_isSocket(false), m_sysNonblock(false), m_userNonblock(false),
+      m_isClosed(false), m_recvTimeout(-1), m_sendTimeout(-1)
+{
+    if (nonblock_socket)
+    {
+        m_isInit = true;
+        m_isSocket = true;
+        m_sysNonblock = true;
+    }
+    else
+    {
+        init();
+    }
+}
+
 FdCtx::~FdCtx()
 {
 }
@@ -83,50 +100,58 @@ uint64_t FdCtx::getTimeout(int type)
 
 FdManager::FdManager()
 {
-    m_datas.resize(64);
 }
 
-FdCtx::ptr FdManager::get(int fd, bool auto_create)
+FdManager::~FdManager()
 {
+    m_datas.forEach([](FdCtx::ptr *holder) { delete holder; });
+}
 
-    RWMutexType::ReadLock lock(m_mutex);
-    //有没有超过m_datas的范围
-    if ((int)m_datas.size() <= fd)
+FdCtx::ptr FdManager::get(int fd, bool auto_create)
+{
     {
-        if (!auto_create)
+        EpochGuard guard;
+        FdCtx::ptr *holder = m_datas.get(fd);
+        if (holder || !auto_create)
         {
-            return nullptr;
+            return holder ? *holder : nullptr;
         }
     }
-    else
+    //创建，初始化的时候会init，就一定保证加进来的就是socket
+    return install(fd, new FdCtx(fd));
+}
+
+FdCtx::ptr FdManager::addSocket(int fd)
+{
+    return install(fd, new FdCtx(fd, true));
+}
+
+FdCtx::ptr FdManager::install(int fd, FdCtx *ctx)
+{
+    if (!FdTable<FdCtx::ptr>::InRange(fd))
     {
-        if (m_datas[fd] || !auto_create)
-        {
-            return m_datas[fd];
-        }
+        delete ctx;
+        return nullptr;
     }
-    lock.unlock();
-    //创建
-    RWMutexType::WriteLock lock2(m_mutex);
-    if ((int)m_datas.size() <= fd)
+    FdCtx::ptr *created = new FdCtx::ptr(ctx);
+    EpochGuard guard;
+    FdCtx::ptr *holder = m_datas.install(fd, created);
+    //别的线程先放进去了，用它的
+    if (holder != created)
     {
-        m_datas.resize(fd + 1);
+        delete created;
     }
-    // 初始化的时候会init，就一定保证加进来的就是socket
-    FdCtx::ptr ctx(new FdCtx(fd));
-    m_datas[fd] = ctx;
-    return ctx;
+    return *holder;
 }
+
 void FdManager::del(int fd)
 {
-    RWMutexType::WriteLock lock(m_mutex);
-    //有没有超过m_datas的范围
-    if ((int)m_datas.size() <= fd)
+    FdCtx::ptr *holder = m_datas.exchange(fd, nullptr);
+    //可能还有线程在 EpochGuard 里读着它，等它们都离开之后再释放
+    if (holder)
     {
-        return;
+        Epoch::Retire(holder);
     }
-    //删除
-    m_datas[fd].reset();
 }
 
 } // namespace sylar
\ No newline at end of file
@@ -1,9 +1,9 @@
 #ifndef __FD_MANAGER_H__
 #define __FD_MANAGER_H__
+#include "sylar/fd_table.h"
 #include "sylar/singleton.h"
 #include "sylar/thread.h"
 #include <memory>
-#include <vector>
 /**
  * @brief 文件描述符管理类
  * 用于判断一个句柄是否和socket相关，如果是，就去用hook，否则就直接调用系统调用
@@ -16,6 +16,8 @@ class FdCtx : public std::enable_shared_from_this<FdCtx>
 public:
     typedef std::shared_ptr<FdCtx> ptr;
     FdCtx(int fd);
+    /// 已经知道是 O_NONBLOCK 的 socket（比如 accept4 带 SOCK_NONBLOCK 拿到的），不再 fstat/fcntl
+    FdCtx(int fd, bool nonblock_socket);
     ~FdCtx();
     bool init();
 
@@ -67,17 +69,33 @@ private:
     uint64_t m_sendTimeout;
 };
 
+/**
+ * @brief fd 上下文表
+ *
+ * 槽位里放的是堆上的一份 FdCtx::ptr，表本身不加锁；
+ * del 摘下的那份交给 Epoch 延迟释放，所以在 EpochGuard 里拿到的裸指针一直有效。
+ */
 class FdManager
 {
 public:
-    typedef RWMutex RWMutexType;
     FdManager();
+    ~FdManager();
     FdCtx::ptr get(int fd, bool auto_create = false);
+    /// 登记一个已经是 O_NONBLOCK 的 socket，省掉 FdCtx::init 里的系统调用
+    FdCtx::ptr addSocket(int fd);
+    /// 不复制 shared_ptr 的查找，返回的指针只在调用者的 EpochGuard 作用域内有效
+    FdCtx *lookup(int fd) const
+    {
+        FdCtx::ptr *holder = m_datas.get(fd);
+        return holder ? holder->get() : nullptr;
+    }
     void del(int fd);
 
 private:
-    RWMutexType m_mutex;
-    std::vector<FdCtx::ptr> m_datas;
+    FdCtx::ptr install(int fd, FdCtx *ctx);
+
+private:
+    FdTable<FdCtx::ptr> m_datas;
 };
 
 typedef Singleton<FdManager> FdMgr;
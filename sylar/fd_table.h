@@ -0,0 +1,155 @@
+#ifndef __SYLAR_FD_TABLE_H__
+#define __SYLAR_FD_TABLE_H__
+
+#include "noncopyable.h"
+#include <atomic>
+#include <cstddef>
+
+namespace sylar
+{
+
+/**
+ * @brief 按 fd 下标访问的指针表
+ *
+ * 分成固定大小的段，段在第一次用到时创建，之后一直不移动也不释放，
+ * 所以查找就是两次原子读，不加锁；写入用 CAS/exchange，不会互相覆盖。
+ * 表只保存指针，不管理指向的对象，对象什么时候释放由使用者决定。
+ */
+template <class T> class FdTable : Noncopyable
+{
+public:
+    static const size_t kSegmentBits = 10;
+    static const size_t kSegmentSize = 1 << kSegmentBits;
+    /// 最多 4M 个 fd，段目录本身 32KB
+    static const size_t kMaxSegments = 4096;
+
+    FdTable()
+    {
+        for (auto &i : m_segments)
+        {
+            i.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~FdTable()
+    {
+        for (auto &i : m_segments)
+        {
+            delete[] i.load(std::memory_order_relaxed);
+        }
+    }
+
+    static bool InRange(int fd)
+    {
+        return fd >= 0 && (size_t)fd < kSegmentSize * kMaxSegments;
+    }
+
+    // 没有的话返回 nullptr
+    T *get(int fd) const
+    {
+        if (!InRange(fd))
+        {
+            return nullptr;
+        }
+        std::atomic<T *> *seg = m_segments[fd >> kSegmentBits].load(std::memory_order_acquire);
+        if (!seg)
+        {
+            return nullptr;
+        }
+        return seg[fd & (kSegmentSize - 1)].load(std::memory_order_acquire);
+    }
+
+    // 槽位空着时放入 v 并返回 v，否则返回已经在里面的指针（调用者自己处理 v）
+    T *install(int fd, T *v)
+    {
+        std::atomic<T *> *slot = getSlot(fd);
+        if (!slot)
+        {
+            return nullptr;
+        }
+        T *expected = nullptr;
+        if (slot->compare_exchange_strong(expected, v, std::memory_order_acq_rel))
+        {
+            return v;
+        }
+        return expected;
+    }
+
+    // 换成 v，返回原来的指针
+    T *exchange(int fd, T *v)
+    {
+        std::atomic<T *> *slot = v ? getSlot(fd) : findSlot(fd);
+        if (!slot)
+        {
+            return nullptr;
+        }
+        return slot->exchange(v, std::memory_order_acq_rel);
+    }
+
+    // 遍历所有非空槽位，只在没有并发写入时使用（比如析构）
+    template <class Func> void forEach(Func func)
+    {
+        for (auto &i : m_segments)
+        {
+            std::atomic<T *> *seg = i.load(std::memory_order_acquire);
+            if (!seg)
+            {
+                continue;
+            }
+            for (size_t j = 0; j < kSegmentSize; ++j)
+            {
+                T *v = seg[j].load(std::memory_order_acquire);
+                if (v)
+                {
+                    func(v);
+                }
+            }
+        }
+    }
+
+private:
+    std::atomic<T *> *findSlot(int fd)
+    {
+        if (!InRange(fd))
+        {
+            return nullptr;
+        }
+        std::atomic<T *> *seg = m_segments[fd >> kSegmentBits].load(std::memory_order_acquire);
+        return seg ? &seg[fd & (kSegmentSize - 1)] : nullptr;
+    }
+
+    // 段还不存在时创建，和别的线程同时创建时用先放进去的那个
+    std::atomic<T *> *getSlot(int fd)
+    {
+        if (!InRange(fd))
+        {
+            return nullptr;
+        }
+        std::atomic<std::atomic<T *> *> &dir = m_segments[fd >> kSegmentBits];
+        std::atomic<T *> *seg = dir.load(std::memory_order_acquire);
+        if (!seg)
+        {
+            std::atomic<T *> *created = new std::atomic<T *>[kSegmentSize];
+            for (size_t i = 0; i < kSegmentSize; ++i)
+            {
+                created[i].store(nullptr, std::memory_order_relaxed);
+            }
+            if (dir.compare_exchange_strong(seg, created, std::memory_order_acq_rel))
+            {
+                seg = created;
+            }
+            else
+            {
+                delete[] created;
+            }
+        }
+        return &seg[fd & (kSegmentSize - 1)];
+    }
+
+private:
+    std::atomic<std::atomic<T *> *> m_segments[kMaxSegments];
+};
+
+} // namespace sylar
+
+#endif
@@ -3,11 +3,14 @@
 #include "log.h"
 #include "macro.h"
 #include "scheduler.h"
+#include "stack_allocator.h"
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
-#include <ucontext.h>
+#include <vector>
 namespace sylar
 {
 
@@ -22,29 +25,97 @@ static thread_local Fiber::ptr t_threadFiber = nullptr;
 
 sylar::ConfigVar<uint32_t>::ptr g_fiber_stack_size =
     Config::Lookup<uint32_t>("fiber.stack_size", 1024 * 1024, "fiber stack size");
+static sylar::ConfigVar<uint32_t>::ptr g_fiber_shared_stack_count = Config::Lookup<uint32_t>(
+    "fiber.shared_stack.count", 4, "shared stacks per thread for shared-stack fibers");
+static sylar::ConfigVar<uint32_t>::ptr g_fiber_shared_stack_size = Config::Lookup<uint32_t>(
+    "fiber.shared_stack.size", 1024 * 1024, "size of each shared fiber stack");
 
-class MallocStackAllocator
+static sylar::ConfigVar<uint32_t>::ptr g_fiber_pool_max_size = Config::Lookup<uint32_t>(
+    "fiber.pool.max_size", 64, "max terminated fibers cached per thread for reuse");
+
+//池里只放默认栈大小的协程，热路径上不读ConfigVar，由监听器同步取整后的默认栈大小
+static std::atomic<uint32_t> s_fiber_pool_max_size{64};
+static std::atomic<size_t> s_fiber_pool_stack_size{0};
+static std::atomic<uint64_t> s_fiber_pool_hits{0};
+static std::atomic<uint64_t> s_fiber_pool_misses{0};
+static std::atomic<uint64_t> s_fiber_pool_recycled{0};
+static std::atomic<uint64_t> s_fiber_pool_cached{0};
+
+struct _FiberPoolIniter
+{
+    _FiberPoolIniter()
+    {
+        s_fiber_pool_max_size = g_fiber_pool_max_size->getValue();
+        s_fiber_pool_stack_size = g_fiber_stack_size->getValue();
+        g_fiber_pool_max_size->addListener([](const uint32_t &old_value, const uint32_t &new_value)
+                                           { s_fiber_pool_max_size = new_value; });
+        g_fiber_stack_size->addListener([](const uint32_t &old_value, const uint32_t &new_value)
+                                        { s_fiber_pool_stack_size = new_value; });
+    }
+};
+
+static _FiberPoolIniter s_fiber_pool_initer;
+
+//切出时记录的栈指针是swapOut里一个局部变量的地址，再往下留一段余量，
+//覆盖swapOut自身栈帧和上下文切换函数压栈的寄存器
+static const size_t kSharedStackSpMargin = 1024;
+
+//共享栈：同一线程上的多个协程轮流使用，owner是当前内容属于哪个协程
+class FiberSharedStack
 {
 public:
-    static void *Alloc(size_t size)
+    FiberSharedStack(size_t size) : size(StackAllocator::RoundSize(size))
     {
-        return malloc(size);
+        stack = (char *)StackAllocator::Alloc(this->size);
     }
+    ~FiberSharedStack()
+    {
+        StackAllocator::Dealloc(stack, size);
+    }
+    char *top() const
+    {
+        return stack + size;
+    }
+
+    char *stack = nullptr;
+    size_t size = 0;
+    std::atomic<Fiber *> owner{nullptr};
+};
 
-    static void Dealloc(void *vp, size_t size)
+namespace
+{
+//每个线程自己的共享栈，第一次有共享栈协程运行时才创建
+struct SharedStackPool
+{
+    std::vector<std::shared_ptr<FiberSharedStack>> stacks;
+    size_t next = 0;
+};
+} // namespace
+
+static thread_local SharedStackPool t_sharedStackPool;
+
+namespace
+{
+//每个线程缓存的已结束协程，栈和Fiber对象一起复用
+struct FiberPool
+{
+    ~FiberPool()
     {
-        return free(vp);
+        s_fiber_pool_cached -= fibers.size();
     }
+    std::vector<Fiber::ptr> fibers;
 };
+} // namespace
+
+static thread_local FiberPool t_fiberPool;
 
-using StackAllocator = MallocStackAllocator;
 //无参构造函数用于创建主协程，不需要独立的栈空间，核心是关联当前线程的执行上下文
 Fiber::Fiber()
 {
     m_state = EXEC;
     SetThis(this);
     //获取线程的上下文环境，保存到m_ctx中，方便在子协程全部结束后回到线程的原状态
-    if (getcontext(&m_ctx))
+    if (m_ctx.init())
     {
         SYLAR_ASSERT2(false, "getcontext");
     }
@@ -55,40 +126,40 @@ Fiber::Fiber()
 
 //创建子协程，拥有独立的栈空间，执行函数cb
 //需要初始化协程上下文
-Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
-    : m_id(++s_fiber_id), m_cb(cb)
+Fiber::Fiber(Task cb, size_t stacksize, bool use_caller, bool shared_stack)
+    : m_id(++s_fiber_id), m_cb(std::move(cb))
 {
     s_fiber_count++;
-    m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
-    m_stack = StackAllocator::Alloc(m_stacksize);
-    //保留的是线程的状态，子协程用不到，他只是为了初始化m_ctx,方便后面makecontext使用
-    if (getcontext(&m_ctx))
-    {
-        SYLAR_ASSERT2(false, "getcontext");
-    }
-    //改成nullptr，后面协程执行完毕后不会再切换到别的协程，而是直接回到线程的上下文环境
-    //所以这里只是暂时这样设置
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
-
-    if (!use_caller)
+    //m_rootFiber走call/back切换，不参与共享栈
+    if (shared_stack && !use_caller)
     {
-        makecontext(&m_ctx, &Fiber::MainFunc, 0);
+        //栈要等第一次swapIn时才知道落在哪个线程的哪块共享栈上，上下文也推迟到那时构造
+        m_useSharedStack = true;
+        return;
     }
-    //只有m_rootFiber才用到这个，其他的都是直接创建的一个Fiber对象，use_caller默认为false的
-    else
+    //栈尺寸会被取整到分配器的档位上，方便回收后给别的协程复用
+    m_stacksize = StackAllocator::RoundSize(stacksize ? stacksize : g_fiber_stack_size->getValue());
+    m_stack = StackAllocator::Alloc(m_stacksize);
+    SYLAR_ASSERT2(m_stack, "alloc fiber stack size=" + std::to_string(m_stacksize));
+    //协程执行完毕后不会自然返回，而是在MainFunc/CallerMainFunc里主动切回去，
+    //所以上下文里不需要uc_link这样的后继上下文
+    //只有m_rootFiber才用到CallerMainFunc，其他的都是直接创建的一个Fiber对象，use_caller默认为false的
+    if (m_ctx.make(m_stack, m_stacksize, use_caller ? &Fiber::CallerMainFunc : &Fiber::MainFunc))
     {
-        makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
+        SYLAR_ASSERT2(false, "makecontext");
     }
-    // makecontext(&m_ctx, &Fiber::MainFunc, 0);
     // SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
 }
 
 Fiber::~Fiber()
 {
     --s_fiber_count;
-    if (m_stack)
+    if (m_useSharedStack)
+    {
+        SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+        releaseSharedStack();
+    }
+    else if (m_stack)
     {
         SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
 
@@ -214,20 +285,22 @@ void Fiber::CallerMainFunc()
 }
 
 //执行完了当前的回调函数，但是还没有释放资源，那么就新给他一个任务
-void Fiber::reset(std::function<void()> cb)
+void Fiber::reset(Task cb)
 {
-    SYLAR_ASSERT(m_stack);
+    SYLAR_ASSERT(m_stack || m_useSharedStack);
     SYLAR_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
-    m_cb = cb;
-    ;
-    if (getcontext(&m_ctx))
+    m_cb = std::move(cb);
+    if (m_useSharedStack)
     {
-        SYLAR_ASSERT2(false, "getcontext");
+        //结束时已经让出了共享栈，下次swapIn重新分配
+        releaseSharedStack();
+        m_state = INIT;
+        return;
+    }
+    if (m_ctx.make(m_stack, m_stacksize, &Fiber::MainFunc))
+    {
+        SYLAR_ASSERT2(false, "makecontext");
     }
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stacksize;
-    makecontext(&m_ctx, &Fiber::MainFunc, 0);
     m_state = INIT;
 }
 
@@ -242,7 +315,7 @@ void Fiber::call()
     SetThis(this);
     m_state = EXEC;
     SYLAR_LOG_INFO(g_logger) << "执行call方法m_rootfiber  " << getId();
-    if (swapcontext(&t_threadFiber->m_ctx, &m_ctx))
+    if (t_threadFiber->m_ctx.swapTo(m_ctx))
     {
         SYLAR_ASSERT2(false, "swapcontext");
     }
@@ -251,7 +324,7 @@ void Fiber::call()
 void Fiber::back()
 {
     SetThis(t_threadFiber.get());
-    if (swapcontext(&m_ctx, &t_threadFiber->m_ctx))
+    if (m_ctx.swapTo(t_threadFiber->m_ctx))
     {
         SYLAR_ASSERT2(false, "swapcontext");
     }
@@ -263,24 +336,174 @@ void Fiber::swapIn()
 {
     SetThis(this);
     SYLAR_ASSERT(m_state != EXEC);
+    if (m_useSharedStack)
+    {
+        //这里还运行在调度器主协程自己的栈上，可以放心地改写共享栈
+        acquireSharedStack();
+    }
     m_state = EXEC;
     // 对于m_rootFiber
-    if (swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx))
+    if (Scheduler::GetMainFiber()->m_ctx.swapTo(m_ctx))
     {
         SYLAR_ASSERT2(false, "swapcontext");
     }
+    if (m_useSharedStack && (m_state == TERM || m_state == EXCEPT))
+    {
+        releaseSharedStack();
+    }
 }
 //由子协程转到主协程
 void Fiber::swapOut()
 {
     SetThis(Scheduler::GetMainFiber());
+    if (m_useSharedStack)
+    {
+        char marker = 0;
+        m_sharedSp = (char *)((uintptr_t)&marker - kSharedStackSpMargin);
+    }
     //这里是当前的idle fiber，切换到id为1的协程，那么他应该和谁交换呢？
-    if (swapcontext(&m_ctx, &Scheduler::GetMainFiber()->m_ctx))
+    if (m_ctx.swapTo(Scheduler::GetMainFiber()->m_ctx))
     {
         SYLAR_ASSERT2(false, "swapcontext");
     }
 }
 
+void Fiber::acquireSharedStack()
+{
+    bool fresh = !m_sharedStack;
+    if (fresh)
+    {
+        auto &stacks = t_sharedStackPool.stacks;
+        if (stacks.empty())
+        {
+            uint32_t count = g_fiber_shared_stack_count->getValue();
+            size_t size = g_fiber_shared_stack_size->getValue();
+            for (uint32_t i = 0; i < (count ? count : 1); ++i)
+            {
+                stacks.push_back(std::make_shared<FiberSharedStack>(size));
+            }
+        }
+        //优先找空闲的共享栈，都被占用时轮流挤占
+        for (size_t i = 0; i < stacks.size() && !m_sharedStack; ++i)
+        {
+            if (!stacks[i]->owner)
+            {
+                m_sharedStack = stacks[i];
+            }
+        }
+        if (!m_sharedStack)
+        {
+            m_sharedStack = stacks[t_sharedStackPool.next++ % stacks.size()];
+        }
+        m_boundThread = sylar::GetThreadId();
+        m_stacksize = m_sharedStack->size;
+    }
+    Fiber *owner = m_sharedStack->owner;
+    if (owner == this)
+    {
+        return;
+    }
+    //初始帧写在栈顶，正是原主人最外层几帧所在的位置，必须先把它的栈拷走
+    if (owner)
+    {
+        owner->saveSharedStack();
+    }
+    m_sharedStack->owner = this;
+    if (fresh)
+    {
+        if (m_ctx.make(m_sharedStack->stack, m_sharedStack->size, &Fiber::MainFunc))
+        {
+            SYLAR_ASSERT2(false, "makecontext");
+        }
+    }
+    else if (m_savedSize)
+    {
+        memcpy(m_sharedStack->top() - m_savedSize, m_savedStack, m_savedSize);
+    }
+}
+
+void Fiber::saveSharedStack()
+{
+    char *top = m_sharedStack->top();
+    char *sp = m_sharedSp < m_sharedStack->stack ? m_sharedStack->stack : m_sharedSp;
+    m_savedSize = top - sp;
+    //按实际用量分配，缓冲区明显偏大时缩回去，避免一次深调用让空闲协程一直占着大块内存
+    if (m_savedCapacity < m_savedSize || m_savedCapacity > m_savedSize * 2)
+    {
+        free(m_savedStack);
+        m_savedStack = (char *)malloc(m_savedSize);
+        m_savedCapacity = m_savedSize;
+    }
+    memcpy(m_savedStack, sp, m_savedSize);
+}
+
+void Fiber::releaseSharedStack()
+{
+    if (m_sharedStack)
+    {
+        Fiber *self = this;
+        m_sharedStack->owner.compare_exchange_strong(self, nullptr);
+        m_sharedStack.reset();
+    }
+    free(m_savedStack);
+    m_savedStack = nullptr;
+    m_savedSize = 0;
+    m_savedCapacity = 0;
+    m_boundThread = -1;
+}
+
+Fiber::ptr Fiber::Create(Task cb)
+{
+    auto &fibers = t_fiberPool.fibers;
+    size_t stacksize = StackAllocator::RoundSize(s_fiber_pool_stack_size);
+    while (!fibers.empty())
+    {
+        Fiber::ptr fiber = std::move(fibers.back());
+        fibers.pop_back();
+        --s_fiber_pool_cached;
+        //默认栈大小改过的话，旧尺寸的协程直接丢掉
+        if (fiber->m_stacksize == stacksize)
+        {
+            ++s_fiber_pool_hits;
+            fiber->reset(std::move(cb));
+            return fiber;
+        }
+    }
+    ++s_fiber_pool_misses;
+    return Fiber::ptr(new Fiber(std::move(cb)));
+}
+
+void Fiber::Recycle(Fiber::ptr &&fiber)
+{
+    Fiber::ptr f(std::move(fiber));
+    //还有别人持有的协程不能复用，共享栈协程和自定义栈大小的协程也不进池
+    if (!f || f.use_count() != 1 || (f->m_state != TERM && f->m_state != EXCEPT) ||
+        f->m_useSharedStack || !f->m_stack)
+    {
+        return;
+    }
+    auto &fibers = t_fiberPool.fibers;
+    if (fibers.size() >= s_fiber_pool_max_size ||
+        f->m_stacksize != StackAllocator::RoundSize(s_fiber_pool_stack_size))
+    {
+        return;
+    }
+    f->m_cb = nullptr;
+    fibers.push_back(std::move(f));
+    ++s_fiber_pool_cached;
+    ++s_fiber_pool_recycled;
+}
+
+FiberPoolStats Fiber::GetPoolStats()
+{
+    FiberPoolStats stats;
+    stats.hits = s_fiber_pool_hits;
+    stats.misses = s_fiber_pool_misses;
+    stats.recycled = s_fiber_pool_recycled;
+    stats.cached = s_fiber_pool_cached;
+    return stats;
+}
+
 uint64_t Fiber::GetFiberId()
 {
     if (t_fiber)
@@ -1,13 +1,26 @@
 #ifndef __SYLAR_FIBER_H__
 #define __SYLAR_FIBER_H__
 
+#include "fiber_context.h"
+#include "task.h"
 #include <cstdint>
 #include <functional>
 #include <memory>
-#include <sys/ucontext.h>
-#include <ucontext.h>
 namespace sylar
 {
+class FiberSharedStack;
+
+/**
+ * @brief 协程池统计（所有线程汇总）
+ */
+struct FiberPoolStats
+{
+    uint64_t hits = 0;     // Fiber::Create 从池里拿到了可复用的协程
+    uint64_t misses = 0;   // 池里没有合适的协程，新建了一个
+    uint64_t recycled = 0; // 结束后被放回池里的协程
+    uint64_t cached = 0;   // 当前各线程池里缓存的协程数
+};
+
 class Fiber : public std::enable_shared_from_this<Fiber>
 {
 
@@ -29,10 +42,15 @@ public:
 public:
     //下面的几个方法是协程的切换和获取
     typedef std::shared_ptr<Fiber> ptr;
-    Fiber(std::function<void()> cb, size_t stacksize = 0, bool use_caller = false);
+    // shared_stack 为 true 时不单独分配栈，而是运行在当前线程的共享栈上，
+    // 被别的协程挤占时把用到的那一段栈拷贝到堆上；这种协程第一次运行后就固定在该线程上调度
+    Fiber(Task cb,
+          size_t stacksize = 0,
+          bool use_caller = false,
+          bool shared_stack = false);
     ~Fiber();
     //用来给未释放的协程重新一个回调函数来执行任务
-    void reset(std::function<void()> cb);
+    void reset(Task cb);
     //用来调度模块的调度器协程执行任务
     void call();
     void back();
@@ -51,6 +69,17 @@ public:
         return m_state;
     }
 
+    bool isSharedStack() const
+    {
+        return m_useSharedStack;
+    }
+
+    // 共享栈协程当前拷贝在堆上的栈字节数
+    size_t getSavedStackSize() const
+    {
+        return m_savedSize;
+    }
+
 public:
     static void SetThis(Fiber *f);
     static Fiber::ptr GetThis();
@@ -61,16 +90,38 @@ public:
     static void CallerMainFunc();
     static uint64_t GetFiberId();
 
+    // 优先从当前线程的协程池里取一个已结束的协程，reset成cb后返回；池里没有时才新建
+    static Fiber::ptr Create(Task cb);
+    // 已结束、没有其他引用的默认栈协程放回当前线程的协程池，池满或不满足条件时直接释放
+    static void Recycle(Fiber::ptr &&fiber);
+    static FiberPoolStats GetPoolStats();
+
 private:
     Fiber();
 
+    // 占用一块共享栈（第一次运行时）并把之前拷出去的栈内容拷回来
+    void acquireSharedStack();
+    // 把挂起时用到的那一段共享栈拷贝到堆上，让出共享栈
+    void saveSharedStack();
+    void releaseSharedStack();
+
 private:
     uint64_t m_id = 0;
     uint32_t m_stacksize = 0;
     State m_state = INIT;
-    ucontext_t m_ctx;
+    FiberContext m_ctx;
     void *m_stack = nullptr;
-    std::function<void()> m_cb;
+    Task m_cb;
+
+    bool m_useSharedStack = false;
+    // 共享栈协程第一次运行的线程，之后只能在这个线程上恢复（栈内容必须回到同一个地址）
+    int m_boundThread = -1;
+    std::shared_ptr<FiberSharedStack> m_sharedStack;
+    // 切出时的栈指针（保守估计），[m_sharedSp, 栈顶) 就是需要保存的部分
+    char *m_sharedSp = nullptr;
+    char *m_savedStack = nullptr;
+    size_t m_savedSize = 0;
+    size_t m_savedCapacity = 0;
 };
 } // namespace sylar
 #endif
\ No newline at end of file
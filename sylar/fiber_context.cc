@@ -0,0 +1,179 @@
+#include "fiber_context.h"
+#include <cstdint>
+#include <cstring>
+
+#ifndef SYLAR_FIBER_CONTEXT_UCONTEXT
+// 新上下文第一次被切入时从这里开始执行：汇编切换函数 ret 到这里，再调用保存在寄存器里的入口
+extern "C" void sylar_fiber_context_start();
+#endif
+
+namespace sylar
+{
+
+#ifdef SYLAR_FIBER_CONTEXT_UCONTEXT
+
+int FiberContext::init()
+{
+    return getcontext(&m_ctx);
+}
+
+int FiberContext::make(void *stack, size_t size, Entry entry)
+{
+    if (getcontext(&m_ctx))
+    {
+        return -1;
+    }
+    m_ctx.uc_link = nullptr;
+    m_ctx.uc_stack.ss_sp = stack;
+    m_ctx.uc_stack.ss_size = size;
+    makecontext(&m_ctx, entry, 0);
+    return 0;
+}
+
+int FiberContext::swapTo(FiberContext &to)
+{
+    return swapcontext(&m_ctx, &to.m_ctx);
+}
+
+const char *FiberContext::Backend()
+{
+    return "ucontext";
+}
+
+#elif defined(__x86_64__)
+
+// 栈顶的初始帧要和 sylar_fiber_swap_context 恢复的顺序一致：
+// [mxcsr|x87 cw] r12 r13 r14 r15 rbx rbp ret
+int FiberContext::make(void *stack, size_t size, Entry entry)
+{
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+    uint64_t *frame = (uint64_t *)(top - 64);
+    memset(frame, 0, 64);
+    uint32_t mxcsr = 0x1F80;
+    uint16_t fpu_cw = 0x037F;
+    memcpy((char *)frame, &mxcsr, sizeof(mxcsr));
+    memcpy((char *)frame + 4, &fpu_cw, sizeof(fpu_cw));
+    frame[1] = (uint64_t)entry; // r12
+    frame[7] = (uint64_t)&sylar_fiber_context_start; // ret
+    m_sp = frame;
+    return 0;
+}
+
+const char *FiberContext::Backend()
+{
+    return "asm-x86_64";
+}
+
+#elif defined(__aarch64__)
+
+// 初始帧：x19-x28, x29, x30, d8-d15，共 160 字节，x30 即第一次切入后的返回地址
+int FiberContext::make(void *stack, size_t size, Entry entry)
+{
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+    uint64_t *frame = (uint64_t *)(top - 160);
+    memset(frame, 0, 160);
+    frame[0] = (uint64_t)entry; // x19
+    frame[11] = (uint64_t)&sylar_fiber_context_start; // x30
+    m_sp = frame;
+    return 0;
+}
+
+const char *FiberContext::Backend()
+{
+    return "asm-aarch64";
+}
+
+#endif
+
+} // namespace sylar
+
+#if !defined(SYLAR_FIBER_CONTEXT_UCONTEXT) && defined(__x86_64__)
+// void sylar_fiber_swap_context(void **from_sp, void *to_sp)
+// 只保存 System V ABI 规定的 callee-saved 寄存器和浮点控制字，不碰信号掩码
+__asm__(".text\n"
+        ".globl sylar_fiber_swap_context\n"
+        ".type sylar_fiber_swap_context,@function\n"
+        ".align 16\n"
+        "sylar_fiber_swap_context:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r15\n"
+        "    pushq %r14\n"
+        "    pushq %r13\n"
+        "    pushq %r12\n"
+        "    subq $8, %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    addq $8, %rsp\n"
+        "    popq %r12\n"
+        "    popq %r13\n"
+        "    popq %r14\n"
+        "    popq %r15\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size sylar_fiber_swap_context,.-sylar_fiber_swap_context\n"
+        "\n"
+        ".globl sylar_fiber_context_start\n"
+        ".hidden sylar_fiber_context_start\n"
+        ".type sylar_fiber_context_start,@function\n"
+        ".align 16\n"
+        "sylar_fiber_context_start:\n"
+        "    .cfi_startproc\n"
+        "    .cfi_undefined rip\n"
+        "    callq *%r12\n"
+        "    ud2\n"
+        "    .cfi_endproc\n"
+        ".size sylar_fiber_context_start,.-sylar_fiber_context_start\n");
+#elif !defined(SYLAR_FIBER_CONTEXT_UCONTEXT) && defined(__aarch64__)
+// void sylar_fiber_swap_context(void **from_sp, void *to_sp)
+// 保存 AAPCS64 规定的 x19-x30 以及 d8-d15
+__asm__(".text\n"
+        ".globl sylar_fiber_swap_context\n"
+        ".type sylar_fiber_swap_context,%function\n"
+        ".align 4\n"
+        "sylar_fiber_swap_context:\n"
+        "    sub sp, sp, #160\n"
+        "    stp x19, x20, [sp, #0]\n"
+        "    stp x21, x22, [sp, #16]\n"
+        "    stp x23, x24, [sp, #32]\n"
+        "    stp x25, x26, [sp, #48]\n"
+        "    stp x27, x28, [sp, #64]\n"
+        "    stp x29, x30, [sp, #80]\n"
+        "    stp d8, d9, [sp, #96]\n"
+        "    stp d10, d11, [sp, #112]\n"
+        "    stp d12, d13, [sp, #128]\n"
+        "    stp d14, d15, [sp, #144]\n"
+        "    mov x9, sp\n"
+        "    str x9, [x0]\n"
+        "    mov sp, x1\n"
+        "    ldp x19, x20, [sp, #0]\n"
+        "    ldp x21, x22, [sp, #16]\n"
+        "    ldp x23, x24, [sp, #32]\n"
+        "    ldp x25, x26, [sp, #48]\n"
+        "    ldp x27, x28, [sp, #64]\n"
+        "    ldp x29, x30, [sp, #80]\n"
+        "    ldp d8, d9, [sp, #96]\n"
+        "    ldp d10, d11, [sp, #112]\n"
+        "    ldp d12, d13, [sp, #128]\n"
+        "    ldp d14, d15, [sp, #144]\n"
+        "    add sp, sp, #160\n"
+        "    ret\n"
+        ".size sylar_fiber_swap_context,.-sylar_fiber_swap_context\n"
+        "\n"
+        ".globl sylar_fiber_context_start\n"
+        ".hidden sylar_fiber_context_start\n"
+        ".type sylar_fiber_context_start,%function\n"
+        ".align 4\n"
+        "sylar_fiber_context_start:\n"
+        "    .cfi_startproc\n"
+        "    .cfi_undefined x30\n"
+        "    blr x19\n"
+        "    brk #0\n"
+        "    .cfi_endproc\n"
+        ".size sylar_fiber_context_start,.-sylar_fiber_context_start\n");
+#endif
@@ -0,0 +1,64 @@
+#ifndef __SYLAR_FIBER_CONTEXT_H__
+#define __SYLAR_FIBER_CONTEXT_H__
+
+#include <cstddef>
+
+/**
+ * @brief 协程上下文后端
+ *
+ * 默认使用手写汇编切换，只保存 callee-saved 寄存器，不经过 rt_sigprocmask 系统调用；
+ * 构建时打开 SYLAR_FIBER_CONTEXT_UCONTEXT（cmake -DSYLAR_FIBER_CONTEXT=ucontext），
+ * 或者在不支持的架构上，退回到 ucontext 实现。
+ */
+#if !defined(SYLAR_FIBER_CONTEXT_UCONTEXT) && !defined(__x86_64__) && !defined(__aarch64__)
+#define SYLAR_FIBER_CONTEXT_UCONTEXT
+#endif
+
+#ifdef SYLAR_FIBER_CONTEXT_UCONTEXT
+#include <ucontext.h>
+#else
+extern "C" void sylar_fiber_swap_context(void **from_sp, void *to_sp);
+#endif
+
+namespace sylar
+{
+class FiberContext
+{
+public:
+    typedef void (*Entry)();
+
+    // 记录当前线程的执行上下文，主协程使用；返回 0 表示成功
+    int init();
+    // 在 [stack, stack + size) 上构造一个从 entry 开始执行的上下文
+    int make(void *stack, size_t size, Entry entry);
+    // 把当前执行流保存到自己，然后切换到 to
+    int swapTo(FiberContext &to);
+
+    // 当前构建使用的后端名字，便于日志和基准测试输出
+    static const char *Backend();
+
+private:
+#ifdef SYLAR_FIBER_CONTEXT_UCONTEXT
+    ucontext_t m_ctx;
+#else
+    void *m_sp = nullptr;
+#endif
+};
+
+#ifndef SYLAR_FIBER_CONTEXT_UCONTEXT
+inline int FiberContext::init()
+{
+    // 汇编后端在切出时才写入栈指针，这里不需要做任何事
+    return 0;
+}
+
+inline int FiberContext::swapTo(FiberContext &to)
+{
+    sylar_fiber_swap_context(&m_sp, to.m_sp);
+    return 0;
+}
+#endif
+
+} // namespace sylar
+
+#endif
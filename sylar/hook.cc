@@ -1,7 +1,9 @@
 #include "hook.h"
 #include "fiber.h"
 #include "sylar/config.h"
+#include "sylar/epoch.h"
 #include "sylar/fd_manager.h"
+#include "sylar/io_uring.h"
 #include "sylar/iomanager.h"
 #include "sylar/log.h"
 #include "sylar/scheduler.h"
@@ -9,9 +11,12 @@
 #include <fcntl.h>
 
 #include <functional>
+#include <linux/io_uring.h>
 #include <memory>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 namespace sylar
@@ -28,6 +33,7 @@ static sylar::ConfigVar<int>::ptr g_tcp_connect_timeout =
     XX(socket)                                                                                     \
     XX(connect)                                                                                    \
     XX(accept)                                                                                     \
+    XX(accept4)                                                                                    \
     XX(read)                                                                                       \
     XX(readv)                                                                                      \
     XX(recv)                                                                                       \
@@ -38,6 +44,7 @@ static sylar::ConfigVar<int>::ptr g_tcp_connect_timeout =
     XX(send)                                                                                       \
     XX(sendto)                                                                                     \
     XX(sendmsg)                                                                                    \
+    XX(sendfile)                                                                                   \
     XX(close)                                                                                      \
     XX(fcntl)                                                                                      \
     XX(ioctl)                                                                                      \
@@ -89,10 +96,77 @@ void set_hook_enable(bool flag)
 }
 } // namespace sylar
 
-struct timer_info
+// 协程让出后可能在别的线程上恢复，而 __errno_location 声明成了 const，
+// 编译器会沿用让出之前算好的 errno 地址；让出之后读写 errno 都经过这两个函数
+static int __attribute__((noinline)) get_errno()
 {
-    int cancelled = 0;
-};
+    return errno;
+}
+
+static void __attribute__((noinline)) set_errno(int err)
+{
+    errno = err;
+}
+
+static sylar::UringOp make_uring_op(
+    uint8_t opcode, int fd, const void *addr, uint32_t len, uint64_t off = 0, uint32_t flags = 0)
+{
+    sylar::UringOp op;
+    op.opcode = opcode;
+    op.fd = fd;
+    op.addr = (uint64_t)(uintptr_t)addr;
+    op.len = len;
+    op.off = off;
+    op.op_flags = flags;
+    return op;
+}
+
+// 把操作交给 io_uring 执行，返回 false 表示没有走 io_uring，调用方按 epoll 方式处理
+static bool
+do_uring_io(const sylar::UringOp &op, uint32_t event, uint64_t timeout_ms, ssize_t &n)
+{
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    if (!iom || !iom->isUringEnabled())
+    {
+        return false;
+    }
+    // 要跨越让出比较 fd 是不是换了上下文，这里持有一份引用
+    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(op.fd);
+    while (true)
+    {
+        int res = 0;
+        if (!iom->uringIo(op, (sylar::IOManager::Event)event, timeout_ms, res))
+        {
+            return false;
+        }
+        // 内核没有挂起等待而是直接返回了 EAGAIN，交给 epoll 去等
+        if (res == -EAGAIN)
+        {
+            return false;
+        }
+        // 被 cancelEvent/cancelAll 打断：fd 已经关闭就返回 EBADF，否则和 epoll 方式一样接着等
+        if (res == -ECANCELED)
+        {
+            if (sylar::FdMgr::GetInstance()->get(op.fd) != ctx)
+            {
+                set_errno(EBADF);
+                n = -1;
+                return true;
+            }
+            continue;
+        }
+        if (res < 0)
+        {
+            set_errno(-res);
+            n = -1;
+        }
+        else
+        {
+            n = res;
+        }
+        return true;
+    }
+}
 
 template <typename OriginFun, typename... Args>
 static ssize_t do_io(int fd,
@@ -100,6 +174,7 @@ static ssize_t do_io(int fd,
                      const char *hook_fun_name,
                      uint32_t event,
                      int timeout_so,
+                     const sylar::UringOp *uop,
                      Args &&...args)
 {
     // 1、如果线程没有开启hook，就运行系统调用
@@ -108,87 +183,72 @@ static ssize_t do_io(int fd,
         return fun(fd, std::forward<Args>(args)...);
     }
     // 2、判断是不是对socket执行方法，不是就运行系统调用
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-    if (!ctx)
+    // fd 上下文只在 EpochGuard 里用裸指针读，不复制 shared_ptr；
+    // 守卫要在可能阻塞的系统调用之前结束，否则会拖住回收
+    bool hooked = false;
+    uint64_t to = 0;
     {
-        return fun(fd, std::forward<Args>(args)...);
-    }
-    // 3、是socket，但是仍然不能继续往下走的情况
+        sylar::EpochGuard guard;
+        sylar::FdCtx *ctx = sylar::FdMgr::GetInstance()->lookup(fd);
+        // 3、是socket，但是仍然不能继续往下走的情况
 
-    // 对应的fd关闭了
-    if (ctx->isClose())
-    {
-        errno = EBADF;
-        return -1;
+        // 对应的fd关闭了
+        if (ctx && ctx->isClose())
+        {
+            errno = EBADF;
+            return -1;
+        }
+        // 如果不是socket，或者用户设置了非阻塞，就运行系统调用
+        hooked = ctx && ctx->isSocket() && !ctx->getUserNonblock();
+        if (hooked)
+        {
+            to = ctx->getTimeout(timeout_so);
+        }
     }
-    // 如果不是socket，或者用户设置了非阻塞，就运行系统调用
-    if (!ctx->isSocket() || ctx->getUserNonblock())
+    if (!hooked)
     {
         return fun(fd, std::forward<Args>(args)...);
     }
     // 4、执行socket操作
-    uint64_t to = ctx->getTimeout(timeout_so);
-    std::shared_ptr<timer_info> tinfo(new timer_info());
+    // 启用了 io_uring 时直接把操作提交给内核，由完成事件恢复协程，不用先试一次再等 epoll
+    if (uop)
+    {
+        ssize_t n = 0;
+        if (do_uring_io(*uop, event, to, n))
+        {
+            return n;
+        }
+    }
     // 4.1 先使用系统调用直接执行，因为大多数socket其实是准备好了的，直接系统调用最快，
     // 你注册进epoll反而是资源浪费，影响性能
 retry:
     ssize_t n = fun(fd, std::forward<Args>(args)...);
-    while (n == -1 && errno == EINTR)
+    while (n == -1 && get_errno() == EINTR)
     {
         n = fun(fd, std::forward<Args>(args)...);
     }
     // 4.2 如果系统调用返回EAGAIN，说明socket还没有准备好，
     // 这时候就需要注册到epoll，等待事件发生，交给调度器管理去了
-    if (n == -1 && (errno == EAGAIN))
+    if (n == -1 && get_errno() == EAGAIN)
     {
         sylar::IOManager *iom = sylar::IOManager::GetThis();
-        sylar::Timer::ptr timer;
-        std::weak_ptr<timer_info> winfo(tinfo);
         // uint64_t是无符号整数，-1 强转 代表的是最大值
-        //这里就表示的超时怎么办（协程设置为超时，正常返回错误）
-        if (to != (uint64_t)-1)
-        {
-            timer = iom->addConditionTimer(
-                to,
-                [winfo, fd, iom, event]()
-                {
-                    auto t = winfo.lock();
-                    if (!t || t->cancelled)
-                    {
-                        return;
-                    }
-                    t->cancelled = ETIMEDOUT;
-                    iom->cancelEvent(fd, (sylar::IOManager::Event)event);
-                },
-                winfo);
-        }
-        //正常是返回0，错误返回-1
-        int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
+        // 超时截止时间记在 fd 的事件上下文里，由 IOManager 的定时器检查，这里不用分配任何东西
+        int rt = iom->waitEvent(fd, (sylar::IOManager::Event)(event), to);
         //发生错误才执行后面的
-        if (rt)
+        if (rt == -1)
         {
             SYLAR_LOG_ERROR(g_logger)
                 << hook_fun_name << " addEvent(" << fd << ", " << event << ")";
-            if (timer)
-            {
-                timer->cancel();
-            }
             return -1;
         }
-        else
+        //协程设置为超时，正常返回错误
+        if (rt)
         {
-            sylar::Fiber::YieldToHold();
-            if (timer)
-            {
-                timer->cancel();
-            }
-            if (tinfo->cancelled)
-            {
-                errno = tinfo->cancelled;
-                return -1;
-            }
-            goto retry;
+            set_errno(rt);
+            return -1;
         }
+        goto retry;
     }
     return n;
 }
@@ -215,9 +275,7 @@ unsigned int sleep(unsigned int seconds)
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager *iom = sylar::IOManager::GetThis();
     iom->addTimer(seconds * 1000,
-                  std::bind((void(sylar::Scheduler::*)(sylar::Fiber::ptr, int thread)) &
-                                sylar::IOManager::schedule,
-                            iom, fiber, -1));
+                  [iom, fiber]() { iom->schedule(fiber); });
     // 切换到其他协程，等待定时器到期
     sylar::Fiber::YieldToHold();
     return 0;
@@ -233,9 +291,7 @@ int usleep(useconds_t usec)
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager *iom = sylar::IOManager::GetThis();
     iom->addTimer(usec / 1000,
-                  std::bind((void(sylar::Scheduler::*)(sylar::Fiber::ptr, int thread)) &
-                                sylar::IOManager::schedule,
-                            iom, fiber, -1));
+                  [iom, fiber]() { iom->schedule(fiber); });
     // 切换到其他协程，等待定时器到期
     sylar::Fiber::YieldToHold();
     return 0;
@@ -299,57 +355,33 @@ int connect_with_timeout(int fd,
         return connect_f(fd, addr, addrlen);
     }
 
+    ssize_t un = 0;
+    if (do_uring_io(make_uring_op(IORING_OP_CONNECT, fd, addr, 0, addrlen),
+                    sylar::IOManager::WRITE, timeout_ms, un))
+    {
+        return un;
+    }
+
     int n = connect_f(fd, addr, addrlen);
     if (n == 0)
     {
         return 0;
     }
     // EINPROGRESS 连接正在建立（正常情况）
-    else if (n != -1 || errno != EINPROGRESS)
+    else if (n != -1 || get_errno() != EINPROGRESS)
     {
         return n;
     }
     auto iom = sylar::IOManager::GetThis();
-    sylar::Timer::ptr timer;
-    std::shared_ptr<timer_info> tinfo(new timer_info);
-    std::weak_ptr<timer_info> winfo(tinfo);
-    if (timeout_ms != (uint64_t)-1)
-    {
-        timer = iom->addConditionTimer(
-            timeout_ms,
-            [winfo, fd, iom]()
-            {
-                auto t = winfo.lock();
-                if (!t || t->cancelled)
-                {
-                    return;
-                }
-                t->cancelled = ETIMEDOUT;
-                iom->cancelEvent(fd, sylar::IOManager::WRITE);
-            },
-            winfo);
-    }
-    int rt = iom->addEvent(fd, sylar::IOManager::WRITE);
-    if (rt == 0)
-    {
-        sylar::Fiber::YieldToHold();
-        //后面的代码其实就代表着协程恢复之后，也就是说connect已经连接成功了,也就不用timer了
-        if (timer)
-        {
-            timer->cancel();
-        }
-        if (tinfo->cancelled)
-        {
-            errno = tinfo->cancelled;
-            return -1;
-        }
+    int rt = iom->waitEvent(fd, sylar::IOManager::WRITE, timeout_ms);
+    //后面的代码其实就代表着协程恢复之后，也就是说connect已经连接成功了
+    if (rt == ETIMEDOUT)
+    {
+        set_errno(rt);
+        return -1;
     }
-    else
+    else if (rt)
     {
-        if (timer)
-        {
-            timer->cancel();
-        }
         SYLAR_LOG_ERROR(g_logger) << "connect addEvent(" << fd << ", WRITE) error";
     }
     // epoll返回wirte只能代表事件状态发生变化，不能说明真的连接成功，所以还得正式查看一下
@@ -367,7 +399,7 @@ int connect_with_timeout(int fd,
     //这里代表的是connect失败
     else
     {
-        errno = error;
+        set_errno(error);
         return -1;
     }
 }
@@ -378,7 +410,8 @@ int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 }
 int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
 {
-    int fd = do_io(s, accept_f, "accept", sylar::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+    sylar::UringOp op = make_uring_op(IORING_OP_ACCEPT, s, addr, 0, (uint64_t)(uintptr_t)addrlen);
+    int fd = do_io(s, accept_f, "accept", sylar::IOManager::READ, SO_RCVTIMEO, &op, addr, addrlen);
     if (fd >= 0)
     {
         sylar::FdMgr::GetInstance()->get(fd, true);
@@ -386,60 +419,98 @@ int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
     return fd;
 }
 
+int accept4(int s, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+    sylar::UringOp op =
+        make_uring_op(IORING_OP_ACCEPT, s, addr, 0, (uint64_t)(uintptr_t)addrlen, flags);
+    int fd = do_io(
+        s, accept4_f, "accept4", sylar::IOManager::READ, SO_RCVTIMEO, &op, addr, addrlen, flags);
+    if (fd >= 0)
+    {
+        //带 SOCK_NONBLOCK 时已经是非阻塞的了，直接登记
+        if (flags & SOCK_NONBLOCK)
+        {
+            sylar::FdMgr::GetInstance()->addSocket(fd);
+        }
+        else
+        {
+            sylar::FdMgr::GetInstance()->get(fd, true);
+        }
+    }
+    return fd;
+}
+
 // read
 ssize_t read(int fd, void *buf, size_t count)
 {
-    return do_io(fd, read_f, "read", sylar::IOManager::READ, SO_RCVTIMEO, buf, count);
+    sylar::UringOp op = make_uring_op(IORING_OP_READ, fd, buf, count, (uint64_t)-1);
+    return do_io(fd, read_f, "read", sylar::IOManager::READ, SO_RCVTIMEO, &op, buf, count);
 }
 
 ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
 {
-    return do_io(fd, readv_f, "readv", sylar::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+    sylar::UringOp op = make_uring_op(IORING_OP_READV, fd, iov, iovcnt, (uint64_t)-1);
+    return do_io(fd, readv_f, "readv", sylar::IOManager::READ, SO_RCVTIMEO, &op, iov, iovcnt);
 }
 
 ssize_t recv(int sockfd, void *buf, size_t len, int flags)
 {
-    return do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    sylar::UringOp op = make_uring_op(IORING_OP_RECV, sockfd, buf, len, 0, flags);
+    return do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO, &op, buf, len,
+                 flags);
 }
 
 ssize_t recvfrom(
     int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen)
 {
-    return do_io(sockfd, recvfrom_f, "recvfrom", sylar::IOManager::READ, SO_RCVTIMEO, buf, len,
-                 flags, src_addr, addrlen);
+    return do_io(sockfd, recvfrom_f, "recvfrom", sylar::IOManager::READ, SO_RCVTIMEO, nullptr, buf,
+                 len, flags, src_addr, addrlen);
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
 {
-    return do_io(sockfd, recvmsg_f, "recvmsg", sylar::IOManager::READ, SO_RCVTIMEO, msg, flags);
+    sylar::UringOp op = make_uring_op(IORING_OP_RECVMSG, sockfd, msg, 1, 0, flags);
+    return do_io(sockfd, recvmsg_f, "recvmsg", sylar::IOManager::READ, SO_RCVTIMEO, &op, msg,
+                 flags);
 }
 
 // write
 ssize_t write(int fd, const void *buf, size_t count)
 {
-    return do_io(fd, write_f, "write", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count);
+    sylar::UringOp op = make_uring_op(IORING_OP_WRITE, fd, buf, count, (uint64_t)-1);
+    return do_io(fd, write_f, "write", sylar::IOManager::WRITE, SO_SNDTIMEO, &op, buf, count);
 }
 
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
 {
-    return do_io(fd, writev_f, "writev", sylar::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+    sylar::UringOp op = make_uring_op(IORING_OP_WRITEV, fd, iov, iovcnt, (uint64_t)-1);
+    return do_io(fd, writev_f, "writev", sylar::IOManager::WRITE, SO_SNDTIMEO, &op, iov, iovcnt);
 }
 
 ssize_t send(int s, const void *msg, size_t len, int flags)
 {
-    return do_io(s, send_f, "send", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
+    sylar::UringOp op = make_uring_op(IORING_OP_SEND, s, msg, len, 0, flags);
+    return do_io(s, send_f, "send", sylar::IOManager::WRITE, SO_SNDTIMEO, &op, msg, len, flags);
 }
 
 ssize_t
 sendto(int s, const void *msg, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
 {
-    return do_io(s, sendto_f, "sendto", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags, to,
-                 tolen);
+    return do_io(s, sendto_f, "sendto", sylar::IOManager::WRITE, SO_SNDTIMEO, nullptr, msg, len,
+                 flags, to, tolen);
 }
 
 ssize_t sendmsg(int s, const struct msghdr *msg, int flags)
 {
-    return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+    sylar::UringOp op = make_uring_op(IORING_OP_SENDMSG, s, msg, 1, 0, flags);
+    return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, &op, msg, flags);
+}
+
+// io_uring 没有对应的操作，走 epoll 等可写
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    return do_io(out_fd, sendfile_f, "sendfile", sylar::IOManager::WRITE, SO_SNDTIMEO, nullptr,
+                 in_fd, offset, count);
 }
 
 int close(int fd)
@@ -451,12 +522,13 @@ int close(int fd)
     sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
     if (ctx)
     {
+        //先摘掉 FdCtx 再取消，被取消的 io_uring 操作据此知道 fd 已经关闭，不会重新提交
+        sylar::FdMgr::GetInstance()->del(fd);
         sylar::IOManager *iom = sylar::IOManager::GetThis();
         if (iom)
         {
             iom->cancelAll(fd);
         }
-        sylar::FdMgr::GetInstance()->del(fd);
     }
     return close_f(fd);
 }
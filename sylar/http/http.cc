@@ -8,6 +8,109 @@ namespace sylar
 namespace http
 {
 
+namespace
+{
+
+// 不经过 iostream 的整数格式化
+void AppendUint(std::string &out, uint64_t v)
+{
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    do
+    {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    out.append(p, end - p);
+}
+
+int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// %XX 转回字节，'+' 转成空格，不合法的 % 原样保留
+std::string UrlDecode(const char *data, size_t len)
+{
+    std::string rt;
+    rt.reserve(len);
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (data[i] == '+')
+        {
+            rt.push_back(' ');
+        }
+        else if (data[i] == '%' && i + 2 < len && HexValue(data[i + 1]) >= 0 &&
+                 HexValue(data[i + 2]) >= 0)
+        {
+            rt.push_back((char)(HexValue(data[i + 1]) << 4 | HexValue(data[i + 2])));
+            i += 2;
+        }
+        else
+        {
+            rt.push_back(data[i]);
+        }
+    }
+    return rt;
+}
+
+// 0x11 -> "HTTP/1.1"
+void AppendVersion(std::string &out, uint8_t version)
+{
+    out.append("HTTP/");
+    AppendUint(out, version >> 4);
+    out.append(".");
+    AppendUint(out, version & 0x0F);
+}
+
+// "a=1&b=2"、"a=1; b=2" 这样的键值对，已经有的键不覆盖；cookie 不做 url 解码
+void ParseParams(const char *data, size_t len, char sep, bool decode, HttpRequest::MapType &out)
+{
+    const char *end = data + len;
+    while (data < end)
+    {
+        const char *item_end = (const char *)memchr(data, sep, end - data);
+        if (!item_end)
+        {
+            item_end = end;
+        }
+        while (data < item_end && *data == ' ')
+        {
+            ++data;
+        }
+        const char *eq = (const char *)memchr(data, '=', item_end - data);
+        if (eq && eq != data)
+        {
+            if (decode)
+            {
+                out.insert(std::make_pair(UrlDecode(data, eq - data),
+                                          UrlDecode(eq + 1, item_end - eq - 1)));
+            }
+            else
+            {
+                out.insert(std::make_pair(std::string(data, eq - data),
+                                          std::string(eq + 1, item_end - eq - 1)));
+            }
+        }
+        data = item_end + 1;
+    }
+}
+
+} // namespace
+
 HttpMethod StringToHttpMethod(const std::string &m)
 {
 #define XX(num, name, string)                                                                      \
@@ -82,29 +185,31 @@ std::shared_ptr<HttpResponse> HttpRequest::createResponse()
 
 std::string HttpRequest::getHeader(const std::string &key, const std::string &def) const
 {
-    auto it = m_headers.find(key);
-    return it == m_headers.end() ? def : it->second;
+    return m_headers.get(key, def);
 }
 
 std::string HttpRequest::getParam(const std::string &key, const std::string &def) const
 {
+    initParam();
     auto it = m_params.find(key);
     return it == m_params.end() ? def : it->second;
 }
 
 std::string HttpRequest::getCookie(const std::string &key, const std::string &def) const
 {
+    initCookies();
     auto it = m_cookies.find(key);
     return it == m_cookies.end() ? def : it->second;
 }
 
 void HttpRequest::setHeader(const std::string &key, const std::string &val)
 {
-    m_headers[key] = val;
+    m_headers.set(key, val);
 }
 
 void HttpRequest::setParam(const std::string &key, const std::string &val)
 {
+    //懒解析只插入还没有的键，这里设置的不会被覆盖，不用先解析
     m_params[key] = val;
 }
 
@@ -115,35 +220,29 @@ void HttpRequest::setCookie(const std::string &key, const std::string &val)
 
 void HttpRequest::delHeader(const std::string &key)
 {
-    m_headers.erase(key);
+    m_headers.del(key);
 }
 
 void HttpRequest::delParam(const std::string &key)
 {
+    initParam();
     m_params.erase(key);
 }
 
 void HttpRequest::delCookie(const std::string &key)
 {
+    initCookies();
     m_cookies.erase(key);
 }
 
 bool HttpRequest::hasHeader(const std::string &key, std::string *val)
 {
-    auto it = m_headers.find(key);
-    if (it == m_headers.end())
-    {
-        return false;
-    }
-    if (val)
-    {
-        *val = it->second;
-    }
-    return true;
+    return m_headers.has(key, val);
 }
 
 bool HttpRequest::hasParam(const std::string &key, std::string *val)
 {
+    initParam();
     auto it = m_params.find(key);
     if (it == m_params.end())
     {
@@ -158,6 +257,7 @@ bool HttpRequest::hasParam(const std::string &key, std::string *val)
 
 bool HttpRequest::hasCookie(const std::string &key, std::string *val)
 {
+    initCookies();
     auto it = m_cookies.find(key);
     if (it == m_cookies.end())
     {
@@ -170,42 +270,114 @@ bool HttpRequest::hasCookie(const std::string &key, std::string *val)
     return true;
 }
 
+void HttpRequest::initParam() const
+{
+    initQueryParam();
+    initBodyParam();
+}
+
+void HttpRequest::initQueryParam() const
+{
+    if (m_parserParamFlag & QUERY_PARSED)
+    {
+        return;
+    }
+    m_parserParamFlag |= QUERY_PARSED;
+    ParseParams(m_query.data(), m_query.size(), '&', true, m_params);
+}
+
+void HttpRequest::initBodyParam() const
+{
+    if (m_parserParamFlag & BODY_PARSED)
+    {
+        return;
+    }
+    m_parserParamFlag |= BODY_PARSED;
+    int idx = m_headers.indexOf(HttpHeader::CONTENT_TYPE);
+    if (idx < 0)
+    {
+        return;
+    }
+    static const char s_form[] = "application/x-www-form-urlencoded";
+    HttpHeaders::Slice type = m_headers.value(idx);
+    if (type.size < sizeof(s_form) - 1 || strncasecmp(type.data, s_form, sizeof(s_form) - 1))
+    {
+        return;
+    }
+    ParseParams(m_body.data(), m_body.size(), '&', true, m_params);
+}
+
+void HttpRequest::initCookies() const
+{
+    if (m_parserParamFlag & COOKIE_PARSED)
+    {
+        return;
+    }
+    m_parserParamFlag |= COOKIE_PARSED;
+    int idx = m_headers.indexOf(HttpHeader::COOKIE);
+    if (idx < 0)
+    {
+        return;
+    }
+    HttpHeaders::Slice cookie = m_headers.value(idx);
+    ParseParams(cookie.data, cookie.size, ';', false, m_cookies);
+}
+
 std::ostream &HttpRequest::dump(std::ostream &os) const
+{
+    std::string head;
+    dumpHead(head);
+    return os << head << m_body;
+}
+
+void HttpRequest::dumpHead(std::string &out) const
 {
     // GET /uri HTTP/1.1
     // Host: wwww.sylar.top
 
-    os << HttpMethodToString(m_method) << " " << m_path << (m_query.empty() ? "" : "?") << m_query
-       << (m_fragment.empty() ? "" : "#") << m_fragment
-       << " HTTP/"
-       // m_version 不是字符串
-       // "1.1"，而是一个字节编码值。高四位直接拿到，低四位&0x0F为了输出时清掉高四位
-       << ((uint32_t)(m_version >> 4)) << "." << ((uint32_t)(m_version & 0x0F)) << "\r\n";
+    out.append(HttpMethodToString(m_method)).append(" ").append(m_path);
+    if (!m_query.empty())
+    {
+        out.append("?").append(m_query);
+    }
+    if (!m_fragment.empty())
+    {
+        out.append("#").append(m_fragment);
+    }
+    // m_version 不是字符串
+    // "1.1"，而是一个字节编码值。高四位直接拿到，低四位&0x0F为了输出时清掉高四位
+    out.append(" ");
+    AppendVersion(out, m_version);
+    out.append("\r\n");
     if (!m_websocket)
     {
-        os << "connection: " << (m_close ? "close" : "keep-alive") << "\r\n";
+        out.append("connection: ").append(m_close ? "close" : "keep-alive").append("\r\n");
     }
-    for (auto &i : m_headers)
+    for (size_t i = 0; i < m_headers.size(); ++i)
     {
-        if (!m_websocket && strcasecmp(i.first.c_str(), "connection") == 0)
+        HttpHeaders::Slice name = m_headers.name(i);
+        if (!m_websocket && name.size == 10 && strncasecmp(name.data, "connection", 10) == 0)
         {
             continue;
         }
-        os << i.first << ":" << i.second << "\r\n";
+        HttpHeaders::Slice value = m_headers.value(i);
+        out.append(name.data, name.size).append(":").append(value.data, value.size);
+        out.append("\r\n");
     }
 
     if (!m_body.empty())
     {
         //前一个 \r\n：结束 content-length 这一行(也就是说content-length其实还是在headers中)
         //后一个 \r\n：表示头部结束，body 开始
-        os << "content-length: " << m_body.size() << "\r\n\r\n" << m_body;
+        out.append("content-length: ");
+        AppendUint(out, m_body.size());
+        out.append("\r\n\r\n");
     }
     else
     {
         //没有 body，也仍然要补一个空行，表示请求头结束。
-        os << "\r\n";
+        out.append("\r\n");
     }
-    return os;
 }
 
 std::string HttpRequest::toString() const
@@ -221,20 +393,16 @@ HttpResponse::HttpResponse(uint8_t version, bool close)
 }
 std::string HttpResponse::getHeader(const std::string &key, const std::string &def) const
 {
-    auto it = m_headers.find(key);
-    if (it != m_headers.end())
-    {
-        return it->second;
-    }
-    return def;
+    return m_headers.get(key, def);
 }
 void HttpResponse::setHeader(const std::string &key, const std::string &val)
 {
-    m_headers[key] = val;
+    m_headers.set(key, val);
 }
+
 void HttpResponse::delHeader(const std::string &key)
 {
-    m_headers.erase(key);
+    m_headers.del(key);
 }
 
 std::string HttpResponse::toString() const
@@ -246,30 +414,51 @@ std::string HttpResponse::toString() const
 
 std::ostream &HttpResponse::dump(std::ostream &os) const
 {
-    os << "HTTP/" << (uint32_t)(m_version >> 4) << "." << (uint32_t)(m_version & 0x0F) << " "
-       << (uint32_t)m_status << " " << (m_reason.empty() ? HttpStatusToString(m_status) : m_reason)
-       << "\r\n";
-    for (auto &i : m_headers)
+    std::string head;
+    dumpHead(head);
+    return os << head << m_body;
+}
+
+void HttpResponse::dumpHead(std::string &out) const
+{
+    AppendVersion(out, m_version);
+    out.append(" ");
+    AppendUint(out, (uint32_t)m_status);
+    out.append(" ");
+    if (m_reason.empty())
+    {
+        out.append(HttpStatusToString(m_status));
+    }
+    else
+    {
+        out.append(m_reason);
+    }
+    out.append("\r\n");
+    for (size_t i = 0; i < m_headers.size(); ++i)
     {
-        if (!m_websocket && strcasecmp(i.first.c_str(), "connection") == 0)
+        HttpHeaders::Slice name = m_headers.name(i);
+        if (!m_websocket && name.size == 10 && strncasecmp(name.data, "connection", 10) == 0)
         {
             continue;
         }
-        os << i.first << ": " << i.second << "\r\n";
+        HttpHeaders::Slice value = m_headers.value(i);
+        out.append(name.data, name.size).append(": ").append(value.data, value.size);
+        out.append("\r\n");
     }
     if (!m_websocket)
     {
-        os << "connection: " << (m_close ? "close" : "keep-alive") << "\r\n";
+        out.append("connection: ").append(m_close ? "close" : "keep-alive").append("\r\n");
     }
     if (!m_body.empty())
     {
-        os << "content-length: " << m_body.size() << "\r\n\r\n" << m_body;
+        out.append("content-length: ");
+        AppendUint(out, m_body.size());
+        out.append("\r\n\r\n");
     }
     else
     {
-        os << "\r\n";
+        out.append("\r\n");
     }
-    return os;
 }
 
 std::ostream &operator<<(std::ostream &os, const HttpRequest &req)
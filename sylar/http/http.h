@@ -1,5 +1,6 @@
 #ifndef __SYLAR__HTTP_HTTP_H__
 #define __SYLAR__HTTP_HTTP_H__
+#include "http_header.h"
 #include <boost/lexical_cast.hpp>
 #include <iostream>
 #include <map>
@@ -218,16 +219,23 @@ public:
     {
         return m_body;
     }
-    const MapType &getHeaders() const
+    const HttpHeaders &getHeaders() const
     {
         return m_headers;
     }
+    HttpHeaders &getHeaders()
+    {
+        return m_headers;
+    }
+    // 参数和 cookie 第一次访问时才从 query/body/Cookie 头里解析出来
     const MapType &getParams() const
     {
+        initParam();
         return m_params;
     }
     const MapType &getCookies() const
     {
+        initCookies();
         return m_cookies;
     }
     void setMethod(HttpMethod v)
@@ -257,19 +265,23 @@ public:
     void setBody(const std::string &v)
     {
         m_body = v;
+        //请求体可能在参数已经被访问之后才读进来（路由参数、流式 servlet）
+        m_parserParamFlag &= ~BODY_PARSED;
     }
 
-    void setHeaders(const MapType &v)
+    void setHeaders(const HttpHeaders &v)
     {
         m_headers = v;
     }
     void setParams(const MapType &v)
     {
         m_params = v;
+        m_parserParamFlag |= QUERY_PARSED | BODY_PARSED;
     }
     void setCookies(const MapType &v)
     {
         m_cookies = v;
+        m_parserParamFlag |= COOKIE_PARSED;
     }
     bool isClose() const
     {
@@ -316,43 +328,54 @@ public:
     template <class T>
     bool checkGetHeaderAs(const std::string &key, T &val, const T &def = T())
     {
-        return checkGetAs(m_headers, key, val, def);
+        return m_headers.checkGetAs(key, val, def);
     }
 
     template <class T>
     T getHeaderAs(const std::string &key, const T &def = T())
     {
-        return getAs(m_headers, key, def);
+        return m_headers.getAs(key, def);
     }
 
     template <class T>
     bool checkGetParamAs(const std::string &key, T &val, const T &def = T())
     {
+        initParam();
         return checkGetAs(m_params, key, val, def);
     }
 
     template <class T>
     T getParamAs(const std::string &key, const T &def = T())
     {
+        initParam();
         return getAs(m_params, key, def);
     }
 
     template <class T>
     bool checkGetCookieAs(const std::string &key, T &val, const T &def = T())
     {
+        initCookies();
         return checkGetAs(m_cookies, key, val, def);
     }
 
     template <class T>
     T getCookieAs(const std::string &key, const T &def = T())
     {
+        initCookies();
         return getAs(m_cookies, key, def);
     }
 
     std::ostream &dump(std::ostream &os) const;
+    // 起始行和头部（到结束的空行为止）追加到 out 后面，不含 body，body 由调用者另外发送
+    void dumpHead(std::string &out) const;
     std::string toString() const;
 
 private:
+    void initParam() const;
+    void initQueryParam() const;
+    void initBodyParam() const;
+    void initCookies() const;
+
     // 检查map中是否有key并且返回对应的bool，，同时传入一个参数，有则转换为T类型，没有则返回def,
     //其实这种引用传递就做了多返回值的功能了
     template <class T>
@@ -406,9 +429,17 @@ private:
     std::string m_fragment;
     std::string m_body;
 
-    MapType m_headers;
-    MapType m_params;
-    MapType m_cookies;
+    HttpHeaders m_headers;
+    // 按需解析，const 的 get 里也会填充
+    mutable MapType m_params;
+    mutable MapType m_cookies;
+    enum
+    {
+        QUERY_PARSED = 0x1,
+        BODY_PARSED = 0x2,
+        COOKIE_PARSED = 0x4,
+    };
+    mutable uint8_t m_parserParamFlag = 0;
     /// 是否为websocket
     bool m_websocket;
 };
@@ -436,7 +467,11 @@ public:
     {
         return m_reason;
     }
-    const MapType &getHeaders() const
+    const HttpHeaders &getHeaders() const
+    {
+        return m_headers;
+    }
+    HttpHeaders &getHeaders()
     {
         return m_headers;
     }
@@ -457,7 +492,7 @@ public:
     {
         m_reason = v;
     }
-    void setHeaders(const MapType &v)
+    void setHeaders(const HttpHeaders &v)
     {
         m_headers = v;
     }
@@ -494,16 +529,18 @@ public:
     template <class T>
     bool checkGetHeaderAs(const std::string &key, T &val, const T &def = T())
     {
-        return checkGetAs(m_headers, key, val, def);
+        return m_headers.checkGetAs(key, val, def);
     }
 
     template <class T>
     T getHeaderAs(const std::string &key, const T &def = T())
     {
-        return getAs(m_headers, key, def);
+        return m_headers.getAs(key, def);
     }
 
     std::ostream &dump(std::ostream &os) const;
+    // 起始行和头部（到结束的空行为止）追加到 out 后面，不含 body，body 由调用者另外发送
+    void dumpHead(std::string &out) const;
     std::string toString() const;
 
 private:
@@ -513,7 +550,7 @@ private:
     std::string m_body;
     // 返回的状态码对应的string
     std::string m_reason;
-    MapType m_headers;
+    HttpHeaders m_headers;
     /// 是否为websocket
     bool m_websocket;
 };
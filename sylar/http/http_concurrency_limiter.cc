@@ -156,7 +156,7 @@ void HttpConcurrencyLimiter::releaseLocal(const std::string &endpoint_key)
 
 bool HttpConcurrencyLimiter::tryAcquireQps(const std::string &endpoint_key)
 {
-    uint64_t now_ms = sylar::GetCurrentMS();
+    uint64_t now_ms = sylar::CoarseMonoMs();
     bool global_acquired = false;
     static TokenBucket s_global_qps_bucket;
     if (m_options.max_global_qps > 0)
@@ -22,7 +22,7 @@ static uint64_t GetTimeoutLeft(uint64_t start_ms, uint64_t total_timeout_ms)
     {
         return s_http_timeout_forever;
     }
-    uint64_t now_ms = sylar::GetCurrentMS();
+    uint64_t now_ms = sylar::CoarseMonoMs();
     uint64_t elapsed = now_ms >= start_ms ? now_ms - start_ms : 0;
     return elapsed >= total_timeout_ms ? 0 : total_timeout_ms - elapsed;
 }
@@ -249,14 +249,22 @@ int HttpConnection::sendRequest(HttpRequest::ptr rsp)
 
 int HttpConnection::sendRequest(HttpRequest::ptr rsp, HttpAttemptOutcome *attempt)
 {
-    std::stringstream ss;
-    ss << *rsp;
-    std::string data = ss.str();
-    size_t offset = 0;
-    int64_t left = data.size();
+    //头部格式化进复用的缓冲，body 作为第二段直接发，不拷贝
+    m_sendBuf.clear();
+    rsp->dumpHead(m_sendBuf);
+    const std::string &body = rsp->getBody();
+    iovec iovs[2];
+    iovs[0].iov_base = &m_sendBuf[0];
+    iovs[0].iov_len = m_sendBuf.size();
+    iovs[1].iov_base = (void *)body.data();
+    iovs[1].iov_len = body.size();
+    iovec *iov = iovs;
+    size_t count = body.empty() ? 1 : 2;
+    size_t total = m_sendBuf.size() + body.size();
+    int64_t left = total;
     while (left > 0)
     {
-        int64_t len = write(data.c_str() + offset, left);
+        int64_t len = writev(iov, count);
         if (len <= 0)
         {
             if (attempt)
@@ -280,8 +288,8 @@ int HttpConnection::sendRequest(HttpRequest::ptr rsp, HttpAttemptOutcome *attemp
             attempt->request_bytes_started = true;
             attempt->request_bytes_sent += len;
         }
-        offset += len;
         left -= len;
+        AdvanceIovec(iov, count, len);
     }
 
     if (attempt)
@@ -289,7 +297,7 @@ int HttpConnection::sendRequest(HttpRequest::ptr rsp, HttpAttemptOutcome *attemp
         attempt->request_bytes_completed = true;
         attempt->may_have_submitted = true;
     }
-    return data.size();
+    return total;
 }
 
 HttpResult::ptr HttpConnection::DoGet(const std::string &url,
@@ -447,7 +455,7 @@ HttpResult::ptr HttpConnection::DoRequest(HttpRequest::ptr req, Uri::ptr uri, ui
 HttpResult::ptr
 HttpConnection::DoRequest(HttpRequest::ptr req, Uri::ptr uri, const HttpRequestOptions &options)
 {
-    uint64_t start_ms = sylar::GetCurrentMS();
+    uint64_t start_ms = sylar::CoarseMonoMs();
     HttpAttemptOutcome attempt;
     bool is_ssl = uri->getScheme() == "https";
     Address::ptr addr = uri->createAddress();
@@ -619,11 +627,11 @@ HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms)
 HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms,
                                                       const HttpRequestOptions &options)
 {
-    uint64_t start_ms = sylar::GetCurrentMS();
+    uint64_t start_ms = sylar::CoarseMonoMs();
     std::vector<HttpConnection *> invalid_conns;
     while (true)
     {
-        uint64_t now_ms = sylar::GetCurrentMS();
+        uint64_t now_ms = sylar::CoarseMonoMs();
         HttpConnection *ptr = nullptr;
         bool need_create = false;
         Waiter::ptr waiter;
@@ -686,7 +694,8 @@ HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms,
             IPAddress::ptr addr = Address::LookupAnyIPAddress(m_host);
             if (!addr)
             {
-                SYLAR_LOG_ERROR(g_logger) << "get addr fail: " << m_host;
+                SYLAR_LOG_RATE_LIMITED(g_logger, LogLevel::ERROR, 10, 20)
+                    << "get addr fail: " << m_host;
                 MutexType::Lock lock(m_mutex);
                 --m_total;
                 notifyWaiter();
@@ -710,7 +719,9 @@ HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms,
             uint64_t connect_timeout_ms = MergeTimeout(timeout_ms, start_ms, timeout_ms);
             if (!sock->connect(addr, connect_timeout_ms))
             {
-                SYLAR_LOG_ERROR(g_logger) << "sock connect fail: " << *addr;
+                //上游挂了时每个请求都连不上，按调用点限流
+                SYLAR_LOG_RATE_LIMITED(g_logger, LogLevel::ERROR, 10, 20)
+                    << "sock connect fail: " << *addr;
                 MutexType::Lock lock(m_mutex);
                 --m_total;
                 notifyWaiter();
@@ -718,7 +729,7 @@ HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms,
             }
 
             ptr = new HttpConnection(sock);
-            ptr->m_createTime = sylar::GetCurrentMS();
+            ptr->m_createTime = sylar::CoarseMonoMs();
             return HttpConnection::ptr(
                 ptr, std::bind(&HttpConnectionPool::ReleasePtr, std::placeholders::_1, this));
         }
@@ -771,7 +782,7 @@ HttpConnection::ptr HttpConnectionPool::getConnection(uint64_t timeout_ms,
 void HttpConnectionPool::ReleasePtr(HttpConnection *ptr, HttpConnectionPool *pool)
 {
     ++ptr->m_request;
-    uint64_t now_ms = sylar::GetCurrentMS();
+    uint64_t now_ms = sylar::CoarseMonoMs();
     if (!pool->isConnectionReusable(ptr, now_ms))
     {
         delete ptr;
@@ -937,7 +948,7 @@ HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req, uint64_t tim
 HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req,
                                               const HttpRequestOptions &options)
 {
-    uint64_t start_ms = sylar::GetCurrentMS();
+    uint64_t start_ms = sylar::CoarseMonoMs();
     HttpAttemptOutcome attempt;
     uint64_t connect_timeout_ms =
         MergeTimeout(options.connect_timeout_ms, start_ms, options.total_timeout_ms);
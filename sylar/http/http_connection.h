@@ -315,6 +315,8 @@ public:
 private:
     uint64_t m_createTime = 0;
     uint64_t m_request = 0;
+    // 请求头的格式化缓冲，连接上的请求复用
+    std::string m_sendBuf;
 };
 
 class HttpConnectionPool
@@ -0,0 +1,134 @@
+#include "http_header.h"
+#include <cstring>
+#include <strings.h>
+
+namespace sylar
+{
+namespace http
+{
+
+bool HttpHeaders::Key::equals(const Key &o) const
+{
+    return hash == o.hash && size == o.size && strncasecmp(data, o.data, size) == 0;
+}
+
+void HttpHeaders::clear()
+{
+    m_buf.clear();
+    m_fields.clear();
+    m_garbage = 0;
+}
+
+int HttpHeaders::indexOf(const Key &key) const
+{
+    for (size_t i = 0; i < m_fields.size(); ++i)
+    {
+        const Field &f = m_fields[i];
+        if (f.hash == key.hash && f.nameLen == key.size &&
+            strncasecmp(m_buf.data() + f.nameOff, key.data, key.size) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+bool HttpHeaders::has(const Key &key, std::string *val) const
+{
+    int idx = indexOf(key);
+    if (idx < 0)
+    {
+        return false;
+    }
+    if (val)
+    {
+        *val = value(idx).str();
+    }
+    return true;
+}
+
+std::string HttpHeaders::get(const Key &key, const std::string &def) const
+{
+    int idx = indexOf(key);
+    return idx < 0 ? def : value(idx).str();
+}
+
+uint32_t HttpHeaders::append(const char *data, size_t len)
+{
+    if (m_buf.capacity() == 0)
+    {
+        //一般的请求头几百字节、十几个字段，先留够，解析时基本不用再扩容
+        m_buf.reserve(512);
+        m_fields.reserve(16);
+    }
+    uint32_t off = m_buf.size();
+    m_buf.append(data, len);
+    return off;
+}
+
+void HttpHeaders::set(const Key &key, const char *val, size_t len)
+{
+    int idx = indexOf(key);
+    if (idx < 0)
+    {
+        Field f;
+        f.hash = key.hash;
+        f.nameLen = key.size;
+        f.nameOff = append(key.data, key.size);
+        f.valueLen = len;
+        f.valueOff = append(val, len);
+        m_fields.push_back(f);
+        return;
+    }
+    Field &f = m_fields[idx];
+    if (len <= f.valueLen)
+    {
+        //新值不比旧值长，原地覆盖
+        memmove(&m_buf[f.valueOff], val, len);
+        m_garbage += f.valueLen - len;
+    }
+    else
+    {
+        m_garbage += f.valueLen;
+        f.valueOff = append(val, len);
+    }
+    f.valueLen = len;
+    compact();
+}
+
+bool HttpHeaders::del(const Key &key)
+{
+    int idx = indexOf(key);
+    if (idx < 0)
+    {
+        return false;
+    }
+    m_garbage += m_fields[idx].nameLen + m_fields[idx].valueLen;
+    m_fields.erase(m_fields.begin() + idx);
+    compact();
+    return true;
+}
+
+void HttpHeaders::compact()
+{
+    if (m_garbage < 1024 || m_garbage * 2 < m_buf.size())
+    {
+        return;
+    }
+    std::string buf;
+    buf.reserve(m_buf.size() - m_garbage);
+    for (auto &f : m_fields)
+    {
+        uint32_t off = buf.size();
+        buf.append(m_buf, f.nameOff, f.nameLen);
+        f.nameOff = off;
+        off = buf.size();
+        buf.append(m_buf, f.valueOff, f.valueLen);
+        f.valueOff = off;
+    }
+    m_buf.swap(buf);
+    m_garbage = 0;
+}
+
+} // namespace http
+} // namespace sylar
@@ -0,0 +1,164 @@
+#ifndef __SYLAR_HTTP_HTTP_HEADER_H__
+#define __SYLAR_HTTP_HTTP_HEADER_H__
+
+#include <boost/lexical_cast.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sylar
+{
+namespace http
+{
+
+/**
+ * @brief HTTP 头部的扁平存储
+ * @details 所有字段的名字和值都拷贝进同一块连续缓冲，每个字段只记偏移、长度和名字转小写后的哈希。
+ *          解析一个请求头只有这块缓冲和字段数组的几次扩容，不再是每个字段两个 string 加一个
+ *          map 节点。字段按插入顺序保存；查找先比哈希，哈希相同再忽略大小写比较名字。
+ *          同名字段只保留一个，后设置的覆盖前面的，和原来 map 的行为一致。
+ */
+class HttpHeaders
+{
+public:
+    /// 指向缓冲里的一段字节，对 HttpHeaders 做修改之后失效
+    struct Slice
+    {
+        const char *data;
+        size_t size;
+
+        std::string str() const
+        {
+            return std::string(data, size);
+        }
+    };
+
+    static constexpr char ToLower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+    }
+
+    /// 名字转小写后的 FNV-1a，字面量可以在编译期算出来
+    static constexpr uint32_t Hash(const char *str, size_t len, uint32_t h = 2166136261u)
+    {
+        return len == 0 ? h : Hash(str + 1, len - 1, (h ^ (uint8_t)ToLower(*str)) * 16777619u);
+    }
+
+    /// 查找用的名字，带上算好的哈希，常用的名字见 HttpHeader 命名空间
+    struct Key
+    {
+        const char *data;
+        size_t size;
+        uint32_t hash;
+
+        template <size_t N>
+        constexpr Key(const char (&str)[N]) : data(str), size(N - 1), hash(Hash(str, N - 1))
+        {
+        }
+        constexpr Key(const char *str, size_t len) : data(str), size(len), hash(Hash(str, len))
+        {
+        }
+        Key(const std::string &str)
+            : data(str.data()), size(str.size()), hash(Hash(str.data(), str.size()))
+        {
+        }
+
+        bool equals(const Key &o) const;
+    };
+
+    size_t size() const
+    {
+        return m_fields.size();
+    }
+    bool empty() const
+    {
+        return m_fields.empty();
+    }
+    void clear();
+
+    Slice name(size_t idx) const
+    {
+        const Field &f = m_fields[idx];
+        return Slice{m_buf.data() + f.nameOff, f.nameLen};
+    }
+    Slice value(size_t idx) const
+    {
+        const Field &f = m_fields[idx];
+        return Slice{m_buf.data() + f.valueOff, f.valueLen};
+    }
+
+    /// 找不到返回 -1
+    int indexOf(const Key &key) const;
+    bool has(const Key &key, std::string *val = nullptr) const;
+    std::string get(const Key &key, const std::string &def = "") const;
+
+    void set(const Key &key, const char *val, size_t len);
+    void set(const Key &key, const std::string &val)
+    {
+        set(key, val.data(), val.size());
+    }
+    bool del(const Key &key);
+
+    template <class T> bool checkGetAs(const Key &key, T &val, const T &def = T()) const
+    {
+        int idx = indexOf(key);
+        if (idx < 0)
+        {
+            val = def;
+            return false;
+        }
+        Slice v = value(idx);
+        try
+        {
+            val = boost::lexical_cast<T>(v.data, v.size);
+            return true;
+        }
+        catch (...)
+        {
+            val = def;
+        }
+        return false;
+    }
+
+    template <class T> T getAs(const Key &key, const T &def = T()) const
+    {
+        T val;
+        checkGetAs(key, val, def);
+        return val;
+    }
+
+private:
+    uint32_t append(const char *data, size_t len);
+    // 被覆盖和删除的字节太多时重新排一遍缓冲
+    void compact();
+
+private:
+    struct Field
+    {
+        uint32_t hash;
+        uint32_t nameOff;
+        uint32_t nameLen;
+        uint32_t valueOff;
+        uint32_t valueLen;
+    };
+
+    std::string m_buf;
+    std::vector<Field> m_fields;
+    /// m_buf 里已经没有字段引用的字节数
+    size_t m_garbage = 0;
+};
+
+/// 框架自己要查的头部，哈希在编译期算好
+namespace HttpHeader
+{
+constexpr HttpHeaders::Key CONNECTION("connection");
+constexpr HttpHeaders::Key CONTENT_LENGTH("content-length");
+constexpr HttpHeaders::Key CONTENT_TYPE("content-type");
+constexpr HttpHeaders::Key COOKIE("cookie");
+constexpr HttpHeaders::Key HOST("host");
+} // namespace HttpHeader
+
+} // namespace http
+} // namespace sylar
+
+#endif
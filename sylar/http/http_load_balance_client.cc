@@ -389,11 +389,11 @@ HttpResult::ptr HttpLoadBalanceClient::request(HttpMethod method,
         }
 
         uint64_t interval_ms = HttpClient::GetRetryInterval(retry_options, retry_index + 1);
-        SYLAR_LOG_INFO(g_logger) << "HttpLoadBalanceClient retry method="
-                                 << HttpMethodToString(method) << " path=" << request_path
-                                 << " retry_index=" << (retry_index + 1)
-                                 << " result=" << (result ? result->result : -1)
-                                 << " interval_ms=" << interval_ms;
+        //上游整体不可用时每个请求都会重试，按调用点限流
+        SYLAR_LOG_RATE_LIMITED(g_logger, sylar::LogLevel::INFO, 10, 20)
+            << "HttpLoadBalanceClient retry method=" << HttpMethodToString(method)
+            << " path=" << request_path << " retry_index=" << (retry_index + 1)
+            << " result=" << (result ? result->result : -1) << " interval_ms=" << interval_ms;
         if (interval_ms > 0)
         {
             usleep(interval_ms * 1000);
@@ -149,17 +149,17 @@ void on_request_http_field(
         return;
     }
 
-    std::string key(field, flen);
-    std::string val(value, vlen);
-    parser->getData()->setHeader(key, val);
+    //名字和值直接拷进头部的连续缓冲，不再构造临时 string
+    HttpHeaders::Key key(field, flen);
+    parser->getData()->getHeaders().set(key, value, vlen);
 
-    if (strcasecmp(key.c_str(), "connection") == 0)
+    if (key.equals(HttpHeader::CONNECTION))
     {
-        if (strcasecmp(val.c_str(), "keep-alive") == 0)
+        if (vlen == 10 && strncasecmp(value, "keep-alive", vlen) == 0)
         {
             parser->getData()->setClose(false);
         }
-        else if (strcasecmp(val.c_str(), "close") == 0)
+        else if (vlen == 5 && strncasecmp(value, "close", vlen) == 0)
         {
             parser->getData()->setClose(true);
         }
@@ -168,6 +168,12 @@ void on_request_http_field(
 
 HttpRequestParser::HttpRequestParser() : m_error(0)
 {
+    reset();
+}
+
+void HttpRequestParser::reset()
+{
+    m_error = 0;
     m_data.reset(new sylar::http::HttpRequest);
     http_parser_init(&m_parser);
     m_parser.request_method = on_request_method;
@@ -183,7 +189,7 @@ HttpRequestParser::HttpRequestParser() : m_error(0)
 
 uint64_t HttpRequestParser::getContentLength()
 {
-    return m_data->getHeaderAs<uint64_t>("content-length", 0);
+    return m_data->getHeaders().getAs<uint64_t>(HttpHeader::CONTENT_LENGTH, 0);
 }
 
 // 1: 成功
@@ -200,6 +206,15 @@ size_t HttpRequestParser::execute(char *data, size_t len)
     return offset;
 }
 
+size_t HttpRequestParser::execute(const char *data, size_t len, size_t off)
+{
+    if (off >= len)
+    {
+        return off;
+    }
+    return http_parser_execute(&m_parser, data, len, off);
+}
+
 int HttpRequestParser::isFinished()
 {
     return http_parser_finish(&m_parser);
@@ -267,17 +282,17 @@ void on_response_http_field(
         parser->setError(1002);
         return;
     }
-    std::string key(field, flen);
-    std::string val(value, vlen);
-    parser->getData()->setHeader(key, val);
+    //名字和值直接拷进头部的连续缓冲，不再构造临时 string
+    HttpHeaders::Key key(field, flen);
+    parser->getData()->getHeaders().set(key, value, vlen);
 
-    if (strcasecmp(key.c_str(), "connection") == 0)
+    if (key.equals(HttpHeader::CONNECTION))
     {
-        if (strcasecmp(val.c_str(), "keep-alive") == 0)
+        if (vlen == 10 && strncasecmp(value, "keep-alive", vlen) == 0)
         {
             parser->getData()->setClose(false);
         }
-        else if (strcasecmp(val.c_str(), "close") == 0)
+        else if (vlen == 5 && strncasecmp(value, "close", vlen) == 0)
         {
             parser->getData()->setClose(true);
         }
@@ -320,7 +335,7 @@ int HttpResponseParser::hasError()
 
 uint64_t HttpResponseParser::getContentLength()
 {
-    return m_data->getHeaderAs<uint64_t>("content-length", 0);
+    return m_data->getHeaders().getAs<uint64_t>(HttpHeader::CONTENT_LENGTH, 0);
 }
 
 } // namespace http
@@ -15,7 +15,15 @@ class HttpRequestParser
 public:
     typedef std::shared_ptr<HttpRequestParser> ptr;
     HttpRequestParser();
+    // 清掉状态和已经解析出的请求，用来在同一个连接上解析下一个请求
+    void reset();
     size_t execute(char *data, size_t len);
+    /**
+     * @brief 不移动数据，从 off 开始接着解析
+     * @details data 里要一直保留从请求开头到 len 的所有字节，因为解析器记的是相对 data 的偏移；
+     *          返回请求开头到目前为止一共解析了多少字节，解析完请求头就停在头后面
+     */
+    size_t execute(const char *data, size_t len, size_t off);
     int isFinished();
     int hasError();
 
@@ -61,7 +61,13 @@ void HttpServer::handleClient(Socket::ptr client)
     // SYLAR_LOG_INFO(g_logger) << "成功连接上一个客户端" << *client;
     do
     {
-        auto req = session->recvRequest();
+        auto req = session->recvRequestHead();
+        Servlet::ptr slt = req ? m_dispatch->route(req) : nullptr;
+        //不自己读请求体的 servlet 还是拿到完整的 body
+        if (req && !(slt && slt->isStreamBody()) && !session->recvRequestBody(req))
+        {
+            req = nullptr;
+        }
         if (!req)
         {
             auto error = session->getLastRecvRequestError();
@@ -75,6 +81,8 @@ void HttpServer::handleClient(Socket::ptr client)
             }
             else
             {
+                //对端地址是第一次用到时才取的，打日志前先取一下
+                client->getRemoteAddress();
                 SYLAR_LOG_WARN(g_logger)
                     << "recv http request fail reason=" << HttpRecvRequestErrorToString(error)
                     << " errno=" << error_no << " errstr=" << strerror(error_no)
@@ -86,15 +94,30 @@ void HttpServer::handleClient(Socket::ptr client)
         HttpResponse::ptr rsp(
             new HttpResponse(req->getVersion(), req->isClose() || !m_isKeepalive));
         rsp->setHeader("Server", getName());
-        m_dispatch->handle(req, rsp, session);
+        if (slt)
+        {
+            slt->handle(req, rsp, session);
+        }
         //        rsp->setBody("hello sylar");
         //
         //        SYLAR_LOG_INFO(g_logger) << "requst:" << std::endl
         //            << *req;
         //        SYLAR_LOG_INFO(g_logger) << "response:" << std::endl
         //            << *rsp;
-        int rt = session->sendResponse(rsp);
-        if (rt <= 0)
+        //servlet 流式发送时写失败了，已经发出去的响应不完整，不补结束块直接关连接
+        if (session->isWriteFailed())
+        {
+            break;
+        }
+        //servlet 自己开始分块发送了，没发结束块的补上
+        int rt = session->isResponseStarted() ? session->endChunkedResponse()
+                                              : session->sendResponse(rsp);
+        if (rt < 0 || (rt == 0 && !session->isResponseStarted()))
+        {
+            break;
+        }
+        //servlet 没读完的请求体丢掉，下一个请求才能从正确的位置开始解析
+        if (!session->discardBody())
         {
             break;
         }
@@ -1,7 +1,9 @@
 #include "http_session.h"
-#include "http_parser.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstdio>
+#include <cstring>
 
 namespace sylar
 {
@@ -10,6 +12,9 @@ namespace http
 namespace
 {
 
+// 没读的请求体超过这么多就不读了，直接关连接
+const uint64_t s_max_discard_body = 64 * 1024;
+
 bool IsTimeoutLikeError(int error)
 {
     return error == EAGAIN || error == EWOULDBLOCK || error == ETIMEDOUT;
@@ -35,100 +40,313 @@ HttpSession::HttpSession(Socket::ptr sock, bool owner) : SocketStream(sock, owne
 }
 
 HttpRequest::ptr HttpSession::recvRequest()
+{
+    HttpRequest::ptr req = recvRequestHead();
+    if (req && !recvRequestBody(req))
+    {
+        return nullptr;
+    }
+    return req;
+}
+
+HttpRequest::ptr HttpSession::recvRequestHead()
 {
     m_lastRecvRequestError = HttpSessionRecvRequestError::NONE;
     m_lastRecvRequestErrno = 0;
+    m_chunkMode = ChunkMode::NONE;
+    if (!discardBody())
+    {
+        m_lastRecvRequestErrno = errno;
+        m_lastRecvRequestError = ClassifyReadFailure(-1, m_lastRecvRequestErrno);
+        close();
+        return nullptr;
+    }
 
-    HttpRequestParser::ptr parser(new HttpRequestParser);
-    // 设置这个主要是为了避免请求体过大，超过一定大小直接认为是非法请求
-    uint64_t buff_size = HttpRequestParser::GetHttpRequestBufferSize();
-    // uint64_t buff_size = 100;
-    std::shared_ptr<char> buffer(new char[buff_size], [](char *ptr) { delete[] ptr; });
-    char *data = buffer.get();
-    int offset = 0;
-    //这里其实就是先读，能读多长就多长（尽量读），让parser尽量解析，但是有可能本次读到的字节没法解析完整的信息，
-    //那就下一轮继续读，直到解析完整的信息
-    do
-    {
-        //读到了多少数据，放到data里
-        int len = read(data + offset, buff_size - offset);
-        if (len <= 0)
+    if (!m_buf)
+    {
+        // 设置这个主要是为了避免请求头过大，超过一定大小直接认为是非法请求
+        m_bufSize = HttpRequestParser::GetHttpRequestBufferSize();
+        m_buf.reset(new char[m_bufSize]);
+    }
+    // 上一个请求剩下的字节挪到最前面，作为这个请求的开头
+    if (m_bufPos > 0)
+    {
+        memmove(m_buf.get(), m_buf.get() + m_bufPos, m_bufLen - m_bufPos);
+        m_bufLen -= m_bufPos;
+        m_bufPos = 0;
+    }
+    m_parser.reset();
+    char *data = m_buf.get();
+    // 从请求开头已经解析了多少字节，解析器按偏移接着解析，不移动数据
+    size_t nparse = 0;
+    //缓冲区里有没解析的字节就先解析，解析不出完整的请求头再从 socket 读
+    while (true)
+    {
+        nparse = m_parser.execute(data, m_bufLen, nparse);
+        if (m_parser.hasError())
         {
-            m_lastRecvRequestErrno = len < 0 ? errno : 0;
-            m_lastRecvRequestError = ClassifyReadFailure(len, m_lastRecvRequestErrno);
+            m_lastRecvRequestError = HttpSessionRecvRequestError::PARSE_ERROR;
             close();
             return nullptr;
         }
-        //表示当前的缓冲区有多少有效字节
-        len += offset;
-        //返回已解析的字节数
-        size_t nparse = parser->execute(data, len);
-        if (parser->hasError())
+        if (m_parser.isFinished())
         {
-            m_lastRecvRequestError = HttpSessionRecvRequestError::PARSE_ERROR;
-            close();
-            return nullptr;
+            break;
         }
-        // 更新剩余未解析的数据长度
-        offset = len - nparse;
-        if (offset == (int)buff_size)
+        if (m_bufLen == m_bufSize)
         {
             m_lastRecvRequestError = HttpSessionRecvRequestError::REQUEST_TOO_LARGE;
             close();
             return nullptr;
         }
-        if (parser->isFinished())
+        int len = SocketStream::read(data + m_bufLen, m_bufSize - m_bufLen);
+        if (len <= 0)
         {
-            break;
+            m_lastRecvRequestErrno = len < 0 ? errno : 0;
+            m_lastRecvRequestError = ClassifyReadFailure(len, m_lastRecvRequestErrno);
+            close();
+            return nullptr;
         }
-    } while (true);
+        m_bufLen += len;
+    }
+    // 请求头后面的字节是请求体或者下一个请求，由 read 按顺序交出去
+    m_bufPos = nparse;
+
+    m_bodyLeft = m_parser.getContentLength();
+    return m_parser.getData();
+}
+
+bool HttpSession::recvRequestBody(HttpRequest::ptr req)
+{
+    if (m_bodyLeft == 0)
+    {
+        return true;
+    }
+    std::string body;
+    body.resize(m_bodyLeft);
+    int read_len = readFixSize(&body[0], m_bodyLeft);
+    if (read_len <= 0)
+    {
+        m_lastRecvRequestErrno = read_len < 0 ? errno : 0;
+        m_lastRecvRequestError = ClassifyReadFailure(read_len, m_lastRecvRequestErrno);
+        close();
+        return false;
+    }
+    m_bodyLeft = 0;
+    req->setBody(body);
+    return true;
+}
 
-    int64_t length = parser->getContentLength();
-    if (length > 0)
+int HttpSession::readBody(void *buffer, size_t length)
+{
+    if (m_bodyLeft == 0)
     {
-        // 1、前面不停地读，本来是想解析头的，但是可能把body也多读出来了，
-        // 所以先判断是不是有，然后把多读的先写进body变量里
-        std::string body;
-        body.resize(length);
-        int len = 0;
-        if (length >= offset)
+        return 0;
+    }
+    int rt = read(buffer, std::min<uint64_t>(length, m_bodyLeft));
+    if (rt > 0)
+    {
+        m_bodyLeft -= rt;
+    }
+    else if (rt == 0)
+    {
+        //请求体还没完对端就关了
+        rt = -1;
+    }
+    return rt;
+}
+
+bool HttpSession::discardBody()
+{
+    if (m_bodyLeft > s_max_discard_body)
+    {
+        return false;
+    }
+    char buf[4096];
+    while (m_bodyLeft > 0)
+    {
+        if (readBody(buf, sizeof(buf)) <= 0)
         {
-            // body.append(data, offset);
-            memcpy(&body[0], data, offset);
-            len = offset;
+            return false;
         }
-        else
+    }
+    return true;
+}
+
+int HttpSession::read(void *buffer, size_t length)
+{
+    if (m_bufPos < m_bufLen)
+    {
+        size_t n = std::min(length, m_bufLen - m_bufPos);
+        memcpy(buffer, m_buf.get() + m_bufPos, n);
+        m_bufPos += n;
+        return n;
+    }
+    return SocketStream::read(buffer, length);
+}
+
+int HttpSession::read(ByteArray::ptr ba, size_t length)
+{
+    if (m_bufPos < m_bufLen)
+    {
+        size_t n = std::min(length, m_bufLen - m_bufPos);
+        ba->write(m_buf.get() + m_bufPos, n);
+        m_bufPos += n;
+        return n;
+    }
+    return SocketStream::read(ba, length);
+}
+
+int HttpSession::sendResponse(HttpResponse::ptr rsp)
+{
+    //头部格式化进复用的缓冲，body 原样作为第二段，一次 sendmsg 发出去，不再拼接拷贝
+    m_sendBuf.clear();
+    rsp->dumpHead(m_sendBuf);
+    const std::string &body = rsp->getBody();
+    iovec iov[2];
+    iov[0].iov_base = &m_sendBuf[0];
+    iov[0].iov_len = m_sendBuf.size();
+    iov[1].iov_base = (void *)body.data();
+    iov[1].iov_len = body.size();
+    return writevFixSize(iov, body.empty() ? 1 : 2);
+}
+
+int HttpSession::beginChunkedResponse(HttpResponse::ptr rsp)
+{
+    std::string body = rsp->getBody();
+    rsp->setBody("");
+    rsp->delHeader("content-length");
+    if (rsp->getVersion() >= 0x11)
+    {
+        rsp->setHeader("Transfer-Encoding", "chunked");
+        m_chunkMode = ChunkMode::CHUNKED;
+    }
+    else
+    {
+        rsp->delHeader("transfer-encoding");
+        rsp->setClose(true);
+        m_chunkMode = ChunkMode::RAW;
+    }
+    m_sendBuf.clear();
+    rsp->dumpHead(m_sendBuf);
+    int rt = writeFixSize(m_sendBuf.data(), m_sendBuf.size());
+    if (rt <= 0)
+    {
+        m_writeFailed = true;
+        return rt;
+    }
+    if (body.empty())
+    {
+        return rt;
+    }
+    return sendChunk(body.data(), body.size());
+}
+
+int HttpSession::sendChunk(const void *data, size_t length)
+{
+    if (m_writeFailed)
+    {
+        return -1;
+    }
+    if (m_chunkMode != ChunkMode::RAW && m_chunkMode != ChunkMode::CHUNKED)
+    {
+        return -1;
+    }
+    if (length == 0)
+    {
+        //CHUNKED 模式下长度为 0 的块是结束块，这里不能发
+        return 0;
+    }
+    int rt = 0;
+    if (m_chunkMode == ChunkMode::RAW)
+    {
+        rt = writeFixSize(data, length);
+        if (rt <= 0)
         {
-            // body.append(data, length);
-            memcpy(&body[0], data, length);
-            len = length;
+            m_writeFailed = true;
         }
+        return rt;
+    }
+    char size_line[24];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+    iovec iov[3];
+    iov[0].iov_base = size_line;
+    iov[0].iov_len = n;
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = length;
+    iov[2].iov_base = (void *)"\r\n";
+    iov[2].iov_len = 2;
+    rt = writevFixSize(iov, 3);
+    if (rt <= 0)
+    {
+        //块写了一半，后面的数据接不上了
+        m_writeFailed = true;
+    }
+    return rt;
+}
 
-        length -= offset;
-        // 2、如果body还有数据，继续读,这次就是全读出来了（内部有while）
-        if (length > 0)
+int HttpSession::endChunkedResponse()
+{
+    if (m_chunkMode == ChunkMode::NONE)
+    {
+        return -1;
+    }
+    ChunkMode mode = m_chunkMode;
+    m_chunkMode = ChunkMode::FINISHED;
+    if (m_writeFailed)
+    {
+        //前面的块没发完整，再补结束块对端会当成一个完整的响应
+        return -1;
+    }
+    if (mode == ChunkMode::CHUNKED)
+    {
+        int rt = writeFixSize("0\r\n\r\n", 5);
+        if (rt <= 0)
         {
-            int read_len = readFixSize(&body[len], length);
-            if (read_len <= 0)
-            {
-                m_lastRecvRequestErrno = read_len < 0 ? errno : 0;
-                m_lastRecvRequestError = ClassifyReadFailure(read_len, m_lastRecvRequestErrno);
-                close();
-                return nullptr;
-            }
+            m_writeFailed = true;
         }
-        parser->getData()->setBody(body);
+        return rt;
     }
-    return parser->getData();
+    return 0;
 }
 
-int HttpSession::sendResponse(HttpResponse::ptr rsp)
+int64_t HttpSession::sendFileResponse(HttpResponse::ptr rsp, int fd, off_t offset, uint64_t length)
 {
-    std::stringstream ss;
-    ss << *rsp;
-    std::string data = ss.str();
-    // std::cout << "sendResponse:" << data << std::endl;
-    return writeFixSize(data.c_str(), data.size());
+    m_chunkMode = ChunkMode::FINISHED;
+    rsp->setBody("");
+    rsp->delHeader("transfer-encoding");
+    rsp->setHeader("Content-Length", std::to_string(length));
+    m_sendBuf.clear();
+    rsp->dumpHead(m_sendBuf);
+    //MSG_MORE 让内核等文件内容一起发，小文件的头和内容能落在同一个包里
+    size_t sent = 0;
+    while (sent < m_sendBuf.size())
+    {
+        if (!isConnected())
+        {
+            m_writeFailed = true;
+            return -1;
+        }
+        int len = m_socket->send(&m_sendBuf[sent], m_sendBuf.size() - sent,
+                                 length ? MSG_MORE : 0);
+        if (len <= 0)
+        {
+            m_writeFailed = true;
+            return len;
+        }
+        sent += len;
+    }
+    if (length == 0)
+    {
+        return sent;
+    }
+    int64_t rt = sendFileFixSize(fd, offset, length);
+    if (rt <= 0)
+    {
+        m_writeFailed = true;
+        return rt;
+    }
+    return rt + sent;
 }
 
 } // namespace http
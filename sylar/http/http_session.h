@@ -2,7 +2,9 @@
 #define __SYLAR_HTTP_SESSION_H__
 
 #include "http.h"
+#include "http_parser.h"
 #include "sylar/socket_stream.h"
+#include <memory>
 
 namespace sylar
 {
@@ -23,7 +25,29 @@ class HttpSession : public SocketStream
 public:
     typedef std::shared_ptr<HttpSession> ptr;
     HttpSession(Socket::ptr sock, bool owner = true);
+    // 读请求头和整个请求体
     HttpRequest::ptr recvRequest();
+    /**
+     * @brief 只读请求头，请求体留在连接上，由 readBody 按需读
+     * @details 上一个请求没读完的请求体会先被丢掉
+     */
+    HttpRequest::ptr recvRequestHead();
+    // 把当前请求剩下的请求体全部读进 req 的 body
+    bool recvRequestBody(HttpRequest::ptr req);
+    /**
+     * @brief 读当前请求的请求体，不会读到下一个请求
+     * @return 读到的字节数，0 表示请求体读完了，<0 出错
+     */
+    int readBody(void *buffer, size_t length);
+    uint64_t getBodyLeft() const
+    {
+        return m_bodyLeft;
+    }
+    /**
+     * @brief 丢掉当前请求没读完的请求体，让连接能接着读下一个请求
+     * @return 剩下的太多（不值得为了保持连接去读）或者读失败返回 false
+     */
+    bool discardBody();
     HttpSessionRecvRequestError getLastRecvRequestError() const
     {
         return m_lastRecvRequestError;
@@ -34,7 +58,62 @@ public:
     }
     int sendResponse(HttpResponse::ptr rsp);
 
+    /**
+     * @brief 开始分块发送响应，先发响应头
+     * @details HTTP/1.1 用 chunked 编码；HTTP/1.0 不支持，改成不带长度、发完关闭连接。
+     *          rsp 里已经有的 body 作为第一块发出去
+     */
+    int beginChunkedResponse(HttpResponse::ptr rsp);
+    // 发一块响应体，length 为 0 时什么也不发
+    int sendChunk(const void *data, size_t length);
+    // 发结束块，之后这个响应就发完了
+    int endChunkedResponse();
+    /**
+     * @brief 发送响应头，再用 sendfile 发文件 fd 的 [offset, offset + length) 作为响应体
+     * @details rsp 的 body 会被忽略，Content-Length 设为 length；发完以后 isResponseStarted()
+     *          为 true，HttpServer 不会再发一次响应
+     */
+    int64_t sendFileResponse(HttpResponse::ptr rsp, int fd, off_t offset, uint64_t length);
+    // 当前请求的响应是否已经开始分块发送，是的话不能再 sendResponse
+    bool isResponseStarted() const
+    {
+        return m_chunkMode != ChunkMode::NONE;
+    }
+    // 响应发到一半写失败了，连接上的数据已经不完整，只能关闭，不能再发也不能继续 keep-alive
+    bool isWriteFailed() const
+    {
+        return m_writeFailed;
+    }
+
+    // 先交出读缓冲里还没用掉的字节（请求体、流水线里的下一个请求、升级后的 websocket 帧），
+    // 读完了再从 socket 读
+    virtual int read(void *buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+
 private:
+    enum class ChunkMode
+    {
+        NONE,
+        CHUNKED,
+        // HTTP/1.0，body 原样发，连接关闭表示结束
+        RAW,
+        FINISHED
+    };
+
+    // 读缓冲里 [m_bufPos, m_bufLen) 是已经从 socket 读到、还没交出去的字节，
+    // 连接上的所有请求共用这一块缓冲，一个请求后面多读的部分留给下一个请求
+    std::unique_ptr<char[]> m_buf;
+    size_t m_bufSize = 0;
+    size_t m_bufPos = 0;
+    size_t m_bufLen = 0;
+    HttpRequestParser m_parser;
+    // 响应头的格式化缓冲，连接上的响应复用，容量保留
+    std::string m_sendBuf;
+    // 当前请求还没读的请求体字节数
+    uint64_t m_bodyLeft = 0;
+    ChunkMode m_chunkMode = ChunkMode::NONE;
+    // 流式写失败过，之后的分块写都直接返回失败
+    bool m_writeFailed = false;
     HttpSessionRecvRequestError m_lastRecvRequestError = HttpSessionRecvRequestError::NONE;
     int m_lastRecvRequestErrno = 0;
 };
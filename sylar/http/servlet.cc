@@ -1,5 +1,5 @@
 #include "servlet.h"
-#include <fnmatch.h>
+#include "sylar/epoch.h"
 
 namespace sylar
 {
@@ -17,16 +17,21 @@ int32_t FunctionServlet::handle(sylar::http::HttpRequest::ptr request,
     return m_cb(request, response, session);
 }
 
-ServletDispatch::ServletDispatch() : Servlet("ServletDispatch")
+ServletDispatch::ServletDispatch() : Servlet("ServletDispatch"), m_router(new ServletRouter)
 {
     m_default.reset(new NotFoundServlet("sylar/1.0"));
 }
 
+ServletDispatch::~ServletDispatch()
+{
+    delete m_router.load(std::memory_order_relaxed);
+}
+
 int32_t ServletDispatch::handle(sylar::http::HttpRequest::ptr request,
                                 sylar::http::HttpResponse::ptr response,
                                 sylar::http::HttpSession::ptr session)
 {
-    auto slt = getMatchedServlet(request->getPath());
+    auto slt = route(request);
     if (slt)
     {
         slt->handle(request, response, session);
@@ -34,36 +39,59 @@ int32_t ServletDispatch::handle(sylar::http::HttpRequest::ptr request,
     return 0;
 }
 
-//优先匹配，匹配不到尝试模糊匹配
+//精确匹配优先，然后是最长的前缀通配，最后才逐个试其他通配模式
 Servlet::ptr ServletDispatch::getMatchedServlet(const std::string &uri)
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    auto mit = m_datas.find(uri);
-    if (mit != m_datas.end())
+    Servlet::ptr slt;
     {
-        return mit->second;
+        EpochGuard guard;
+        slt = m_router.load(std::memory_order_acquire)->match(uri);
     }
-    for (auto it = m_globs.begin(); it != m_globs.end(); ++it)
+    return slt ? slt : m_default;
+}
+
+Servlet::ptr ServletDispatch::route(HttpRequest::ptr req)
+{
+    ServletRouter::Params params;
+    Servlet::ptr slt;
     {
-        if (!fnmatch(it->first.c_str(), uri.c_str(), 0))
-        {
-            return it->second;
-        }
+        EpochGuard guard;
+        slt = m_router.load(std::memory_order_acquire)->match(req->getPath(), &params);
+    }
+    for (auto &i : params)
+    {
+        req->setParam(i.first, i.second);
+    }
+    return slt ? slt : m_default;
+}
+
+void ServletDispatch::rebuild()
+{
+    ServletRouter *router = new ServletRouter;
+    for (auto &i : m_datas)
+    {
+        router->addServlet(i.first, i.second);
     }
-    return m_default;
+    for (auto &i : m_globs)
+    {
+        router->addGlobServlet(i.first, i.second);
+    }
+    ServletRouter *old = m_router.exchange(router, std::memory_order_acq_rel);
+    Epoch::Retire(old);
 }
 
 void ServletDispatch::addServlet(const std::string &uri, Servlet::ptr slt)
 {
     RWMutexType::WriteLock lock(m_mutex);
     m_datas[uri] = slt;
+    rebuild();
 }
 
 void ServletDispatch::addServlet(const std::string &uri, FunctionServlet::callback cb)
 {
-    RWMutexType::WriteLock lock(m_mutex);
-    m_datas[uri].reset(new FunctionServlet(cb));
+    addServlet(uri, FunctionServlet::ptr(new FunctionServlet(cb)));
 }
+
 void ServletDispatch::addGlobServlet(const std::string &uri, Servlet::ptr slt)
 {
     RWMutexType::WriteLock lock(m_mutex);
@@ -76,6 +104,7 @@ void ServletDispatch::addGlobServlet(const std::string &uri, Servlet::ptr slt)
         }
     }
     m_globs.push_back(std::make_pair(uri, slt));
+    rebuild();
 }
 
 void ServletDispatch::addGlobServlet(const std::string &uri, FunctionServlet::callback cb)
@@ -86,7 +115,10 @@ void ServletDispatch::addGlobServlet(const std::string &uri, FunctionServlet::ca
 void ServletDispatch::delServlet(const std::string &uri)
 {
     RWMutexType::WriteLock lock(m_mutex);
-    m_datas.erase(uri);
+    if (m_datas.erase(uri))
+    {
+        rebuild();
+    }
 }
 
 void ServletDispatch::delGlobServlet(const std::string &uri)
@@ -97,6 +129,7 @@ void ServletDispatch::delGlobServlet(const std::string &uri)
         if (it->first == uri)
         {
             m_globs.erase(it);
+            rebuild();
             break;
         }
     }
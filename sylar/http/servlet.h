@@ -3,7 +3,9 @@
 
 #include "http.h"
 #include "http_session.h"
+#include "servlet_router.h"
 #include "sylar/thread.h"
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
@@ -31,8 +33,23 @@ public:
         return m_name;
     }
 
+    /**
+     * @brief 是否自己读请求体
+     * @details 为 true 时 HttpServer 只读完请求头就调用 handle，请求体由 servlet 通过
+     *          session->readBody 分段读，内存占用和请求体大小无关；没读完的部分 handle 返回后丢掉
+     */
+    bool isStreamBody() const
+    {
+        return m_streamBody;
+    }
+    void setStreamBody(bool v)
+    {
+        m_streamBody = v;
+    }
+
 protected:
     std::string m_name;
+    bool m_streamBody = false;
 };
 
 class FunctionServlet : public Servlet
@@ -59,12 +76,15 @@ public:
     typedef RWMutex RWMutexType;
 
     ServletDispatch();
+    ~ServletDispatch();
     virtual int32_t handle(sylar::http::HttpRequest::ptr request,
                            sylar::http::HttpResponse::ptr response,
                            sylar::http::HttpSession::ptr session) override;
 
+    // uri 里以 ':' 开头的段是参数，例如 /user/:id，匹配到的值用 route() 写进请求参数
     void addServlet(const std::string &uri, Servlet::ptr slt);
     void addServlet(const std::string &uri, FunctionServlet::callback cb);
+    // fnmatch 模式，只有最后一个 '*' 的前缀模式走路由树，其他的按加入顺序逐个匹配
     void addGlobServlet(const std::string &uri, Servlet::ptr slt);
     void addGlobServlet(const std::string &uri, FunctionServlet::callback cb);
 
@@ -84,13 +104,22 @@ public:
     Servlet::ptr getGlobServlet(const std::string &uri);
 
     Servlet::ptr getMatchedServlet(const std::string &uri);
+    // 同 getMatchedServlet，另外把路径里的参数段设置到 req 的参数里
+    Servlet::ptr route(HttpRequest::ptr req);
+
+private:
+    // 持有写锁时调用，按当前的路由表建新的快照替换上去
+    void rebuild();
 
 private:
+    // 只保护下面两张路由表，请求线程只读 m_router，不加锁
     RWMutexType m_mutex;
     // uri(/sylar/xxx) -> servlet
     std::unordered_map<std::string, Servlet::ptr> m_datas;
     // uri(/sylar/*) -> servlet
     std::vector<std::pair<std::string, Servlet::ptr>> m_globs;
+    // 路由表的不可变快照，修改路由时整个换掉，旧的等读者都离开后由 Epoch 回收
+    std::atomic<ServletRouter *> m_router;
     //默认servlet，所有路径都没匹配到时使用
     Servlet::ptr m_default;
 };
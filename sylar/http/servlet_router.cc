@@ -0,0 +1,216 @@
+#include "servlet_router.h"
+#include <algorithm>
+#include <cstring>
+#include <fnmatch.h>
+
+namespace sylar
+{
+namespace http
+{
+
+struct ServletRouter::Node
+{
+    /// 从父节点到这里的一段静态字符
+    std::string prefix;
+    /// 静态子节点，首字符互不相同
+    std::vector<std::unique_ptr<Node>> children;
+    /// 各静态子节点的首字符，和 children 一一对应，查找时 memchr 一下就行
+    std::string indices;
+    /// 参数段子节点，匹配到下一个 '/' 为止
+    std::unique_ptr<Node> param;
+    /// 路径正好在这里结束时用的 servlet
+    ServletPtr exact;
+    /// exact 路由里各个参数段的名字，按出现顺序
+    std::vector<std::string> paramNames;
+    /// 路径以到这里为止的前缀开头时用的 servlet
+    ServletPtr wildcard;
+};
+
+struct ServletRouter::MatchState
+{
+    const char *begin;
+    const char *end;
+    /// 当前分支上各参数值在路径里的偏移和长度
+    std::vector<std::pair<size_t, size_t>> spans;
+    const Node *found = nullptr;
+    /// 目前为止最长的前缀通配
+    const Node *wildcard = nullptr;
+    size_t wildcardLen = 0;
+};
+
+ServletRouter::ServletRouter() : m_root(new Node)
+{
+}
+
+ServletRouter::~ServletRouter()
+{
+    delete m_root;
+}
+
+ServletRouter::Node *ServletRouter::insertStatic(Node *node, const char *str, size_t len)
+{
+    while (len > 0)
+    {
+        size_t idx = node->indices.find(*str);
+        if (idx == std::string::npos)
+        {
+            Node *child = new Node;
+            child->prefix.assign(str, len);
+            node->children.emplace_back(child);
+            node->indices.push_back(*str);
+            return child;
+        }
+        std::unique_ptr<Node> *next = &node->children[idx];
+        Node *child = next->get();
+        size_t common = 0;
+        size_t max = std::min(len, child->prefix.size());
+        while (common < max && child->prefix[common] == str[common])
+        {
+            ++common;
+        }
+        if (common < child->prefix.size())
+        {
+            //只共用了一部分，把这条边拆成两段
+            Node *mid = new Node;
+            mid->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            mid->children.emplace_back(next->release());
+            mid->indices.push_back(child->prefix[0]);
+            next->reset(mid);
+            child = mid;
+        }
+        node = child;
+        str += common;
+        len -= common;
+    }
+    return node;
+}
+
+void ServletRouter::addServlet(const std::string &uri, ServletPtr slt)
+{
+    Node *node = m_root;
+    std::vector<std::string> names;
+    size_t i = 0;
+    while (i < uri.size())
+    {
+        if (uri[i] == ':' && (i == 0 || uri[i - 1] == '/'))
+        {
+            size_t end = uri.find('/', i);
+            if (end == std::string::npos)
+            {
+                end = uri.size();
+            }
+            names.push_back(uri.substr(i + 1, end - i - 1));
+            if (!node->param)
+            {
+                node->param.reset(new Node);
+            }
+            node = node->param.get();
+            i = end;
+            continue;
+        }
+        size_t j = i;
+        while (j < uri.size() && !(uri[j] == ':' && (j == 0 || uri[j - 1] == '/')))
+        {
+            ++j;
+        }
+        node = insertStatic(node, uri.data() + i, j - i);
+        i = j;
+    }
+    node->exact = slt;
+    node->paramNames.swap(names);
+}
+
+void ServletRouter::addGlobServlet(const std::string &pattern, ServletPtr slt)
+{
+    size_t meta = pattern.find_first_of("*?[\\");
+    if (meta != std::string::npos && meta + 1 == pattern.size() && pattern[meta] == '*')
+    {
+        insertStatic(m_root, pattern.data(), meta)->wildcard = slt;
+        return;
+    }
+    m_globs.push_back(std::make_pair(pattern, slt));
+}
+
+bool ServletRouter::matchNode(const Node *node, const char *pos, MatchState &state) const
+{
+    if (node->wildcard && (!state.wildcard || (size_t)(pos - state.begin) >= state.wildcardLen))
+    {
+        state.wildcard = node;
+        state.wildcardLen = pos - state.begin;
+    }
+    if (pos == state.end)
+    {
+        if (node->exact)
+        {
+            state.found = node;
+            return true;
+        }
+        return false;
+    }
+    //静态段优先，走不通再试参数段
+    const char *idx = (const char *)memchr(node->indices.data(), *pos, node->indices.size());
+    if (idx)
+    {
+        const Node *child = node->children[idx - node->indices.data()].get();
+        size_t len = child->prefix.size();
+        if ((size_t)(state.end - pos) >= len && memcmp(pos, child->prefix.data(), len) == 0 &&
+            matchNode(child, pos + len, state))
+        {
+            return true;
+        }
+    }
+    if (node->param)
+    {
+        const char *seg_end = (const char *)memchr(pos, '/', state.end - pos);
+        if (!seg_end)
+        {
+            seg_end = state.end;
+        }
+        if (seg_end > pos)
+        {
+            state.spans.push_back(std::make_pair(pos - state.begin, seg_end - pos));
+            if (matchNode(node->param.get(), seg_end, state))
+            {
+                return true;
+            }
+            state.spans.pop_back();
+        }
+    }
+    return false;
+}
+
+ServletRouter::ServletPtr ServletRouter::match(const std::string &path, Params *params) const
+{
+    MatchState state;
+    state.begin = path.data();
+    state.end = path.data() + path.size();
+    if (matchNode(m_root, state.begin, state))
+    {
+        if (params)
+        {
+            const std::vector<std::string> &names = state.found->paramNames;
+            for (size_t i = 0; i < state.spans.size() && i < names.size(); ++i)
+            {
+                params->push_back(std::make_pair(
+                    names[i], path.substr(state.spans[i].first, state.spans[i].second)));
+            }
+        }
+        return state.found->exact;
+    }
+    if (state.wildcard)
+    {
+        return state.wildcard->wildcard;
+    }
+    for (auto &i : m_globs)
+    {
+        if (!fnmatch(i.first.c_str(), path.c_str(), 0))
+        {
+            return i.second;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace http
+} // namespace sylar
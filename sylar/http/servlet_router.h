@@ -0,0 +1,61 @@
+#ifndef __SYLAR_HTTP_SERVLET_ROUTER_H__
+#define __SYLAR_HTTP_SERVLET_ROUTER_H__
+
+#include "sylar/noncopyable.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sylar
+{
+namespace http
+{
+
+class Servlet;
+
+/**
+ * @brief 路由表的不可变快照：压缩前缀树
+ * @details 建好之后只读，多个线程可以同时 match。支持三种路由：
+ *          1. 精确路径，其中以 ':' 开头的段是参数，匹配到下一个 '/' 为止，例如 /user/:id/profile
+ *          2. 前缀通配，形如 "/static/" 加 '*'，'*' 只能在最后，可以匹配 '/'（和 fnmatch 不带标志时一样）
+ *          3. 其他 fnmatch 模式放在一个列表里，前两种都没匹配上才按加入顺序逐个尝试
+ *          优先级：精确（静态段优先于参数段）> 最长的前缀通配 > 其他通配。
+ *          匹配沿着树走一遍路径，和注册了多少条路由无关。
+ */
+class ServletRouter : Noncopyable
+{
+public:
+    typedef std::shared_ptr<Servlet> ServletPtr;
+    typedef std::vector<std::pair<std::string, std::string>> Params;
+
+    ServletRouter();
+    ~ServletRouter();
+
+    void addServlet(const std::string &uri, ServletPtr slt);
+    void addGlobServlet(const std::string &pattern, ServletPtr slt);
+
+    /**
+     * @brief 找 path 对应的 servlet，没有返回 nullptr
+     * @param[out] params 不为空时填入参数段的名字和值
+     */
+    ServletPtr match(const std::string &path, Params *params = nullptr) const;
+
+private:
+    struct Node;
+    struct MatchState;
+
+    // 从 node 往下插入静态字符串，必要时拆分边，返回字符串末尾对应的节点
+    Node *insertStatic(Node *node, const char *str, size_t len);
+    bool matchNode(const Node *node, const char *pos, MatchState &state) const;
+
+private:
+    Node *m_root;
+    // 不能放进树里的通配模式
+    std::vector<std::pair<std::string, ServletPtr>> m_globs;
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif
@@ -0,0 +1,531 @@
+#include "static_file_servlet.h"
+#include "http_session.h"
+#include "sylar/log.h"
+#include "sylar/util.h"
+#include <cstring>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace sylar
+{
+namespace http
+{
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+struct StaticFileServlet::File
+{
+    int fd = -1;
+    uint64_t size = 0;
+    time_t mtime = 0;
+    long mtimeNsec = 0;
+    ino_t ino = 0;
+    std::string etag;
+    std::string lastModified;
+    /// 上次 stat 的时间（CoarseMonoMs），只在写锁下修改
+    uint64_t checkTime = 0;
+
+    ~File()
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+};
+
+namespace
+{
+
+std::string FormatHttpDate(time_t t)
+{
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[64];
+    size_t n = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, n);
+}
+
+bool ParseHttpDate(const std::string &str, time_t &t)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end)
+    {
+        return false;
+    }
+    t = timegm(&tm);
+    return true;
+}
+
+int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// 路径里的 %XX 解码，'+' 在路径里不是空格
+bool PercentDecode(const std::string &str, std::string &out)
+{
+    out.clear();
+    out.reserve(str.size());
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        if (str[i] != '%')
+        {
+            out.push_back(str[i]);
+            continue;
+        }
+        if (i + 2 >= str.size())
+        {
+            return false;
+        }
+        int hi = HexValue(str[i + 1]);
+        int lo = HexValue(str[i + 2]);
+        if (hi < 0 || lo < 0 || (hi == 0 && lo == 0))
+        {
+            return false;
+        }
+        out.push_back((char)(hi * 16 + lo));
+        i += 2;
+    }
+    return true;
+}
+
+// If-None-Match 是逗号分隔的列表，比较时忽略弱校验前缀 W/
+bool EtagMatch(const std::string &header, const std::string &etag)
+{
+    size_t pos = 0;
+    while (pos < header.size())
+    {
+        size_t end = header.find(',', pos);
+        if (end == std::string::npos)
+        {
+            end = header.size();
+        }
+        size_t b = pos;
+        size_t e = end;
+        while (b < e && (header[b] == ' ' || header[b] == '\t'))
+        {
+            ++b;
+        }
+        while (e > b && (header[e - 1] == ' ' || header[e - 1] == '\t'))
+        {
+            --e;
+        }
+        if (e - b >= 2 && header.compare(b, 2, "W/") == 0)
+        {
+            b += 2;
+        }
+        if ((e - b == 1 && header[b] == '*') || header.compare(b, e - b, etag) == 0)
+        {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+enum class RangeResult
+{
+    // 没有 Range 或者格式看不懂，按整个文件处理
+    NONE,
+    OK,
+    UNSATISFIABLE,
+};
+
+// 只支持单段 bytes=a-b / bytes=a- / bytes=-n，多段的按整个文件发
+RangeResult ParseRange(const std::string &str, uint64_t size, uint64_t &start, uint64_t &end)
+{
+    if (str.compare(0, 6, "bytes=") != 0 || str.find(',') != std::string::npos)
+    {
+        return RangeResult::NONE;
+    }
+    const char *p = str.c_str() + 6;
+    const char *dash = strchr(p, '-');
+    if (!dash)
+    {
+        return RangeResult::NONE;
+    }
+    char *e = nullptr;
+    if (dash == p)
+    {
+        //后缀形式，最后 n 个字节
+        if (!isdigit((unsigned char)dash[1]))
+        {
+            return RangeResult::NONE;
+        }
+        uint64_t n = strtoull(dash + 1, &e, 10);
+        if (*e)
+        {
+            return RangeResult::NONE;
+        }
+        if (n == 0 || size == 0)
+        {
+            return RangeResult::UNSATISFIABLE;
+        }
+        start = n >= size ? 0 : size - n;
+        end = size - 1;
+        return RangeResult::OK;
+    }
+    if (!isdigit((unsigned char)*p))
+    {
+        return RangeResult::NONE;
+    }
+    start = strtoull(p, &e, 10);
+    if (e != dash)
+    {
+        return RangeResult::NONE;
+    }
+    if (dash[1] == '\0')
+    {
+        end = size - 1;
+    }
+    else
+    {
+        if (!isdigit((unsigned char)dash[1]))
+        {
+            return RangeResult::NONE;
+        }
+        end = strtoull(dash + 1, &e, 10);
+        if (*e || end < start)
+        {
+            return RangeResult::NONE;
+        }
+        if (end >= size)
+        {
+            end = size - 1;
+        }
+    }
+    if (start >= size)
+    {
+        return RangeResult::UNSATISFIABLE;
+    }
+    return RangeResult::OK;
+}
+
+void SendError(HttpResponse::ptr response, HttpStatus status)
+{
+    response->setStatus(status);
+    response->setHeader("Content-Type", "text/plain");
+    response->setBody(std::string(HttpStatusToString(status)) + "\n");
+}
+
+} // namespace
+
+StaticFileServlet::StaticFileServlet(const std::string &root, const std::string &prefix)
+    : Servlet("StaticFileServlet"), m_root(root), m_prefix(prefix)
+{
+    while (!m_root.empty() && m_root.back() == '/')
+    {
+        m_root.pop_back();
+    }
+    while (!m_prefix.empty() && m_prefix.back() == '/')
+    {
+        m_prefix.pop_back();
+    }
+}
+
+const char *StaticFileServlet::GetMimeType(const std::string &path)
+{
+    static const struct
+    {
+        const char *ext;
+        const char *type;
+    } s_types[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "application/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"webp", "image/webp"},
+        {"ico", "image/x-icon"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+        {"mp4", "video/mp4"},
+        {"map", "application/json"},
+    };
+    size_t dot = path.rfind('.');
+    size_t slash = path.rfind('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    {
+        const char *ext = path.c_str() + dot + 1;
+        for (auto &i : s_types)
+        {
+            if (strcasecmp(ext, i.ext) == 0)
+            {
+                return i.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+std::string StaticFileServlet::mapPath(const std::string &uri) const
+{
+    if (m_singleFile)
+    {
+        return m_root;
+    }
+    std::string path;
+    if (!PercentDecode(uri, path))
+    {
+        return "";
+    }
+    if (!m_prefix.empty())
+    {
+        if (path.compare(0, m_prefix.size(), m_prefix) != 0 ||
+            (path.size() > m_prefix.size() && path[m_prefix.size()] != '/'))
+        {
+            return "";
+        }
+        path.erase(0, m_prefix.size());
+    }
+    if (path.empty() || path[0] != '/')
+    {
+        path.insert(0, "/");
+    }
+    //不允许 ".." 段跳出 root
+    size_t pos = 0;
+    while (pos < path.size())
+    {
+        size_t end = path.find('/', pos + 1);
+        if (end == std::string::npos)
+        {
+            end = path.size();
+        }
+        if (end - pos == 3 && path.compare(pos, 3, "/..") == 0)
+        {
+            return "";
+        }
+        pos = end;
+    }
+    if (path.back() == '/')
+    {
+        path += m_index;
+    }
+    return m_root + path;
+}
+
+StaticFileServlet::FilePtr StaticFileServlet::openFile(const std::string &path)
+{
+    //单调时钟，墙上时间被调整不影响缓存多久重新 stat
+    uint64_t now = sylar::CoarseMonoMs();
+    FilePtr old;
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_cache.find(path);
+        if (it != m_cache.end())
+        {
+            if (now - it->second->checkTime < m_cacheTtl)
+            {
+                return it->second;
+            }
+            old = it->second;
+        }
+    }
+
+    FilePtr file;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        //不存在的路径也缓存一会，挡住反复请求同一个 404
+        file = std::make_shared<File>();
+    }
+    else if (old && old->fd >= 0 && old->ino == st.st_ino && old->size == (uint64_t)st.st_size &&
+             old->mtime == st.st_mtim.tv_sec && old->mtimeNsec == st.st_mtim.tv_nsec)
+    {
+        //文件没变，沿用已经打开的 fd
+        RWMutexType::WriteLock lock(m_mutex);
+        old->checkTime = now;
+        return old;
+    }
+    else
+    {
+        file = std::make_shared<File>();
+        file->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file->fd < 0)
+        {
+            SYLAR_LOG_WARN(g_logger) << "StaticFileServlet open " << path << " errno=" << errno
+                                     << " errstr=" << strerror(errno);
+        }
+        else
+        {
+            file->size = st.st_size;
+            file->mtime = st.st_mtim.tv_sec;
+            file->mtimeNsec = st.st_mtim.tv_nsec;
+            file->ino = st.st_ino;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "\"%llx-%llx\"", (unsigned long long)file->size,
+                     (unsigned long long)file->mtime);
+            file->etag = buf;
+            file->lastModified = FormatHttpDate(file->mtime);
+        }
+    }
+    file->checkTime = now;
+
+    RWMutexType::WriteLock lock(m_mutex);
+    if (m_cache.size() >= m_maxCacheSize && !m_cache.count(path))
+    {
+        m_cache.clear();
+    }
+    m_cache[path] = file;
+    return file;
+}
+
+void StaticFileServlet::clearCache()
+{
+    RWMutexType::WriteLock lock(m_mutex);
+    m_cache.clear();
+}
+
+size_t StaticFileServlet::getCacheSize()
+{
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_cache.size();
+}
+
+int32_t StaticFileServlet::handle(sylar::http::HttpRequest::ptr request,
+                                  sylar::http::HttpResponse::ptr response,
+                                  sylar::http::HttpSession::ptr session)
+{
+    HttpMethod method = request->getMethod();
+    if (method != HttpMethod::GET && method != HttpMethod::HEAD)
+    {
+        response->setHeader("Allow", "GET, HEAD");
+        SendError(response, HttpStatus::METHOD_NOT_ALLOWED);
+        return 0;
+    }
+    std::string path = mapPath(request->getPath());
+    if (path.empty())
+    {
+        SendError(response, HttpStatus::BAD_REQUEST);
+        return 0;
+    }
+    FilePtr file = openFile(path);
+    if (file->fd < 0)
+    {
+        SendError(response, HttpStatus::NOT_FOUND);
+        return 0;
+    }
+
+    response->setHeader("Content-Type", GetMimeType(path));
+    if (m_gzip)
+    {
+        response->setHeader("Vary", "Accept-Encoding");
+        if (request->getHeader("Accept-Encoding").find("gzip") != std::string::npos)
+        {
+            FilePtr gz = openFile(path + ".gz");
+            if (gz->fd >= 0)
+            {
+                file = gz;
+                response->setHeader("Content-Encoding", "gzip");
+            }
+        }
+    }
+    response->setHeader("ETag", file->etag);
+    response->setHeader("Last-Modified", file->lastModified);
+    response->setHeader("Accept-Ranges", "bytes");
+    if (!m_cacheControl.empty())
+    {
+        response->setHeader("Cache-Control", m_cacheControl);
+    }
+
+    std::string inm = request->getHeader("If-None-Match");
+    std::string ims = request->getHeader("If-Modified-Since");
+    time_t since = 0;
+    if (inm.empty() ? (!ims.empty() && ParseHttpDate(ims, since) && file->mtime <= since)
+                    : EtagMatch(inm, file->etag))
+    {
+        response->setStatus(HttpStatus::NOT_MODIFIED);
+        return 0;
+    }
+
+    uint64_t start = 0;
+    uint64_t length = file->size;
+    std::string range = request->getHeader("Range");
+    std::string if_range = request->getHeader("If-Range");
+    if (!range.empty() &&
+        (if_range.empty() || if_range == file->etag || if_range == file->lastModified))
+    {
+        uint64_t end = 0;
+        RangeResult rr = ParseRange(range, file->size, start, end);
+        if (rr == RangeResult::UNSATISFIABLE)
+        {
+            response->setHeader("Content-Range", "bytes */" + std::to_string(file->size));
+            SendError(response, HttpStatus::RANGE_NOT_SATISFIABLE);
+            return 0;
+        }
+        if (rr == RangeResult::OK)
+        {
+            length = end - start + 1;
+            response->setStatus(HttpStatus::PARTIAL_CONTENT);
+            response->setHeader("Content-Range", "bytes " + std::to_string(start) + "-" +
+                                                     std::to_string(end) + "/" +
+                                                     std::to_string(file->size));
+        }
+        else
+        {
+            start = 0;
+        }
+    }
+
+    if (method == HttpMethod::HEAD)
+    {
+        response->setHeader("Content-Length", std::to_string(length));
+        return 0;
+    }
+    if (session)
+    {
+        //file 持有 fd，发完之前缓存被换掉也不会关
+        if (session->sendFileResponse(response, file->fd, start, length) <= 0)
+        {
+            //响应已经发了一部分，这个连接不能再用
+            response->setClose(true);
+            return -1;
+        }
+        return 0;
+    }
+    //没有连接（比如直接调用 handle）时读进 body
+    std::string body(length, '\0');
+    size_t got = 0;
+    while (got < length)
+    {
+        ssize_t n = ::pread(file->fd, &body[got], length - got, start + got);
+        if (n <= 0)
+        {
+            break;
+        }
+        got += n;
+    }
+    body.resize(got);
+    response->setBody(body);
+    return 0;
+}
+
+} // namespace http
+} // namespace sylar
@@ -0,0 +1,102 @@
+#ifndef __SYLAR_HTTP_STATIC_FILE_SERVLET_H__
+#define __SYLAR_HTTP_STATIC_FILE_SERVLET_H__
+
+#include "servlet.h"
+#include "sylar/mutex.h"
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+
+namespace sylar
+{
+namespace http
+{
+
+/**
+ * @brief 把一个本地目录作为静态文件发出去
+ * @details 响应体用 sendfile 直接从文件发到 socket，不经过用户态。打开的 fd 和 stat 结果按路径缓存，
+ *          超过 cache_ttl 才重新 stat 一次，文件变了就换成新打开的 fd。
+ *          支持 ETag/Last-Modified 条件请求（304）、单段 Range（206/416）、HEAD，
+ *          打开 gzip 后客户端接受 gzip 时优先发同名的 .gz 文件。
+ *          一般用 addGlobServlet 注册成以 '*' 结尾的前缀通配，prefix 填通配前面那段路径
+ */
+class StaticFileServlet : public Servlet
+{
+public:
+    typedef std::shared_ptr<StaticFileServlet> ptr;
+    typedef RWMutex RWMutexType;
+
+    /**
+     * @param[in] root 本地目录
+     * @param[in] prefix 请求路径开头要去掉的部分，剩下的拼在 root 后面
+     */
+    StaticFileServlet(const std::string &root, const std::string &prefix = "");
+
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request,
+                           sylar::http::HttpResponse::ptr response,
+                           sylar::http::HttpSession::ptr session) override;
+
+    // 客户端接受 gzip 时是否发预先压缩好的 .gz 文件
+    void setGzip(bool v)
+    {
+        m_gzip = v;
+    }
+    // 缓存的文件信息多久之后重新 stat 一次，0 表示每次都 stat
+    void setCacheTtl(uint64_t ms)
+    {
+        m_cacheTtl = ms;
+    }
+    // 最多缓存多少个路径，满了整个清掉
+    void setMaxCacheSize(size_t v)
+    {
+        m_maxCacheSize = v;
+    }
+    // 请求路径以 '/' 结尾时用的文件名
+    void setIndex(const std::string &v)
+    {
+        m_index = v;
+    }
+    // 非空时加到每个响应上
+    void setCacheControl(const std::string &v)
+    {
+        m_cacheControl = v;
+    }
+    // root 是一个文件，不管请求路径是什么都发它，用来把单个页面挂在固定的路由上
+    void setSingleFile(bool v)
+    {
+        m_singleFile = v;
+    }
+    void clearCache();
+    size_t getCacheSize();
+
+    // 按扩展名猜 Content-Type
+    static const char *GetMimeType(const std::string &path);
+
+private:
+    struct File;
+    typedef std::shared_ptr<File> FilePtr;
+
+    // 取 path 对应的文件，不存在或者不是普通文件时返回的 File::fd 为 -1
+    FilePtr openFile(const std::string &path);
+    // 请求路径转成 root 下的本地路径，不合法（比如带 ".."）返回空
+    std::string mapPath(const std::string &uri) const;
+
+private:
+    std::string m_root;
+    std::string m_prefix;
+    std::string m_index = "index.html";
+    std::string m_cacheControl;
+    bool m_gzip = false;
+    bool m_singleFile = false;
+    uint64_t m_cacheTtl = 1000;
+    size_t m_maxCacheSize = 4096;
+
+    RWMutexType m_mutex;
+    std::unordered_map<std::string, FilePtr> m_cache;
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif
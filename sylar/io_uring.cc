@@ -0,0 +1,265 @@
+#include "io_uring.h"
+#include "log.h"
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static int sys_io_uring_setup(uint32_t entries, io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int sys_io_uring_register(int fd, uint32_t opcode, const void *arg, uint32_t nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+IoUring::IoUring()
+{
+}
+
+IoUring::~IoUring()
+{
+    if (m_sqes)
+    {
+        munmap(m_sqes, m_sqesSize);
+    }
+    if (m_ringPtr)
+    {
+        munmap(m_ringPtr, m_ringSize);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+bool IoUring::init(uint32_t entries)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 2;
+    m_fd = sys_io_uring_setup(entries, &p);
+    if (m_fd < 0)
+    {
+        SYLAR_LOG_INFO(g_logger) << "io_uring_setup entries=" << entries << " errno=" << errno
+                                 << " errstr=" << strerror(errno);
+        return false;
+    }
+    // 老内核（5.4 以前）SQ 和 CQ 要分开映射，不支持的直接放弃，退回 epoll
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP))
+    {
+        SYLAR_LOG_INFO(g_logger) << "io_uring features=" << p.features << " not supported";
+        return false;
+    }
+    m_sqEntries = p.sq_entries;
+    m_cqEntries = p.cq_entries;
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    m_ringSize = sq_size > cq_size ? sq_size : cq_size;
+    void *ptr = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                     IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "mmap io_uring ring errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+    m_ringPtr = ptr;
+
+    m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    ptr = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+               IORING_OFF_SQES);
+    if (ptr == MAP_FAILED)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "mmap io_uring sqes errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+    m_sqes = (io_uring_sqe *)ptr;
+
+    char *base = (char *)m_ringPtr;
+    m_sqHead = (uint32_t *)(base + p.sq_off.head);
+    m_sqTail = (uint32_t *)(base + p.sq_off.tail);
+    m_sqMask = (uint32_t *)(base + p.sq_off.ring_mask);
+    m_sqFlags = (uint32_t *)(base + p.sq_off.flags);
+    m_sqArray = (uint32_t *)(base + p.sq_off.array);
+    m_cqHead = (uint32_t *)(base + p.cq_off.head);
+    m_cqTail = (uint32_t *)(base + p.cq_off.tail);
+    m_cqMask = (uint32_t *)(base + p.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe *)(base + p.cq_off.cqes);
+    m_cqFlags = p.cq_off.flags ? (uint32_t *)(base + p.cq_off.flags) : nullptr;
+    return true;
+}
+
+bool IoUring::registerEventFd(int fd)
+{
+    // EVENTFD_ASYNC 只通知 io-wq 线程里完成的事件，socket 上靠 poll 唤醒的完成不算，不能用
+    if (!m_cqFlags || sys_io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &fd, 1))
+    {
+        SYLAR_LOG_ERROR(g_logger) << "io_uring register eventfd errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool IoUring::probe()
+{
+    static const uint8_t s_ops[] = {IORING_OP_READ,         IORING_OP_WRITE,   IORING_OP_READV,
+                                    IORING_OP_WRITEV,       IORING_OP_RECV,    IORING_OP_SEND,
+                                    IORING_OP_RECVMSG,      IORING_OP_SENDMSG, IORING_OP_ACCEPT,
+                                    IORING_OP_CONNECT,      IORING_OP_ASYNC_CANCEL,
+                                    IORING_OP_LINK_TIMEOUT};
+    static const size_t kProbeOps = 256;
+    alignas(io_uring_probe) char
+        buf[sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op)];
+    memset(buf, 0, sizeof(buf));
+    io_uring_probe *p = (io_uring_probe *)buf;
+    if (sys_io_uring_register(m_fd, IORING_REGISTER_PROBE, p, kProbeOps))
+    {
+        SYLAR_LOG_INFO(g_logger) << "io_uring probe errno=" << errno
+                                 << " errstr=" << strerror(errno);
+        return false;
+    }
+    for (auto op : s_ops)
+    {
+        if (op > p->last_op || !(p->ops[op].flags & IO_URING_OP_SUPPORTED))
+        {
+            SYLAR_LOG_INFO(g_logger) << "io_uring opcode=" << (int)op << " not supported";
+            return false;
+        }
+    }
+
+    // hook 层依赖内核在数据没到时把操作挂起等待，而不是对非阻塞 socket 直接返回 EAGAIN
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv))
+    {
+        return false;
+    }
+    char c = 0;
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sv[0];
+    sqe->addr = (uint64_t)(uintptr_t)&c;
+    sqe->len = 1;
+    sqe->user_data = 1;
+    submit();
+    // 写一个字节，正常情况下挂起的 recv 会收到它
+    send(sv[1], &c, 1, MSG_NOSIGNAL);
+    int res = -EINPROGRESS;
+    for (int i = 0; i < 100 && res == -EINPROGRESS; ++i)
+    {
+        enter(0, 1, IORING_ENTER_GETEVENTS);
+        reap([&res](io_uring_cqe *cqe) { res = cqe->res; });
+    }
+    close(sv[0]);
+    close(sv[1]);
+    if (res != 1)
+    {
+        SYLAR_LOG_INFO(g_logger) << "io_uring recv on nonblocking socket res=" << res;
+        return false;
+    }
+    return true;
+}
+
+io_uring_sqe *IoUring::getSqe()
+{
+    uint32_t head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    uint32_t tail = *m_sqTail + m_sqPending;
+    if (tail - head >= m_sqEntries)
+    {
+        return nullptr;
+    }
+    uint32_t idx = tail & *m_sqMask;
+    io_uring_sqe *sqe = &m_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[idx] = idx;
+    ++m_sqPending;
+    return sqe;
+}
+
+int IoUring::submit()
+{
+    uint32_t n = m_sqPending;
+    if (!n)
+    {
+        return 0;
+    }
+    __atomic_store_n(m_sqTail, *m_sqTail + n, __ATOMIC_RELEASE);
+    m_sqPending = 0;
+    // 提交期间当场完成的事件不写 eventfd，省掉一次空闲线程的无效唤醒
+    setEventFdEnabled(false);
+    int rt = 0;
+    do
+    {
+        rt = enter(n, 0, 0);
+    } while (rt == -EINTR);
+    setEventFdEnabled(true);
+    return rt;
+}
+
+void IoUring::setEventFdEnabled(bool v)
+{
+    if (!m_cqFlags)
+    {
+        return;
+    }
+    if (v)
+    {
+        __atomic_fetch_and(m_cqFlags, ~(uint32_t)IORING_CQ_EVENTFD_DISABLED, __ATOMIC_SEQ_CST);
+    }
+    else
+    {
+        __atomic_fetch_or(m_cqFlags, (uint32_t)IORING_CQ_EVENTFD_DISABLED, __ATOMIC_SEQ_CST);
+    }
+}
+
+io_uring_cqe *IoUring::peekCqe()
+{
+    uint32_t head = *m_cqHead;
+    if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+    {
+        return nullptr;
+    }
+    return &m_cqes[head & *m_cqMask];
+}
+
+void IoUring::advanceCq()
+{
+    __atomic_store_n(m_cqHead, *m_cqHead + 1, __ATOMIC_RELEASE);
+}
+
+bool IoUring::flushOverflow()
+{
+    if (!(__atomic_load_n(m_sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW))
+    {
+        return false;
+    }
+    enter(0, 0, IORING_ENTER_GETEVENTS);
+    return peekCqe() != nullptr;
+}
+
+int IoUring::enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    int rt = sys_io_uring_enter(m_fd, to_submit, min_complete, flags);
+    return rt < 0 ? -errno : rt;
+}
+
+} // namespace sylar
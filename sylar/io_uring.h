@@ -0,0 +1,110 @@
+#ifndef __SYLAR_IO_URING_H__
+#define __SYLAR_IO_URING_H__
+
+#include "noncopyable.h"
+#include <cstddef>
+#include <cstdint>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace sylar
+{
+
+/**
+ * @brief 一次要交给 io_uring 执行的操作
+ *
+ * 各种 socket 操作用到的 SQE 字段是同一组，hook 层只需要填好这几个字段，
+ * 不用关心 SQE 的具体布局
+ */
+struct UringOp
+{
+    uint8_t opcode = 0;
+    int fd = -1;
+    uint64_t addr = 0;     // 缓冲区 / iovec / msghdr / sockaddr 地址
+    uint32_t len = 0;      // 长度 / iovec 个数
+    uint64_t off = 0;      // 文件偏移；accept 时是 socklen_t*，connect 时是地址长度
+    uint32_t op_flags = 0; // msg_flags / accept_flags
+};
+
+/**
+ * @brief 对 io_uring 系统调用的最小封装（不依赖 liburing）
+ *
+ * 只负责建环、拿 SQE、提交和收割 CQE，不是线程安全的，由使用者加锁。
+ */
+class IoUring : Noncopyable
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    // 建一个 entries 大小的环，失败返回 false（内核不支持或被禁用）
+    bool init(uint32_t entries);
+    // 完成事件到来时写 eventfd；提交时当场完成的不通知
+    bool registerEventFd(int fd);
+    // 内核是否支持本框架用到的所有操作码和行为
+    bool probe();
+
+    // 取一个空闲的 SQE，已经清零；SQ 满了返回 nullptr
+    io_uring_sqe *getSqe();
+    // 提交所有已经填好的 SQE，返回提交的个数，失败返回 -errno；
+    // 提交期间完成的事件不写 eventfd，调用者提交后要自己收割一次
+    int submit();
+
+    // 逐个处理已经完成的 CQE，返回处理的个数
+    template <class Func> size_t reap(Func func)
+    {
+        size_t count = 0;
+        while (true)
+        {
+            io_uring_cqe *cqe = peekCqe();
+            if (!cqe)
+            {
+                //CQ 溢出时内核把事件暂存起来，需要 enter 一次才会搬回 CQ
+                if (!flushOverflow())
+                {
+                    break;
+                }
+                continue;
+            }
+            func(cqe);
+            advanceCq();
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    io_uring_cqe *peekCqe();
+    void advanceCq();
+    bool flushOverflow();
+    int enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+    void setEventFdEnabled(bool v);
+
+private:
+    int m_fd = -1;
+    uint32_t m_sqEntries = 0;
+    uint32_t m_cqEntries = 0;
+    // 上次提交以来填好但还没交给内核的 SQE 个数
+    uint32_t m_sqPending = 0;
+
+    void *m_ringPtr = nullptr;
+    size_t m_ringSize = 0;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    uint32_t *m_sqHead = nullptr;
+    uint32_t *m_sqTail = nullptr;
+    uint32_t *m_sqMask = nullptr;
+    uint32_t *m_sqFlags = nullptr;
+    uint32_t *m_sqArray = nullptr;
+    uint32_t *m_cqHead = nullptr;
+    uint32_t *m_cqTail = nullptr;
+    uint32_t *m_cqMask = nullptr;
+    uint32_t *m_cqFlags = nullptr;
+    io_uring_cqe *m_cqes = nullptr;
+};
+
+} // namespace sylar
+
+#endif
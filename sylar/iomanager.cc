@@ -1,4 +1,6 @@
 #include "iomanager.h"
+#include "io_uring.h"
+#include "sylar/config.h"
 #include "sylar/log.h"
 #include "sylar/macro.h"
 #include "sylar/thread.h"
@@ -8,13 +10,21 @@
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
+#include <iterator>
+#include <linux/io_uring.h>
 #include <memory>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 namespace sylar
 {
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static ConfigVar<std::string>::ptr g_iomanager_backend =
+    Config::Lookup<std::string>("iomanager.backend", "epoll", "io backend: epoll|io_uring");
+static ConfigVar<uint32_t>::ptr g_iomanager_uring_entries =
+    Config::Lookup<uint32_t>("iomanager.io_uring.entries", 256, "io_uring submission queue size");
+
 IOManager::FdContext::EventContext &IOManager::FdContext::getContext(IOManager::Event event)
 {
     switch (event)
@@ -33,6 +43,7 @@ void IOManager::FdContext::resetContext(EventContext &ctx)
     ctx.scheduler = nullptr;
     ctx.fiber.reset();
     ctx.cb = nullptr;
+    ctx.timed = false;
 }
 void IOManager::FdContext::triggerEvent(Event event)
 {
@@ -48,6 +59,7 @@ void IOManager::FdContext::triggerEvent(Event event)
         ctx.scheduler->schedule(&ctx.fiber);
     }
     ctx.scheduler = nullptr;
+    ctx.timed = false;
     return;
 }
 
@@ -57,78 +69,78 @@ IOManager::IOManager(size_t threads, bool use_caller, const std::string &name)
     m_epfd = epoll_create(5000);
     SYLAR_ASSERT(m_epfd > 0);
 
-    //创建管道，m_tickleFds[0]是读端，m_tickleFds[1]是写端,用于进程间的唤醒
-    //当需要唤醒阻塞在 epoll_wait 的 IO 线程时，向管道写端（m_tickleFds [1]）写入一个字节，
-    // epoll 检测到管道读端的读事件，线程就会从 epoll_wait 中返回；
-    int rt = pipe(m_tickleFds);
-    SYLAR_ASSERT(!rt);
+    //用eventfd唤醒阻塞在 epoll_wait 的 IO 线程：写入一次计数，epoll 检测到读事件，线程就会从 epoll_wait 中返回；
+    //比管道少一个fd，多次写入只累加计数，一次read就能清空
+    m_tickleFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    SYLAR_ASSERT(m_tickleFd >= 0);
 
     //初始化epoll_event结构体，用于描述要监听的事件 epoll_event event;
+    //多个线程阻塞在同一个epfd上时，一次就绪事件只会唤醒其中一个
     epoll_event event;
     memset(&event, 0, sizeof(epoll_event));
     event.events = EPOLLIN | EPOLLET;
-    event.data.fd = m_tickleFds[0];
+    event.data.fd = m_tickleFd;
 
-    //将管道读端设置为非阻塞模式，避免读操作阻塞线程
-    rt = fcntl(m_tickleFds[0], F_SETFL, O_NONBLOCK);
+    int rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFd, &event);
     SYLAR_ASSERT(!rt);
 
-    //将管道读端注册到epoll实例中，监听其读事件
-    rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFds[0], &event);
-    SYLAR_ASSERT(!rt);
-    contextResize(32);
-    start();
-}
-
-IOManager::~IOManager()
-{
-    stop();
-    close(m_epfd);
-    close(m_tickleFds[0]);
-    close(m_tickleFds[1]);
-    for (size_t i = 0; i < m_fdContexts.size(); i++)
+    //io_uring 和 epoll 并存：hook 的 socket 读写直接提交给 io_uring，addEvent 仍然走 epoll；
+    //io_uring 完成事件写到 m_uringEventFd，它也挂在 epfd 上，所以空闲线程还是只等一个 epoll_wait
+    if (g_iomanager_backend->getValue() == "io_uring")
     {
-        if (m_fdContexts[i])
+        std::unique_ptr<IoUring> uring(new IoUring);
+        int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd >= 0 && uring->init(g_iomanager_uring_entries->getValue()) && uring->probe() &&
+            uring->registerEventFd(efd))
+        {
+            event.data.fd = efd;
+            rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, efd, &event);
+            SYLAR_ASSERT(!rt);
+            m_uringEventFd = efd;
+            m_uring = std::move(uring);
+        }
+        else
         {
-            delete m_fdContexts[i];
+            SYLAR_LOG_WARN(g_logger) << "name=" << name
+                                     << " io_uring unavailable, fall back to epoll";
+            if (efd >= 0)
+            {
+                close(efd);
+            }
         }
     }
+    start();
 }
 
-// 上下文容器扩容,并且初始化
-void IOManager::contextResize(size_t size)
+IOManager::~IOManager()
 {
-    m_fdContexts.resize(size);
-    for (size_t i = 0; i < m_fdContexts.size(); i++)
+    stop();
+    close(m_epfd);
+    close(m_tickleFd);
+    if (m_uringEventFd >= 0)
     {
-        if (!m_fdContexts[i])
-        {
-            m_fdContexts[i] = new FdContext;
-            m_fdContexts[i]->fd = i;
-        }
+        close(m_uringEventFd);
     }
+    m_fdContexts.forEach([](FdContext *fd_ctx) { delete fd_ctx; });
 }
 
 //对IOManager管理的一些fd添加监控，当发生某些事情，就会调用对应的回调函数
 int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
 {
-    FdContext *fd_ctx = nullptr;
-    RWMutexType::ReadLock lock(m_mutex);
     // 1、拿到被管理的fd
-    if ((int)m_fdContexts.size() > fd)
-    {
-        fd_ctx = m_fdContexts[fd];
-        lock.unlock();
-    }
-    else
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx)
     {
-        lock.unlock();
-        RWMutexType::WriteLock lock2(m_mutex);
-        contextResize(fd * 1.5);
-        fd_ctx = m_fdContexts[fd];
+        return -1;
     }
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    return doAddEvent(fd_ctx, event, cb);
+}
+
+int IOManager::doAddEvent(FdContext *fd_ctx, Event event, std::function<void()> &cb)
+{
+    int fd = fd_ctx->fd;
     // 2、查看fd上是否已经有了相同的想要被监控的事件
-    FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     if (fd_ctx->events & event)
     {
         SYLAR_LOG_ERROR(g_logger) << "addEvent assert fd=" << fd << " event=" << event
@@ -172,16 +184,78 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
     }
     return 0;
 }
+
+int IOManager::waitEvent(int fd, Event event, uint64_t timeout_ms)
+{
+    FdContext *fd_ctx = getFdContext(fd);
+    if (!fd_ctx)
+    {
+        return -1;
+    }
+    FdContext::EventContext &event_ctx = fd_ctx->getContext(event);
+    uint32_t seq = 0;
+    {
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        std::function<void()> cb;
+        if (doAddEvent(fd_ctx, event, cb))
+        {
+            return -1;
+        }
+        if (timeout_ms != ~0ull)
+        {
+            event_ctx.timed = true;
+            //序号区分每一次等待，已经触发、还没执行的旧回调看到序号变了就什么都不做
+            seq = ++event_ctx.seq;
+            //捕获的内容不超过 std::function 的内部缓冲区，赋值不分配内存
+            auto on_timeout = [fd_ctx, event, seq]()
+            { IOManager::GetThis()->onEventTimeout(fd_ctx, event, seq); };
+            //定时器对象跟着 fd 上下文复用，只有第一次等待时创建
+            if (!event_ctx.timer)
+            {
+                event_ctx.timer = addTimer(timeout_ms, on_timeout);
+            }
+            else
+            {
+                event_ctx.timer->restart(timeout_ms, on_timeout);
+            }
+        }
+    }
+    Fiber::YieldToHold();
+    bool timed_out = false;
+    if (timeout_ms != ~0ull)
+    {
+        //被唤醒后这个 fd 上可能已经开始了下一次等待，定时器归它了
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        if (event_ctx.seq == seq)
+        {
+            event_ctx.timer->cancel();
+        }
+        timed_out = event_ctx.timedOutSeq == seq;
+    }
+    return timed_out ? ETIMEDOUT : 0;
+}
+
+void IOManager::onEventTimeout(FdContext *fd_ctx, Event event, uint32_t seq)
+{
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    FdContext::EventContext &event_ctx = fd_ctx->getContext(event);
+    //事件已经到了，或者这已经是下一次等待
+    if (!(fd_ctx->events & event) || event_ctx.seq != seq || !event_ctx.timed)
+    {
+        return;
+    }
+    event_ctx.timedOutSeq = seq;
+    doCancelEvent(fd_ctx, event);
+}
+
 bool IOManager::delEvent(int fd, Event event)
 {
-    RWMutexType::ReadLock lock(m_mutex);
     //对哪个fd进行监控，拿到对应的fd_ctx
-    if ((int)m_fdContexts.size() <= fd)
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if (!fd_ctx)
     {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
     //看执行操作后EPOLL是修改还是删除
     if (!(fd_ctx->events & event))
@@ -214,32 +288,35 @@ bool IOManager::delEvent(int fd, Event event)
 // 取消事件,不过会把时间先触发一下
 bool IOManager::cancelEvent(int fd, Event event)
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_fdContexts.size() <= fd)
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if (!fd_ctx)
     {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+    bool uring_cancelled = m_uring && cancelUring(fd_ctx, event);
     if (!(fd_ctx->events & event))
     {
-        return false;
+        return uring_cancelled;
     }
+    return doCancelEvent(fd_ctx, event);
+}
 
+bool IOManager::doCancelEvent(FdContext *fd_ctx, Event event)
+{
     Event new_events = (Event)(fd_ctx->events & ~event);
     int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
     epoll_event epevent;
     epevent.events = EPOLLET | new_events;
     epevent.data.ptr = fd_ctx;
 
-    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+    int rt = epoll_ctl(m_epfd, op, fd_ctx->fd, &epevent);
     if (rt)
     {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << "," << fd << ","
-                                  << epevent.events << "):" << rt << " (" << errno << ") ("
-                                  << strerror(errno) << ")";
+        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << "," << fd_ctx->fd
+                                  << "," << epevent.events << "):" << rt << " (" << errno
+                                  << ") (" << strerror(errno) << ")";
         return false;
     }
 
@@ -251,18 +328,22 @@ bool IOManager::cancelEvent(int fd, Event event)
 // 取消所有事件
 bool IOManager::cancelAll(int fd)
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_fdContexts.size() <= fd)
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if (!fd_ctx)
     {
         return false;
     }
-    FdContext *fd_ctx = m_fdContexts[fd];
-    lock.unlock();
 
     FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+    bool uring_cancelled = false;
+    if (m_uring)
+    {
+        uring_cancelled |= cancelUring(fd_ctx, READ);
+        uring_cancelled |= cancelUring(fd_ctx, WRITE);
+    }
     if (!fd_ctx->events)
     {
-        return false;
+        return uring_cancelled;
     }
     int op = EPOLL_CTL_DEL;
     epoll_event epevent;
@@ -280,10 +361,12 @@ bool IOManager::cancelAll(int fd)
     if (fd_ctx->events & Event::READ)
     {
         fd_ctx->triggerEvent(Event::READ);
+        --m_pendingEventCount;
     }
     if (fd_ctx->events & Event::WRITE)
     {
         fd_ctx->triggerEvent(Event::WRITE);
+        --m_pendingEventCount;
     }
     SYLAR_ASSERT(fd_ctx->events == 0);
     return true;
@@ -294,18 +377,201 @@ IOManager *IOManager::GetThis()
     return dynamic_cast<IOManager *>(Scheduler::GetThis());
 }
 
-//向管道写入一个字节，通知epoll_wait有事件发生
+IOManager::FdContext *IOManager::getFdContext(int fd)
+{
+    FdContext *fd_ctx = m_fdContexts.get(fd);
+    if (fd_ctx || !FdTable<FdContext>::InRange(fd))
+    {
+        return fd_ctx;
+    }
+    //上下文创建后就不再释放，同时创建时用先放进去的那个
+    FdContext *created = new FdContext;
+    created->fd = fd;
+    fd_ctx = m_fdContexts.install(fd, created);
+    if (fd_ctx != created)
+    {
+        delete created;
+    }
+    return fd_ctx;
+}
+
+bool IOManager::uringIo(const UringOp &op, Event event, uint64_t timeout_ms, int &result)
+{
+    //内核在协程挂起期间异步写 waiter 和读缓冲，它们多半在协程栈上；
+    //共享栈协程挂起后那块栈会被别的协程占用，只能退回 epoll
+    if (!m_uring || Fiber::GetThis()->isSharedStack())
+    {
+        return false;
+    }
+    FdContext *fd_ctx = getFdContext(op.fd);
+    if (!fd_ctx)
+    {
+        return false;
+    }
+    UringWaiter waiter;
+    UringWaiter *&slot = event == READ ? fd_ctx->uringRead : fd_ctx->uringWrite;
+    {
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        if (slot)
+        {
+            return false;
+        }
+        slot = &waiter;
+    }
+    waiter.scheduler = Scheduler::GetThis();
+    waiter.fiber = Fiber::GetThis();
+    waiter.pending = timeout_ms != ~0ull ? 2 : 1;
+
+    bool done = false;
+    bool submitted = false;
+    {
+        // 超时时间在提交时就被内核读走，放在栈上就可以
+        __kernel_timespec ts;
+        Mutex::Lock lock(m_uringMutex);
+        io_uring_sqe *sqe = m_uring->getSqe();
+        io_uring_sqe *tsqe = sqe && waiter.pending == 2 ? m_uring->getSqe() : nullptr;
+        if (sqe && (waiter.pending == 1 || tsqe))
+        {
+            sqe->opcode = op.opcode;
+            sqe->fd = op.fd;
+            sqe->addr = op.addr;
+            sqe->len = op.len;
+            sqe->off = op.off;
+            sqe->msg_flags = op.op_flags;
+            sqe->user_data = (uint64_t)(uintptr_t)&waiter;
+            if (tsqe)
+            {
+                sqe->flags |= IOSQE_IO_LINK;
+                ts.tv_sec = timeout_ms / 1000;
+                ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+                tsqe->opcode = IORING_OP_LINK_TIMEOUT;
+                tsqe->fd = -1;
+                tsqe->addr = (uint64_t)(uintptr_t)&ts;
+                tsqe->len = 1;
+                //最低位区分超时的 CQE，waiter 至少按 8 字节对齐
+                tsqe->user_data = (uint64_t)(uintptr_t)&waiter | 1;
+            }
+            ++m_uringInflight;
+            int rt = m_uring->submit();
+            if (rt > 0)
+            {
+                submitted = true;
+                ++m_uringSubmitted;
+                //数据已经就绪的操作在提交时当场就完成了，直接收割，不用挂起协程
+                reapUring(&waiter);
+                done = waiter.pending == 0;
+            }
+            else
+            {
+                --m_uringInflight;
+                SYLAR_LOG_ERROR(g_logger) << "io_uring submit fd=" << op.fd << " rt=" << rt;
+            }
+        }
+        else if (sqe)
+        {
+            //只拿到一个 SQE，放回去之前要让它无害
+            sqe->opcode = IORING_OP_NOP;
+            m_uring->submit();
+            reapUring(nullptr);
+        }
+    }
+    if (submitted && !done)
+    {
+        Fiber::YieldToHold();
+    }
+    {
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        if (slot == &waiter)
+        {
+            slot = nullptr;
+        }
+    }
+    if (!submitted)
+    {
+        return false;
+    }
+    result = waiter.res;
+    if (result == -ECANCELED && waiter.timedOut)
+    {
+        result = -ETIMEDOUT;
+    }
+    return true;
+}
+
+void IOManager::reapUring(UringWaiter *self)
+{
+    m_uring->reap(
+        [this, self](io_uring_cqe *cqe)
+        {
+            uint64_t data = cqe->user_data;
+            // 取消请求自己的 CQE
+            if (!data)
+            {
+                return;
+            }
+            UringWaiter *waiter = (UringWaiter *)(uintptr_t)(data & ~1ull);
+            if (data & 1)
+            {
+                waiter->timedOut = cqe->res == -ETIME;
+            }
+            else
+            {
+                waiter->res = cqe->res;
+            }
+            if (--waiter->pending)
+            {
+                return;
+            }
+            --m_uringInflight;
+            if (waiter != self)
+            {
+                // 调度之后协程可能马上在别的线程恢复，waiter 随之失效，先把要用的取出来
+                Scheduler *scheduler = waiter->scheduler;
+                Fiber::ptr fiber = std::move(waiter->fiber);
+                scheduler->schedule(std::move(fiber));
+            }
+        });
+}
+
+bool IOManager::cancelUring(FdContext *fd_ctx, Event event)
+{
+    UringWaiter *waiter = event == READ ? fd_ctx->uringRead : fd_ctx->uringWrite;
+    if (!waiter)
+    {
+        return false;
+    }
+    Mutex::Lock lock(m_uringMutex);
+    io_uring_sqe *sqe = m_uring->getSqe();
+    if (!sqe)
+    {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)waiter;
+    sqe->user_data = 0;
+    m_uring->submit();
+    //被取消的操作一般当场完成，收割后协程会带着 -ECANCELED 恢复
+    reapUring(nullptr);
+    return true;
+}
+
+//向eventfd写入计数，通知epoll_wait有事件发生
 //因为新加入的协程任务并不是fd事件，epoll不会处理，主动tickle一下，
 // ，继续执行 idle() 剩余代码，随后会swapout，或者说从idle返回去执行协程任务就是tickle的作用
+//一次写入只唤醒一个空闲线程；在它读走之前的tickle全部合并，被唤醒的线程发现还有别的活时会接着tickle
 void IOManager::tickle()
 {
     //当所有的阻塞IO都完成后，才会真正调用tickle，去处理未完成的事件
-    if (!hasIdleThreads())
+    if (!hasIdleThreads() || m_tickled.exchange(true))
     {
+        ++m_ticklesSuppressed;
         return;
     }
-    int rt = write(m_tickleFds[1], "T", 1);
-    SYLAR_ASSERT(rt == 1);
+    uint64_t one = 1;
+    int rt = write(m_tickleFd, &one, sizeof(one));
+    SYLAR_ASSERT(rt == (int)sizeof(one));
+    ++m_ticklesSent;
 }
 bool IOManager::stopping()
 {
@@ -317,7 +583,8 @@ bool IOManager::stopping()
 bool IOManager::stopping(uint64_t &timeout)
 {
     timeout = getNextTimer();
-    return timeout == ~0ull && m_pendingEventCount == 0 && Scheduler::stopping();
+    return timeout == ~0ull && m_pendingEventCount == 0 && m_uringInflight == 0 &&
+           Scheduler::stopping();
 }
 
 //如果任务队列里没有可以直接执行的任务或者说协程，才会调用idle方法
@@ -353,6 +620,8 @@ void IOManager::idle()
                 next_timeout = MAX_TIMEOUT;
             }
             rt = epoll_wait(m_epfd, events, MAX_EVNETS, (int)next_timeout);
+            //醒来后刷新一次缓存时钟，接下来的定时器检查和事件处理都用它
+            RefreshCoarseClock();
             // SYLAR_LOG_INFO(g_logger) << "epoll_wait rt=" << rt;
             if (rt < 0 && errno == EINTR)
             {
@@ -369,7 +638,7 @@ void IOManager::idle()
         if (!cbs.empty())
         {
             // SYLAR_LOG_DEBUG(g_logger) << "on timer cbs.size=" << cbs.size();
-            schedule(cbs.begin(), cbs.end());
+            schedule(std::make_move_iterator(cbs.begin()), std::make_move_iterator(cbs.end()));
             cbs.clear();
         }
         for (int i = 0; i < rt; i++)
@@ -377,14 +646,27 @@ void IOManager::idle()
             //如果是tickle发来的,因为现在idle等待IO事件中，线程阻塞在这里，
             //现在来一个新的任务，需要去处理，所以要让线程继续运行，去处理那个事件
             epoll_event &event = events[i];
-            if (event.data.fd == m_tickleFds[0])
+            if (event.data.fd == m_tickleFd)
             {
-                uint8_t dummy[256];
-                while (read(m_tickleFds[0], dummy, sizeof(dummy)) > 0)
+                //先读空再清标记：清之前来的tickle被合并，但这个线程本来就要回去取任务；
+                //清之后来的tickle会重新写入。反过来的话，夹在中间的那次写入会被读掉，
+                //标记却一直是true，之后的tickle全被吞掉
+                uint64_t dummy;
+                while (read(m_tickleFd, &dummy, sizeof(dummy)) > 0)
                     ;
+                m_tickled = false;
                 //需要注意的是这个continue跳出的是最外面的while，也就是直接跳出去整个idle了
                 continue;
             }
+            if (m_uringEventFd >= 0 && event.data.fd == m_uringEventFd)
+            {
+                uint64_t dummy;
+                while (read(m_uringEventFd, &dummy, sizeof(dummy)) > 0)
+                    ;
+                Mutex::Lock lock(m_uringMutex);
+                reapUring(nullptr);
+                continue;
+            }
             //如果是正常的IO读写事件
             FdContext *fd_ctx = (FdContext *)event.data.ptr;
             FdContext::MutexType::Lock lock(fd_ctx->mutex);
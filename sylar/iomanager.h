@@ -1,5 +1,6 @@
 #ifndef __SYLAR_IOMANAGER_H__
 #define __SYLAR_IOMANAGER_H__
+#include "fd_table.h"
 #include "scheduler.h"
 #include "sylar/thread.h"
 #include "timer.h"
@@ -9,6 +10,9 @@
 
 namespace sylar
 {
+struct UringOp;
+class IoUring;
+
 class IOManager : public Scheduler, public TimerManager
 {
 public:
@@ -27,6 +31,13 @@ public:
 
     // 0 success , -1 fail
     int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+    /**
+     * @brief 注册 fd 上的事件并挂起当前协程，直到事件到来、被取消或者超时
+     * @param[in] timeout_ms 超时时间(毫秒)，~0ull 表示不超时
+     * @return 0 事件到来或者被 cancelEvent/cancelAll 唤醒，ETIMEDOUT 超时，-1 注册失败
+     * @details 超时用 fd 上下文里复用的定时器，除了每个 fd 第一次超时等待，不分配内存
+     */
+    int waitEvent(int fd, Event event, uint64_t timeout_ms);
     // del一个fd的一个event
     bool delEvent(int fd, Event event);
     //给一个fd的一个event强制触发了回调之后，不再继续监控这个fd
@@ -36,6 +47,39 @@ public:
 
     static IOManager *GetThis();
 
+    // 是否启用了 io_uring 后端（iomanager.backend=io_uring 且内核支持）
+    bool isUringEnabled() const
+    {
+        return m_uring != nullptr;
+    }
+    /**
+     * @brief 把一个 socket 操作提交给 io_uring，挂起当前协程直到完成
+     * @param[in] op 要执行的操作
+     * @param[in] event 操作的方向，cancelEvent/cancelAll 按方向取消正在执行的操作
+     * @param[in] timeout_ms 超时时间(毫秒)，~0ull 表示不超时
+     * @param[out] result 操作的返回值，失败时是 -errno，超时是 -ETIMEDOUT，
+     *             被 cancelEvent/cancelAll 打断是 -ECANCELED
+     * @return 没有提交（这个方向上已经有操作在等、当前是共享栈协程，或者提交失败）返回 false，
+     *         调用方退回 epoll 方式
+     */
+    bool uringIo(const UringOp &op, Event event, uint64_t timeout_ms, int &result);
+    // 提交给 io_uring 的操作个数
+    uint64_t getUringSubmitted() const
+    {
+        return m_uringSubmitted;
+    }
+
+    // 真正写了eventfd的唤醒次数
+    uint64_t getTicklesSent() const
+    {
+        return m_ticklesSent;
+    }
+    // 没有空闲线程，或者已经有一次唤醒还没被处理，因而省掉的唤醒次数
+    uint64_t getTicklesSuppressed() const
+    {
+        return m_ticklesSuppressed;
+    }
+
 protected:
     //
     void tickle() override;
@@ -43,12 +87,22 @@ protected:
     //等待被阻塞的IO事件完成，并执行回调
     void idle() override;
 
-    void contextResize(size_t size);
-
     void onTimerInsertedAtFront() override;
     bool stopping(uint64_t &timeout);
 
+
 private:
+    // 在 io_uring 上等待完成的一个操作，放在发起操作的协程栈上，所以共享栈协程不走 io_uring
+    struct UringWaiter
+    {
+        Scheduler *scheduler = nullptr;
+        Fiber::ptr fiber;
+        int res = 0;
+        // 还没收到的 CQE 个数，带超时的操作有操作本身和超时两个 CQE
+        int pending = 0;
+        bool timedOut = false;
+    };
+
     //将fd和回调进行绑定，一旦fd上有事件发生，就会调用对应的回调函数
     // 这个 fd 正在等什么事件？ 等 READ 还是 WRITE？ 事件发生后恢复哪个协程？
     struct FdContext
@@ -60,6 +114,15 @@ private:
             Scheduler *scheduler = nullptr;
             Fiber::ptr fiber;
             std::function<void()> cb;
+            // waitEvent 的超时定时器，同一个 fd 上的等待反复使用；事件触发或重置时不清
+            Timer::ptr timer;
+            // 第几次带超时的等待，用来认出过时的超时回调
+            uint32_t seq = 0;
+            // 当前这次等待带超时，事件触发或重置时清掉，之后到的超时回调就什么都不做
+            bool timed = false;
+            // 最近一次超时的等待的序号，等待者醒来后和自己的序号比对。
+            // 不能放在等待者栈上，共享栈协程挂起时那块栈可能正被别的协程用着
+            uint32_t timedOutSeq = 0;
         };
 
         EventContext &getContext(Event event); // 获取事件上下文
@@ -68,18 +131,46 @@ private:
 
         EventContext read;   // 读事件上下文
         EventContext write;  // 写事件上下文
+        UringWaiter *uringRead = nullptr;  // 正在 io_uring 上执行的读操作
+        UringWaiter *uringWrite = nullptr; // 正在 io_uring 上执行的写操作
         int fd = 0;          // 事件关联的句柄
         Event events = NONE; //已经注册的事件
         MutexType mutex;
     };
 
+    // 没有就创建，fd 超出范围返回 nullptr
+    FdContext *getFdContext(int fd);
+    // 下面两个由调用者持有 fd_ctx->mutex
+    int doAddEvent(FdContext *fd_ctx, Event event, std::function<void()> &cb);
+    bool doCancelEvent(FdContext *fd_ctx, Event event);
+    // waitEvent 的超时回调，seq 对不上说明那次等待已经结束
+    void onEventTimeout(FdContext *fd_ctx, Event event, uint32_t seq);
+    // 收割已经完成的 CQE 并唤醒对应的协程，self 是调用者自己的操作，完成时只做标记不调度
+    void reapUring(UringWaiter *self);
+    // 取消 fd_ctx 上 event 方向正在执行的 io_uring 操作，调用者持有 fd_ctx->mutex
+    bool cancelUring(FdContext *fd_ctx, Event event);
+
     int m_epfd = 0;
-    int m_tickleFds[2];
+    //用于唤醒epoll_wait的eventfd
+    int m_tickleFd = -1;
+    //已经写过eventfd、还没有线程读走时为true，这期间的tickle都合并掉
+    std::atomic<bool> m_tickled = {false};
+    std::atomic<uint64_t> m_ticklesSent = {0};
+    std::atomic<uint64_t> m_ticklesSuppressed = {0};
     // 等待事件的数量
     std::atomic<size_t> m_pendingEventCount = {0};
-    RWMutex m_mutex;
-    // 文件描述符上下文容器
-    std::vector<FdContext *> m_fdContexts;
+    // 文件描述符上下文容器，按 fd 下标无锁查找，上下文创建后直到析构都不释放
+    FdTable<FdContext> m_fdContexts;
+
+    // io_uring 后端，没有启用时为空
+    std::unique_ptr<IoUring> m_uring;
+    // 异步完成的 CQE 通过它通知到 epoll，由空闲线程收割
+    int m_uringEventFd = -1;
+    // 提交和收割都要持有
+    Mutex m_uringMutex;
+    // 已经提交、还没收齐 CQE 的操作个数
+    std::atomic<size_t> m_uringInflight = {0};
+    std::atomic<uint64_t> m_uringSubmitted = {0};
 };
 } // namespace sylar
 #endif
\ No newline at end of file
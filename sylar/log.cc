@@ -1,14 +1,26 @@
 #include "log.h"
 #include "config.h"
+#include <algorithm>
 #include <bits/types/time_t.h>
 #include <cstdint>
+#include <cstring>
+#include <ctype.h>
+#include <deque>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <functional>
 #include <memory>
+#include <new>
 #include <set>
+#include <signal.h>
 #include <sstream>
 #include <string>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 #include <vector>
+#include <zlib.h>
 
 namespace sylar
 {
@@ -56,17 +68,80 @@ LogLevel::Level LogLevel::fromString(const std::string &str)
 #undef XX
 }
 
+namespace
+{
+
+// 每个线程留几个用过的事件，日志语句里嵌套打日志时一次要用好几个
+struct LogEventPool
+{
+    std::vector<LogEvent::ptr> events;
+    ~LogEventPool();
+};
+
+static thread_local bool t_event_pool_destroyed = false;
+static thread_local LogEventPool t_event_pool;
+static const size_t s_event_pool_size = 8;
+
+LogEventPool::~LogEventPool()
+{
+    t_event_pool_destroyed = true;
+}
+
+LogEvent::ptr AcquireEvent()
+{
+    //线程退出时池已经析构，之后的日志直接 new
+    if (t_event_pool_destroyed || t_event_pool.events.empty())
+    {
+        return std::make_shared<LogEvent>();
+    }
+    LogEvent::ptr event = std::move(t_event_pool.events.back());
+    t_event_pool.events.pop_back();
+    return event;
+}
+
+void ReleaseEvent(LogEvent::ptr &event)
+{
+    //被 appender 留住的不能再用
+    if (!t_event_pool_destroyed && event.use_count() == 1 &&
+        t_event_pool.events.size() < s_event_pool_size)
+    {
+        //池子里的事件不能让 logger（连带它的 appender 和打开的文件）一直活着
+        event->clearLogger();
+        t_event_pool.events.push_back(std::move(event));
+    }
+}
+
+} // namespace
+
 LogEventWrap::LogEventWrap(LogEvent::ptr e) : m_event(e)
 {
 }
+
+LogEventWrap::LogEventWrap(const std::shared_ptr<Logger> &logger,
+                           LogLevel::Level level,
+                           const char *file,
+                           int32_t line,
+                           uint64_t suppressed)
+    : m_event(AcquireEvent()), m_suppressed(suppressed)
+{
+    //调度线程上 CoarseNowMs 只读线程局部的缓存，比每条日志都取一次时钟便宜
+    m_event->reset(logger, level, file, line, 0, GetThreadId(), GetFiberId(),
+                   (int64_t)(CoarseNowMs() / 1000), Thread::GetName());
+}
+
 LogEventWrap::~LogEventWrap()
 {
     if (m_event)
     {
+        if (m_suppressed > 0)
+        {
+            m_event->getSS() << " (suppressed " << m_suppressed << " similar messages)";
+        }
         m_event->getLogger()->log(m_event->getLevel(), m_event);
+        ReleaseEvent(m_event);
     }
 }
-std::stringstream &LogEventWrap::getSS()
+std::ostream &LogEventWrap::getSS()
 {
     return m_event->getSS();
 }
@@ -91,6 +166,52 @@ LogFormatter::ptr LogAppender::getFormatter()
     return m_formatter;
 }
 
+LogEvent::LogEvent() : m_buf(m_content), m_ss(&m_buf), m_level(LogLevel::DEBUG)
+{
+}
+
+LogEvent::LogEvent(Logger::ptr logger,
+                   LogLevel::Level level,
+                   const char *file,
+                   int32_t line,
+                   uint32_t elapse,
+                   int32_t threadId,
+                   uint32_t fiberId,
+                   int64_t time,
+                   const std::string &thread_name)
+    : LogEvent()
+{
+    reset(logger, level, file, line, elapse, threadId, fiberId, time, thread_name);
+}
+
+void LogEvent::reset(const Logger::ptr &logger,
+                     LogLevel::Level level,
+                     const char *file,
+                     int32_t line,
+                     uint32_t elapse,
+                     int32_t threadId,
+                     uint32_t fiberId,
+                     int64_t time,
+                     const std::string &thread_name)
+{
+    m_logger = logger;
+    m_level = level;
+    m_file = file;
+    m_line = line;
+    m_elapse = elapse;
+    m_threadId = threadId;
+    m_fiberId = fiberId;
+    m_time = time;
+    m_threadName = thread_name;
+    m_content.clear();
+    //上一条日志可能改了进制、精度之类的，恢复成新建流的样子
+    m_ss.clear();
+    m_ss.flags(std::ios_base::dec | std::ios_base::skipws);
+    m_ss.precision(6);
+    m_ss.width(0);
+    m_ss.fill(' ');
+}
+
 void LogEvent::format(const char *fmt, ...)
 {
     va_list al;
@@ -101,433 +222,1687 @@ void LogEvent::format(const char *fmt, ...)
 
 void LogEvent::format(const char *fmt, va_list al)
 {
-    char *buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if (len != -1)
+    char buf[512];
+    va_list copy;
+    va_copy(copy, al);
+    int len = vsnprintf(buf, sizeof(buf), fmt, al);
+    if (len >= 0 && (size_t)len < sizeof(buf))
     {
-        m_ss << std::string(buf, len);
-        free(buf);
+        m_content.append(buf, len);
     }
+    else if (len >= 0)
+    {
+        size_t old = m_content.size();
+        m_content.resize(old + len + 1);
+        vsnprintf(&m_content[old], len + 1, fmt, copy);
+        m_content.resize(old + len);
+    }
+    va_end(copy);
 }
 
-class MessageFormatItem : public LogFormatter::FormatItem
+namespace
+{
+
+// 先写进栈上的缓冲，析构时一次性追加到 out，比逐段 std::string::append 少很多检查
+class FormatWriter
 {
 public:
-    MessageFormatItem(const std::string &str = "")
+    explicit FormatWriter(std::string &out) : m_out(out), m_pos(m_buf)
     {
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    ~FormatWriter()
     {
-        os << event->getContent();
-    };
-};
+        flush();
+    }
 
-class LevelFormatItem : public LogFormatter::FormatItem
-{
-public:
-    LevelFormatItem(const std::string &str = "")
+    void append(const char *data, size_t len)
+    {
+        if ((size_t)(m_buf + sizeof(m_buf) - m_pos) < len)
+        {
+            flush();
+            if (len > sizeof(m_buf))
+            {
+                m_out.append(data, len);
+                return;
+            }
+        }
+        memcpy(m_pos, data, len);
+        m_pos += len;
+    }
+    void append(const std::string &str)
     {
+        append(str.data(), str.size());
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    void appendUint(uint64_t v)
     {
-        os << LogLevel::toString(level);
-    };
+        char tmp[24];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+        do
+        {
+            *--p = (char)('0' + v % 10);
+            v /= 10;
+        } while (v);
+        append(p, end - p);
+    }
+    void appendInt(int64_t v)
+    {
+        if (v < 0)
+        {
+            append("-", 1);
+            appendUint(0 - (uint64_t)v);
+            return;
+        }
+        appendUint(v);
+    }
+
+private:
+    void flush()
+    {
+        m_out.append(m_buf, m_pos - m_buf);
+        m_pos = m_buf;
+    }
+
+private:
+    std::string &m_out;
+    char m_buf[1024];
+    char *m_pos;
 };
 
-class ElapseFormatItem : public LogFormatter::FormatItem
+// 同一秒内的时间字符串只算一次，localtime_r 和 strftime 都不便宜
+void AppendTime(FormatWriter &out, const std::string &format, time_t time)
 {
-public:
-    ElapseFormatItem(const std::string &str = "")
+    struct Cache
+    {
+        time_t time = -1;
+        std::string format;
+        char buf[64];
+        size_t len = 0;
+    };
+    static thread_local Cache t_cache;
+    if (t_cache.time != time || t_cache.format != format)
     {
+        struct tm tm;
+        localtime_r(&time, &tm);
+        t_cache.len = strftime(t_cache.buf, sizeof(t_cache.buf), format.c_str(), &tm);
+        t_cache.time = time;
+        t_cache.format = format;
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    out.append(t_cache.buf, t_cache.len);
+}
+
+// 每个线程一块格式化用的缓冲，容量一直留着
+std::string &FormatBuffer()
+{
+    static thread_local std::string t_buf;
+    t_buf.clear();
+    return t_buf;
+}
+
+} // namespace
+
+Logger::Logger(const std::string &name)
+    : m_name(name), m_level(LogLevel::DEBUG), m_appenders(std::make_shared<AppenderList>())
+{
+    // 使用默认的格式化参数
+    m_formatter.reset(
+        new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T<%f:%l>%T%m%T%n"));
+}
+
+void Logger::addAppender(LogAppender::ptr appender)
+{
+    RWMutexType::WriteLock lock(m_mutex);
+    // 使用默认的格式化参数
+    if (!appender->getFormatter())
     {
-        os << event->getElapse();
-    };
+        LogAppender::MutexType::Lock appender_lock(appender->m_mutex);
+        appender->m_formatter = m_formatter;
+    }
+    auto appenders = std::make_shared<AppenderList>(*m_appenders);
+    appenders->push_back(appender);
+    m_appenders = appenders;
 };
 
-class NameFormatItem : public LogFormatter::FormatItem
+void Logger::delAppender(LogAppender::ptr appender)
 {
-public:
-    NameFormatItem(const std::string &str = "")
+    RWMutexType::WriteLock lock(m_mutex);
+    auto appenders = std::make_shared<AppenderList>(*m_appenders);
+    for (auto it = appenders->begin(); it != appenders->end(); it++)
     {
+        if (*it == appender)
+        {
+            appenders->erase(it);
+            break;
+        }
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
-    {
-        os << event->getLogger()->getName();
-    };
+    m_appenders = appenders;
 };
 
-class ThreadIdFormatItem : public LogFormatter::FormatItem
+void Logger::clearAppenders()
 {
-public:
-    ThreadIdFormatItem(const std::string &str = "")
+    RWMutexType::WriteLock lock(m_mutex);
+    m_appenders = std::make_shared<AppenderList>();
+}
+
+void Logger::log(LogLevel::Level level, LogEvent::ptr event)
+{
+
+    if (level >= m_level)
     {
+        //事件里的 logger 一般就是自己，直接用它的 shared_ptr，省掉 shared_from_this 的原子操作
+        Logger::ptr holder;
+        const Logger::ptr &self = event->getLogger().get() == this
+                                      ? event->getLogger()
+                                      : (holder = shared_from_this());
+        std::shared_ptr<const AppenderList> appenders;
+        {
+            RWMutexType::ReadLock lock(m_mutex);
+            appenders = m_appenders;
+        }
+        if (!appenders->empty())
+        {
+            for (auto &i : *appenders)
+            {
+                i->log(self, level, event);
+            }
+        }
+        else if (m_root)
+        {
+            // MutexType::Lock lock(m_mutex);
+            m_root->log(level, event);
+        }
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
-    {
-
-        os << event->getThreadId();
-    };
 };
-
-class FiberIdFormatItem : public LogFormatter::FormatItem
+void Logger::setFormatter(LogFormatter::ptr val)
 {
-public:
-    FiberIdFormatItem(const std::string &str = "")
+    RWMutexType::WriteLock lock(m_mutex);
+    m_formatter = val;
+    for (auto &i : *m_appenders)
     {
+        LogAppender::MutexType::Lock appender_lock(i->m_mutex);
+        if (!i->m_hasFormatter)
+        {
+            i->m_formatter = m_formatter;
+        }
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+}
+
+void Logger::setFormatter(const std::string &val)
+{
+    sylar::LogFormatter::ptr new_val(new sylar::LogFormatter(val));
+    if (new_val->isError())
     {
+        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT())
+            << "Logger setFormatter name=" << m_name << " invalid formatter "
+            << "value = " << val << "invlid formatter";
+        return;
+    }
+    setFormatter(new_val);
+}
 
-        os << event->getFiberId();
-    };
+LogFormatter::ptr Logger::getFormatter()
+{
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_formatter;
+}
+
+void Logger::debug(LogEvent::ptr event)
+{
+    log(LogLevel::DEBUG, event);
+}
+
+void Logger::info(LogEvent::ptr event)
+{
+    log(LogLevel::INFO, event);
 };
 
-class ThreadNameFormatItem : public LogFormatter::FormatItem
+void Logger::warn(LogEvent::ptr event)
 {
-public:
-    ThreadNameFormatItem(const std::string &str = "")
+    log(LogLevel::WARN, event);
+};
+
+void Logger::error(LogEvent::ptr event)
+{
+    log(LogLevel::ERROR, event);
+};
+
+void Logger::fatal(LogEvent::ptr event)
+{
+    log(LogLevel::FATAL, event);
+};
+namespace
+{
+
+// 后台线程多久醒一次，缓冲里的日志最多等这么久写到文件，SIGHUP 也最多等这么久生效
+static const uint64_t s_rotate_tick_ms = 100;
+// FileLogAppender 攒够这么多再 write
+static const size_t s_file_buffer_size = 64 * 1024;
+// 多久检查一次文件
+static const uint64_t s_rotate_check_ms = 1000;
+static volatile sig_atomic_t s_sighup_received = 0;
+
+void OnSighup(int)
+{
+    s_sighup_received = 1;
+}
+
+// fork 出来的子进程里只剩调用 fork 的线程，原来的后台线程已经不存在了，
+// Thread 析构会去 detach 它，只能放掉不管
+void AbandonThread(Thread::ptr &thread)
+{
+    new Thread::ptr(std::move(thread));
+}
+
+// t 所在周期的开始时间，不轮转时都算 0
+time_t PeriodStart(FileLogAppender::RotateInterval interval, time_t t)
+{
+    if (interval == FileLogAppender::NONE)
     {
+        return 0;
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    if (interval == FileLogAppender::DAILY)
     {
-        os << event->getThreadName();
+        tm.tm_hour = 0;
     }
-};
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
 
-class DateTimeFormatItem : public LogFormatter::FormatItem
+// 把 path 压缩成 path.gz 后删掉 path，失败时保留原文件
+bool CompressFile(const std::string &path)
 {
-public:
-    DateTimeFormatItem(const std::string &format = "%Y-%m-%d %H:%M:%S") : m_format(format)
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    std::string gz_path = path + ".gz";
+    gzFile gz = gzopen(gz_path.c_str(), "wb");
+    if (!gz)
     {
-        if (m_format.empty())
+        ::close(fd);
+        return false;
+    }
+    bool ok = true;
+    char buf[64 * 1024];
+    ssize_t n = 0;
+    while ((n = ::read(fd, buf, sizeof(buf))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        if (gzwrite(gz, buf, n) != n)
         {
-            m_format = "%Y-%m-%d %H:%M:%S";
+            ok = false;
+            break;
         }
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    ::close(fd);
+    if (gzclose(gz) != Z_OK)
     {
-        struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm);
-        char buf[64];
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-        // os << event->getTime();
-        os << buf;
-    };
-
-private:
-    std::string m_format;
-};
+        ok = false;
+    }
+    if (!ok)
+    {
+        ::unlink(gz_path.c_str());
+        return false;
+    }
+    ::unlink(path.c_str());
+    return true;
+}
 
-class FilenameFormatItem : public LogFormatter::FormatItem
+// 删掉 filename 轮转出来的文件里最老的那些，只留 max_files 个
+void RemoveOldFiles(const std::string &filename, uint32_t max_files)
 {
-public:
-public:
-    FilenameFormatItem(const std::string &str = "")
+    size_t pos = filename.rfind('/');
+    std::string dir = pos == std::string::npos ? "." : filename.substr(0, pos + 1);
+    std::string prefix = (pos == std::string::npos ? filename : filename.substr(pos + 1)) + ".";
+    DIR *d = opendir(dir.c_str());
+    if (!d)
     {
+        return;
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    // (修改时间, 路径)，排序后最前面的最老
+    std::vector<std::pair<time_t, std::string>> files;
+    struct dirent *dp = nullptr;
+    while ((dp = readdir(d)) != nullptr)
     {
-
-        os << event->getFile();
-    };
-};
-
-class LineFormatItem : public LogFormatter::FormatItem
-{
-public:
-    LineFormatItem(const std::string &str = "")
+        //轮转出来的文件名是 "文件名.时间戳"，时间戳以数字开头
+        if (strncmp(dp->d_name, prefix.c_str(), prefix.size()) != 0 ||
+            !isdigit((unsigned char)dp->d_name[prefix.size()]))
+        {
+            continue;
+        }
+        std::string path = (pos == std::string::npos ? "" : dir) + dp->d_name;
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+        {
+            files.push_back(std::make_pair(st.st_mtime, path));
+        }
+    }
+    closedir(d);
+    if (files.size() <= max_files)
     {
+        return;
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() - max_files; ++i)
     {
+        ::unlink(files[i].second.c_str());
+    }
+}
 
-        os << event->getLine();
-    };
-};
-
-class NewLineFormatItem : public LogFormatter::FormatItem
+/**
+ * @brief 所有 FileLogAppender 共用的后台线程
+ * @details 每秒检查一次各个文件，收到 SIGHUP 时全部重新打开，轮转出来的文件在这里压缩和清理，
+ *          不占用写日志的线程
+ */
+class LogFileRotator
 {
 public:
-    NewLineFormatItem(const std::string &str = "")
+    struct Job
+    {
+        // 轮转出来的文件
+        std::string path;
+        // 原来的文件名
+        std::string filename;
+        bool compress;
+        uint32_t maxFiles;
+    };
+
+    LogFileRotator()
     {
+        pthread_atfork(&LogFileRotator::OnForkPrepare, &LogFileRotator::OnForkParent,
+                       &LogFileRotator::OnForkChild);
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+
+    static LogFileRotator *GetInstance()
     {
+        //不析构，进程退出时别的静态对象里的 appender 析构还要用到它
+        static LogFileRotator *s_instance = new LogFileRotator;
+        return s_instance;
+    }
 
-        os << std::endl;
-    };
-};
+    void add(FileLogAppender *appender)
+    {
+        Mutex::Lock lock(m_appendersMutex);
+        m_appenders.push_back(appender);
+        if (!m_thread)
+        {
+            m_thread.reset(new Thread(std::bind(&LogFileRotator::run, this), "log_rotate"));
+        }
+    }
 
-class StringFormatItem : public LogFormatter::FormatItem
-{
-public:
-    StringFormatItem(const std::string &str) : m_string(str)
+    void del(FileLogAppender *appender)
     {
+        Mutex::Lock lock(m_appendersMutex);
+        m_appenders.erase(std::remove(m_appenders.begin(), m_appenders.end(), appender),
+                          m_appenders.end());
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+
+    void submit(const Job &job)
     {
+        {
+            std::lock_guard<std::mutex> lock(m_jobsMutex);
+            m_jobs.push_back(job);
+        }
+        m_cond.notify_one();
+    }
 
-        os << m_string;
-    };
+    void reopenAll()
+    {
+        Mutex::Lock lock(m_appendersMutex);
+        for (auto &i : m_appenders)
+        {
+            i->reopen();
+        }
+    }
 
 private:
-    std::string m_string;
-};
+    // fork 的时候后台线程可能正拿着锁，先都拿到手，子进程里的锁才是干净的
+    static void OnForkPrepare()
+    {
+        LogFileRotator *self = GetInstance();
+        self->m_appendersMutex.lock();
+        //缓冲在 fork 之前写出去：daemon() 的父进程直接退出，不写就丢了
+        for (auto &i : self->m_appenders)
+        {
+            i->lockForFork();
+        }
+        self->m_jobsMutex.lock();
+    }
+
+    static void OnForkParent()
+    {
+        LogFileRotator *self = GetInstance();
+        self->m_jobsMutex.unlock();
+        for (auto &i : self->m_appenders)
+        {
+            i->unlockAfterFork(false);
+        }
+        self->m_appendersMutex.unlock();
+    }
+
+    // 子进程（比如 -d 守护进程）里没有后台线程，不刷缓冲也不轮转，要重新起一个
+    static void OnForkChild()
+    {
+        LogFileRotator *self = GetInstance();
+        //排着的压缩和清理父进程会做
+        self->m_jobs.clear();
+        //原来的后台线程等在 m_cond 上，理由同 AsyncLogAppender::OnForkChild
+        new (&self->m_cond) std::condition_variable;
+        self->m_jobsMutex.unlock();
+        for (auto &i : self->m_appenders)
+        {
+            i->unlockAfterFork(true);
+        }
+        if (self->m_thread)
+        {
+            AbandonThread(self->m_thread);
+            self->m_thread.reset(
+                new Thread(std::bind(&LogFileRotator::run, self), "log_rotate"));
+        }
+        self->m_appendersMutex.unlock();
+    }
+
+    void run()
+    {
+        uint64_t last_check = GetCurrentMS();
+        while (true)
+        {
+            Job job;
+            bool has_job = false;
+            {
+                std::unique_lock<std::mutex> lock(m_jobsMutex);
+                if (m_jobs.empty())
+                {
+                    m_cond.wait_for(lock, std::chrono::milliseconds(s_rotate_tick_ms));
+                }
+                if (!m_jobs.empty())
+                {
+                    job = m_jobs.front();
+                    m_jobs.pop_front();
+                    has_job = true;
+                }
+            }
+            if (s_sighup_received)
+            {
+                s_sighup_received = 0;
+                reopenAll();
+            }
+            uint64_t now = GetCurrentMS();
+            bool check = now - last_check >= s_rotate_check_ms;
+            if (check)
+            {
+                last_check = now;
+            }
+            {
+                Mutex::Lock lock(m_appendersMutex);
+                for (auto &i : m_appenders)
+                {
+                    i->flush();
+                    if (check)
+                    {
+                        i->check();
+                    }
+                }
+            }
+            if (has_job)
+            {
+                if (job.compress)
+                {
+                    CompressFile(job.path);
+                }
+                if (job.maxFiles > 0)
+                {
+                    RemoveOldFiles(job.filename, job.maxFiles);
+                }
+            }
+        }
+    }
+
+private:
+    // 锁的顺序：m_appendersMutex -> appender 自己的锁 -> m_jobsMutex
+    Mutex m_appendersMutex;
+    std::vector<FileLogAppender *> m_appenders;
+    std::mutex m_jobsMutex;
+    std::condition_variable m_cond;
+    std::deque<Job> m_jobs;
+    Thread::ptr m_thread;
+};
+
+} // namespace
+
+const char *FileLogAppender::RotateIntervalToString(RotateInterval v)
+{
+    switch (v)
+    {
+    case HOURLY:
+        return "hourly";
+    case DAILY:
+        return "daily";
+    default:
+        return "none";
+    }
+}
+
+FileLogAppender::RotateInterval FileLogAppender::RotateIntervalFromString(const std::string &str)
+{
+    if (str == "hourly" || str == "HOURLY")
+    {
+        return HOURLY;
+    }
+    if (str == "daily" || str == "DAILY")
+    {
+        return DAILY;
+    }
+    return NONE;
+}
+
+FileLogAppender::FileLogAppender(const std::string &filename) : m_filename(filename)
+{
+    reopen();
+    LogFileRotator::GetInstance()->add(this);
+};
+
+FileLogAppender::~FileLogAppender()
+{
+    LogFileRotator::GetInstance()->del(this);
+    flushLocked();
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+void FileLogAppender::log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
+{
+    if (level < m_level)
+    {
+        return;
+    }
+    MutexType::Lock lock(m_mutex);
+    std::string &buf = FormatBuffer();
+    m_formatter->format(buf, level, *event);
+    prepareWriteLocked(buf.size());
+    writeLocked(buf.data(), buf.size());
+    if (level >= LogLevel::FATAL)
+    {
+        flushLocked();
+    }
+};
+
+void FileLogAppender::prepareWriteLocked(size_t len)
+{
+    if (m_maxSize > 0 && m_size > 0 && m_size + len > m_maxSize)
+    {
+        rotateLocked(time(nullptr));
+    }
+}
+
+void FileLogAppender::writeLocked(const char *data, size_t len)
+{
+    if (m_fd < 0)
+    {
+        return;
+    }
+    m_writeBuf.append(data, len);
+    m_size += len;
+    if (m_writeBuf.size() >= s_file_buffer_size)
+    {
+        flushLocked();
+    }
+}
+
+void FileLogAppender::flushLocked()
+{
+    size_t off = 0;
+    while (off < m_writeBuf.size() && m_fd >= 0)
+    {
+        ssize_t n = ::write(m_fd, m_writeBuf.data() + off, m_writeBuf.size() - off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        off += n;
+    }
+    m_writeBuf.clear();
+}
+
+void FileLogAppender::flush()
+{
+    MutexType::Lock lock(m_mutex);
+    flushLocked();
+}
+
+void FileLogAppender::lockForFork()
+{
+    m_mutex.lock();
+    flushLocked();
+}
+
+void FileLogAppender::unlockAfterFork(bool child)
+{
+    if (child)
+    {
+        m_writeBuf.clear();
+    }
+    m_mutex.unlock();
+}
+
+std::string FileLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = m_typeName;
+    node["file"] = m_filename;
+    if (m_maxSize > 0)
+    {
+        node["max_size"] = m_maxSize;
+    }
+    if (m_interval != NONE)
+    {
+        node["rotate"] = RotateIntervalToString(m_interval);
+    }
+    if (m_maxFiles > 0)
+    {
+        node["max_files"] = m_maxFiles;
+    }
+    if (m_maxSize > 0 || m_interval != NONE)
+    {
+        node["compress"] = m_compress;
+    }
+    if (m_level != LogLevel::UNKNOW)
+    {
+        node["level"] = LogLevel::toString(m_level);
+    }
+    if (m_hasFormatter && m_formatter)
+    {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+bool FileLogAppender::reopen()
+{
+    MutexType::Lock lock(m_mutex);
+    return reopenLocked();
+};
+
+// 追加打开，打开新文件成功了才关掉旧的
+bool FileLogAppender::reopenLocked()
+{
+    int fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    //还没写出去的属于旧文件
+    flushLocked();
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+    m_fd = fd;
+    ++m_openCount;
+    m_dev = st.st_dev;
+    m_ino = st.st_ino;
+    m_size = st.st_size;
+    //已经有内容的文件按最后修改时间算周期，上个周期留下的文件会在下次检查时轮转掉
+    m_periodStart = PeriodStart(m_interval, st.st_size > 0 ? st.st_mtime : time(nullptr));
+    return true;
+}
+
+void FileLogAppender::setRotateInterval(RotateInterval v)
+{
+    MutexType::Lock lock(m_mutex);
+    m_interval = v;
+    struct stat st;
+    bool has_data = m_fd >= 0 && fstat(m_fd, &st) == 0 && st.st_size > 0;
+    m_periodStart = PeriodStart(m_interval, has_data ? st.st_mtime : time(nullptr));
+}
+
+bool FileLogAppender::rotate()
+{
+    MutexType::Lock lock(m_mutex);
+    return rotateLocked(time(nullptr));
+}
+
+bool FileLogAppender::rotateLocked(time_t now)
+{
+    if (m_fd < 0)
+    {
+        return false;
+    }
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y%m%d-%H%M%S", &tm);
+    std::string target = m_filename + "." + buf;
+    //同一秒里轮转了好几次时加序号
+    for (int i = 1;
+         access(target.c_str(), F_OK) == 0 || access((target + ".gz").c_str(), F_OK) == 0; ++i)
+    {
+        target = m_filename + "." + buf + "-" + std::to_string(i);
+    }
+    flushLocked();
+    if (::rename(m_filename.c_str(), target.c_str()) != 0)
+    {
+        return false;
+    }
+    //新文件打不开就继续写改了名的那个，下次检查时再试
+    reopenLocked();
+    if (m_compress || m_maxFiles > 0)
+    {
+        LogFileRotator::GetInstance()->submit({target, m_filename, m_compress, m_maxFiles});
+    }
+    return true;
+}
+
+void FileLogAppender::check()
+{
+    struct stat st;
+    bool exists = ::stat(m_filename.c_str(), &st) == 0;
+    time_t now = time(nullptr);
+    MutexType::Lock lock(m_mutex);
+    if (m_fd < 0 || !exists || (uint64_t)st.st_dev != m_dev || (uint64_t)st.st_ino != m_ino)
+    {
+        reopenLocked();
+    }
+    else if ((uint64_t)st.st_size < m_size)
+    {
+        //被 copytruncate 之类的截断了
+        m_size = st.st_size;
+    }
+    if (m_interval != NONE)
+    {
+        time_t period = PeriodStart(m_interval, now);
+        if (period != m_periodStart)
+        {
+            if (m_size == 0 || !rotateLocked(now))
+            {
+                m_periodStart = period;
+            }
+        }
+    }
+}
+
+void FileLogAppender::ReopenAll()
+{
+    LogFileRotator::GetInstance()->reopenAll();
+}
+
+void FileLogAppender::InstallSighupHandler()
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &OnSighup;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGHUP, &sa, nullptr);
+}
+
+namespace
+{
+
+// 文件头：魔数加版本号。每次打开文件都写一个，读的时候遇到就清空已有的定义
+static const char s_binary_log_magic[] = "SYLARLOG";
+static const size_t s_binary_log_magic_len = sizeof(s_binary_log_magic) - 1;
+static const uint8_t s_binary_log_version = 1;
+
+// 文件头以外的记录，第一个字节是类型，后面的整数都是 varint
+enum BinaryRecordType : uint8_t
+{
+    // id, 长度, 内容：线程名、logger 名
+    BINARY_STRING = 1,
+    // id, 行号, 文件名长度, 文件名
+    BINARY_SITE = 2,
+    // 级别, 时间, elapse, 线程id, 协程id, 调用点id, 线程名id, logger名id, 消息长度, 消息
+    BINARY_EVENT = 3,
+};
+
+void PutVarint(std::string &out, uint64_t v)
+{
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        buf[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (char)v;
+    out.append(buf, n);
+}
+
+void PutString(std::string &out, const char *data, size_t len)
+{
+    PutVarint(out, len);
+    out.append(data, len);
+}
+
+} // namespace
+
+BinaryLogAppender::BinaryLogAppender(const std::string &filename) : FileLogAppender(filename)
+{
+    m_typeName = "BinaryLogAppender";
+}
+
+void BinaryLogAppender::log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
+{
+    if (level < m_level)
+    {
+        return;
+    }
+    const std::string &content = event->getContent();
+    MutexType::Lock lock(m_mutex);
+    //大小只是估计，定义记录和头部差不多这么长
+    prepareWriteLocked(content.size() + 64);
+    if (m_fileOpenCount != m_openCount)
+    {
+        startFileLocked();
+    }
+    std::string &buf = FormatBuffer();
+    uint32_t site = siteIdLocked(event->getFile(), event->getLine(), buf);
+    uint32_t thread_name = stringIdLocked(event->getThreadName(), buf);
+    uint32_t logger_name = stringIdLocked(event->getLogger()->getName(), buf);
+    buf.push_back((char)BINARY_EVENT);
+    buf.push_back((char)level);
+    PutVarint(buf, event->getTime());
+    PutVarint(buf, event->getElapse());
+    PutVarint(buf, (uint32_t)event->getThreadId());
+    PutVarint(buf, event->getFiberId());
+    PutVarint(buf, site);
+    PutVarint(buf, thread_name);
+    PutVarint(buf, logger_name);
+    PutString(buf, content.data(), content.size());
+    writeLocked(buf.data(), buf.size());
+    if (level >= LogLevel::FATAL)
+    {
+        flushLocked();
+    }
+}
+
+void BinaryLogAppender::startFileLocked()
+{
+    m_fileOpenCount = m_openCount;
+    m_strings.clear();
+    m_sites.clear();
+    std::string header(s_binary_log_magic, s_binary_log_magic_len);
+    header.push_back((char)s_binary_log_version);
+    writeLocked(header.data(), header.size());
+}
+
+uint32_t BinaryLogAppender::stringIdLocked(const std::string &str, std::string &buf)
+{
+    auto it = m_strings.find(str);
+    if (it != m_strings.end())
+    {
+        return it->second;
+    }
+    uint32_t id = m_strings.size();
+    m_strings.emplace(str, id);
+    buf.push_back((char)BINARY_STRING);
+    PutVarint(buf, id);
+    PutString(buf, str.data(), str.size());
+    return id;
+}
+
+uint32_t BinaryLogAppender::siteIdLocked(const char *file, int32_t line, std::string &buf)
+{
+    //__FILE__ 是字面量，同一个调用点指针不变，按指针比就行
+    auto key = std::make_pair(file, line);
+    auto it = m_sites.find(key);
+    if (it != m_sites.end())
+    {
+        return it->second;
+    }
+    uint32_t id = m_sites.size();
+    m_sites.emplace(key, id);
+    buf.push_back((char)BINARY_SITE);
+    PutVarint(buf, id);
+    PutVarint(buf, (uint32_t)line);
+    PutString(buf, file, strlen(file));
+    return id;
+}
+
+BinaryLogReader::BinaryLogReader()
+{
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+    if (m_file)
+    {
+        gzclose((gzFile)m_file);
+    }
+}
+
+bool BinaryLogReader::open(const std::string &path)
+{
+    if (m_file)
+    {
+        gzclose((gzFile)m_file);
+        m_file = nullptr;
+    }
+    m_buf.clear();
+    m_pos = 0;
+    m_error = false;
+    m_strings.clear();
+    m_sites.clear();
+    //不是 gzip 格式的 gzread 原样读出来
+    if (path == "-")
+    {
+        int fd = dup(STDIN_FILENO);
+        m_file = fd < 0 ? nullptr : gzdopen(fd, "rb");
+    }
+    else
+    {
+        m_file = gzopen(path.c_str(), "rb");
+    }
+    if (!m_file)
+    {
+        return false;
+    }
+    //第一个记录必须是文件头
+    uint8_t type = 0;
+    if (!readByte(type) || type != (uint8_t)s_binary_log_magic[0] || !readHeader())
+    {
+        m_error = true;
+        return false;
+    }
+    return true;
+}
+
+bool BinaryLogReader::fill(size_t n)
+{
+    if (m_buf.size() - m_pos >= n)
+    {
+        return true;
+    }
+    if (!m_file)
+    {
+        return false;
+    }
+    m_buf.erase(0, m_pos);
+    m_pos = 0;
+    char buf[64 * 1024];
+    while (m_buf.size() < n)
+    {
+        int len = gzread((gzFile)m_file, buf, sizeof(buf));
+        if (len <= 0)
+        {
+            return false;
+        }
+        m_buf.append(buf, len);
+    }
+    return true;
+}
+
+bool BinaryLogReader::readByte(uint8_t &v)
+{
+    if (!fill(1))
+    {
+        return false;
+    }
+    v = (uint8_t)m_buf[m_pos++];
+    return true;
+}
+
+bool BinaryLogReader::readVarint(uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t b = 0;
+        if (!readByte(b))
+        {
+            return false;
+        }
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            return true;
+        }
+    }
+    m_error = true;
+    return false;
+}
+
+bool BinaryLogReader::readString(std::string &v)
+{
+    uint64_t len = 0;
+    if (!readVarint(len) || !fill(len))
+    {
+        return false;
+    }
+    v.assign(m_buf, m_pos, len);
+    m_pos += len;
+    return true;
+}
+
+bool BinaryLogReader::readHeader()
+{
+    //类型字节就是魔数的第一个字节，已经读掉了
+    if (!fill(s_binary_log_magic_len))
+    {
+        return false;
+    }
+    if (m_buf.compare(m_pos, s_binary_log_magic_len - 1, s_binary_log_magic + 1) != 0 ||
+        (uint8_t)m_buf[m_pos + s_binary_log_magic_len - 1] != s_binary_log_version)
+    {
+        m_error = true;
+        return false;
+    }
+    m_pos += s_binary_log_magic_len;
+    m_strings.clear();
+    m_sites.clear();
+    return true;
+}
+
+bool BinaryLogReader::next(LogEvent &event)
+{
+    while (!m_error)
+    {
+        uint8_t type = 0;
+        if (!readByte(type))
+        {
+            return false;
+        }
+        if (type == (uint8_t)s_binary_log_magic[0])
+        {
+            if (!readHeader())
+            {
+                return false;
+            }
+            continue;
+        }
+        if (type == BINARY_STRING)
+        {
+            uint64_t id = 0;
+            std::string str;
+            if (!readVarint(id) || !readString(str))
+            {
+                return false;
+            }
+            //写的一方按顺序编号，跳号说明文件坏了，不能照着一个坏掉的 id 去扩表
+            if (id > m_strings.size())
+            {
+                m_error = true;
+                return false;
+            }
+            if (id == m_strings.size())
+            {
+                m_strings.emplace_back();
+            }
+            m_strings[id].swap(str);
+            continue;
+        }
+        if (type == BINARY_SITE)
+        {
+            uint64_t id = 0;
+            uint64_t line = 0;
+            std::string file;
+            if (!readVarint(id) || !readVarint(line) || !readString(file))
+            {
+                return false;
+            }
+            if (id > m_sites.size())
+            {
+                m_error = true;
+                return false;
+            }
+            if (id == m_sites.size())
+            {
+                m_sites.emplace_back();
+            }
+            m_sites[id] = std::make_pair(file, (int32_t)line);
+            continue;
+        }
+        if (type != BINARY_EVENT)
+        {
+            m_error = true;
+            return false;
+        }
+        uint8_t level = 0;
+        uint64_t v[8];
+        if (!readByte(level))
+        {
+            return false;
+        }
+        for (auto &i : v)
+        {
+            if (!readVarint(i))
+            {
+                return false;
+            }
+        }
+        //v: 时间, elapse, 线程id, 协程id, 调用点id, 线程名id, logger名id, 消息长度
+        if (v[4] >= m_sites.size() || v[5] >= m_strings.size() || v[6] >= m_strings.size())
+        {
+            m_error = true;
+            return false;
+        }
+        if (!fill(v[7]))
+        {
+            return false;
+        }
+        std::shared_ptr<Logger> &logger = m_loggers[m_strings[v[6]]];
+        if (!logger)
+        {
+            logger.reset(new Logger(m_strings[v[6]]));
+        }
+        const std::pair<std::string, int32_t> &site = m_sites[v[4]];
+        event.reset(logger, (LogLevel::Level)level, site.first.c_str(), site.second, v[1],
+                    (int32_t)v[2], v[3], v[0], m_strings[v[5]]);
+        event.getSS().write(m_buf.data() + m_pos, v[7]);
+        m_pos += v[7];
+        return true;
+    }
+    return false;
+}
+
+void StdoutLogAppender::log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
+{
+    if (level >= m_level)
+    {
+        MutexType::Lock lock(m_mutex);
+        std::string &buf = FormatBuffer();
+        m_formatter->format(buf, level, *event);
+        std::cout.write(buf.data(), buf.size());
+    }
+};
+
+std::string StdoutLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "StdoutLogAppender";
+    if (m_level != LogLevel::UNKNOW)
+    {
+        node["level"] = LogLevel::toString(m_level);
+    }
+    if (m_hasFormatter && m_formatter)
+    {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+static const size_t s_async_batch_size = 1024 * 1024;
+static const uint64_t s_async_flush_interval_ms = 10;
+static const uint64_t s_async_check_interval_ms = 1000;
+static std::atomic<uint64_t> s_async_appender_id{0};
+
+// 活着的 AsyncLogAppender，fork 前后逐个处理
+struct AsyncAppenderRegistry
+{
+    Mutex mutex;
+    std::vector<AsyncLogAppender *> appenders;
+};
+
+static AsyncAppenderRegistry *GetAsyncAppenderRegistry()
+{
+    //不析构，理由同 LogFileRotator
+    static AsyncAppenderRegistry *s_registry = new AsyncAppenderRegistry;
+    return s_registry;
+}
+
+struct AsyncLogAppender::Ring
+{
+    explicit Ring(size_t cap) : buf(new char[cap]), mask(cap - 1), owner(pthread_self())
+    {
+    }
+    ~Ring()
+    {
+        delete[] buf;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    // 只在所属线程调用，放不下返回 false，不会只放进去一半
+    bool push(const char *data, size_t len)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        if (capacity() - (h - t) < len)
+        {
+            return false;
+        }
+        size_t off = h & mask;
+        size_t first = std::min(len, capacity() - off);
+        memcpy(buf + off, data, first);
+        memcpy(buf, data + first, len - first);
+        head.store(h + len, std::memory_order_release);
+        return true;
+    }
+
+    // 只在后台线程调用，把现有的数据追加到 out
+    size_t pop(std::string &out)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        size_t len = h - t;
+        if (len == 0)
+        {
+            return 0;
+        }
+        size_t off = t & mask;
+        size_t first = std::min(len, capacity() - off);
+        out.append(buf + off, first);
+        out.append(buf, len - first);
+        tail.store(h, std::memory_order_release);
+        return len;
+    }
+
+    // 生产者和消费者各写各的下标，中间隔开避免伪共享
+    std::atomic<uint64_t> head{0};
+    char pad1[64];
+    std::atomic<uint64_t> tail{0};
+    char pad2[64];
+    /// 所属线程已经退出，取空以后可以扔掉
+    std::atomic<bool> closed{false};
+    /// appender 已经析构，所属线程下次写日志时扔掉
+    std::atomic<bool> orphaned{false};
+    char *buf;
+    size_t mask;
+    /// 所属线程，在所属线程里创建
+    pthread_t owner;
+};
+
+const char *AsyncLogAppender::OverflowPolicyToString(OverflowPolicy v)
+{
+    switch (v)
+    {
+    case DROP:
+        return "drop";
+    case DROP_BELOW_LEVEL:
+        return "drop_below_level";
+    default:
+        return "block";
+    }
+}
+
+AsyncLogAppender::OverflowPolicy AsyncLogAppender::OverflowPolicyFromString(const std::string &str)
+{
+    if (str == "drop" || str == "DROP")
+    {
+        return DROP;
+    }
+    if (str == "drop_below_level" || str == "DROP_BELOW_LEVEL")
+    {
+        return DROP_BELOW_LEVEL;
+    }
+    return BLOCK;
+}
+
+AsyncLogAppender::AsyncLogAppender(const std::string &filename, size_t buffer_size)
+    : m_id(++s_async_appender_id), m_filename(filename), m_bufferSize(4096)
+{
+    while (m_bufferSize < buffer_size)
+    {
+        m_bufferSize <<= 1;
+    }
+    if (m_filename.empty())
+    {
+        m_fd = STDOUT_FILENO;
+    }
+    else
+    {
+        reopen();
+        m_lastCheck = GetMonotonicMS();
+    }
+    m_thread.reset(new Thread(std::bind(&AsyncLogAppender::run, this), "log_async"));
+    static int s_atfork = pthread_atfork(&OnForkPrepare, &OnForkParent, &OnForkChild);
+    (void)s_atfork;
+    AsyncAppenderRegistry *registry = GetAsyncAppenderRegistry();
+    Mutex::Lock lock(registry->mutex);
+    registry->appenders.push_back(this);
+}
 
-class TabFormatItem : public LogFormatter::FormatItem
+AsyncLogAppender::~AsyncLogAppender()
 {
-public:
-    TabFormatItem(const std::string &str = "")
     {
+        AsyncAppenderRegistry *registry = GetAsyncAppenderRegistry();
+        Mutex::Lock lock(registry->mutex);
+        auto &v = registry->appenders;
+        v.erase(std::remove(v.begin(), v.end(), this), v.end());
     }
-    void format(std::ostream &os,
-                Logger::ptr logger,
-                LogLevel::Level level,
-                LogEvent::ptr event) override
+    m_stopping = true;
     {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+    }
+    m_wakeCond.notify_one();
+    m_thread->join();
+    Mutex::Lock lock(m_ringsMutex);
+    for (auto &i : m_rings)
+    {
+        i->orphaned = true;
+    }
+    if (m_fd > STDERR_FILENO)
+    {
+        ::close(m_fd);
+    }
+}
 
-        os << "\t"; // 制表符
-    };
-
-private:
-    std::string m_string;
-};
-
-LogEvent::LogEvent(Logger::ptr logger,
-                   LogLevel::Level level,
-                   const char *file,
-                   int32_t line,
-                   uint32_t elapse,
-                   int32_t threadId,
-                   uint32_t fiberId,
-                   int64_t time,
-                   const std::string &thread_name)
-    : m_file(file), m_line(line), m_elapse(elapse), m_threadId(threadId), m_fiberId(fiberId),
-      m_time(time), m_level(level), m_logger(logger), m_threadName(thread_name){};
-
-Logger::Logger(const std::string &name) : m_name(name), m_level(LogLevel::DEBUG)
+// fork 的时候后台线程可能正拿着锁，先都拿到手，子进程里的锁才是干净的
+void AsyncLogAppender::OnForkPrepare()
 {
-    // 使用默认的格式化参数
-    m_formatter.reset(
-        new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T<%f:%l>%T%m%T%n"));
+    AsyncAppenderRegistry *registry = GetAsyncAppenderRegistry();
+    registry->mutex.lock();
+    for (auto &i : registry->appenders)
+    {
+        i->m_ringsMutex.lock();
+        i->m_waitMutex.lock();
+    }
 }
 
-void Logger::addAppender(LogAppender::ptr appender)
+void AsyncLogAppender::OnForkParent()
 {
-    MutexType::Lock lock(m_mutex);
-    // 使用默认的格式化参数
-    if (!appender->getFormatter())
+    AsyncAppenderRegistry *registry = GetAsyncAppenderRegistry();
+    for (auto &i : registry->appenders)
     {
-        MutexType::Lock appender_lock(appender->m_mutex);
-        appender->m_formatter = m_formatter;
+        i->m_waitMutex.unlock();
+        i->m_ringsMutex.unlock();
     }
-    m_appenders.push_back(appender);
-};
+    registry->mutex.unlock();
+}
 
-void Logger::delAppender(LogAppender::ptr appender)
+// 子进程里没有后台线程，写日志的 BLOCK 会一直等、DROP 会全丢，要重新起一个
+void AsyncLogAppender::OnForkChild()
 {
-    MutexType::Lock lock(m_mutex);
-    for (auto it = m_appenders.begin(); it != m_appenders.end(); it++)
+    AsyncAppenderRegistry *registry = GetAsyncAppenderRegistry();
+    for (auto &i : registry->appenders)
     {
-        if (*it == appender)
+        for (auto &ring : i->m_rings)
         {
-            m_appenders.erase(it);
-            break;
+            //还没取走的日志是父进程的线程写的，父进程会写出去，子进程再写就重复了
+            ring->tail.store(ring->head.load());
+            //其他线程在子进程里不存在，它们的缓冲让后台线程扔掉
+            if (!pthread_equal(ring->owner, pthread_self()))
+            {
+                ring->closed = true;
+            }
         }
+        i->m_sleeping = false;
+        //父进程里等在条件变量上的线程子进程里没有了，留着它们的状态 notify 可能永远等下去，
+        //原地重新构造（不能析构，析构也会等它们）
+        new (&i->m_wakeCond) std::condition_variable;
+        new (&i->m_flushCond) std::condition_variable;
+        i->m_waitMutex.unlock();
+        i->m_ringsMutex.unlock();
+        AbandonThread(i->m_thread);
+        i->m_thread.reset(new Thread(std::bind(&AsyncLogAppender::run, i), "log_async"));
     }
-};
-
-void Logger::clearAppenders()
-{
-    MutexType::Lock lock(m_mutex);
-    m_appenders.clear();
+    registry->mutex.unlock();
 }
 
-void Logger::log(LogLevel::Level level, LogEvent::ptr event)
+AsyncLogAppender::Ring *AsyncLogAppender::getRing()
 {
-
-    if (level >= m_level)
+    //线程退出时把缓冲标记成 closed，后台线程取空以后释放
+    struct ThreadRings
     {
-        auto self = shared_from_this();
-        MutexType::Lock lock(m_mutex);
-        if (!m_appenders.empty())
+        std::vector<std::pair<uint64_t, RingPtr>> rings;
+        ~ThreadRings()
         {
-            for (auto &i : m_appenders)
+            for (auto &i : rings)
             {
-                i->log(self, level, event);
+                i.second->closed = true;
             }
         }
-        else if (m_root)
+    };
+    static thread_local ThreadRings t_rings;
+
+    auto &rings = t_rings.rings;
+    for (auto it = rings.begin(); it != rings.end();)
+    {
+        if (it->first == m_id)
         {
-            // MutexType::Lock lock(m_mutex);
-            m_root->log(level, event);
+            return it->second.get();
+        }
+        if (it->second->orphaned)
+        {
+            it = rings.erase(it);
+            continue;
         }
+        ++it;
     }
-};
-void Logger::setFormatter(LogFormatter::ptr val)
+    RingPtr ring = std::make_shared<Ring>(m_bufferSize);
+    {
+        Mutex::Lock lock(m_ringsMutex);
+        m_rings.push_back(ring);
+    }
+    rings.push_back(std::make_pair(m_id, ring));
+    return ring.get();
+}
+
+void AsyncLogAppender::push(LogLevel::Level level, const char *data, size_t len)
 {
-    MutexType::Lock lock(m_mutex);
-    m_formatter = val;
-    for (auto &i : m_appenders)
+    Ring *ring = getRing();
+    //比整个缓冲还长的只留前面的部分
+    len = std::min(len, ring->capacity());
+    bool block = m_policy == BLOCK || (m_policy == DROP_BELOW_LEVEL && level >= m_dropLevel);
+    //data 一般指向线程的格式化缓冲，让出期间同线程的其他协程会改写它，等之前先拷一份
+    std::string copy;
+    while (!ring->push(data, len))
     {
-        MutexType::Lock appender_lock(i->m_mutex);
-        if (!i->m_hasFormatter)
+        if (!block || m_stopping)
         {
-            i->m_formatter = m_formatter;
+            ++m_dropped;
+            return;
+        }
+        if (data != copy.data())
+        {
+            copy.assign(data, len);
+            data = copy.data();
         }
+        m_wakeCond.notify_one();
+        //开了 hook 的线程里只让出当前协程
+        usleep(100);
+        //协程恢复时可能已经换了线程，每个环只能由所属线程写，要重新取
+        ring = getRing();
+    }
+    //过半了而后台线程还在睡，叫醒它，不用等到下一个周期
+    if (ring->size() > ring->capacity() / 2 && m_sleeping.load(std::memory_order_relaxed))
+    {
+        m_wakeCond.notify_one();
     }
 }
 
-void Logger::setFormatter(const std::string &val)
+void AsyncLogAppender::log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
 {
-    sylar::LogFormatter::ptr new_val(new sylar::LogFormatter(val));
-    if (new_val->isError())
+    if (level < m_level)
     {
-        SYLAR_LOG_ERROR(SYLAR_LOG_ROOT())
-            << "Logger setFormatter name=" << m_name << " invalid formatter "
-            << "value = " << val << "invlid formatter";
         return;
     }
-    setFormatter(new_val);
-}
-
-LogFormatter::ptr Logger::getFormatter()
-{
-    MutexType::Lock lock(m_mutex);
-    return m_formatter;
+    LogFormatter::ptr formatter;
+    {
+        MutexType::Lock lock(m_mutex);
+        formatter = m_formatter;
+    }
+    std::string &buf = FormatBuffer();
+    formatter->format(buf, level, *event);
+    push(level, buf.data(), buf.size());
+    if (level >= LogLevel::FATAL)
+    {
+        //FATAL 之后进程多半要退出，等它落盘
+        flush();
+    }
 }
 
-void Logger::debug(LogEvent::ptr event)
+void AsyncLogAppender::flush()
 {
-    log(LogLevel::DEBUG, event);
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    uint64_t req = ++m_flushRequest;
+    m_wakeCond.notify_one();
+    m_flushCond.wait(lock, [this, req]() { return m_flushDone >= req || m_stopping; });
 }
 
-void Logger::info(LogEvent::ptr event)
-{
-    log(LogLevel::INFO, event);
-};
-
-void Logger::warn(LogEvent::ptr event)
-{
-    log(LogLevel::WARN, event);
-};
-
-void Logger::error(LogEvent::ptr event)
+void AsyncLogAppender::run()
 {
-    log(LogLevel::ERROR, event);
-};
+    std::string batch;
+    batch.reserve(s_async_batch_size);
+    while (true)
+    {
+        bool stopping = m_stopping;
+        uint64_t req = m_flushRequest;
+        if (!m_filename.empty() && GetMonotonicMS() - m_lastCheck >= s_async_check_interval_ms)
+        {
+            checkFile();
+        }
+        size_t n = drain(batch);
+        writeOut(batch);
 
-void Logger::fatal(LogEvent::ptr event)
-{
-    log(LogLevel::FATAL, event);
-};
-FileLogAppender::FileLogAppender(const std::string &filename) : m_filename(filename)
-{
-    reopen();
-};
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        if (req > m_flushDone)
+        {
+            m_flushDone = req;
+            m_flushCond.notify_all();
+        }
+        if (stopping)
+        {
+            break;
+        }
+        if (n == 0 && !m_stopping && m_flushRequest == req)
+        {
+            m_sleeping = true;
+            m_wakeCond.wait_for(lock, std::chrono::milliseconds(s_async_flush_interval_ms));
+            m_sleeping = false;
+        }
+    }
+}
 
-void FileLogAppender::log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
+size_t AsyncLogAppender::drain(std::string &batch)
 {
-
-    if (level >= m_level)
+    std::vector<RingPtr> rings;
     {
-        uint64_t now = time(0);
-        if (now != m_lastTime)
-        {
-            reopen();
-            m_lastTime = now;
-        }
-        MutexType::Lock lock(m_mutex);
-        if (!(m_fileStream << m_formatter->format(logger, level, event)))
+        Mutex::Lock lock(m_ringsMutex);
+        rings = m_rings;
+    }
+    size_t total = 0;
+    bool has_closed = false;
+    for (auto &i : rings)
+    {
+        has_closed = has_closed || i->closed;
+        total += i->pop(batch);
+        if (batch.size() >= s_async_batch_size)
         {
-            std::cout << "error" << std::endl;
+            writeOut(batch);
         }
     }
-};
-std::string FileLogAppender::toYamlString()
+    if (has_closed)
+    {
+        Mutex::Lock lock(m_ringsMutex);
+        m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(),
+                                     [](const RingPtr &r) { return r->closed && r->size() == 0; }),
+                      m_rings.end());
+    }
+    return total;
+}
+
+void AsyncLogAppender::writeOut(std::string &batch)
 {
-    MutexType::Lock lock(m_mutex);
-    YAML::Node node;
-    node["type"] = "FileLogAppender";
-    node["file"] = m_filename;
-    if (m_level != LogLevel::UNKNOW)
+    size_t off = 0;
+    while (off < batch.size() && m_fd >= 0)
     {
-        node["level"] = LogLevel::toString(m_level);
+        ssize_t n = ::write(m_fd, batch.data() + off, batch.size() - off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        off += n;
     }
-    if (m_hasFormatter && m_formatter)
+    if (!batch.empty())
     {
-        node["formatter"] = m_formatter->getPattern();
+        ++m_writes;
     }
-    std::stringstream ss;
-    ss << node;
-    return ss.str();
+    batch.clear();
 }
 
-// 如果文件已经打开，那么就先把他关闭，再重新打开
-bool FileLogAppender::reopen()
+void AsyncLogAppender::checkFile()
 {
-    MutexType::Lock lock(m_mutex);
-    if (m_fileStream)
+    m_lastCheck = GetMonotonicMS();
+    struct stat st;
+    if (m_fd >= 0 && ::stat(m_filename.c_str(), &st) == 0 && (uint64_t)st.st_dev == m_dev &&
+        (uint64_t)st.st_ino == m_ino)
     {
-        m_fileStream.close();
+        return;
     }
-    m_fileStream.open(m_filename);
-    return !!m_fileStream;
-};
-void StdoutLogAppender::log(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
+    reopen();
+}
+
+// 追加打开，打开新文件成功了才关掉旧的
+void AsyncLogAppender::reopen()
 {
-    if (level >= m_level)
+    int fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
     {
-        MutexType::Lock lock(m_mutex);
-        std::string str = m_formatter->format(logger, level, event);
-        std::cout << str;
+        return;
     }
-};
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return;
+    }
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+    m_fd = fd;
+    m_dev = st.st_dev;
+    m_ino = st.st_ino;
+}
 
-std::string StdoutLogAppender::toYamlString()
+std::string AsyncLogAppender::toYamlString()
 {
     MutexType::Lock lock(m_mutex);
     YAML::Node node;
-    node["type"] = "StdoutLogAppender";
+    node["type"] = "AsyncLogAppender";
+    if (!m_filename.empty())
+    {
+        node["file"] = m_filename;
+    }
+    node["overflow"] = OverflowPolicyToString(m_policy);
+    if (m_policy == DROP_BELOW_LEVEL)
+    {
+        node["drop_level"] = LogLevel::toString(m_dropLevel);
+    }
+    node["buffer_size"] = m_bufferSize;
     if (m_level != LogLevel::UNKNOW)
     {
         node["level"] = LogLevel::toString(m_level);
@@ -548,13 +1923,73 @@ LogFormatter::LogFormatter(const std::string &pattern) : m_pattern(pattern)
 
 std::string LogFormatter::format(Logger::ptr logger, LogLevel::Level level, LogEvent::ptr event)
 {
-    std::stringstream ss;
-    for (auto i : m_items)
+    std::string str;
+    format(str, level, *event);
+    return str;
+};
+
+void LogFormatter::format(std::string &out, LogLevel::Level level, const LogEvent &event) const
+{
+    FormatWriter writer(out);
+    const char *literals = m_literals.data();
+    for (auto &i : m_ops)
+    {
+        switch (i.type)
+        {
+        case LITERAL:
+            writer.append(literals + i.arg, i.len);
+            break;
+        case MESSAGE:
+            writer.append(event.getContent());
+            break;
+        case LEVEL:
+        {
+            const char *str = LogLevel::toString(level);
+            writer.append(str, strlen(str));
+            break;
+        }
+        case ELAPSE:
+            writer.appendUint(event.getElapse());
+            break;
+        case NAME:
+            writer.append(event.getLogger()->getName());
+            break;
+        case THREAD_ID:
+            writer.appendInt(event.getThreadId());
+            break;
+        case FIBER_ID:
+            writer.appendUint(event.getFiberId());
+            break;
+        case THREAD_NAME:
+            writer.append(event.getThreadName());
+            break;
+        case DATE_TIME:
+            AppendTime(writer, m_dateFormats[i.arg], event.getTime());
+            break;
+        case FILE_NAME:
+            writer.append(event.getFile(), strlen(event.getFile()));
+            break;
+        case LINE:
+            writer.appendInt(event.getLine());
+            break;
+        }
+    }
+}
+
+void LogFormatter::addLiteral(const std::string &str)
+{
+    //和前一段文本挨着就接在后面
+    if (!m_ops.empty() && m_ops.back().type == LITERAL &&
+        m_ops.back().arg + m_ops.back().len == m_literals.size())
     {
-        i->format(ss, logger, level, event);
+        m_ops.back().len += str.size();
     }
-    return ss.str();
-};
+    else
+    {
+        m_ops.push_back(Op{LITERAL, (uint32_t)m_literals.size(), (uint32_t)str.size()});
+    }
+    m_literals.append(str);
+}
 
 // 需要格式化的字符串为%d [%p] <%f:%l> %m %n
 void LogFormatter::init()
@@ -575,8 +2010,8 @@ void LogFormatter::init()
         {
             if (m_pattern[i + 1] == '%')
             {
-
                 nstr.append(1, '%');
+                ++i;
                 continue;
             }
         }
@@ -657,56 +2092,62 @@ void LogFormatter::init()
         vec.push_back(std::make_tuple(nstr, std::string(""), 0));
     }
 
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string &)>>
-        s_format_items = {
-#define XX(str, C)                                                                                 \
-    {                                                                                              \
-#str, [](const std::string &fmt) { return FormatItem::ptr(new C(fmt)); }                   \
-    }
-            XX(m, MessageFormatItem),    // m:消息
-            XX(p, LevelFormatItem),      // p:日志级别
-            XX(r, ElapseFormatItem),     // r:累计毫秒数
-            XX(c, NameFormatItem),       // c:日志名称
-            XX(t, ThreadIdFormatItem),   // t:线程id
-            XX(n, NewLineFormatItem),    // n:换行
-            XX(d, DateTimeFormatItem),   // d:时间
-            XX(f, FilenameFormatItem),   // f:文件名
-            XX(l, LineFormatItem),       // l:行号
-            XX(T, TabFormatItem),        // T:Tab
-            XX(F, FiberIdFormatItem),    // F:协程id
-            XX(N, ThreadNameFormatItem), // N:线程名称
-#undef XX
-        };
+    // %T 和 %n 是固定的字符，和普通文本一样处理
+    static const std::map<std::string, OpType> s_ops = {
+        {"m", MESSAGE},     // m:消息
+        {"p", LEVEL},       // p:日志级别
+        {"r", ELAPSE},      // r:累计毫秒数
+        {"c", NAME},        // c:日志名称
+        {"t", THREAD_ID},   // t:线程id
+        {"d", DATE_TIME},   // d:时间
+        {"f", FILE_NAME},   // f:文件名
+        {"l", LINE},        // l:行号
+        {"F", FIBER_ID},    // F:协程id
+        {"N", THREAD_NAME}, // N:线程名称
+    };
     // vec里是tuple
     // tuple第一个参数是格式化字符串的所属类别（比如// %m -- 消息体，%p --
     // 日志级别，%r -- 累计毫秒数），
-    // 第二个是格式化的模板，只有DateTimeFormatItem会用到其实
+    // 第二个是格式化的模板，只有时间会用到其实
     // 第三个是是否是最普通的字符串（0就是普通字符串，1就是需要格式化输出的）
-    // std::tuple<std::string, std::string, int>
+    m_ops.clear();
+    m_literals.clear();
+    m_dateFormats.clear();
     for (auto &i : vec)
     {
+        const std::string &name = std::get<0>(i);
         if (std::get<2>(i) == 0)
         {
-            m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+            addLiteral(name);
+        }
+        else if (name == "T")
+        {
+            addLiteral("\t");
+        }
+        else if (name == "n")
+        {
+            addLiteral("\n");
         }
         else
         {
-            auto it = s_format_items.find(std::get<0>(i));
-            if (it == s_format_items.end())
+            auto it = s_ops.find(name);
+            if (it == s_ops.end())
             {
-                m_items.push_back(FormatItem::ptr(
-                    new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
+                addLiteral("<<error_format %" + name + ">>");
                 m_error = true;
             }
+            else if (it->second == DATE_TIME)
+            {
+                std::string fmt = std::get<1>(i);
+                m_dateFormats.push_back(fmt.empty() ? "%Y-%m-%d %H:%M:%S" : fmt);
+                m_ops.push_back(Op{DATE_TIME, (uint32_t)(m_dateFormats.size() - 1), 0});
+            }
             else
             {
-                m_items.push_back(it->second(std::get<1>(i)));
+                m_ops.push_back(Op{it->second, 0, 0});
             }
         }
     }
-    // std::cout << "(" << std::get<0>(i) << ")-(" << std::get<1>(i) <<
-    // "),(" << std::get<2>(i)
-    // << ")" << std::endl;
 }
 LoggerManager::LoggerManager()
 {
@@ -731,7 +2172,7 @@ std::string LoggerManager::toYamlString()
 
 std::string Logger::toYamlString()
 {
-    MutexType::Lock lock(m_mutex);
+    RWMutexType::ReadLock lock(m_mutex);
     YAML::Node node;
     node["name"] = m_name;
     if (m_level != LogLevel::UNKNOW)
@@ -743,7 +2184,7 @@ std::string Logger::toYamlString()
         node["formatter"] = m_formatter->getPattern();
     }
 
-    for (auto &i : m_appenders)
+    for (auto &i : *m_appenders)
     {
         node["appenders"].push_back(YAML::Load(i->toYamlString()));
     }
@@ -768,15 +2209,26 @@ Logger::ptr LoggerManager::getLogger(const std::string &name)
 
 struct LogAppenderDefine
 {
-    int type = 0; // 1 File 2 Stdout
+    int type = 0; // 1 File 2 Stdout 3 Async 4 Binary
     LogLevel::Level level = LogLevel::DEBUG;
     std::string formatter;
     std::string file;
+    // 下面几个 File 和 Binary 用
+    uint64_t maxSize = 0;
+    FileLogAppender::RotateInterval rotate = FileLogAppender::NONE;
+    uint32_t maxFiles = 0;
+    bool compress = true;
+    // 下面几个只有 Async 用
+    AsyncLogAppender::OverflowPolicy overflow = AsyncLogAppender::BLOCK;
+    LogLevel::Level dropLevel = LogLevel::WARN;
+    size_t bufferSize = 256 * 1024;
 
     bool operator==(const LogAppenderDefine &oth) const
     {
         return type == oth.type && level == oth.level && formatter == oth.formatter &&
-               file == oth.file;
+               file == oth.file && maxSize == oth.maxSize && rotate == oth.rotate &&
+               maxFiles == oth.maxFiles && compress == oth.compress && overflow == oth.overflow &&
+               dropLevel == oth.dropLevel && bufferSize == oth.bufferSize;
     }
 };
 
@@ -836,9 +2288,9 @@ public:
                 }
                 std::string type = a["type"].as<std::string>();
                 LogAppenderDefine lad;
-                if (type == "FileLogAppender")
+                if (type == "FileLogAppender" || type == "BinaryLogAppender")
                 {
-                    lad.type = 1;
+                    lad.type = type == "FileLogAppender" ? 1 : 4;
                     if (!a["file"].IsDefined())
                     {
                         std::cout << "log config error: fileappender file is null, " << a
@@ -846,20 +2298,64 @@ public:
                         continue;
                     }
                     lad.file = a["file"].as<std::string>();
-                    if (a["formatter"].IsDefined())
+                    if (a["max_size"].IsDefined())
+                    {
+                        lad.maxSize = a["max_size"].as<uint64_t>();
+                    }
+                    if (a["rotate"].IsDefined())
+                    {
+                        lad.rotate = FileLogAppender::RotateIntervalFromString(
+                            a["rotate"].as<std::string>());
+                    }
+                    if (a["max_files"].IsDefined())
+                    {
+                        lad.maxFiles = a["max_files"].as<uint32_t>();
+                    }
+                    if (a["compress"].IsDefined())
                     {
-                        lad.formatter = a["formatter"].as<std::string>();
+                        lad.compress = a["compress"].as<bool>();
                     }
                 }
                 else if (type == "StdoutLogAppender")
                 {
                     lad.type = 2;
                 }
+                else if (type == "AsyncLogAppender")
+                {
+                    // file 不填就写标准输出
+                    lad.type = 3;
+                    if (a["file"].IsDefined())
+                    {
+                        lad.file = a["file"].as<std::string>();
+                    }
+                    if (a["overflow"].IsDefined())
+                    {
+                        lad.overflow = AsyncLogAppender::OverflowPolicyFromString(
+                            a["overflow"].as<std::string>());
+                    }
+                    if (a["drop_level"].IsDefined())
+                    {
+                        lad.dropLevel = LogLevel::fromString(a["drop_level"].as<std::string>());
+                    }
+                    if (a["buffer_size"].IsDefined())
+                    {
+                        lad.bufferSize = a["buffer_size"].as<size_t>();
+                    }
+                }
                 else
                 {
                     std::cout << "log config error: appender type is invalid, " << a << std::endl;
                     continue;
                 }
+                if (a["level"].IsDefined())
+                {
+                    lad.level = LogLevel::fromString(a["level"].as<std::string>());
+                }
+                if (a["formatter"].IsDefined())
+                {
+                    lad.formatter = a["formatter"].as<std::string>();
+                }
+                ld.appenders.push_back(lad);
             }
         }
         return ld;
@@ -886,15 +2382,39 @@ public:
         for (auto &a : i.appenders)
         {
             YAML::Node na;
-            if (a.type == 1)
+            if (a.type == 1 || a.type == 4)
             {
-                na["type"] = "FileLogAppender";
+                na["type"] = a.type == 1 ? "FileLogAppender" : "BinaryLogAppender";
                 na["file"] = a.file;
+                if (a.maxSize > 0)
+                {
+                    na["max_size"] = a.maxSize;
+                }
+                if (a.rotate != FileLogAppender::NONE)
+                {
+                    na["rotate"] = FileLogAppender::RotateIntervalToString(a.rotate);
+                }
+                if (a.maxFiles > 0)
+                {
+                    na["max_files"] = a.maxFiles;
+                }
+                na["compress"] = a.compress;
             }
             else if (a.type == 2)
             {
                 na["type"] = "StdoutLogAppender";
             }
+            else if (a.type == 3)
+            {
+                na["type"] = "AsyncLogAppender";
+                if (!a.file.empty())
+                {
+                    na["file"] = a.file;
+                }
+                na["overflow"] = AsyncLogAppender::OverflowPolicyToString(a.overflow);
+                na["drop_level"] = LogLevel::toString(a.dropLevel);
+                na["buffer_size"] = a.bufferSize;
+            }
             if (a.level != LogLevel::UNKNOW)
             {
                 na["level"] = LogLevel::toString(a.level);
@@ -938,11 +2458,12 @@ struct LogIniter
                     //新旧都有，则进行修改的操作
                     else
                     {
-                        if (!(i == *it))
+                        if (i == *it)
                         {
-                            //修改logger
-                            logger = SYLAR_LOG_NAME(i.name);
+                            continue;
                         }
+                        //修改logger
+                        logger = SYLAR_LOG_NAME(i.name);
                     }
                     logger->setLevel(i.level);
                     //如果配置文件没给formatter，就用默认的
@@ -957,14 +2478,29 @@ struct LogIniter
 
                         sylar::LogAppender::ptr ap;
                         // LogDefine里面的type是1就是File，2就是Stdout
-                        if (a.type == 1)
+                        if (a.type == 1 || a.type == 4)
                         {
-                            ap.reset(new FileLogAppender(a.file));
+                            FileLogAppender::ptr file(a.type == 1
+                                                          ? new FileLogAppender(a.file)
+                                                          : new BinaryLogAppender(a.file));
+                            file->setMaxSize(a.maxSize);
+                            file->setRotateInterval(a.rotate);
+                            file->setMaxFiles(a.maxFiles);
+                            file->setCompress(a.compress);
+                            ap = file;
                         }
                         else if (a.type == 2)
                         {
                             ap.reset(new StdoutLogAppender);
                         }
+                        else if (a.type == 3)
+                        {
+                            AsyncLogAppender::ptr async(
+                                new AsyncLogAppender(a.file, a.bufferSize));
+                            async->setOverflowPolicy(a.overflow);
+                            async->setDropLevel(a.dropLevel);
+                            ap = async;
+                        }
                         ap->setLevel(a.level);
                         if (!a.formatter.empty())
                         {
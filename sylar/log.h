@@ -1,8 +1,11 @@
 #ifndef __SYLAR_LOG_H__
 #define __SYLAR_LOG_H__
+#include "noncopyable.h"
 #include "singleton.h"
 #include "thread.h"
 #include "util.h"
+#include <atomic>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
@@ -12,17 +15,17 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// 级别不够时只有一次比较；够的话事件取自本线程的复用池，不分配内存
 #define SYLAR_LOG_LEVEL(logger, level)                                                             \
     if (logger->getLevel() <= level)                                                               \
-    sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(                                  \
-                            logger, level, __FILE__, __LINE__, 0, sylar::GetThreadId(),            \
-                            sylar::GetFiberId(), time(0), sylar::Thread::GetName())))              \
-        .getSS()
+    sylar::LogEventWrap(logger, level, __FILE__, __LINE__).getSS()
 
 #define SYLAR_LOG_DEBUG(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::DEBUG)
 #define SYLAR_LOG_INFO(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::INFO)
@@ -32,11 +35,7 @@
 
 #define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...)                                               \
     if (logger->getLevel() <= level)                                                               \
-    sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(                                  \
-                            logger, level, __FILE__, __LINE__, 0, sylar::GetThreadId(),            \
-                            sylar::GetFiberId(), time(0), sylar::Thread::GetName())))              \
-        .getEvent()                                                                                \
-        ->format(fmt, __VA_ARGS__)
+    sylar::LogEventWrap(logger, level, __FILE__, __LINE__).getEvent()->format(fmt, __VA_ARGS__)
 
 #define SYLAR_LOG_FMT_DEBUG(logger, fmt, ...)                                                      \
     SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::DEBUG, fmt, __VA_ARGS__)
@@ -49,6 +48,33 @@
 #define SYLAR_LOG_FMT_FATAL(logger, fmt, ...)                                                      \
     SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+// 宏展开处的函数静态变量，每个调用点一个
+#define SYLAR_LOG_SITE_SAMPLER(sampler_type)                                                       \
+    ([]() -> sampler_type & {                                                                      \
+        static sampler_type s_sampler;                                                             \
+        return s_sampler;                                                                          \
+    }())
+
+/**
+ * 限流的日志：每个调用点一个 sampler_type 类型的采样器（宏展开处的函数静态变量），
+ * 只用原子操作。被压掉的条数在下一条放行的日志后面带上 "(suppressed N similar messages)"。
+ * 级别不够时不碰采样器
+ */
+#define SYLAR_LOG_SAMPLED(logger, level, sampler_type, ...)                                        \
+    if (logger->getLevel() <= level)                                                               \
+        if (sylar::LogSample _sylar_sample =                                                       \
+                SYLAR_LOG_SITE_SAMPLER(sampler_type).sample(__VA_ARGS__))                          \
+    sylar::LogEventWrap(logger, level, __FILE__, __LINE__, _sylar_sample.suppressed).getSS()
+
+// 每个调用点每 n 条输出一条（第 1、n+1、2n+1... 条）
+#define SYLAR_LOG_EVERY_N(logger, level, n) SYLAR_LOG_SAMPLED(logger, level, sylar::LogEveryN, n)
+// 每个调用点每 ms 毫秒最多输出一条
+#define SYLAR_LOG_EVERY_MS(logger, level, ms)                                                      \
+    SYLAR_LOG_SAMPLED(logger, level, sylar::LogEveryMs, ms)
+// 每个调用点按令牌桶限流：平均每秒 rate 条，最多连着输出 burst 条
+#define SYLAR_LOG_RATE_LIMITED(logger, level, rate, burst)                                         \
+    SYLAR_LOG_SAMPLED(logger, level, sylar::LogTokenBucket, rate, burst)
+
 #define SYLAR_LOG_ROOT() sylar::LoggerMgr::GetInstance()->getRoot()
 #define SYLAR_LOG_NAME(name) sylar::LoggerMgr::GetInstance()->getLogger(name)
 namespace sylar
@@ -75,11 +101,40 @@ public:
     static LogLevel::Level fromString(const std::string &str);
 };
 
+// 把 ostream 的输出直接追加到一个 string 后面
+class LogStreamBuf : public std::streambuf
+{
+public:
+    explicit LogStreamBuf(std::string &str) : m_str(str)
+    {
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+        {
+            m_str.push_back((char)c);
+        }
+        return c;
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        m_str.append(s, n);
+        return n;
+    }
+
+private:
+    std::string &m_str;
+};
+
 // 日志事件
-class LogEvent
+// 宏里用的事件由 LogEventWrap 从本线程的池里取，用完 reset 以后再用，内容缓冲的容量留着
+class LogEvent : Noncopyable
 {
 public:
     typedef std::shared_ptr<LogEvent> ptr;
+    LogEvent();
     LogEvent(std::shared_ptr<Logger> logger,
              LogLevel::Level level,
              const char *file,
@@ -89,6 +144,16 @@ public:
              uint32_t fiberId,
              int64_t time,
              const std::string &thread_name);
+    // 换成一条新日志，清空内容和流的状态
+    void reset(const std::shared_ptr<Logger> &logger,
+               LogLevel::Level level,
+               const char *file,
+               int32_t line,
+               uint32_t elapse,
+               int32_t threadId,
+               uint32_t fiberId,
+               int64_t time,
+               const std::string &thread_name);
     const char *getFile() const
     {
         return m_file;
@@ -116,12 +181,12 @@ public:
         return m_time;
     }
 
-    std::string getContent() const
+    const std::string &getContent() const
     {
-        return m_ss.str();
+        return m_content;
     }
 
-    std::stringstream &getSS()
+    std::ostream &getSS()
     {
         return m_ss;
     }
@@ -131,10 +196,14 @@ public:
         return m_level;
     }
 
-    std::shared_ptr<Logger> getLogger() const
+    const std::shared_ptr<Logger> &getLogger() const
     {
         return m_logger;
     }
+    void clearLogger()
+    {
+        m_logger.reset();
+    }
 
     const std::string &getThreadName() const
     {
@@ -151,18 +220,27 @@ private:
     int32_t m_threadId = 0;           // 线程ID
     uint32_t m_fiberId = 0;           // 协程ID
     int64_t m_time = 0;               // 时间戳
-    std::stringstream m_ss;           // 日志内容
+    std::string m_content;            // 日志内容
+    LogStreamBuf m_buf;               // 往 m_content 里写
+    std::ostream m_ss;                // 用户 << 的流
     LogLevel::Level m_level;          // 日志级别
     std::shared_ptr<Logger> m_logger; // 日志器
     std::string m_threadName;         // 线程名称
 };
 
-class LogEventWrap
+class LogEventWrap : Noncopyable
 {
 public:
     LogEventWrap(LogEvent::ptr e);
+    // 从本线程的池里取一个事件
+    // suppressed 不为 0 时在消息后面带上被压掉的条数
+    LogEventWrap(const std::shared_ptr<Logger> &logger,
+                 LogLevel::Level level,
+                 const char *file,
+                 int32_t line,
+                 uint64_t suppressed = 0);
     ~LogEventWrap();
-    std::stringstream &getSS();
+    std::ostream &getSS();
     LogEvent::ptr getEvent() const
     {
         return m_event;
@@ -170,9 +248,112 @@ public:
 
 private:
     LogEvent::ptr m_event;
+    uint64_t m_suppressed = 0;
+};
+
+// 采样器的结果，suppressed 是上次放行以来被压掉的条数
+struct LogSample
+{
+    bool pass;
+    uint64_t suppressed;
+
+    explicit operator bool() const
+    {
+        return pass;
+    }
+};
+
+// 采样器的公共部分：记上次放行以来被压掉了多少条
+class LogSampler : Noncopyable
+{
+protected:
+    LogSample pass()
+    {
+        return LogSample{true, m_suppressed.exchange(0, std::memory_order_relaxed)};
+    }
+    LogSample drop()
+    {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return LogSample{false, 0};
+    }
+
+private:
+    std::atomic<uint64_t> m_suppressed{0};
+};
+
+// 每 n 条放行一条
+class LogEveryN : public LogSampler
+{
+public:
+    LogSample sample(uint64_t n)
+    {
+        uint64_t count = m_count.fetch_add(1, std::memory_order_relaxed);
+        return n <= 1 || count % n == 0 ? pass() : drop();
+    }
+
+private:
+    std::atomic<uint64_t> m_count{0};
+};
+
+// 每 ms 毫秒最多放行一条，多个线程同时到期时只有一个能放行
+class LogEveryMs : public LogSampler
+{
+public:
+    LogSample sample(uint64_t ms)
+    {
+        uint64_t now = CoarseMonoMs();
+        uint64_t next = m_next.load(std::memory_order_relaxed);
+        if (now >= next &&
+            m_next.compare_exchange_strong(next, now + ms, std::memory_order_relaxed))
+        {
+            return pass();
+        }
+        return drop();
+    }
+
+private:
+    std::atomic<uint64_t> m_next{0};
+};
+
+/**
+ * @brief 令牌桶：平均每秒 rate 条，最多攒 burst 条
+ * @details 按 GCRA 的写法只存一个数：下一条理论上最早的放行时间（微秒），
+ *          比它早不超过 (burst-1) 个间隔的都能放行，CAS 往后推一个间隔
+ */
+class LogTokenBucket : public LogSampler
+{
+public:
+    LogSample sample(uint32_t rate, uint32_t burst)
+    {
+        if (rate == 0)
+        {
+            return drop();
+        }
+        uint64_t now = CoarseMonoMs() * 1000;
+        uint64_t interval = 1000000 / rate;
+        uint64_t tolerance = interval * (burst > 1 ? burst - 1 : 0);
+        uint64_t tat = m_tat.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint64_t start = tat > now ? tat : now;
+            if (start - now > tolerance)
+            {
+                return drop();
+            }
+            if (m_tat.compare_exchange_weak(tat, start + interval, std::memory_order_relaxed))
+            {
+                return pass();
+            }
+        }
+    }
+
+private:
+    std::atomic<uint64_t> m_tat{0};
 };
 
 // 日志格式器
+// 构造时把模式编译成一串操作（相邻的普通文本、%T、%n 合成一段），格式化时按顺序往 string 后面追加，
+// 不经过 iostream
 class LogFormatter
 {
 public:
@@ -180,22 +361,8 @@ public:
     LogFormatter(const std::string &pattern);
     std::string
     format(std::shared_ptr<Logger> logger, LogLevel::Level level, const LogEvent::ptr event);
-
-public:
-    class FormatItem
-    {
-    public:
-        typedef std::shared_ptr<FormatItem> ptr;
-        // FormatItem(const std::string
-        // &str = "") {};
-        virtual ~FormatItem()
-        {
-        }
-        virtual void format(std::ostream &os,
-                            std::shared_ptr<Logger> logger,
-                            LogLevel::Level level,
-                            LogEvent::ptr event) = 0;
-    };
+    // 追加到 out 后面，不清空
+    void format(std::string &out, LogLevel::Level level, const LogEvent &event) const;
 
     void init();
     bool isError() const
@@ -207,9 +374,36 @@ public:
         return m_pattern;
     }
 
+private:
+    enum OpType : uint8_t
+    {
+        LITERAL,
+        MESSAGE,
+        LEVEL,
+        ELAPSE,
+        NAME,
+        THREAD_ID,
+        FIBER_ID,
+        THREAD_NAME,
+        DATE_TIME,
+        FILE_NAME,
+        LINE,
+    };
+    struct Op
+    {
+        OpType type;
+        // LITERAL 是 m_literals 里的偏移，DATE_TIME 是 m_dateFormats 的下标
+        uint32_t arg;
+        uint32_t len;
+    };
+
+    void addLiteral(const std::string &str);
+
 private:
     std::string m_pattern;
-    std::vector<FormatItem::ptr> m_items;
+    std::vector<Op> m_ops;
+    std::string m_literals;
+    std::vector<std::string> m_dateFormats;
     bool m_error = false;
 };
 
@@ -257,7 +451,8 @@ class Logger : public std::enable_shared_from_this<Logger>
 
 public:
     typedef std::shared_ptr<Logger> ptr;
-    typedef Mutex MutexType;
+    // 写日志只读 appender 列表，多个线程可以同时进 log
+    typedef RWMutex RWMutexType;
 
     Logger(const std::string &name = "root");
 
@@ -295,10 +490,13 @@ public:
 private:
     std::string m_name;                      // 日志名称
     LogLevel::Level m_level;                 // 日志级别
-    std::list<LogAppender::ptr> m_appenders; // 输出地集合
+    typedef std::vector<LogAppender::ptr> AppenderList;
+    // 输出地集合，写时复制：log 在锁里只拷一份指针，放锁以后再调 appender，
+    // appender 里让出协程（比如异步输出地等队列空位）不会带着 m_mutex 切走
+    std::shared_ptr<const AppenderList> m_appenders;
     LogFormatter::ptr m_formatter;
     Logger::ptr m_root;
-    MutexType m_mutex;
+    RWMutexType m_mutex;
 };
 
 class LoggerManager
@@ -334,22 +532,322 @@ public:
 private:
 }; // namespace sylar
 
-// 输出到文件的Appender
+/**
+ * @brief 输出到文件的Appender
+ * @details 文件一直开着追加写，写日志的路径上没有 open/close，攒一批再 write。文件被外部移走或删掉
+ *          （比如 logrotate）由后台线程每秒比一次 inode 发现，重新打开；也可以调 reopen、
+ *          ReopenAll，或者 InstallSighupHandler 之后发 SIGHUP。
+ *          设置了 max_size 或 rotate 时自己轮转：当前文件改名成 "文件名.时间戳"，再打开一个新的，
+ *          改名出来的文件交给后台线程压缩成 .gz，超过 max_files 个时删掉最老的
+ */
 class FileLogAppender : public LogAppender
 {
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
+
+    // 按时间轮转的周期
+    enum RotateInterval
+    {
+        NONE = 0,
+        HOURLY = 1,
+        DAILY = 2,
+    };
+    static const char *RotateIntervalToString(RotateInterval v);
+    // 不认识的返回 NONE
+    static RotateInterval RotateIntervalFromString(const std::string &str);
+
     FileLogAppender(const std::string &filename);
+    ~FileLogAppender();
     virtual void
     log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
     std::string toYamlString() override;
     // 重新打开文件，成功返回true
     bool reopen();
+    // 立即轮转一次，成功返回true
+    bool rotate();
+    /**
+     * @brief 检查文件有没有被外部移走、是否到了轮转的时候
+     * @details 后台线程每秒对所有 FileLogAppender 调一次，一般不需要自己调
+     */
+    void check();
+    // 把缓冲里的日志写到文件。平时攒够 64KB、FATAL 日志或者后台线程每 100ms 写一次
+    void flush();
+    // fork 前由后台线程的 pthread_atfork 回调调用：写出缓冲，拿着锁直到 fork 返回
+    void lockForFork();
+    // fork 返回后放锁，子进程里丢掉从父进程继承来的缓冲，免得同一条日志写两遍
+    void unlockAfterFork(bool child);
+
+    const std::string &getFilename() const
+    {
+        return m_filename;
+    }
+    // 当前文件超过这么多字节就轮转，0 表示不按大小轮转
+    void setMaxSize(uint64_t v)
+    {
+        m_maxSize = v;
+    }
+    uint64_t getMaxSize() const
+    {
+        return m_maxSize;
+    }
+    void setRotateInterval(RotateInterval v);
+    RotateInterval getRotateInterval() const
+    {
+        return m_interval;
+    }
+    // 最多保留几个轮转出来的文件，0 表示不删
+    void setMaxFiles(uint32_t v)
+    {
+        m_maxFiles = v;
+    }
+    uint32_t getMaxFiles() const
+    {
+        return m_maxFiles;
+    }
+    // 轮转出来的文件是否在后台压缩成 .gz
+    void setCompress(bool v)
+    {
+        m_compress = v;
+    }
+    bool getCompress() const
+    {
+        return m_compress;
+    }
+
+    // 所有 FileLogAppender 重新打开文件，给 logrotate 之类的外部轮转用
+    static void ReopenAll();
+    // 收到 SIGHUP 时让后台线程执行 ReopenAll
+    static void InstallSighupHandler();
+
+protected:
+    // 下面几个调用方持有 m_mutex
+    bool reopenLocked();
+    bool rotateLocked(time_t now);
+    // 再写 len 字节会超过 max_size 时先轮转
+    void prepareWriteLocked(size_t len);
+    void writeLocked(const char *data, size_t len);
+    void flushLocked();
+
+protected:
+    // toYamlString 里的 type
+    const char *m_typeName = "FileLogAppender";
+    // 成功打开文件的次数，子类靠它知道换了新文件
+    uint64_t m_openCount = 0;
+
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    // 还没 write 的日志
+    std::string m_writeBuf;
+    // 打开的文件的 dev/inode，和路径上现在的文件对不上说明被移走了
+    uint64_t m_dev = 0;
+    uint64_t m_ino = 0;
+    uint64_t m_size = 0;
+    uint64_t m_maxSize = 0;
+    RotateInterval m_interval = NONE;
+    // 当前文件所属周期的开始时间
+    time_t m_periodStart = 0;
+    uint32_t m_maxFiles = 0;
+    bool m_compress = true;
+};
+
+/**
+ * @brief 二进制格式输出到文件的Appender
+ * @details 不用 formatter，每条日志只写时间、级别、线程/协程 id、调用点 id 和消息原文。
+ *          调用点（文件名+行号）、线程名、logger 名第一次出现时写一条定义，之后只写 id，
+ *          每次打开新文件都从头再来，所以每个文件（包括轮转出来的）都能单独解码。
+ *          用 sylar_logcat 或 BinaryLogReader 还原成文本。轮转、压缩和 FileLogAppender 一样
+ */
+class BinaryLogAppender : public FileLogAppender
+{
+public:
+    typedef std::shared_ptr<BinaryLogAppender> ptr;
+
+    BinaryLogAppender(const std::string &filename);
+    virtual void
+    log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+
+private:
+    // 换了新文件时写文件头，清空已经定义过的 id
+    void startFileLocked();
+    // 返回 str 的 id，第一次出现时往 buf 里追加定义
+    uint32_t stringIdLocked(const std::string &str, std::string &buf);
+    uint32_t siteIdLocked(const char *file, int32_t line, std::string &buf);
+
+private:
+    uint64_t m_fileOpenCount = 0;
+    std::unordered_map<std::string, uint32_t> m_strings;
+    std::map<std::pair<const char *, int32_t>, uint32_t> m_sites;
+};
+
+/**
+ * @brief 读 BinaryLogAppender 写的文件
+ * @details 能直接读 .gz 压缩过的文件。读到的事件交给 LogFormatter 就能按任意 pattern 输出
+ */
+class BinaryLogReader : Noncopyable
+{
+public:
+    typedef std::shared_ptr<BinaryLogReader> ptr;
+
+    BinaryLogReader();
+    ~BinaryLogReader();
+
+    // 打开文件，"-" 表示标准输入
+    bool open(const std::string &path);
+    /**
+     * @brief 读下一条日志
+     * @details event 里的文件名指向 reader 内部，下次调用 next 之前有效
+     * @return 读到文件末尾或者格式不对返回 false，后者 isError 为 true。
+     *         最后一条只写了一半（还在写的文件）算正常结束
+     */
+    bool next(LogEvent &event);
+    bool isError() const
+    {
+        return m_error;
+    }
+
+private:
+    // 保证缓冲里至少有 n 个字节，不够了返回 false
+    bool fill(size_t n);
+    bool readByte(uint8_t &v);
+    bool readVarint(uint64_t &v);
+    bool readString(std::string &v);
+    bool readHeader();
+
+private:
+    // gzFile，头文件里不引 zlib.h
+    void *m_file = nullptr;
+    std::string m_buf;
+    size_t m_pos = 0;
+    bool m_error = false;
+    std::vector<std::string> m_strings;
+    std::vector<std::pair<std::string, int32_t>> m_sites;
+    std::unordered_map<std::string, std::shared_ptr<Logger>> m_loggers;
+};
+
+/**
+ * @brief 异步输出的Appender
+ * @details 调用线程只负责格式化，然后把整条日志拷进本线程自己的环形缓冲（单生产者单消费者，
+ *          无锁），后台线程把所有缓冲里的数据攒成一大块，一次 write 到文件或标准输出。
+ *          慢磁盘只会让缓冲变满，不会卡住业务协程；缓冲满了按 OverflowPolicy 处理。
+ *          同一个线程的日志保持顺序，不同线程之间按后台线程收集的顺序，不严格按时间。
+ *          FATAL 日志会等写出去再返回。文件被移走或删掉（比如 logrotate）由后台线程每秒
+ *          比一次 inode 发现，重新打开。
+ */
+class AsyncLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+    // 缓冲满了怎么办
+    enum OverflowPolicy
+    {
+        // 等后台线程腾出空间
+        BLOCK = 0,
+        // 直接丢掉
+        DROP = 1,
+        // 级别低于 dropLevel 的丢掉，其余的等
+        DROP_BELOW_LEVEL = 2,
+    };
+    static const char *OverflowPolicyToString(OverflowPolicy v);
+    // 不认识的返回 BLOCK
+    static OverflowPolicy OverflowPolicyFromString(const std::string &str);
+
+    /**
+     * @param[in] filename 追加写的文件，为空时写标准输出
+     * @param[in] buffer_size 每个线程的缓冲大小，向上取到 2 的幂
+     */
+    AsyncLogAppender(const std::string &filename = "", size_t buffer_size = 256 * 1024);
+    ~AsyncLogAppender();
+
+    virtual void
+    log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    void setOverflowPolicy(OverflowPolicy v)
+    {
+        m_policy = v;
+    }
+    OverflowPolicy getOverflowPolicy() const
+    {
+        return m_policy;
+    }
+    void setDropLevel(LogLevel::Level v)
+    {
+        m_dropLevel = v;
+    }
+    LogLevel::Level getDropLevel() const
+    {
+        return m_dropLevel;
+    }
+    size_t getBufferSize() const
+    {
+        return m_bufferSize;
+    }
+    const std::string &getFilename() const
+    {
+        return m_filename;
+    }
+
+    // 因为缓冲满了丢掉的日志条数
+    uint64_t getDroppedCount() const
+    {
+        return m_dropped;
+    }
+    // 后台线程调用 write 的次数
+    uint64_t getWriteCount() const
+    {
+        return m_writes;
+    }
+    // 等到调用之前本线程写入的日志都交给了 write 才返回
+    void flush();
+
+private:
+    struct Ring;
+    typedef std::shared_ptr<Ring> RingPtr;
+
+    // 本线程往这个 appender 写用的缓冲，第一次用时创建
+    Ring *getRing();
+    void push(LogLevel::Level level, const char *data, size_t len);
+    void run();
+    // 把所有缓冲里的数据取出来写掉，返回取到的字节数
+    size_t drain(std::string &batch);
+    void writeOut(std::string &batch);
+    // 文件路径指向的已经不是打开着的那个文件时重新打开
+    void checkFile();
+    void reopen();
+    // 所有 AsyncLogAppender 共用的 pthread_atfork 回调
+    static void OnForkPrepare();
+    static void OnForkParent();
+    static void OnForkChild();
 
 private:
+    const uint64_t m_id;
     std::string m_filename;
-    std::ofstream m_fileStream;
-    uint64_t m_lastTime = 0;
+    size_t m_bufferSize;
+    OverflowPolicy m_policy = BLOCK;
+    LogLevel::Level m_dropLevel = LogLevel::WARN;
+    int m_fd = -1;
+    // 打开着的文件，和路径 stat 出来的比较
+    uint64_t m_dev = 0;
+    uint64_t m_ino = 0;
+    uint64_t m_lastCheck = 0;
+
+    Mutex m_ringsMutex;
+    std::vector<RingPtr> m_rings;
+
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_writes{0};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_sleeping{false};
+    std::atomic<uint64_t> m_flushRequest{0};
+    uint64_t m_flushDone = 0;
+    std::mutex m_waitMutex;
+    // 后台线程空闲时等在这里
+    std::condition_variable m_wakeCond;
+    // flush 等在这里
+    std::condition_variable m_flushCond;
+    Thread::ptr m_thread;
 };
 
 } // namespace sylar
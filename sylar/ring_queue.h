@@ -0,0 +1,143 @@
+#ifndef __SYLAR_RING_QUEUE_H__
+#define __SYLAR_RING_QUEUE_H__
+
+#include "noncopyable.h"
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace sylar
+{
+
+/**
+ * @brief 连续内存上的环形双端队列（非线程安全）
+ *
+ * 容量是 2 的幂，满了才翻倍扩容，稳定运行后入队出队都不申请内存；
+ * 和 std::list 相比没有逐节点分配，和 std::deque 相比没有分块管理。
+ * 元素只需要可移动。
+ */
+template <class T> class RingQueue : Noncopyable
+{
+public:
+    explicit RingQueue(size_t capacity = 16)
+    {
+        size_t cap = 1;
+        while (cap < capacity)
+        {
+            cap <<= 1;
+        }
+        m_buf = Allocate(cap);
+        m_capacity = cap;
+    }
+
+    ~RingQueue()
+    {
+        clear();
+        ::operator delete(m_buf);
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    T &front()
+    {
+        return m_buf[m_head];
+    }
+
+    T &back()
+    {
+        return m_buf[index(m_size - 1)];
+    }
+
+    void push_back(T &&v)
+    {
+        if (m_size == m_capacity)
+        {
+            grow();
+        }
+        new (&m_buf[index(m_size)]) T(std::move(v));
+        ++m_size;
+    }
+
+    void push_front(T &&v)
+    {
+        if (m_size == m_capacity)
+        {
+            grow();
+        }
+        m_head = (m_head + m_capacity - 1) & (m_capacity - 1);
+        new (&m_buf[m_head]) T(std::move(v));
+        ++m_size;
+    }
+
+    void pop_front()
+    {
+        m_buf[m_head].~T();
+        m_head = (m_head + 1) & (m_capacity - 1);
+        --m_size;
+    }
+
+    void pop_back()
+    {
+        m_buf[index(m_size - 1)].~T();
+        --m_size;
+    }
+
+    void clear()
+    {
+        while (m_size)
+        {
+            pop_front();
+        }
+        m_head = 0;
+    }
+
+private:
+    static T *Allocate(size_t cap)
+    {
+        return static_cast<T *>(::operator new(cap * sizeof(T)));
+    }
+
+    size_t index(size_t i) const
+    {
+        return (m_head + i) & (m_capacity - 1);
+    }
+
+    void grow()
+    {
+        size_t cap = m_capacity << 1;
+        T *buf = Allocate(cap);
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            T &v = m_buf[index(i)];
+            new (&buf[i]) T(std::move(v));
+            v.~T();
+        }
+        ::operator delete(m_buf);
+        m_buf = buf;
+        m_capacity = cap;
+        m_head = 0;
+    }
+
+private:
+    T *m_buf = nullptr;
+    size_t m_capacity = 0;
+    size_t m_head = 0;
+    size_t m_size = 0;
+};
+
+} // namespace sylar
+
+#endif
@@ -6,6 +6,7 @@
 #include "sylar/fiber.h"
 #include "sylar/hook.h"
 #include "thread.h"
+#include "util.h"
 #include <cstddef>
 #include <functional>
 namespace sylar
@@ -21,6 +22,9 @@ static thread_local Scheduler *t_scheduler = nullptr;
 //之所以要存，是因为可以理解为任务队列里的协程随用随释放，根本不用回去
 // static thread_local Fiber *t_fiber = nullptr;
 static thread_local Fiber *t_scheduler_fiber = nullptr;
+//当前线程认领的本地队列在所属调度器m_queues里的下标
+static thread_local Scheduler *t_queue_owner = nullptr;
+static thread_local size_t t_queue_index = 0;
 
 void Scheduler::setThis()
 {
@@ -39,8 +43,7 @@ Fiber *Scheduler::GetMainFiber()
 
 bool Scheduler::stopping()
 {
-    MutexType::Lock lock(m_mutex);
-    return m_autoStop && m_stopping && m_fibers.empty() && m_activeThreadCount == 0;
+    return m_autoStop && m_stopping && m_taskCount == 0 && m_activeThreadCount == 0;
 }
 
 //需要子类去自己实现逻辑
@@ -93,6 +96,12 @@ Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name) :
     }
     //需要创建的线程数量
     m_threadCount = threads;
+    //每个会执行run()的线程一个本地队列
+    size_t queue_count = threads + (use_caller ? 1 : 0);
+    for (size_t i = 0; i < queue_count; ++i)
+    {
+        m_queues.emplace_back(new WorkQueue);
+    }
 }
 
 Scheduler::~Scheduler()
@@ -207,6 +216,226 @@ void Scheduler::stop()
     {
         i->join();
     }
+    //线程都退出了，放开队列的认领，下次 start 的新线程重新认领
+    MutexType::Lock lock(m_mutex);
+    m_registeredQueues = 0;
+    for (auto &i : m_queues)
+    {
+        i->thread = -1;
+    }
+}
+
+Scheduler::WorkQueue *Scheduler::findQueue(int thread)
+{
+    for (auto &i : m_queues)
+    {
+        if (i->thread == thread)
+        {
+            return i.get();
+        }
+    }
+    return nullptr;
+}
+
+bool Scheduler::enqueue(FiberAndThread &ft)
+{
+    WorkQueue *queue = nullptr;
+    if (t_queue_owner == this &&
+        (ft.thread == -1 || ft.thread == m_queues[t_queue_index]->thread))
+    {
+        //调度线程自己提交的任务直接进本地队列，不碰全局锁
+        queue = m_queues[t_queue_index].get();
+    }
+    else if (ft.thread != -1)
+    {
+        queue = findQueue(ft.thread);
+        if (!queue)
+        {
+            //认领队列在m_mutex下进行，加锁后再查一次，保证任务不会落在没人收的地方
+            MutexType::Lock lock(m_mutex);
+            queue = findQueue(ft.thread);
+            if (!queue)
+            {
+                m_pendingPinned.push_back(std::move(ft));
+                ++m_taskCount;
+                return hasIdleThreads();
+            }
+        }
+    }
+    else
+    {
+        MutexType::Lock lock(m_mutex);
+        m_fibers.push_back(std::move(ft));
+        ++m_globalSize;
+        ++m_taskCount;
+        return hasIdleThreads();
+    }
+
+    {
+        MutexType::Lock lock(queue->mutex);
+        if (ft.thread == -1)
+        {
+            queue->tasks.push_back(std::move(ft));
+            ++queue->taskSize;
+        }
+        else
+        {
+            queue->pinned.push_back(std::move(ft));
+            ++queue->pinnedSize;
+        }
+        ++m_taskCount;
+    }
+    //m_taskCount和m_idleThreadCount都是顺序一致的原子变量，
+    //和run()里先登记空闲再检查队列配合，不会出现任务入队了却没人被唤醒
+    return hasIdleThreads();
+}
+
+Scheduler::WorkQueue *Scheduler::registerQueue()
+{
+    MutexType::Lock lock(m_mutex);
+    SYLAR_ASSERT2(m_registeredQueues < m_queues.size(), "调度线程数超过本地队列数");
+    size_t index = m_registeredQueues++;
+    WorkQueue *queue = m_queues[index].get();
+    int thread = sylar::GetThreadId();
+
+    MutexType::Lock queue_lock(queue->mutex);
+    queue->thread = thread;
+    for (auto it = m_pendingPinned.begin(); it != m_pendingPinned.end();)
+    {
+        if (it->thread == thread)
+        {
+            queue->pinned.push_back(std::move(*it));
+            ++queue->pinnedSize;
+            m_pendingPinned.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    t_queue_owner = this;
+    t_queue_index = index;
+    return queue;
+}
+
+bool Scheduler::popTask(WorkQueue *queue, FiberAndThread &ft)
+{
+    if (queue->pinnedSize || queue->taskSize)
+    {
+        MutexType::Lock lock(queue->mutex);
+        RingQueue<FiberAndThread> *tasks = nullptr;
+        if (!queue->pinned.empty())
+        {
+            tasks = &queue->pinned;
+            --queue->pinnedSize;
+        }
+        else if (!queue->tasks.empty())
+        {
+            tasks = &queue->tasks;
+            --queue->taskSize;
+        }
+        if (tasks)
+        {
+            ft = std::move(tasks->front());
+            tasks->pop_front();
+            //先记为活跃再减任务数，stopping()不会在两者之间看到「没任务也没人在跑」
+            ++m_activeThreadCount;
+            --m_taskCount;
+            return true;
+        }
+    }
+    if (m_globalSize)
+    {
+        MutexType::Lock lock(m_mutex);
+        if (!m_fibers.empty())
+        {
+            ft = std::move(m_fibers.front());
+            m_fibers.pop_front();
+            --m_globalSize;
+            ++m_activeThreadCount;
+            --m_taskCount;
+            return true;
+        }
+    }
+    return stealTask(queue, ft);
+}
+
+bool Scheduler::stealTask(WorkQueue *queue, FiberAndThread &ft)
+{
+    //偷来的任务先倒进这里再放进自己的队列，避免同时持有两个队列的锁；线程内复用，不反复申请内存
+    static thread_local RingQueue<FiberAndThread> s_stolen;
+    size_t count = m_queues.size();
+    for (size_t i = 1; i < count; ++i)
+    {
+        WorkQueue *victim = m_queues[(t_queue_index + i) % count].get();
+        if (victim->taskSize == 0)
+        {
+            continue;
+        }
+        {
+            MutexType::Lock lock(victim->mutex);
+            //从队尾拿走一半，victim自己继续从队头按顺序执行
+            size_t n = (victim->tasks.size() + 1) / 2;
+            for (size_t k = 0; k < n; ++k)
+            {
+                s_stolen.push_back(std::move(victim->tasks.back()));
+                victim->tasks.pop_back();
+            }
+            victim->taskSize -= n;
+            if (n)
+            {
+                ++m_activeThreadCount;
+                --m_taskCount;
+            }
+        }
+        if (s_stolen.empty())
+        {
+            continue;
+        }
+        //s_stolen里是倒序的，最后一个是其中最早入队的
+        ft = std::move(s_stolen.back());
+        s_stolen.pop_back();
+        if (!s_stolen.empty())
+        {
+            MutexType::Lock lock(queue->mutex);
+            queue->taskSize += s_stolen.size();
+            while (!s_stolen.empty())
+            {
+                queue->tasks.push_back(std::move(s_stolen.back()));
+                s_stolen.pop_back();
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Scheduler::hasRunnableTask(WorkQueue *queue)
+{
+    if (queue->pinnedSize || queue->taskSize || m_globalSize)
+    {
+        return true;
+    }
+    for (auto &i : m_queues)
+    {
+        if (i->taskSize)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scheduler::hasStrandedPinnedTask(WorkQueue *queue)
+{
+    for (auto &i : m_queues)
+    {
+        if (i.get() != queue && i->idle && i->pinnedSize)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Scheduler::run()
@@ -215,11 +444,14 @@ void Scheduler::run()
     set_hook_enable(true);
     // 1、设置当前线程的调度器
     setThis();
-    // 2、设置好当前运行线程的协程
+    // 2、设置好当前运行的线程的协程
     if (sylar::GetThreadId() != m_rootThread)
     {
         t_scheduler_fiber = Fiber::GetThis().get();
     }
+    WorkQueue *queue = registerQueue();
+    //调度线程上的 CoarseNowMs/CoarseMonoMs 改读缓存
+    RefreshCoarseClock();
     // 3、线程生命周期结束前，始终去查看是否有任务并消费
     // 用来存放当前线程所需要执行的协程或回调函数
     FiberAndThread ft;
@@ -230,65 +462,50 @@ void Scheduler::run()
     while (true)
     {
         ft.reset();
-        // 3.1
-        // 因为可以指定某个协程的任务由某个线程去执行，所以需要当前运行的线程找到自己能运行的任务
-        bool tickle_me = false;
-        bool is_active = false;
+        // 3.1 指定了线程的任务已经直接放进了那个线程的本地队列，这里取任务不需要再遍历挑选
+        bool is_active = popTask(queue, ft);
+        if (is_active)
         {
-            MutexType::Lock lock(m_mutex);
-            auto it = m_fibers.begin();
-            while (it != m_fibers.end())
+            SYLAR_ASSERT2(ft.fiber || ft.cb, "任务队列里面的一个任务没有fiber也没有cb");
+            //协程还在别的线程上执行（刚把自己重新调度还没切出去），放回去稍后再取
+            if (ft.fiber && ft.fiber->getState() == Fiber::EXEC)
             {
-                //先是判断进程什么时候不能执行的某个任务
-                if (it->thread != -1 && it->thread != sylar::GetThreadId())
-                {
-                    it++;
-                    tickle_me = true;
-                    continue;
-                }
-                SYLAR_ASSERT2(it->fiber || it->cb, "m_fibers里面的一个fiber没有任务");
-                //然后是协程什么时候不能执行某个任务(已经在执行中了，就不能再执行)
-                //因为有可能没有指定运行的线程，需要避免竞争
-                // if (ft.fiber && ft.fiber->getState() == Fiber::EXEC)如果写成这样的话，是错的
-                //因为  ft
-                //还没有东西，永远为flase，那么就不会执行continue，就会往后走，触发tickle函数
-                if (it->fiber && it->fiber->getState() == Fiber::EXEC)
-                {
-                    it++;
-                    continue;
-                }
-
-                ft = *it;
-                m_fibers.erase(it++);
-                ++m_activeThreadCount;
-                is_active = true;
-                break;
+                --m_activeThreadCount;
+                enqueue(ft);
+                continue;
+            }
+            //还有剩余任务，叫醒空闲线程来偷
+            if (m_taskCount && hasIdleThreads())
+            {
+                tickle();
             }
-            tickle_me |= it != m_fibers.end();
         }
 
-        if (tickle_me)
-        {
-            tickle();
-        }
         // 3.2 可以运行的任务形势为Fiber或者回调函数
         // 3.2.1 如果m_fibers里面的FiberAndThread存的是一个Fiber
         if (ft.fiber &&
             (ft.fiber->getState() != Fiber::TERM && ft.fiber->getState() != Fiber::EXCEPT))
         {
             // m_activeThreadCount++;
+            //每个任务切入前刷新缓存时钟，任务里读到的时间最多落后它自己的运行时间
+            RefreshCoarseClock(false);
             ft.fiber->swapIn();
             m_activeThreadCount--;
             //如果回来以后还是ready，说明是子类的阻塞任务已经完成，需要的数据已经准备好了，就重新加到任务队列里
             if (ft.fiber->getState() == Fiber::READY)
             {
-                schedule(ft.fiber);
+                schedule(std::move(ft.fiber));
             }
             // 如果任务被阻塞了，就直接给它挂起
             else if (ft.fiber->getState() != Fiber::TERM && ft.fiber->getState() != Fiber::EXCEPT)
             {
                 ft.fiber->m_state = Fiber::HOLD;
             }
+            // 执行结束且没有人再持有的协程（通常是之前挂起过的回调协程）放回协程池
+            else
+            {
+                Fiber::Recycle(std::move(ft.fiber));
+            }
             ft.reset();
         }
         // 3.2.2 如果m_fibers里面的FiberAndThread存的是一个Fiber else if ()
@@ -297,23 +514,23 @@ void Scheduler::run()
             // 如果cb_fiber还没有释放资源，又来拿到一个任务，就可以继续去执行这一个任务
             if (cb_fiber)
             {
-                cb_fiber->reset(ft.cb);
+                cb_fiber->reset(std::move(ft.cb));
             }
-            //如果cb_fiber才刚来，那么就给他设置一个协程
+            //如果cb_fiber才刚来，那么就从协程池里拿一个，池里没有才新建
             else
             {
-                cb_fiber.reset(new Fiber(ft.cb));
+                cb_fiber = Fiber::Create(std::move(ft.cb));
             }
             //后面的执行都是用cb_fiber，比较ft里面只有一个回调，什么都做不了
             ft.reset();
             // m_activeThreadCount++;
+            RefreshCoarseClock(false);
             cb_fiber->swapIn();
             m_activeThreadCount--;
 
             if (cb_fiber->getState() == Fiber::READY)
             {
-                schedule(cb_fiber);
-                cb_fiber.reset();
+                schedule(std::move(cb_fiber));
             }
             else if (cb_fiber->getState() == Fiber::EXCEPT || cb_fiber->getState() == Fiber::TERM)
             {
@@ -337,10 +554,27 @@ void Scheduler::run()
             if (idle_fiber->getState() == Fiber::TERM)
             {
                 SYLAR_LOG_INFO(g_logger) << "idle fiber term";
+                //stop()发出tickle时其他线程可能还在忙，没被叫醒，这里接力叫醒下一个空闲线程退出
+                tickle();
                 break;
             }
+            //先登记空闲再检查一次队列，和enqueue里先入队再看空闲数配合，避免漏掉唤醒
             ++m_idleThreadCount;
+            if (hasRunnableTask(queue))
+            {
+                --m_idleThreadCount;
+                continue;
+            }
+            //被叫醒的不是任务指定的线程时接力唤醒，等待最久的空闲线程会先被叫醒，几轮之内就能轮到它
+            if (hasStrandedPinnedTask(queue))
+            {
+                tickle();
+            }
+            queue->idle = true;
+            //idle 要用它计算下一个定时器的等待时间
+            RefreshCoarseClock(false);
             idle_fiber->swapIn();
+            queue->idle = false;
             --m_idleThreadCount;
             if (idle_fiber->getState() != Fiber::TERM && idle_fiber->getState() != Fiber::EXCEPT)
             {
@@ -348,6 +582,9 @@ void Scheduler::run()
             }
         }
     }
+    //调度器对象可能被销毁后在同一地址上重建，不能留着旧的认领关系
+    t_queue_owner = nullptr;
+    DisableCoarseClock();
 }
 
 /**
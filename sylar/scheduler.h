@@ -1,11 +1,15 @@
 #ifndef __SYLAR_SCHEDULER_H__
 #define __SYLAR_SCHEDULER_H__
 #include "fiber.h"
+#include "ring_queue.h"
+#include "task.h"
 #include "thread.h"
+#include <atomic>
 #include <cstddef>
 #include <functional>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <vector>
 
 namespace sylar
@@ -23,16 +27,11 @@ public:
     }
     //协程调度方法，传入一个协程指针，或者一个回调函数，指定由哪一个线程去执行
     //-1 表示 “任意空闲线程”；
-    //单个任务调度
+    //单个任务调度，右值的协程指针和回调会被移动进队列，不增加引用计数也不拷贝
     template <class FiberOrCb>
-    void schedule(FiberOrCb fc, int thread = -1)
+    void schedule(FiberOrCb &&fc, int thread = -1)
     {
-        bool need_tickle = false;
-        {
-            MutexType::Lock lock(m_mutex);
-            need_tickle = scheduleNoLock(fc, thread);
-        }
-        if (need_tickle)
+        if (scheduleNoLock(std::forward<FiberOrCb>(fc), thread))
         {
             tickle();
         }
@@ -43,13 +42,10 @@ public:
     void schedule(InputIterator begin, InputIterator end, int thread = -1)
     {
         bool need_tickle = false;
+        while (begin != end)
         {
-            MutexType::Lock lock(m_mutex);
-            while (begin != end)
-            {
-                need_tickle = scheduleNoLock(*begin, thread) || need_tickle;
-                begin++;
-            }
+            need_tickle = scheduleNoLock(*begin, thread) || need_tickle;
+            begin++;
         }
         if (need_tickle)
         {
@@ -100,14 +96,14 @@ protected:
     std::atomic<size_t> m_idleThreadCount = {0};
 
 private:
-    //用于绑定
+    //用于绑定，只能移动，入队出队不拷贝回调也不动引用计数
     struct FiberAndThread
     {
         Fiber::ptr fiber;
-        std::function<void()> cb;
+        Task cb;
         int thread;
 
-        FiberAndThread(Fiber::ptr f, int thr) : fiber(f), thread(thr)
+        FiberAndThread(Fiber::ptr f, int thr) : fiber(std::move(f)), thread(thr)
         {
         }
 
@@ -118,17 +114,23 @@ private:
             fiber.swap(*f);
         }
 
-        FiberAndThread(std::function<void()> f, int thr) : cb(f), thread(thr)
+        FiberAndThread(std::function<void()> *f, int thr) : cb(std::move(*f)), thread(thr)
         {
+            *f = nullptr;
         }
 
-        FiberAndThread(std::function<void()> *f, int thr) : thread(thr)
+        //lambda、函数指针、std::function等回调，小对象直接存放在Task内部
+        template <class F>
+        FiberAndThread(F &&f, int thr) : cb(std::forward<F>(f)), thread(thr)
         {
-            cb.swap(*f);
         }
+
         FiberAndThread() : thread(-1)
         {
         }
+        FiberAndThread(FiberAndThread &&) = default;
+        FiberAndThread &operator=(FiberAndThread &&) = default;
+
         void reset()
         {
             fiber = nullptr;
@@ -137,28 +139,66 @@ private:
         }
     };
 
+    //每个调度线程一个本地队列，run()启动时按顺序认领
+    struct WorkQueue
+    {
+        MutexType mutex;
+        //没有指定线程的任务，空闲线程可以从队尾偷走
+        RingQueue<FiberAndThread> tasks;
+        //指定由本线程执行的任务，不参与窃取
+        RingQueue<FiberAndThread> pinned;
+        //两个队列的长度，不加锁判断队列是否为空时用
+        std::atomic<size_t> taskSize{0};
+        std::atomic<size_t> pinnedSize{0};
+        //认领这个队列的线程id，-1表示还没有线程认领
+        std::atomic<int> thread{-1};
+        //线程正在idle()里等待
+        std::atomic<bool> idle{false};
+    };
+
 private:
+    // 把任务放进对应的队列，队列各自加锁，返回是否需要tickle
     template <class FiberOrCb>
-
-    // 把任务放进要管理的vector里
-    bool scheduleNoLock(FiberOrCb fc, int thread)
+    bool scheduleNoLock(FiberOrCb &&fc, int thread)
     {
-        bool need_tickle = m_fibers.empty();
-        FiberAndThread ft(fc, thread);
-        if (ft.fiber || ft.cb)
+        FiberAndThread ft(std::forward<FiberOrCb>(fc), thread);
+        if (!ft.fiber && !ft.cb)
         {
-            m_fibers.push_back(ft);
+            return false;
         }
-        return need_tickle;
+        // 共享栈协程的栈内容只能恢复到原来那个线程的共享栈上
+        if (ft.fiber && ft.thread == -1 && ft.fiber->m_boundThread != -1)
+        {
+            ft.thread = ft.fiber->m_boundThread;
+        }
+        return enqueue(ft);
     }
 
+    bool enqueue(FiberAndThread &ft);
+    WorkQueue *findQueue(int thread);
+    //当前线程认领一个本地队列，并把之前发给本线程的任务收进来
+    WorkQueue *registerQueue();
+    //依次从本地队列、全局队列取任务，都没有时去别的线程偷
+    bool popTask(WorkQueue *queue, FiberAndThread &ft);
+    bool stealTask(WorkQueue *queue, FiberAndThread &ft);
+    bool hasRunnableTask(WorkQueue *queue);
+    //有指定给某个空闲线程的任务，但它没被唤醒（tickle只会叫醒任意一个空闲线程）
+    bool hasStrandedPinnedTask(WorkQueue *queue);
+
 private:
     MutexType m_mutex;
     std::string m_name;
     //存放可以运行的线程
     std::vector<Thread::ptr> m_threads;
-    //存放的是协程以及它对应的线程id
-    std::list<FiberAndThread> m_fibers;
+    //全局注入队列：非调度线程提交的、没有指定线程的任务
+    RingQueue<FiberAndThread> m_fibers;
+    std::atomic<size_t> m_globalSize{0};
+    //指定的线程还没有认领本地队列时，任务先放在这里
+    std::list<FiberAndThread> m_pendingPinned;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    size_t m_registeredQueues = 0;
+    //所有队列里还没被取走的任务总数
+    std::atomic<size_t> m_taskCount{0};
     //存放调度器线程的主协程
     Fiber::ptr m_rootFiber;
 };
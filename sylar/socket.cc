@@ -4,10 +4,12 @@
 #include "iomanager.h"
 #include "log.h"
 #include "macro.h"
+#include <algorithm>
 #include <cstddef>
 #include <limits.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -135,22 +137,59 @@ bool Socket::setOption(int level, int option, const void *result, socklen_t len)
 
 Socket::ptr Socket::accept()
 {
-    Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
-    int newsock = ::accept(m_sock, nullptr, nullptr);
+    int newsock = ::accept4(m_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (newsock == -1)
     {
         SYLAR_LOG_ERROR(g_logger) << "accept(" << m_sock << ") errno=" << errno
                                   << " errstr=" << strerror(errno);
         return nullptr;
     }
-    if (sock->init(newsock))
+    return wrapAccepted(newsock);
+}
+
+Socket::ptr Socket::tryAccept()
+{
+    //绕过 hook 直接调原始的 accept4，监听 socket 是非阻塞的，没有连接时不会让出协程
+    int newsock = accept4_f(m_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (newsock == -1)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            SYLAR_LOG_ERROR(g_logger) << "accept(" << m_sock << ") errno=" << errno
+                                      << " errstr=" << strerror(errno);
+        }
+        return nullptr;
+    }
+    FdMgr::GetInstance()->addSocket(newsock);
+    return wrapAccepted(newsock);
+}
+
+Socket::ptr Socket::wrapAccepted(int sock)
+{
+    Socket::ptr rt(new Socket(m_family, m_type, m_protocol));
+    if (rt->init(sock))
     {
         //对象socket连接的一个socket，封装后返回的
-        return sock;
+        return rt;
     }
+    ::close(sock);
     return nullptr;
 }
 
+bool Socket::setReusePort(bool v)
+{
+    if (!isValid())
+    {
+        newSock();
+        if (SYLAR_UNLIKELY(!isValid()))
+        {
+            return false;
+        }
+    }
+    int val = v ? 1 : 0;
+    return setOption(SOL_SOCKET, SO_REUSEPORT, val);
+}
+
 bool Socket::bind(const Address::ptr addr)
 {
     if (!isValid())
@@ -286,6 +325,16 @@ int Socket::send(const iovec *buffer, size_t len, int flags)
     return -1;
 }
 
+int Socket::sendFile(int fd, off_t *offset, size_t count)
+{
+    if (isConnected())
+    {
+        //一次最多发 INT_MAX，返回值才放得进 int
+        return ::sendfile(m_sock, fd, offset, std::min(count, (size_t)INT_MAX));
+    }
+    return -1;
+}
+
 int Socket::sendTo(const void *buffer, size_t len, const Address::ptr to, int flags)
 {
     if (isConnected())
@@ -492,9 +541,12 @@ bool Socket::init(int sock)
     {
         m_sock = sock;
         m_isConnected = true;
-        initSock();
-        getLocalAddress();
-        getRemoteAddress();
+        //已经连上的 socket 用不着 SO_REUSEADDR；两端地址等第一次用到时再取
+        if (m_type == SOCK_STREAM)
+        {
+            int val = 1;
+            setOption(IPPROTO_TCP, TCP_NODELAY, val);
+        }
         return true;
     }
     return false;
@@ -546,24 +598,6 @@ SSLSocket::SSLSocket(int family, int type, int protocol) : Socket(family, type,
 {
 }
 
-Socket::ptr SSLSocket::accept()
-{
-    SSLSocket::ptr sock(new SSLSocket(m_family, m_type, m_protocol));
-    int newsock = ::accept(m_sock, nullptr, nullptr);
-    if (newsock == -1)
-    {
-        SYLAR_LOG_ERROR(g_logger) << "accept(" << m_sock << ") errno=" << errno
-                                  << " errstr=" << strerror(errno);
-        return nullptr;
-    }
-    sock->m_ctx = m_ctx;
-    if (sock->init(newsock))
-    {
-        return sock;
-    }
-    return nullptr;
-}
-
 bool SSLSocket::bind(const Address::ptr addr)
 {
     return Socket::bind(addr);
@@ -732,6 +766,26 @@ int SSLSocket::send(const iovec *buffers, size_t length, int flags)
     return total;
 }
 
+int SSLSocket::sendFile(int fd, off_t *offset, size_t count)
+{
+    if (!m_ssl)
+    {
+        return -1;
+    }
+    char buf[16 * 1024];
+    ssize_t n = pread(fd, buf, std::min(count, sizeof(buf)), *offset);
+    if (n <= 0)
+    {
+        return n;
+    }
+    int rt = SSL_write(m_ssl.get(), buf, n);
+    if (rt > 0)
+    {
+        *offset += rt;
+    }
+    return rt;
+}
+
 int SSLSocket::sendTo(const void *buffer, size_t length, const Address::ptr to, int flags)
 {
     SYLAR_ASSERT(false);
@@ -788,6 +842,22 @@ int SSLSocket::recvFrom(iovec *buffers, size_t length, Address::ptr from, int fl
     return -1;
 }
 
+Socket::ptr SSLSocket::wrapAccepted(int sock)
+{
+    SSLSocket::ptr rt(new SSLSocket(m_family, m_type, m_protocol));
+    rt->m_ctx = m_ctx;
+    if (rt->init(sock))
+    {
+        return rt;
+    }
+    //握手失败时 fd 已经交给了 rt，由它析构时关闭
+    if (rt->getSocket() == -1)
+    {
+        ::close(sock);
+    }
+    return nullptr;
+}
+
 bool SSLSocket::init(int sock)
 {
     bool v = Socket::init(sock);
@@ -66,7 +66,13 @@ public:
         return setOption(level, option, &value, sizeof(T));
     }
 
-    virtual Socket::ptr accept();
+    // 设置 SO_REUSEPORT，要在 bind 之前调用；fd 还没创建时会先创建
+    bool setReusePort(bool v = true);
+
+    // 等到有新连接为止
+    Socket::ptr accept();
+    // 不等待，backlog 里没有已经完成握手的连接时返回 nullptr，errno 为 EAGAIN
+    Socket::ptr tryAccept();
 
     virtual bool bind(const Address::ptr addr);
     virtual bool connect(const Address::ptr addr, uint64_t timeout_ms = -1);
@@ -77,6 +83,12 @@ public:
     // TCP
     virtual int send(const void *buffer, size_t len, int flags = 0);
     virtual int send(const iovec *buffer, size_t len, int flags = 0);
+    /**
+     * @brief 把文件 fd 从 *offset 开始的最多 count 字节直接发出去，数据不经过用户态
+     * @details 成功后 *offset 前移实际发出的字节数
+     * @return 发出的字节数，<=0 出错
+     */
+    virtual int sendFile(int fd, off_t *offset, size_t count);
     // UDP,因为UDP是无连接的，所以接法消息得带一个地址
     virtual int sendTo(const void *buffer, size_t len, const Address::ptr to, int flags = 0);
     virtual int sendTo(const iovec *buffer, size_t len, const Address::ptr to, int flags = 0);
@@ -124,6 +136,8 @@ public:
 
 protected:
     virtual bool init(int sock);
+    // 把 accept 拿到的 fd 包装成和监听 socket 同类型的对象，失败时关掉 fd
+    virtual Socket::ptr wrapAccepted(int sock);
     void newSock();
     void initSock();
 
@@ -156,13 +170,14 @@ public:
     static SSLSocket::ptr CreateTCPSocket6();
 
     SSLSocket(int family, int type, int protocol = 0);
-    virtual Socket::ptr accept() override;
     virtual bool bind(const Address::ptr addr) override;
     virtual bool connect(const Address::ptr addr, uint64_t timeout_ms = -1) override;
     virtual bool listen(int backlog = SOMAXCONN) override;
     virtual bool close() override;
     virtual int send(const void *buffer, size_t length, int flags = 0) override;
     virtual int send(const iovec *buffers, size_t length, int flags = 0) override;
+    // 要经过 SSL 加密，只能先读到用户态再写
+    virtual int sendFile(int fd, off_t *offset, size_t count) override;
     virtual int
     sendTo(const void *buffer, size_t length, const Address::ptr to, int flags = 0) override;
     virtual int
@@ -185,6 +200,7 @@ public:
 
 protected:
     virtual bool init(int sock) override;
+    virtual Socket::ptr wrapAccepted(int sock) override;
 
 private:
     std::shared_ptr<SSL_CTX> m_ctx;
@@ -70,6 +70,72 @@ int SocketStream::write(ByteArray::ptr ba, size_t length)
     return rt;
 }
 
+int SocketStream::writev(const iovec *iov, size_t count)
+{
+    if (!isConnected())
+    {
+        return -1;
+    }
+    return m_socket->send(iov, count);
+}
+
+int SocketStream::writevFixSize(iovec *iov, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        total += iov[i].iov_len;
+    }
+    size_t left = total;
+    AdvanceIovec(iov, count, 0);
+    while (left > 0)
+    {
+        int len = writev(iov, count);
+        if (len <= 0)
+        {
+            return len;
+        }
+        left -= len;
+        AdvanceIovec(iov, count, len);
+    }
+    return total;
+}
+
+void SocketStream::AdvanceIovec(iovec *&iov, size_t &count, size_t n)
+{
+    //跳过写完的和本来就是空的段
+    while (count > 0 && n >= iov->iov_len)
+    {
+        n -= iov->iov_len;
+        ++iov;
+        --count;
+    }
+    if (count > 0)
+    {
+        iov->iov_base = (char *)iov->iov_base + n;
+        iov->iov_len -= n;
+    }
+}
+
+int64_t SocketStream::sendFileFixSize(int fd, off_t offset, uint64_t length)
+{
+    uint64_t left = length;
+    while (left > 0)
+    {
+        if (!isConnected())
+        {
+            return -1;
+        }
+        int len = m_socket->sendFile(fd, &offset, left);
+        if (len <= 0)
+        {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
+
 void SocketStream::close()
 {
     if (m_socket)
@@ -20,6 +20,25 @@ public:
     virtual int write(ByteArray::ptr ba, size_t length) override;
     virtual void close() override;
 
+    /**
+     * @brief 把多段缓冲一次交给 socket（sendmsg），不先拼成一整块
+     * @return 实际写出的字节数，<=0 出错
+     */
+    int writev(const iovec *iov, size_t count);
+    /**
+     * @brief 写完所有 iovec 为止，iov 会被就地修改
+     * @return 写出的总字节数，<=0 出错
+     */
+    int writevFixSize(iovec *iov, size_t count);
+    /// 跳过已经写出的 n 个字节，iov/count 指向剩下的部分
+    static void AdvanceIovec(iovec *&iov, size_t &count, size_t n);
+
+    /**
+     * @brief 用 sendfile 把文件 fd 的 [offset, offset + length) 全部发出去
+     * @return 发出的总字节数，<=0 出错
+     */
+    int64_t sendFileFixSize(int fd, off_t offset, uint64_t length);
+
     Socket::ptr getSocket() const
     {
         return m_socket;
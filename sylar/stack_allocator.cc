@@ -0,0 +1,305 @@
+#include "stack_allocator.h"
+#include "config.h"
+#include "log.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sylar
+{
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<std::vector<uint32_t>>::ptr g_stack_size_classes =
+    Config::Lookup("fiber.stack_pool.size_classes",
+                   std::vector<uint32_t>{64 * 1024, 256 * 1024, 1024 * 1024},
+                   "fiber stack size classes");
+static ConfigVar<uint32_t>::ptr g_stack_max_cached = Config::Lookup<uint32_t>(
+    "fiber.stack_pool.max_cached", 64, "max cached fiber stacks per thread per size class");
+static ConfigVar<uint32_t>::ptr g_stack_high_water = Config::Lookup<uint32_t>(
+    "fiber.stack_pool.high_water", 16, "cached stacks per class above which pages are released");
+static ConfigVarBase::ptr g_stack_stats = Config::AddStatus(
+    "fiber.stack_pool.stats",
+    []()
+    {
+        StackAllocatorStats stats = StackAllocator::GetStats();
+        YAML::Node node;
+        node["stacks_live"] = stats.stacks_live;
+        node["stacks_cached"] = stats.stacks_cached;
+        node["bytes_committed"] = stats.bytes_committed;
+        node["bytes_mapped"] = stats.bytes_mapped;
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    },
+    "fiber stack allocator stats, read-only");
+
+static const size_t kMaxSizeClasses = 8;
+
+// 热路径上不读 ConfigVar（要加读锁），改由监听器把配置同步到下面这些原子变量里
+static std::atomic<size_t> s_class_count{0};
+static std::atomic<size_t> s_classes[kMaxSizeClasses];
+static std::atomic<uint32_t> s_max_cached{64};
+static std::atomic<uint32_t> s_high_water{16};
+
+static std::atomic<uint64_t> s_stacks_live{0};
+static std::atomic<uint64_t> s_stacks_cached{0};
+static std::atomic<uint64_t> s_bytes_committed{0};
+static std::atomic<uint64_t> s_bytes_mapped{0};
+
+static size_t PageSize()
+{
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    return s_page_size;
+}
+
+static size_t AlignToPage(size_t size)
+{
+    size_t page = PageSize();
+    return (size + page - 1) / page * page;
+}
+
+static void UpdateSizeClasses(const std::vector<uint32_t> &value)
+{
+    std::vector<size_t> classes;
+    for (auto &i : value)
+    {
+        if (i)
+        {
+            classes.push_back(AlignToPage(i));
+        }
+    }
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+    if (classes.size() > kMaxSizeClasses)
+    {
+        SYLAR_LOG_WARN(g_logger) << "fiber.stack_pool.size_classes too many classes, keep first "
+                                 << kMaxSizeClasses;
+        classes.resize(kMaxSizeClasses);
+    }
+    // 先缩小档位数再改写内容，并发的 RoundSize 最多取到一个偏大的档位，不会比申请的小
+    s_class_count = 0;
+    for (size_t i = 0; i < classes.size(); ++i)
+    {
+        s_classes[i] = classes[i];
+    }
+    s_class_count = classes.size();
+}
+
+struct _StackAllocatorIniter
+{
+    _StackAllocatorIniter()
+    {
+        UpdateSizeClasses(g_stack_size_classes->getValue());
+        s_max_cached = g_stack_max_cached->getValue();
+        s_high_water = g_stack_high_water->getValue();
+        g_stack_size_classes->addListener(
+            [](const std::vector<uint32_t> &old_value, const std::vector<uint32_t> &new_value)
+            { UpdateSizeClasses(new_value); });
+        g_stack_max_cached->addListener([](const uint32_t &old_value, const uint32_t &new_value)
+                                        { s_max_cached = new_value; });
+        g_stack_high_water->addListener([](const uint32_t &old_value, const uint32_t &new_value)
+                                        { s_high_water = new_value; });
+    }
+};
+
+static _StackAllocatorIniter s_stack_allocator_initer;
+
+static void *MapStack(size_t size)
+{
+    size_t page = PageSize();
+    void *base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "mmap fiber stack size=" << size << " errno=" << errno
+                                  << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    // 栈向低地址增长，最低一页作为 guard page
+    if (mprotect(base, page, PROT_NONE))
+    {
+        SYLAR_LOG_ERROR(g_logger) << "mprotect fiber stack guard page errno=" << errno
+                                  << " errstr=" << strerror(errno);
+    }
+    s_bytes_mapped += size + page;
+    return (char *)base + page;
+}
+
+static void UnmapStack(void *vp, size_t size)
+{
+    size_t page = PageSize();
+    munmap((char *)vp - page, size + page);
+    s_bytes_mapped -= size + page;
+}
+
+static bool IsSizeClass(size_t size)
+{
+    size_t count = s_class_count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (s_classes[i] == size)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace
+{
+
+struct CachedStack
+{
+    void *ptr = nullptr;
+    // false 表示已经 madvise 过，物理页已经还给系统
+    bool dirty = true;
+};
+
+struct StackBucket
+{
+    size_t size = 0;
+    std::vector<CachedStack> stacks;
+};
+
+// 0 未创建，1 可用，2 线程退出时已析构（之后释放的栈直接 munmap）
+thread_local int t_cache_state = 0;
+
+class ThreadStackCache
+{
+public:
+    ThreadStackCache()
+    {
+        t_cache_state = 1;
+    }
+
+    ~ThreadStackCache()
+    {
+        t_cache_state = 2;
+        for (auto &bucket : m_buckets)
+        {
+            for (auto &i : bucket.stacks)
+            {
+                if (i.dirty)
+                {
+                    s_bytes_committed -= bucket.size;
+                }
+                --s_stacks_cached;
+                UnmapStack(i.ptr, bucket.size);
+            }
+        }
+    }
+
+    StackBucket *find(size_t size, bool create)
+    {
+        for (auto &i : m_buckets)
+        {
+            if (i.size == size)
+            {
+                return &i;
+            }
+        }
+        if (!create)
+        {
+            return nullptr;
+        }
+        m_buckets.push_back(StackBucket());
+        m_buckets.back().size = size;
+        return &m_buckets.back();
+    }
+
+private:
+    std::vector<StackBucket> m_buckets;
+};
+
+thread_local ThreadStackCache t_stack_cache;
+
+} // namespace
+
+size_t StackAllocator::RoundSize(size_t size)
+{
+    size_t count = s_class_count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t cls = s_classes[i];
+        if (cls >= size)
+        {
+            return cls;
+        }
+    }
+    return AlignToPage(size);
+}
+
+void *StackAllocator::Alloc(size_t size)
+{
+    size = RoundSize(size);
+    if (t_cache_state != 2)
+    {
+        StackBucket *bucket = t_stack_cache.find(size, false);
+        if (bucket && !bucket->stacks.empty())
+        {
+            CachedStack stack = bucket->stacks.back();
+            bucket->stacks.pop_back();
+            --s_stacks_cached;
+            if (!stack.dirty)
+            {
+                s_bytes_committed += size;
+            }
+            ++s_stacks_live;
+            return stack.ptr;
+        }
+    }
+    void *vp = MapStack(size);
+    if (vp)
+    {
+        ++s_stacks_live;
+        s_bytes_committed += size;
+    }
+    return vp;
+}
+
+void StackAllocator::Dealloc(void *vp, size_t size)
+{
+    if (!vp)
+    {
+        return;
+    }
+    --s_stacks_live;
+    if (t_cache_state != 2 && IsSizeClass(size))
+    {
+        StackBucket *bucket = t_stack_cache.find(size, true);
+        if (bucket->stacks.size() < s_max_cached)
+        {
+            CachedStack stack;
+            stack.ptr = vp;
+            if (bucket->stacks.size() >= s_high_water)
+            {
+                madvise(vp, size, MADV_DONTNEED);
+                stack.dirty = false;
+                s_bytes_committed -= size;
+            }
+            bucket->stacks.push_back(stack);
+            ++s_stacks_cached;
+            return;
+        }
+    }
+    s_bytes_committed -= size;
+    UnmapStack(vp, size);
+}
+
+StackAllocatorStats StackAllocator::GetStats()
+{
+    StackAllocatorStats stats;
+    stats.stacks_live = s_stacks_live;
+    stats.stacks_cached = s_stacks_cached;
+    stats.bytes_committed = s_bytes_committed;
+    stats.bytes_mapped = s_bytes_mapped;
+    return stats;
+}
+
+} // namespace sylar
@@ -0,0 +1,49 @@
+#ifndef __SYLAR_STACK_ALLOCATOR_H__
+#define __SYLAR_STACK_ALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sylar
+{
+
+/**
+ * @brief 协程栈分配统计
+ */
+struct StackAllocatorStats
+{
+    uint64_t stacks_live = 0;     // 正在被协程使用的栈
+    uint64_t stacks_cached = 0;   // 各线程空闲链表里缓存、还没归还给系统的栈
+    uint64_t bytes_committed = 0; // 按整栈估算的已提交内存：使用中 + 缓存里未 madvise 的栈
+    uint64_t bytes_mapped = 0;    // mmap 出来的总字节数（含 guard page）
+};
+
+/**
+ * @brief 协程栈分配器
+ *
+ * 每个栈单独 mmap，最低一页设成 PROT_NONE 作为 guard page，栈溢出时直接 SIGSEGV 而不是踩坏别的内存。
+ * 释放的栈按尺寸档位放进当前线程的空闲链表复用；某一档缓存数超过 high_water 后，
+ * 新放进去的栈先 madvise(MADV_DONTNEED) 把物理页还给系统，只保留虚拟地址；超过 max_cached 则直接 munmap。
+ *
+ * 相关配置：
+ * - fiber.stack_pool.size_classes 栈尺寸档位，申请的尺寸向上取整到档位
+ * - fiber.stack_pool.max_cached   每个线程每一档最多缓存多少个栈
+ * - fiber.stack_pool.high_water   每个线程每一档超过多少个缓存栈后开始 madvise
+ * - fiber.stack_pool.stats        只读，GetStats 的当前值，YAML 格式
+ */
+class StackAllocator
+{
+public:
+    // 把申请的尺寸取整到档位（大于最大档位时按页取整，不进缓存）
+    static size_t RoundSize(size_t size);
+    // 返回可用区间 [ptr, ptr + RoundSize(size)) 的起始地址，失败返回 nullptr
+    static void *Alloc(size_t size);
+    // size 必须和 Alloc 时传入的取整后尺寸一致
+    static void Dealloc(void *vp, size_t size);
+
+    static StackAllocatorStats GetStats();
+};
+
+} // namespace sylar
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef __SYLAR_TASK_H__
+#define __SYLAR_TASK_H__
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sylar
+{
+
+/**
+ * @brief 只能移动的 void() 可调用对象
+ *
+ * 和 std::function 类似，但不要求可拷贝；不超过 kInlineSize 字节、移动不抛异常的可调用对象
+ * （捕获几个指针或 shared_ptr 的 lambda、函数指针、std::function 本身）直接放在对象内部，
+ * 构造和移动都不申请堆内存，更大的才退回到堆上。调度器的任务队列和协程回调都用它保存。
+ */
+class Task
+{
+public:
+    static const size_t kInlineSize = 48;
+
+    Task()
+    {
+    }
+
+    Task(std::nullptr_t)
+    {
+    }
+
+    template <class F, class = typename std::enable_if<
+                           !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+    {
+        typedef typename std::decay<F>::type Fn;
+        if (IsNull(f))
+        {
+            return;
+        }
+        Construct<Fn>(std::forward<F>(f), std::integral_constant<bool, FitsInline<Fn>()>());
+    }
+
+    Task(Task &&other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task &operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        reset();
+    }
+
+    explicit operator bool() const
+    {
+        return m_ops != nullptr;
+    }
+
+    void operator()()
+    {
+        m_ops->invoke(m_storage);
+    }
+
+    void reset()
+    {
+        if (m_ops)
+        {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    // 可调用对象是否放在内部缓冲区里（没有堆内存）
+    bool isInline() const
+    {
+        return m_ops && m_ops->is_inline;
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void *storage);
+        // 把 src 里的对象移动到 dst 并析构 src 里的对象
+        void (*move)(void *dst, void *src);
+        void (*destroy)(void *storage);
+        bool is_inline;
+    };
+
+    template <class Fn> static constexpr bool FitsInline()
+    {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template <class Fn> struct InlineOps
+    {
+        static void Invoke(void *storage)
+        {
+            (*static_cast<Fn *>(storage))();
+        }
+        static void Move(void *dst, void *src)
+        {
+            new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+            static_cast<Fn *>(src)->~Fn();
+        }
+        static void Destroy(void *storage)
+        {
+            static_cast<Fn *>(storage)->~Fn();
+        }
+        static const Ops ops;
+    };
+
+    // 放不下的对象在堆上，内部缓冲区里只存指针
+    template <class Fn> struct HeapOps
+    {
+        static Fn *&Ptr(void *storage)
+        {
+            return *static_cast<Fn **>(storage);
+        }
+        static void Invoke(void *storage)
+        {
+            (*Ptr(storage))();
+        }
+        static void Move(void *dst, void *src)
+        {
+            new (dst) Fn *(Ptr(src));
+        }
+        static void Destroy(void *storage)
+        {
+            delete Ptr(storage);
+        }
+        static const Ops ops;
+    };
+
+    template <class Fn, class F> void Construct(F &&f, std::true_type)
+    {
+        new (m_storage) Fn(std::forward<F>(f));
+        m_ops = &InlineOps<Fn>::ops;
+    }
+
+    template <class Fn, class F> void Construct(F &&f, std::false_type)
+    {
+        new (m_storage) Fn *(new Fn(std::forward<F>(f)));
+        m_ops = &HeapOps<Fn>::ops;
+    }
+
+    void moveFrom(Task &other)
+    {
+        if (other.m_ops)
+        {
+            other.m_ops->move(m_storage, other.m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+
+    // 空的 std::function 和空函数指针构造出来的 Task 也是空的
+    template <class F> static bool IsNull(const F &)
+    {
+        return false;
+    }
+    template <class Sig> static bool IsNull(const std::function<Sig> &f)
+    {
+        return !f;
+    }
+    template <class R, class... Args> static bool IsNull(R (*const &f)(Args...))
+    {
+        return !f;
+    }
+
+private:
+    alignas(std::max_align_t) char m_storage[kInlineSize];
+    const Ops *m_ops = nullptr;
+};
+
+template <class Fn>
+const Task::Ops Task::InlineOps<Fn>::ops = {&Task::InlineOps<Fn>::Invoke,
+                                            &Task::InlineOps<Fn>::Move,
+                                            &Task::InlineOps<Fn>::Destroy, true};
+
+template <class Fn>
+const Task::Ops Task::HeapOps<Fn>::ops = {&Task::HeapOps<Fn>::Invoke, &Task::HeapOps<Fn>::Move,
+                                          &Task::HeapOps<Fn>::Destroy, false};
+
+} // namespace sylar
+
+#endif
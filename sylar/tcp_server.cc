@@ -3,6 +3,12 @@
 #include "log.h"
 #include "module.h"
 #include "socket_stream.h"
+#include <algorithm>
+#include <iterator>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <unistd.h>
 
 namespace sylar
 {
@@ -10,11 +16,27 @@ namespace sylar
 static sylar::ConfigVar<uint64_t>::ptr g_tcp_server_read_timeout = sylar::Config::Lookup(
     "tcp_server.read_timeout", (uint64_t)(60 * 1000 * 2), "tcp server read timeout");
 
+static sylar::ConfigVar<uint32_t>::ptr g_tcp_server_max_connections =
+    sylar::Config::Lookup("tcp_server.max_connections",
+                          (uint32_t)0,
+                          "tcp server max live connections, 0 means unlimited");
+
+static sylar::ConfigVar<uint32_t>::ptr g_tcp_server_accept_batch = sylar::Config::Lookup(
+    "tcp_server.accept_batch", (uint32_t)64, "tcp server max accepts per readable event");
+
+static sylar::ConfigVar<bool>::ptr g_tcp_server_shed_on_overload =
+    sylar::Config::Lookup("tcp_server.shed_on_overload",
+                          false,
+                          "close new connections instead of pausing accept when full");
+
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
 TcpServer::TcpServer(sylar::IOManager *worker, sylar::IOManager *accept_woker)
     : m_worker(worker), m_acceptWorker(accept_woker),
-      m_recvTimeout(g_tcp_server_read_timeout->getValue()), m_name("sylar/1.0.0"), m_isStop(true)
+      m_recvTimeout(g_tcp_server_read_timeout->getValue()), m_name("sylar/1.0.0"), m_isStop(true),
+      m_maxConnections(g_tcp_server_max_connections->getValue()),
+      m_acceptBatch(std::max(1u, g_tcp_server_accept_batch->getValue())),
+      m_shedOnOverload(g_tcp_server_shed_on_overload->getValue())
 {
 }
 
@@ -25,6 +47,26 @@ TcpServer::~TcpServer()
         i->close();
     }
     m_socks.clear();
+    for (auto &r : m_reactors)
+    {
+        if (!r.iom)
+        {
+            continue;
+        }
+        if (IOManager::GetThis() == r.iom.get())
+        {
+            // 最后一个引用在这个 reactor 自己的线程里释放，不能自己 join 自己，换个线程去停
+            IOManager::ptr iom = r.iom;
+            std::thread([iom]() { iom->stop(); }).detach();
+        }
+        r.iom.reset();
+    }
+}
+
+void TcpServer::setReusePort(uint32_t reactors, bool cpu_affinity)
+{
+    m_reactorCount = reactors;
+    m_reactorAffinity = cpu_affinity;
 }
 
 bool TcpServer::bind(sylar::Address::ptr addr, bool ssl)
@@ -41,6 +83,14 @@ bool TcpServer::bind(const std::vector<Address::ptr> &addrs,
 {
     for (auto &addr : addrs)
     {
+        if (m_reactorCount)
+        {
+            if (!bindReusePort(addr, ssl))
+            {
+                fails.push_back(addr);
+            }
+            continue;
+        }
         Socket::ptr sock = ssl ? SSLSocket::CreateTCP(addr) : Socket::CreateTCP(addr);
         if (!sock->bind(addr))
         {
@@ -64,6 +114,7 @@ bool TcpServer::bind(const std::vector<Address::ptr> &addrs,
     if (!fails.empty())
     {
         m_socks.clear();
+        m_reactors.clear();
         return false;
     }
 
@@ -74,23 +125,186 @@ bool TcpServer::bind(const std::vector<Address::ptr> &addrs,
     return true;
 }
 
+bool TcpServer::bindReusePort(Address::ptr addr, bool ssl)
+{
+    m_reactors.resize(m_reactorCount);
+    // Unix 域 socket 没有 SO_REUSEPORT，重复 bind 还会把前一个的文件删掉
+    uint32_t count = addr->getFamily() == AF_UNIX ? 1 : m_reactorCount;
+    std::vector<Socket::ptr> socks;
+    Address::ptr bind_addr = addr;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Socket::ptr sock = ssl ? SSLSocket::CreateTCP(addr) : Socket::CreateTCP(addr);
+        if (count > 1 && !sock->setReusePort())
+        {
+            SYLAR_LOG_ERROR(g_logger)
+                << "set SO_REUSEPORT fail errno=" << errno << " errstr=" << strerror(errno)
+                << " addr=[" << addr->toString() << "]";
+            return false;
+        }
+        if (!sock->bind(bind_addr))
+        {
+            SYLAR_LOG_ERROR(g_logger)
+                << "bind fail errno=" << errno << " errstr=" << strerror(errno) << " addr=["
+                << bind_addr->toString() << "]";
+            return false;
+        }
+        if (!sock->listen())
+        {
+            SYLAR_LOG_ERROR(g_logger)
+                << "listen fail errno=" << errno << " errstr=" << strerror(errno) << " addr=["
+                << bind_addr->toString() << "]";
+            return false;
+        }
+        // 端口写 0 时后面的 socket 要绑到第一个拿到的端口上，才是同一组
+        bind_addr = sock->getLocalAddress();
+        socks.push_back(sock);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        m_reactors[i].socks.push_back(socks[i]);
+        m_socks.push_back(socks[i]);
+    }
+    return true;
+}
+
+void TcpServer::startReactors()
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (size_t i = 0; i < m_reactors.size(); ++i)
+    {
+        Reactor &r = m_reactors[i];
+        if (!r.iom)
+        {
+            r.iom.reset(new IOManager(1, false, "reactor_" + std::to_string(i)));
+            if (m_reactorAffinity && cpus > 0)
+            {
+                int cpu = i % cpus;
+                r.iom->schedule(
+                    [cpu]()
+                    {
+                        cpu_set_t set;
+                        CPU_ZERO(&set);
+                        CPU_SET(cpu, &set);
+                        int rt = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                        if (rt)
+                        {
+                            SYLAR_LOG_WARN(g_logger) << "reactor bind cpu=" << cpu
+                                                     << " fail errno=" << rt
+                                                     << " errstr=" << strerror(rt);
+                        }
+                    });
+            }
+        }
+        for (auto &sock : r.socks)
+        {
+            r.iom->schedule(std::bind(&TcpServer::startAccept, shared_from_this(), sock));
+        }
+    }
+}
+
+void TcpServer::stopReactors()
+{
+    for (auto &r : m_reactors)
+    {
+        if (!r.iom)
+        {
+            continue;
+        }
+        std::vector<Socket::ptr> socks;
+        socks.swap(r.socks);
+        // cancelAll 要在监听 socket 所在的 IOManager 里调用
+        r.iom->schedule(
+            [socks]()
+            {
+                for (auto &sock : socks)
+                {
+                    sock->cancelAll();
+                    sock->close();
+                }
+            });
+    }
+    m_socks.clear();
+}
+
+void TcpServer::releaseConnection(const std::shared_ptr<FiberSemaphore> &sem)
+{
+    --m_connections;
+    if (sem)
+    {
+        sem->notify();
+    }
+}
+
 void TcpServer::startAccept(Socket::ptr sock)
 {
+    // reactor 模式下连接就在 accept 它的线程里处理
+    IOManager *worker = m_reactors.empty() ? m_worker : IOManager::GetThis();
+    // 每次 start 都换一个新的 m_connSem，这一轮接的连接和名额都跟着这一个走
+    std::shared_ptr<FiberSemaphore> sem = m_connSem;
+    bool wait_slot = sem && !m_shedOnOverload;
+    // 已经为下一个连接拿到了名额
+    bool reserved = false;
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(m_acceptBatch);
     while (!m_isStop)
     {
-        Socket::ptr client = sock->accept();
-        // SYLAR_LOG_INFO(g_logger) << "accept: " << *client;
-        if (client)
+        if (wait_slot && !reserved)
         {
-            client->setRecvTimeOut(m_recvTimeout);
-            // 统一经过模块回调包装，再分派到 HTTP 等子类的 handleClient 实现。
-            m_worker->schedule(
-                std::bind(&TcpServer::handleClientWithModule, shared_from_this(), client));
+            // 满了就停在这里不再 accept，新连接留在内核的 backlog 里，直到有连接结束
+            sem->wait();
+            reserved = true;
+            continue;
         }
-        else
+        Socket::ptr client = sock->accept();
+        if (!client)
         {
             SYLAR_LOG_ERROR(g_logger) << "accept errno=" << errno << " errstr=" << strerror(errno);
+            continue;
         }
+        // 一次可读事件里 backlog 可能已经排了好几个连接，不再经过 epoll，非阻塞地一起取出来
+        for (uint32_t i = 1;; ++i)
+        {
+            if (reserved || !sem || sem->tryWait())
+            {
+                reserved = false;
+                ++m_connections;
+                client->setRecvTimeOut(m_recvTimeout);
+                // 统一经过模块回调包装，再分派到 HTTP 等子类的 handleClient 实现。
+                tasks.push_back(
+                    std::bind(&TcpServer::handleClientWithModule, shared_from_this(), client, sem));
+            }
+            else
+            {
+                ++m_shedCount;
+                SYLAR_LOG_DEBUG(g_logger) << "too many connections, shed: " << *client;
+                client->close();
+            }
+            if (i >= m_acceptBatch || m_isStop)
+            {
+                break;
+            }
+            if (wait_slot)
+            {
+                if (!sem->tryWait())
+                {
+                    break;
+                }
+                reserved = true;
+            }
+            client = sock->tryAccept();
+            if (!client)
+            {
+                break;
+            }
+        }
+        worker->schedule(std::make_move_iterator(tasks.begin()),
+                         std::make_move_iterator(tasks.end()));
+        tasks.clear();
+    }
+    if (reserved)
+    {
+        sem->notify();
     }
 }
 
@@ -101,6 +315,17 @@ bool TcpServer::start()
         return true;
     }
     m_isStop = false;
+    if (m_maxConnections)
+    {
+        //stop 为了叫醒 accept 协程多放过名额，旧的不能再用，每次都重新建一个；
+        //上一轮的 accept 协程和连接结束时把名额还给它们自己拿着的那个
+        m_connSem = std::make_shared<FiberSemaphore>(m_maxConnections);
+    }
+    if (!m_reactors.empty())
+    {
+        startReactors();
+        return true;
+    }
     for (auto &sock : m_socks)
     {
         m_acceptWorker->schedule(std::bind(&TcpServer::startAccept, shared_from_this(), sock));
@@ -111,6 +336,19 @@ bool TcpServer::start()
 void TcpServer::stop()
 {
     m_isStop = true;
+    if (m_connSem)
+    {
+        //叫醒因为连接数到上限而停下的 accept 协程，让它们看到 m_isStop 后退出
+        for (size_t i = 0; i < m_socks.size(); ++i)
+        {
+            m_connSem->notify();
+        }
+    }
+    if (!m_reactors.empty())
+    {
+        stopReactors();
+        return;
+    }
     auto self = shared_from_this();
     m_acceptWorker->schedule(
         [this, self]()
@@ -129,7 +367,7 @@ void TcpServer::handleClient(Socket::ptr client)
     SYLAR_LOG_INFO(g_logger) << "handleClient: " << *client;
 }
 
-void TcpServer::handleClientWithModule(Socket::ptr client)
+void TcpServer::handleClientWithModule(Socket::ptr client, std::shared_ptr<FiberSemaphore> sem)
 {
     // Module 只观察连接，不拥有 socket；协议层仍负责连接关闭语义。
     SocketStream::ptr stream(new SocketStream(client, false));
@@ -149,6 +387,7 @@ void TcpServer::handleClientWithModule(Socket::ptr client)
     }
 
     ModuleMgr::GetInstance()->onDisconnect(stream);
+    releaseConnection(sem);
 }
 
 bool TcpServer::loadCertificates(const std::string &cert_file, const std::string &key_file)
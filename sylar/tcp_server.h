@@ -3,8 +3,10 @@
 
 #include "address.h"
 #include "iomanager.h"
+#include "mutex.h"
 #include "noncopyable.h"
 #include "socket.h"
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
@@ -28,6 +30,24 @@ public:
                       std::vector<Address::ptr> &fails,
                       bool ssl = false);
     bool loadCertificates(const std::string &cert_file, const std::string &key_file);
+    /**
+     * @brief 切换成每核一个 reactor 的模式，要在 bind 之前调用
+     * @param[in] reactors reactor 个数，0 表示用原来的 accept_worker/worker 模式
+     * @param[in] cpu_affinity 是否把第 i 个 reactor 的线程绑到第 i 个 CPU 上
+     * @details 每个 IP 地址绑定 reactors 个带 SO_REUSEPORT 的监听 socket，
+     *          每个 reactor 是一个单线程、独立 epoll 的 IOManager，只 accept 自己的 socket，
+     *          接进来的连接也在同一个线程里解析和处理，由内核在这些 socket 之间分摊连接。
+     *          Unix 域地址不支持 SO_REUSEPORT，只绑定一个 socket，交给第一个 reactor。
+     */
+    void setReusePort(uint32_t reactors, bool cpu_affinity = false);
+    uint32_t getReactorCount() const
+    {
+        return m_reactorCount;
+    }
+    std::vector<Socket::ptr> getSocks() const
+    {
+        return m_socks;
+    }
     virtual bool start();
     virtual void stop();
 
@@ -43,18 +63,59 @@ public:
     {
         m_recvTimeout = v;
     }
+    uint32_t getMaxConnections() const
+    {
+        return m_maxConnections;
+    }
+    /**
+     * @brief 同时存在的连接上限，0 表示不限，要在 start 之前设置
+     * @param[in] shed 到达上限时 true 表示照常 accept 然后马上关掉，
+     *                 false 表示暂停 accept，让新连接排在内核的 backlog 里
+     */
+    void setMaxConnections(uint32_t v, bool shed = false)
+    {
+        m_maxConnections = v;
+        m_shedOnOverload = shed;
+    }
+    /// 一次可读事件里最多连续 accept 几个连接
+    void setAcceptBatch(uint32_t v)
+    {
+        m_acceptBatch = v ? v : 1;
+    }
+    /// 当前还没处理完的连接数
+    uint32_t getConnectionCount() const
+    {
+        return m_connections;
+    }
+    /// 因为超过上限被直接关掉的连接数
+    uint64_t getShedCount() const
+    {
+        return m_shedCount;
+    }
     virtual void setName(const std::string &v)
     {
         m_name = v;
     }
 
 protected:
-    // 统一包装模块连接回调，随后再进入子类的具体协议处理。
-    void handleClientWithModule(Socket::ptr client);
+    // 统一包装模块连接回调，随后再进入子类的具体协议处理。sem 是接这个连接时占的名额
+    void handleClientWithModule(Socket::ptr client, std::shared_ptr<FiberSemaphore> sem);
     //子类进行重写，当连接上一个客户端时做一些动作
     virtual void handleClient(Socket::ptr client);
     virtual void startAccept(Socket::ptr sock);
 
+private:
+    struct Reactor
+    {
+        IOManager::ptr iom;
+        std::vector<Socket::ptr> socks;
+    };
+    bool bindReusePort(Address::ptr addr, bool ssl);
+    // 连接处理完，把名额还给接它时的那个 sem
+    void releaseConnection(const std::shared_ptr<FiberSemaphore> &sem);
+    void startReactors();
+    void stopReactors();
+
 private:
     // 注意它不是客户端 socket，而是服务端监听 socket。
     std::vector<Socket::ptr> m_socks;
@@ -65,6 +126,17 @@ private:
     uint64_t m_recvTimeout;
     std::string m_name;
     bool m_isStop;
+    uint32_t m_reactorCount = 0;
+    bool m_reactorAffinity = false;
+    uint32_t m_maxConnections;
+    uint32_t m_acceptBatch;
+    bool m_shedOnOverload;
+    std::atomic<uint32_t> m_connections{0};
+    std::atomic<uint64_t> m_shedCount{0};
+    // 有连接上限时每次 start 重新创建，名额数就是上限
+    std::shared_ptr<FiberSemaphore> m_connSem;
+    // 第 i 个 reactor 的监听 socket，start 之后才创建 IOManager
+    std::vector<Reactor> m_reactors;
 };
 } // namespace sylar
 #endif
@@ -3,59 +3,437 @@
 #include "sylar/thread.h"
 #include "util.h"
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
 namespace sylar
 
 {
 
-// 返回 true 表示 a 应该排在 b 前面（严格弱序）。
-bool Timer::Comparator::operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const
+/**
+ * @brief 分层时间轮
+ *
+ * 第 0 层 256 格，每格 1ms；第 1~4 层各 64 格，每格是下一层转一圈的时间。
+ * 定时器按离当前时刻的距离放进对应层，低层转完一圈时把上一层对应格子里的定时器
+ * 重新分配到低层（cascade）。每层用位图记录非空的格子，推进时间时跳过空格子，
+ * 计算最早触发时间时不用遍历定时器。所有操作都要持有 m_mutex。
+ */
+class TimerWheel
 {
-    if (!lhs && !rhs)
+public:
+    static const int kLevels = 5;
+    static const size_t kRootBits = 8;
+    static const size_t kRootSlots = 1 << kRootBits;
+    static const size_t kLevelBits = 6;
+    static const size_t kLevelSlots = 1 << kLevelBits;
+    /// 第 4 层能表示的最远距离，再远的先放在这里，到点后重新计算
+    static const uint64_t kMaxDelta = 0xffffffffull;
+    /// 一次推进超过这么多毫秒就整体重建，而不是逐格推进
+    static const uint64_t kRebuildGap = 1 << 16;
+
+    TimerWheel(TimerManager *manager, uint64_t now) : m_manager(manager), m_current(now)
     {
-        return false;
+        m_thread = GetThreadId();
+        m_lastNow = now;
+        memset(m_root, 0, sizeof(m_root));
+        memset(m_levels, 0, sizeof(m_levels));
+        memset(m_rootBitmap, 0, sizeof(m_rootBitmap));
+        memset(m_levelBitmap, 0, sizeof(m_levelBitmap));
     }
-    if (!lhs)
+
+    ~TimerWheel()
     {
-        return true;
+        Timer *list = detachAll();
+        while (list)
+        {
+            Timer *next = list->m_link;
+            list->m_link = nullptr;
+            Timer::ptr self;
+            self.swap(list->m_self);
+            list = next;
+        }
     }
-    if (!rhs)
+
+    TimerManager *getManager() const
     {
-        return false;
+        return m_manager;
     }
-    if (lhs->m_next < rhs->m_next)
+
+    Mutex &mutex()
     {
-        return true;
+        return m_mutex;
     }
-    if (rhs->m_next < lhs->m_next)
+
+    int getThread() const
     {
-        return false;
+        return m_thread;
     }
-    return lhs.get() < rhs.get();
-}
 
-Timer::Timer(uint64_t ms, std::function<void()> cb, TimerManager *manager, bool recurring)
-    : m_ms(ms), m_cb(cb), m_manager(manager), m_recurring(recurring)
-{
-    m_next = GetCurrentMS() + m_ms;
-}
-Timer::Timer(uint64_t next) : m_next(next)
+    size_t size() const
+    {
+        return m_count;
+    }
+
+    // 插入一个新定时器，now 是调用者取到的当前时间
+    void insert(Timer *timer, uint64_t now)
+    {
+        // 时间轮空着的时候没有推进，先把当前刻度追上来，免得新定时器被放进过高的层
+        if (m_count == 0 && now > m_current)
+        {
+            m_current = now;
+        }
+        add(timer);
+    }
+
+    void add(Timer *timer)
+    {
+        uint64_t expires = timer->m_next < m_current ? m_current : timer->m_next;
+        uint64_t delta = expires - m_current;
+        if (delta > kMaxDelta)
+        {
+            expires = m_current + kMaxDelta;
+            delta = kMaxDelta;
+        }
+        Timer **head = nullptr;
+        if (delta < kRootSlots)
+        {
+            size_t slot = expires & (kRootSlots - 1);
+            timer->m_level = 0;
+            timer->m_slot = slot;
+            head = &m_root[slot];
+            m_rootBitmap[slot >> 6] |= 1ull << (slot & 63);
+        }
+        else
+        {
+            int level = 1;
+            while (level < kLevels - 1 && delta >= (1ull << Shift(level + 1)))
+            {
+                ++level;
+            }
+            size_t slot = (expires >> Shift(level)) & (kLevelSlots - 1);
+            timer->m_level = level;
+            timer->m_slot = slot;
+            head = &m_levels[level - 1][slot];
+            m_levelBitmap[level - 1] |= 1ull << slot;
+        }
+        timer->m_link = *head;
+        if (*head)
+        {
+            (*head)->m_pprev = &timer->m_link;
+        }
+        *head = timer;
+        timer->m_pprev = head;
+        ++m_count;
+    }
+
+    void remove(Timer *timer)
+    {
+        *timer->m_pprev = timer->m_link;
+        if (timer->m_link)
+        {
+            timer->m_link->m_pprev = timer->m_pprev;
+        }
+        if (timer->m_level == 0)
+        {
+            if (!m_root[timer->m_slot])
+            {
+                m_rootBitmap[timer->m_slot >> 6] &= ~(1ull << (timer->m_slot & 63));
+            }
+        }
+        else if (!m_levels[timer->m_level - 1][timer->m_slot])
+        {
+            m_levelBitmap[timer->m_level - 1] &= ~(1ull << timer->m_slot);
+        }
+        timer->m_link = nullptr;
+        timer->m_pprev = nullptr;
+        --m_count;
+    }
+
+    // 推进到 now，把过期定时器的回调放进 cbs
+    void expire(uint64_t now, std::vector<std::function<void()>> &cbs)
+    {
+        // 时间取自单调时钟，正常不会回拨；万一回拨超过一小时就认为所有定时器都过期了，避免永不触发
+        bool rollover = now < m_lastNow && now < m_lastNow - 60 * 60 * 1000;
+        m_lastNow = now;
+        if (m_count == 0)
+        {
+            if (now >= m_current)
+            {
+                m_current = now + 1;
+            }
+            return;
+        }
+        if (rollover || (now >= m_current && now - m_current > kRebuildGap))
+        {
+            rebuild(now, rollover, cbs);
+            return;
+        }
+        // 重复定时器和被截断的远期定时器，等推进完再放回去
+        Timer *readd = nullptr;
+        while (m_current <= now && m_count)
+        {
+            size_t idx = m_current & (kRootSlots - 1);
+            if (idx == 0)
+            {
+                for (int level = 1; level < kLevels; ++level)
+                {
+                    size_t slot = (m_current >> Shift(level)) & (kLevelSlots - 1);
+                    cascade(level, slot);
+                    if (slot)
+                    {
+                        break;
+                    }
+                }
+            }
+            Timer *list = m_root[idx];
+            if (list)
+            {
+                m_root[idx] = nullptr;
+                m_rootBitmap[idx >> 6] &= ~(1ull << (idx & 63));
+            }
+            while (list)
+            {
+                Timer *timer = list;
+                list = list->m_link;
+                timer->m_link = nullptr;
+                timer->m_pprev = nullptr;
+                --m_count;
+                fire(timer, now, readd, cbs);
+            }
+            // 跳到本圈下一个非空格子，没有就跳到下一圈开头（那里要 cascade）；
+            // 不能越过 now，否则之后插入的、比跳到的位置更早的定时器会被推迟
+            size_t next = nextRootSlot(idx + 1);
+            uint64_t base = m_current - idx;
+            m_current = next < kRootSlots ? base + next : base + kRootSlots;
+            if (m_current > now + 1)
+            {
+                m_current = now + 1;
+            }
+        }
+        if (m_current <= now)
+        {
+            m_current = now + 1;
+        }
+        while (readd)
+        {
+            Timer *timer = readd;
+            readd = readd->m_link;
+            timer->m_link = nullptr;
+            add(timer);
+        }
+    }
+
+    // 最早可能触发的时间（绝对时间，可能早于实际触发时间，但不会晚），没有定时器返回 ~0ull
+    uint64_t nextExpire() const
+    {
+        if (m_count == 0)
+        {
+            return ~0ull;
+        }
+        size_t idx = m_current & (kRootSlots - 1);
+        uint64_t base = m_current - idx;
+        uint64_t result = ~0ull;
+        size_t slot = nextRootSlot(idx);
+        if (slot < kRootSlots)
+        {
+            result = base + slot;
+        }
+        else
+        {
+            slot = nextRootSlot(0);
+            if (slot < idx)
+            {
+                result = base + kRootSlots + slot;
+            }
+        }
+        // 上层格子在 cascade 之前不会触发，cascade 的时刻就是这个格子的下界
+        for (int level = 1; level < kLevels; ++level)
+        {
+            uint64_t bitmap = m_levelBitmap[level - 1];
+            if (!bitmap)
+            {
+                continue;
+            }
+            uint64_t cur = m_current >> Shift(level);
+            size_t start = (cur + 1) & (kLevelSlots - 1);
+            uint64_t rotated =
+                start ? (bitmap >> start) | (bitmap << (kLevelSlots - start)) : bitmap;
+            uint64_t k = __builtin_ctzll(rotated) + 1;
+            uint64_t at = (cur + k) << Shift(level);
+            if (at < result)
+            {
+                result = at;
+            }
+        }
+        return result;
+    }
+
+private:
+    static size_t Shift(int level)
+    {
+        return level == 0 ? 0 : kRootBits + (level - 1) * kLevelBits;
+    }
+
+    // 从 from 开始第一个非空的第 0 层格子，没有返回 kRootSlots
+    size_t nextRootSlot(size_t from) const
+    {
+        for (size_t word = from >> 6; word < kRootSlots / 64; ++word)
+        {
+            uint64_t bits = m_rootBitmap[word];
+            if (word == (from >> 6))
+            {
+                bits &= ~0ull << (from & 63);
+            }
+            if (bits)
+            {
+                return word * 64 + __builtin_ctzll(bits);
+            }
+        }
+        return kRootSlots;
+    }
+
+    void cascade(int level, size_t slot)
+    {
+        Timer *list = m_levels[level - 1][slot];
+        if (!list)
+        {
+            return;
+        }
+        m_levels[level - 1][slot] = nullptr;
+        m_levelBitmap[level - 1] &= ~(1ull << slot);
+        while (list)
+        {
+            Timer *timer = list;
+            list = list->m_link;
+            --m_count;
+            add(timer);
+        }
+    }
+
+    void fire(Timer *timer, uint64_t now, Timer *&readd, std::vector<std::function<void()>> &cbs)
+    {
+        if (timer->m_next > now)
+        {
+            // 超过 kMaxDelta 被截断的定时器还没到时间
+            timer->m_link = readd;
+            readd = timer;
+            return;
+        }
+        if (timer->m_recurring)
+        {
+            cbs.push_back(timer->m_cb);
+            timer->m_next = now + timer->m_ms;
+            timer->m_link = readd;
+            readd = timer;
+            return;
+        }
+        cbs.push_back(std::move(timer->m_cb));
+        timer->m_cb = nullptr;
+        // 可能是最后一个引用，放到最后
+        Timer::ptr self;
+        self.swap(timer->m_self);
+    }
+
+    // 摘下所有定时器串成一条链表
+    Timer *detachAll()
+    {
+        Timer *all = nullptr;
+        auto take = [&all](Timer *&head)
+        {
+            while (head)
+            {
+                Timer *timer = head;
+                head = head->m_link;
+                timer->m_pprev = nullptr;
+                timer->m_link = all;
+                all = timer;
+            }
+        };
+        for (auto &i : m_root)
+        {
+            take(i);
+        }
+        for (auto &level : m_levels)
+        {
+            for (auto &i : level)
+            {
+                take(i);
+            }
+        }
+        memset(m_rootBitmap, 0, sizeof(m_rootBitmap));
+        memset(m_levelBitmap, 0, sizeof(m_levelBitmap));
+        m_count = 0;
+        return all;
+    }
+
+    // 时间跨度太大（长时间没推进或者时钟跳变）时整体重建，代价和定时器个数成正比
+    void rebuild(uint64_t now, bool all_expired, std::vector<std::function<void()>> &cbs)
+    {
+        Timer *list = detachAll();
+        m_current = now + 1;
+        Timer *readd = nullptr;
+        while (list)
+        {
+            Timer *timer = list;
+            list = list->m_link;
+            timer->m_link = nullptr;
+            if (all_expired || timer->m_next <= now)
+            {
+                if (all_expired)
+                {
+                    timer->m_next = now;
+                }
+                fire(timer, now, readd, cbs);
+            }
+            else
+            {
+                add(timer);
+            }
+        }
+        while (readd)
+        {
+            Timer *timer = readd;
+            readd = readd->m_link;
+            timer->m_link = nullptr;
+            add(timer);
+        }
+    }
+
+private:
+    TimerManager *m_manager;
+    Mutex m_mutex;
+    int m_thread = 0;
+    /// 下一个要处理的刻度（毫秒），它之前的刻度都处理过了
+    uint64_t m_current = 0;
+    /// 上一次推进时的时钟，用来检测回拨
+    uint64_t m_lastNow = 0;
+    std::atomic<size_t> m_count = {0};
+    Timer *m_root[kRootSlots];
+    Timer *m_levels[kLevels - 1][kLevelSlots];
+    uint64_t m_rootBitmap[kRootSlots / 64];
+    uint64_t m_levelBitmap[kLevels - 1];
+};
+
+Timer::Timer(uint64_t ms, std::function<void()> cb, TimerWheel *wheel, bool recurring)
+    : m_ms(ms), m_cb(cb), m_wheel(wheel), m_recurring(recurring)
 {
+    m_next = GetMonotonicMS() + m_ms;
 }
 
 // cancel 取消定时器(后面不执行)
 bool Timer::cancel()
 {
-    TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
+    // 时间轮持有的引用在解锁后才释放
+    Timer::ptr self;
+    Mutex::Lock lock(m_wheel->mutex());
     if (m_cb)
     {
         m_cb = nullptr;
-        //从manager里面找到这个timer，然后删除他
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it != m_manager->m_timers.end())
+        //从时间轮上摘下来
+        if (m_pprev)
         {
-            m_manager->m_timers.erase(it);
+            m_wheel->remove(this);
+            self.swap(m_self);
         }
         return true;
     }
@@ -65,22 +443,15 @@ bool Timer::cancel()
 // 给现在这个定时器重新设置下次执行的时间（当前时间  +  ms）
 bool Timer::refresh()
 {
-    TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
-    if (!m_cb)
-    {
-        return false;
-    }
-    //先找到
-    auto it = m_manager->m_timers.find(shared_from_this());
-    if (it == m_manager->m_timers.end())
+    Mutex::Lock lock(m_wheel->mutex());
+    if (!m_cb || !m_pprev)
     {
         return false;
     }
-    //删除原来的
-    m_manager->m_timers.erase(it);
-    //添加新的
-    m_next = sylar::GetCurrentMS() + m_ms;
-    m_manager->m_timers.insert(shared_from_this());
+    //摘下来再按新的时间放回去
+    m_wheel->remove(this);
+    m_next = sylar::GetMonotonicMS() + m_ms;
+    m_wheel->add(this);
     return true;
 }
 
@@ -93,51 +464,127 @@ bool Timer::reset(uint64_t ms, bool from_now)
     {
         return true;
     }
-    TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
-
-    //先找到
-    if (!m_cb)
-    {
-        return false;
-    }
-    auto it = m_manager->m_timers.find(shared_from_this());
-    if (it == m_manager->m_timers.end())
-    {
-        return false;
-    }
-    //删除原来的
-    m_manager->m_timers.erase(it);
-    //添加新的
-    m_ms = ms;
-    uint64_t start = 0;
-    if (from_now)
     {
-        start = sylar::GetCurrentMS();
+        Mutex::Lock lock(m_wheel->mutex());
+        if (!m_cb || !m_pprev)
+        {
+            return false;
+        }
+        m_wheel->remove(this);
+        uint64_t start = 0;
+        if (from_now)
+        {
+            start = sylar::GetMonotonicMS();
+        }
+        else
+        {
+            start = m_next - m_ms;
+        }
+        m_ms = ms;
+        m_next = start + m_ms;
+        m_wheel->add(this);
     }
-    else
+    m_wheel->getManager()->onTimerAdded(m_next);
+    return true;
+}
+
+void Timer::restart(uint64_t ms, std::function<void()> cb)
+{
+    // 之前挂着的话，时间轮持有的引用在解锁后才释放
+    Timer::ptr self;
     {
-        start = m_next - m_ms;
+        Mutex::Lock lock(m_wheel->mutex());
+        if (m_pprev)
+        {
+            m_wheel->remove(this);
+            self.swap(m_self);
+        }
+        m_cb.swap(cb);
+        m_ms = ms;
+        m_next = sylar::GetMonotonicMS() + m_ms;
+        m_self = shared_from_this();
+        m_wheel->insert(this, m_next - m_ms);
     }
-    m_ms = ms;
-    m_next = start + m_ms;
-    m_manager->addTimer(shared_from_this(), lock);
-    return true;
+    m_wheel->getManager()->onTimerAdded(m_next);
 }
 
+static std::atomic<uint64_t> s_timer_manager_id{0};
+
+namespace
+{
+// 当前线程最近一次用到的时间轮
+struct WheelCache
+{
+    uint64_t manager = 0;
+    TimerWheel *wheel = nullptr;
+};
+thread_local WheelCache t_wheel_cache;
+} // namespace
+
 TimerManager::TimerManager()
 {
-    m_previouseTime = sylar::GetCurrentMS();
+    m_id = ++s_timer_manager_id;
+    for (auto &i : m_wheels)
+    {
+        i = nullptr;
+    }
 }
 
 TimerManager::~TimerManager()
 {
+    size_t count = m_wheelCount;
+    for (size_t i = 0; i < count; ++i)
+    {
+        delete m_wheels[i].load();
+    }
+}
+
+TimerWheel *TimerManager::getWheel()
+{
+    if (t_wheel_cache.manager == m_id)
+    {
+        return t_wheel_cache.wheel;
+    }
+    int thread = GetThreadId();
+    Mutex::Lock lock(m_wheelMutex);
+    size_t count = m_wheelCount;
+    TimerWheel *wheel = nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_wheels[i].load()->getThread() == thread)
+        {
+            wheel = m_wheels[i];
+            break;
+        }
+    }
+    if (!wheel)
+    {
+        if (count < kMaxWheels)
+        {
+            wheel = new TimerWheel(this, CoarseMonoMs());
+            m_wheels[count] = wheel;
+            m_wheelCount = count + 1;
+        }
+        else
+        {
+            wheel = m_wheels[thread % kMaxWheels];
+        }
+    }
+    t_wheel_cache.manager = m_id;
+    t_wheel_cache.wheel = wheel;
+    return wheel;
 }
 
 Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring)
 {
-    Timer::ptr timer(new Timer(ms, cb, this, recurring));
-    RWMutexType::WriteLock lock(m_mutex);
-    addTimer(timer, lock);
+    TimerWheel *wheel = getWheel();
+    Timer::ptr timer(new Timer(ms, cb, wheel, recurring));
+    {
+        Mutex::Lock lock(wheel->mutex());
+        timer->m_self = timer;
+        wheel->insert(timer.get(), timer->m_next - ms);
+    }
+    onTimerAdded(timer->m_next);
     return timer;
 }
 
@@ -158,118 +605,75 @@ Timer::ptr TimerManager::addConditionTimer(uint64_t ms,
     return addTimer(ms, std::bind(&onTimer, weak_cond, cb), recurring);
 }
 
-void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock &lock)
+void TimerManager::onTimerAdded(uint64_t next)
 {
-    //得到位置，看看时间是不是最早的
-    auto it = m_timers.insert(val).first;
-    bool at_front = (it == m_timers.begin()) && !m_tickled;
-    if (at_front)
-    {
-        m_tickled = true;
-    }
-    lock.unlock();
-    if (at_front)
+    //比空闲线程正在等的时间早，并且还没通知过，才需要让它们重新计算epoll_wait的超时
+    if (next < m_nextWake && !m_tickled.exchange(true))
     {
         //里面是tickle(),代表来了一个新任务（Fibers）
         onTimerInsertedAtFront();
     }
 }
 
-// 列出所有过期的定时器,判断是否重新调度
-//按理来说m_timers里面都是没执行的，不会有过期的，有过期的就是时钟回拨了
+// 列出所有过期的定时器,重复定时器重新放回时间轮
 void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs)
 {
-
-    std::vector<Timer::ptr> expired;
+    uint64_t now_ms = CoarseMonoMs();
+    size_t count = m_wheelCount;
+    for (size_t i = 0; i < count; ++i)
     {
-        RWMutexType::ReadLock lock(m_mutex);
-        if (m_timers.empty())
+        TimerWheel *wheel = m_wheels[i];
+        if (!wheel->size())
         {
-            return;
-        }
-    }
-    RWMutexType::WriteLock lock(m_mutex);
-    if (m_timers.empty())
-    {
-        return;
-    }
-    // 仅仅用于判断 m_timers里的定时器是否过期，用来比较的
-    uint64_t now_ms = GetCurrentMS();
-    // 检测是否发生了时钟回拨
-    bool rollover = detectClockRollover(now_ms);
-    //如果没有时钟回拨，并且最近的一个定时器都没到应执行的时间
-    //那就是说明没有过期的定时器
-    if (!rollover && (*(m_timers.begin()))->m_next > now_ms)
-    {
-        return;
-    }
-
-    Timer::ptr now_timer(new Timer(now_ms));
-    // 找到第一个下次执行时间大于等于当前时间的定时器,如果时钟回拨了，就是所有的都过期了
-    //避免定时器因时钟异常回拨而永不触发
-    auto it = rollover ? m_timers.end() : m_timers.lower_bound(now_timer);
-    //把下次执行时间等于当前时间的定时器排除在外，不算过期
-    while (it != m_timers.end() && (*it)->m_next <= now_ms)
-    {
-        it++;
-    }
-    // 把所有过期的定时器都放到 expired 里
-    expired.insert(expired.begin(), m_timers.begin(), it);
-    m_timers.erase(m_timers.begin(), it);
-    cbs.reserve(expired.size());
-    for (auto &timer : expired)
-    {
-        cbs.push_back(timer->m_cb);
-        if (timer->m_recurring)
-        {
-            timer->m_next = now_ms + timer->m_ms;
-            m_timers.insert(timer);
-        }
-        else
-        {
-            timer->m_cb = nullptr;
+            continue;
         }
+        Mutex::Lock lock(wheel->mutex());
+        wheel->expire(now_ms, cbs);
     }
 }
 
-//返回下一个未过期的定时器要执行的具体时间
+//返回下一个未过期的定时器距离现在的毫秒数
 uint64_t TimerManager::getNextTimer()
 {
-    RWMutexType::ReadLock lock(m_mutex);
     //表示读取的就是最早要执行的一个定时器的时间，不需要通知epoll去修改timeout
     m_tickled = false;
-    // 如果定时器队列空了，返回一个最大值，代表没有定时器要执行
-    if (m_timers.empty())
-    {
-        return ~0ull;
-    }
-    // 否则返回最早要执行的定时器的时间
-    const Timer::ptr &next = *m_timers.begin();
-    uint64_t now_ms = sylar::GetCurrentMS();
-    if (now_ms >= next->m_next)
+    uint64_t next = ~0ull;
+    size_t count = m_wheelCount;
+    for (size_t i = 0; i < count; ++i)
     {
-        return 0;
+        TimerWheel *wheel = m_wheels[i];
+        if (!wheel->size())
+        {
+            continue;
+        }
+        Mutex::Lock lock(wheel->mutex());
+        uint64_t v = wheel->nextExpire();
+        if (v < next)
+        {
+            next = v;
+        }
     }
-    else
+    m_nextWake = next;
+    // 如果定时器都空了，返回一个最大值，代表没有定时器要执行
+    if (next == ~0ull)
     {
-        return next->m_next - now_ms;
+        return ~0ull;
     }
+    uint64_t now_ms = sylar::CoarseMonoMs();
+    return now_ms >= next ? 0 : next - now_ms;
 }
 
 bool TimerManager::hasTimer()
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    return !m_timers.empty();
-}
-
-bool TimerManager::detectClockRollover(uint64_t now_ms)
-{
-    bool rollover = false;
-    if (now_ms < m_previouseTime && now_ms < (m_previouseTime - 60 * 60 * 1000))
+    size_t count = m_wheelCount;
+    for (size_t i = 0; i < count; ++i)
     {
-        rollover = true;
+        if (m_wheels[i].load()->size())
+        {
+            return true;
+        }
     }
-    m_previouseTime = now_ms;
-    return rollover;
+    return false;
 }
-} // namespace sylar
\ No newline at end of file
+
+} // namespace sylar
@@ -2,17 +2,19 @@
 #define __SYLAR_TIMER_H__
 
 #include "thread.h"
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
-#include <set>
 #include <vector>
 namespace sylar
 {
 class TimerManager;
+class TimerWheel;
 class Timer : public std::enable_shared_from_this<Timer>
 {
     friend class TimerManager;
+    friend class TimerWheel;
 
 public:
     typedef std::shared_ptr<Timer> ptr;
@@ -20,30 +22,42 @@ public:
     bool cancel();
     bool refresh();
     bool reset(uint64_t ms, bool from_now = false);
+    /// 换上新的回调，从现在开始 ms 后触发；不管之前是否已经触发或者取消，复用这个对象
+    void restart(uint64_t ms, std::function<void()> cb);
 
 private:
-    Timer(uint64_t ms, std::function<void()> cb, TimerManager *manager, bool recurring = false);
-    Timer(uint64_t next);
-
-private:
-    struct Comparator
-    {
-        bool operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const;
-    };
+    Timer(uint64_t ms, std::function<void()> cb, TimerWheel *wheel, bool recurring = false);
 
 private:
     /// 定时器间隔时间（毫秒）
     uint64_t m_ms = 0;
     /// 定时器回调函数
     std::function<void()> m_cb;
-    /// 定时器管理器
-    TimerManager *m_manager = nullptr;
+    /// 所属的时间轮，创建后不再变化
+    TimerWheel *m_wheel = nullptr;
     //是否重复触发
     bool m_recurring = false;
     /// 下次触发时间（毫秒）（精确的一个触发时间）
     uint64_t m_next = 0;
+
+    /// 挂在时间轮槽位链表上时持有自己，保证回调触发前不被释放
+    Timer::ptr m_self;
+    /// 槽位链表的后继，以及指向前驱 next 指针（或者槽位头）的指针，摘除是 O(1)
+    Timer *m_link = nullptr;
+    Timer **m_pprev = nullptr;
+    uint8_t m_level = 0;
+    uint16_t m_slot = 0;
 };
 
+/**
+ * @brief 定时器管理
+ *
+ * 定时器放在分层时间轮里（1ms 一格，5 层共 2^32 ms），插入和取消都是 O(1)。
+ * 每个添加定时器的线程有自己的一个时间轮和锁，互相之间不争用；
+ * 过期检查和最近超时时间则遍历所有时间轮。
+ * 时间用单调时钟，不受系统时间调整影响。过期检查用调度线程缓存的 CoarseMonoMs；
+ * 算触发时间时读精确值，否则长任务里加的定时器会提前触发。
+ */
 class TimerManager
 {
     friend class Timer;
@@ -67,21 +81,26 @@ public:
 
 protected:
     virtual void onTimerInsertedAtFront() = 0;
-    void addTimer(Timer::ptr val, RWMutexType::WriteLock &lock);
+    /// 新定时器比空闲线程正在等的时间更早时通知它们重新计算超时
+    void onTimerAdded(uint64_t next);
 
 private:
-    /// 检测是否发生了时钟回拨
-    bool detectClockRollover(uint64_t now_ms);
+    /// 当前线程使用的时间轮，第一次用时创建
+    TimerWheel *getWheel();
 
 private:
-    /// 定时器集合
-    std::set<Timer::ptr, Timer::Comparator> m_timers;
-    /// 读写锁
-    RWMutexType m_mutex;
+    static const size_t kMaxWheels = 128;
+    /// 每个线程一个时间轮，线程数超过上限时按序号共用
+    std::atomic<TimerWheel *> m_wheels[kMaxWheels];
+    std::atomic<size_t> m_wheelCount = {0};
+    /// 只在注册新时间轮时使用
+    Mutex m_wheelMutex;
+    /// 区分先后创建在同一地址上的 TimerManager，线程局部缓存用它判断是否失效
+    uint64_t m_id = 0;
     /// 用于通知epoll是否有新的定时器修改或者插入，需要去执行的
-    bool m_tickled = false;
-    /// 上一次记录的时钟时间
-    uint64_t m_previouseTime = 0;
+    std::atomic<bool> m_tickled = {false};
+    /// 空闲线程上次计算出的最早触发时间（绝对时间），没有定时器时是 ~0ull
+    std::atomic<uint64_t> m_nextWake = {~0ull};
 };
 } // namespace sylar
-#endif
\ No newline at end of file
+#endif
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <dirent.h>
 #include <execinfo.h>
+#include <pthread.h>
 #include <signal.h>
 #include <sstream>
 #include <string.h>
@@ -17,9 +18,31 @@ namespace sylar
 
 // sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
 
+//每条日志都要取线程id，缓存起来省掉系统调用；fork 出来的子进程里清掉重新取
+static thread_local pid_t t_thread_id = 0;
+
+static void ResetThreadIdCache()
+{
+    t_thread_id = 0;
+}
+
+struct ThreadIdIniter
+{
+    ThreadIdIniter()
+    {
+        pthread_atfork(nullptr, nullptr, &ResetThreadIdCache);
+    }
+};
+
+static ThreadIdIniter s_thread_id_initer;
+
 pid_t GetThreadId()
 {
-    return syscall(SYS_gettid);
+    if (t_thread_id == 0)
+    {
+        t_thread_id = syscall(SYS_gettid);
+    }
+    return t_thread_id;
 }
 
 uint32_t GetFiberId()
@@ -80,6 +103,54 @@ uint64_t GetCurrentUS()
     return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
 }
 
+uint64_t GetMonotonicMS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+
+namespace
+{
+struct CoarseClock
+{
+    bool enabled = false;
+    uint64_t mono_ms = 0;
+    /// 墙上时间减单调时间，两个时钟同时读一次算出来，墙上时间 = mono_ms + wall_offset
+    uint64_t wall_offset = 0;
+};
+} // namespace
+
+static thread_local CoarseClock t_coarse_clock;
+
+uint64_t CoarseNowMs()
+{
+    const CoarseClock &c = t_coarse_clock;
+    return c.enabled ? c.mono_ms + c.wall_offset : GetCurrentMS();
+}
+
+uint64_t CoarseMonoMs()
+{
+    const CoarseClock &c = t_coarse_clock;
+    return c.enabled ? c.mono_ms : GetMonotonicMS();
+}
+
+void RefreshCoarseClock(bool wall)
+{
+    CoarseClock &c = t_coarse_clock;
+    c.mono_ms = GetMonotonicMS();
+    if (wall || !c.enabled)
+    {
+        c.wall_offset = GetCurrentMS() - c.mono_ms;
+    }
+    c.enabled = true;
+}
+
+void DisableCoarseClock()
+{
+    t_coarse_clock.enabled = false;
+}
+
 std::string Time2Str(time_t ts, const std::string &format)
 {
     struct tm tm;
@@ -28,6 +28,25 @@ uint32_t GetFiberID();
 //时间ms
 uint64_t GetCurrentMS();
 uint64_t GetCurrentUS();
+//单调时钟ms，不受系统时间调整影响，只能用来计算时间差
+uint64_t GetMonotonicMS();
+
+/**
+ * @brief 缓存的粗粒度时钟
+ *
+ * 调度线程每次从 epoll_wait 返回、每次切入任务前刷新一次线程局部的缓存，
+ * 同一个任务里的读取都只是读内存，不再陷入内核取时间；
+ * 不在调度线程上（没有刷新过）时退回到直接读时钟。
+ * 误差是当前任务从切入到现在已经运行的时间，只用在能容忍这点误差的地方
+ */
+//墙上时间ms，和 GetCurrentMS 同一基准
+uint64_t CoarseNowMs();
+//单调时间ms，和 GetMonotonicMS 同一基准
+uint64_t CoarseMonoMs();
+//刷新当前线程的缓存并开始使用它；wall=false 时只读单调时钟，墙上时间沿用上次的偏移
+void RefreshCoarseClock(bool wall = true);
+//当前线程停止使用缓存
+void DisableCoarseClock();
 
 std::string Time2Str(time_t ts = time(0), const std::string &format = "%Y-%m-%d %H:%M:%S");
 
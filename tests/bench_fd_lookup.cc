@@ -0,0 +1,178 @@
+#include "sylar/epoch.h"
+#include "sylar/fd_manager.h"
+#include "sylar/hook.h"
+#include "sylar/log.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+#include <cstdlib>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief fd 上下文查找的并发基准：分段无锁表 vs 原来的读写锁 + vector<shared_ptr>
+ *
+ * 每个线程反复查找 fd 上下文，分两种情况：
+ * 1. 每个线程用自己的 fd
+ * 2. 所有线程查同一个 fd（shared_ptr 的引用计数在同一个缓存行上）
+ * 最后每个线程在自己的 socket 上反复做 hook 过的 recv(MSG_PEEK)，看整条 hook 路径的开销。
+ *
+ * 用法：bench_fd_lookup [每个线程的次数] [线程数]
+ */
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+namespace
+{
+
+// 原来 FdManager 的数据结构，作为对照
+class LockedFdTable
+{
+public:
+    sylar::FdCtx::ptr get(int fd)
+    {
+        sylar::RWMutex::ReadLock lock(m_mutex);
+        if ((int)m_datas.size() <= fd)
+        {
+            return nullptr;
+        }
+        return m_datas[fd];
+    }
+
+    void set(int fd, sylar::FdCtx::ptr ctx)
+    {
+        sylar::RWMutex::WriteLock lock(m_mutex);
+        if ((int)m_datas.size() <= fd)
+        {
+            m_datas.resize(fd + 1);
+        }
+        m_datas[fd] = ctx;
+    }
+
+private:
+    sylar::RWMutex m_mutex;
+    std::vector<sylar::FdCtx::ptr> m_datas;
+};
+
+size_t s_count = 1000000;
+size_t s_threads = 32;
+std::vector<int> s_socks;
+
+void Report(const char *name, size_t ops, uint64_t cost_us)
+{
+    SYLAR_LOG_INFO(g_logger) << name << ": threads=" << s_threads << " ops=" << ops
+                             << " cost_us=" << cost_us
+                             << " ns/op=" << (cost_us * 1000.0 / ops);
+}
+
+// func(线程序号) 执行一次操作，返回值累加起来防止被优化掉
+template <class Func> void bench(const char *name, size_t count, Func func)
+{
+    std::vector<std::thread> threads;
+    std::vector<size_t> sums(s_threads);
+    uint64_t start = sylar::GetCurrentUS();
+    for (size_t t = 0; t < s_threads; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                size_t sum = 0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    sum += func(t);
+                }
+                sums[t] = sum;
+            });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    Report(name, count * s_threads, sylar::GetCurrentUS() - start);
+}
+
+void bench_lookup()
+{
+    LockedFdTable locked;
+    for (int fd : s_socks)
+    {
+        locked.set(fd, sylar::FdMgr::GetInstance()->get(fd));
+    }
+    sylar::FdManager *mgr = sylar::FdMgr::GetInstance();
+    int shared_fd = s_socks[0];
+
+    bench("rwlock+shared_ptr own fd", s_count,
+          [&](size_t t) { return (size_t)locked.get(s_socks[t * 2])->isSocket(); });
+    bench("lock-free get own fd", s_count,
+          [&](size_t t) { return (size_t)mgr->get(s_socks[t * 2])->isSocket(); });
+    bench("lock-free lookup own fd", s_count,
+          [&](size_t t)
+          {
+              sylar::EpochGuard guard;
+              return (size_t)mgr->lookup(s_socks[t * 2])->isSocket();
+          });
+
+    bench("rwlock+shared_ptr same fd", s_count,
+          [&](size_t) { return (size_t)locked.get(shared_fd)->isSocket(); });
+    bench("lock-free get same fd", s_count,
+          [&](size_t) { return (size_t)mgr->get(shared_fd)->isSocket(); });
+    bench("lock-free lookup same fd", s_count,
+          [&](size_t)
+          {
+              sylar::EpochGuard guard;
+              return (size_t)mgr->lookup(shared_fd)->isSocket();
+          });
+}
+
+void bench_hooked_recv()
+{
+    bench("hooked recv(MSG_PEEK)", s_count / 10,
+          [&](size_t t)
+          {
+              sylar::set_hook_enable(true);
+              char c = 0;
+              return (size_t)recv(s_socks[t * 2], &c, 1, MSG_PEEK);
+          });
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    s_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    s_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 32;
+    if (s_count < 10)
+    {
+        s_count = 10;
+    }
+    if (s_threads == 0)
+    {
+        s_threads = 1;
+    }
+    // 每个线程一对 socket，对端写一个字节，MSG_PEEK 读它永远不会阻塞
+    for (size_t i = 0; i < s_threads; ++i)
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+        {
+            SYLAR_LOG_ERROR(g_logger) << "socketpair failed";
+            return 1;
+        }
+        sylar::FdMgr::GetInstance()->get(sv[0], true);
+        sylar::FdMgr::GetInstance()->get(sv[1], true);
+        write(sv[1], "x", 1);
+        s_socks.push_back(sv[0]);
+        s_socks.push_back(sv[1]);
+    }
+    bench_lookup();
+    bench_hooked_recv();
+    for (int fd : s_socks)
+    {
+        sylar::FdMgr::GetInstance()->del(fd);
+        close(fd);
+    }
+    return 0;
+}
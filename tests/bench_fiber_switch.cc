@@ -0,0 +1,120 @@
+#include "sylar/fiber.h"
+#include "sylar/fiber_context.h"
+#include "sylar/log.h"
+#include "sylar/iomanager.h"
+#include "sylar/util.h"
+
+#include <cstdlib>
+#include <ucontext.h>
+#include <vector>
+
+/**
+ * @brief 协程切换微基准
+ *
+ * 分三组输出每秒切换次数：
+ * 1. FiberContext 裸切换（当前构建选择的后端）
+ * 2. libc swapcontext 裸切换（作为对照，每次切换带一次 rt_sigprocmask）
+ * 3. 调度器里 Fiber::YieldToReady 往返（包含调度队列开销）
+ *
+ * 用法：bench_fiber_switch [次数]
+ */
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+namespace
+{
+
+const size_t kStackSize = 64 * 1024;
+uint64_t s_rounds = 0;
+
+sylar::FiberContext s_main_ctx;
+sylar::FiberContext s_child_ctx;
+
+void ContextEntry()
+{
+    while (true)
+    {
+        s_child_ctx.swapTo(s_main_ctx);
+    }
+}
+
+ucontext_t s_main_uc;
+ucontext_t s_child_uc;
+
+void UcontextEntry()
+{
+    while (true)
+    {
+        swapcontext(&s_child_uc, &s_main_uc);
+    }
+}
+
+void Report(const char *name, uint64_t switches, uint64_t cost_us)
+{
+    double seconds = cost_us ? cost_us / 1000000.0 : 1e-6;
+    SYLAR_LOG_INFO(g_logger) << name << ": switches=" << switches << " cost_us=" << cost_us
+                             << " switches/s=" << (uint64_t)(switches / seconds)
+                             << " ns/switch=" << (cost_us * 1000.0 / switches);
+}
+
+void bench_fiber_context()
+{
+    std::vector<char> stack(kStackSize);
+    s_main_ctx.init();
+    s_child_ctx.make(&stack[0], kStackSize, &ContextEntry);
+    uint64_t start = sylar::GetCurrentUS();
+    for (uint64_t i = 0; i < s_rounds; ++i)
+    {
+        s_main_ctx.swapTo(s_child_ctx);
+    }
+    Report(sylar::FiberContext::Backend(), s_rounds * 2, sylar::GetCurrentUS() - start);
+}
+
+void bench_swapcontext()
+{
+    std::vector<char> stack(kStackSize);
+    getcontext(&s_child_uc);
+    s_child_uc.uc_link = nullptr;
+    s_child_uc.uc_stack.ss_sp = &stack[0];
+    s_child_uc.uc_stack.ss_size = kStackSize;
+    makecontext(&s_child_uc, &UcontextEntry, 0);
+    uint64_t start = sylar::GetCurrentUS();
+    for (uint64_t i = 0; i < s_rounds; ++i)
+    {
+        swapcontext(&s_main_uc, &s_child_uc);
+    }
+    Report("libc swapcontext", s_rounds * 2, sylar::GetCurrentUS() - start);
+}
+
+void bench_scheduler_yield()
+{
+    uint64_t start = 0;
+    {
+        sylar::IOManager iom(1, true, "bench");
+        iom.schedule(
+            [&start]()
+            {
+                start = sylar::GetCurrentUS();
+                for (uint64_t i = 0; i < s_rounds; ++i)
+                {
+                    sylar::Fiber::YieldToReady();
+                }
+            });
+    }
+    Report("scheduler YieldToReady", s_rounds * 2, sylar::GetCurrentUS() - start);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    s_rounds = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    if (s_rounds == 0)
+    {
+        s_rounds = 1;
+    }
+    bench_fiber_context();
+    bench_swapcontext();
+    bench_scheduler_yield();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "sylar/log.h"
+#include "sylar/util.h"
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 日志热路径基准
+ *
+ * 级别不够被过滤掉的日志、格式化以后直接丢掉的日志（只算构造事件和格式化）、
+ * printf 风格的日志，以及 AsyncLogAppender 写 /dev/null。
+ *
+ * 用法：bench_log [每个线程的条数] [线程数]
+ */
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+namespace
+{
+
+// 按 formatter 格式化以后扔掉
+class NullLogAppender : public sylar::LogAppender
+{
+public:
+    void log(sylar::Logger::ptr logger,
+             sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {
+        static thread_local std::string t_buf;
+        t_buf.clear();
+        m_formatter->format(t_buf, level, *event);
+        bytes += t_buf.size();
+    }
+    std::string toYamlString() override
+    {
+        return "";
+    }
+
+    uint64_t bytes = 0;
+};
+
+size_t s_count = 1000000;
+size_t s_threads = 1;
+
+template <class Func> void bench(const char *name, Func func)
+{
+    std::vector<std::thread> threads;
+    uint64_t start = sylar::GetCurrentUS();
+    for (size_t t = 0; t < s_threads; ++t)
+    {
+        threads.emplace_back(
+            [&]()
+            {
+                for (size_t i = 0; i < s_count; ++i)
+                {
+                    func(i);
+                }
+            });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - start;
+    size_t ops = s_count * s_threads;
+    SYLAR_LOG_INFO(g_logger) << name << ": threads=" << s_threads << " ops=" << ops
+                             << " cost_us=" << cost << " ns/op=" << (cost * 1000.0 / ops);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    s_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    s_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1;
+    if (s_threads == 0)
+    {
+        s_threads = 1;
+    }
+
+    sylar::Logger::ptr logger(new sylar::Logger("bench"));
+    logger->setLevel(sylar::LogLevel::INFO);
+    logger->addAppender(std::make_shared<NullLogAppender>());
+
+    bench("disabled", [&](size_t i) { SYLAR_LOG_DEBUG(logger) << "value=" << i; });
+    bench("enabled", [&](size_t i)
+          { SYLAR_LOG_INFO(logger) << "request done path=/api/v1/chat status=" << 200
+                                   << " cost=" << i; });
+    bench("enabled fmt", [&](size_t i)
+          { SYLAR_LOG_FMT_INFO(logger, "request done path=%s status=%d cost=%zu",
+                               "/api/v1/chat", 200, i); });
+
+    sylar::Logger::ptr async(new sylar::Logger("bench_async"));
+    async->setLevel(sylar::LogLevel::INFO);
+    sylar::AsyncLogAppender::ptr appender(new sylar::AsyncLogAppender("/dev/null", 1 << 20));
+    async->addAppender(appender);
+    bench("async /dev/null", [&](size_t i)
+          { SYLAR_LOG_INFO(async) << "request done path=/api/v1/chat status=" << 200
+                                  << " cost=" << i; });
+    appender->flush();
+    SYLAR_LOG_INFO(g_logger) << "async dropped=" << appender->getDroppedCount()
+                             << " writes=" << appender->getWriteCount();
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "sylar/http/servlet.h"
+#include "sylar/log.h"
+#include "sylar/mutex.h"
+#include "sylar/util.h"
+
+#include <cstdlib>
+#include <fnmatch.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 路由匹配基准：前缀树快照 vs 原来的 unordered_map + 逐个 fnmatch
+ *
+ * 注册 N 条 "/svcX/" 加 '*' 的通配路由和 N 条精确路由，分别查精确路径、落在最后一条通配上的路径
+ * 和什么都匹配不上的路径。
+ *
+ * 用法：bench_servlet_dispatch [路由数] [每个线程的次数] [线程数]
+ */
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+namespace
+{
+
+// 原来 ServletDispatch::getMatchedServlet 的做法，作为对照
+class LinearDispatch
+{
+public:
+    void addServlet(const std::string &uri, sylar::http::Servlet::ptr slt)
+    {
+        m_datas[uri] = slt;
+    }
+    void addGlobServlet(const std::string &uri, sylar::http::Servlet::ptr slt)
+    {
+        m_globs.push_back(std::make_pair(uri, slt));
+    }
+    sylar::http::Servlet::ptr getMatchedServlet(const std::string &uri)
+    {
+        sylar::RWMutex::ReadLock lock(m_mutex);
+        auto mit = m_datas.find(uri);
+        if (mit != m_datas.end())
+        {
+            return mit->second;
+        }
+        for (auto &i : m_globs)
+        {
+            if (!fnmatch(i.first.c_str(), uri.c_str(), 0))
+            {
+                return i.second;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    sylar::RWMutex m_mutex;
+    std::unordered_map<std::string, sylar::http::Servlet::ptr> m_datas;
+    std::vector<std::pair<std::string, sylar::http::Servlet::ptr>> m_globs;
+};
+
+size_t s_routes = 500;
+size_t s_count = 200000;
+size_t s_threads = 4;
+
+template <class Func> void bench(const char *name, Func func)
+{
+    std::vector<std::thread> threads;
+    uint64_t start = sylar::GetCurrentUS();
+    for (size_t t = 0; t < s_threads; ++t)
+    {
+        threads.emplace_back(
+            [&]()
+            {
+                for (size_t i = 0; i < s_count; ++i)
+                {
+                    func();
+                }
+            });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    uint64_t cost = sylar::GetCurrentUS() - start;
+    size_t ops = s_count * s_threads;
+    SYLAR_LOG_INFO(g_logger) << name << ": routes=" << s_routes << " threads=" << s_threads
+                             << " ops=" << ops << " cost_us=" << cost
+                             << " ns/op=" << (cost * 1000.0 / ops);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    s_routes = argc > 1 ? strtoull(argv[1], nullptr, 10) : 500;
+    s_count = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200000;
+    s_threads = argc > 3 ? strtoull(argv[3], nullptr, 10) : 4;
+    if (s_routes == 0)
+    {
+        s_routes = 1;
+    }
+    if (s_threads == 0)
+    {
+        s_threads = 1;
+    }
+
+    auto slt = std::make_shared<sylar::http::FunctionServlet>(
+        [](sylar::http::HttpRequest::ptr, sylar::http::HttpResponse::ptr,
+           sylar::http::HttpSession::ptr) { return 0; });
+    LinearDispatch linear;
+    sylar::http::ServletDispatch tree;
+    for (size_t i = 0; i < s_routes; ++i)
+    {
+        std::string n = std::to_string(i);
+        linear.addServlet("/exact" + n + "/info", slt);
+        tree.addServlet("/exact" + n + "/info", slt);
+        linear.addGlobServlet("/svc" + n + "/*", slt);
+        tree.addGlobServlet("/svc" + n + "/*", slt);
+    }
+    std::string exact = "/exact" + std::to_string(s_routes / 2) + "/info";
+    std::string last_glob = "/svc" + std::to_string(s_routes - 1) + "/v1/chat/completions";
+    std::string miss = "/unknown/v1/chat/completions";
+
+    bench("linear exact", [&]() { linear.getMatchedServlet(exact); });
+    bench("tree exact", [&]() { tree.getMatchedServlet(exact); });
+    bench("linear last glob", [&]() { linear.getMatchedServlet(last_glob); });
+    bench("tree last glob", [&]() { tree.getMatchedServlet(last_glob); });
+    bench("linear miss", [&]() { linear.getMatchedServlet(miss); });
+    bench("tree miss", [&]() { tree.getMatchedServlet(miss); });
+    return 0;
+}
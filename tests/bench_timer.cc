@@ -0,0 +1,190 @@
+#include "sylar/log.h"
+#include "sylar/thread.h"
+#include "sylar/timer.h"
+#include "sylar/util.h"
+
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 定时器微基准：时间轮 vs 原来的 std::set + 读写锁
+ *
+ * 模拟大量 socket 同时挂着超时：先放入 N 个 1~60 秒的定时器，再分别测
+ * 1. 单线程逐个添加、逐个取消的耗时
+ * 2. 多个线程在 N 个存量定时器的基础上并发 "添加后马上取消"（hook 里每次 IO 等待的模式）
+ *
+ * 用法：bench_timer [定时器个数] [线程数]
+ */
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+namespace
+{
+
+// 原来 TimerManager 的数据结构，作为对照
+class SetTimerQueue
+{
+public:
+    struct Item
+    {
+        uint64_t next = 0;
+        std::function<void()> cb;
+    };
+    typedef std::shared_ptr<Item> ItemPtr;
+
+    ItemPtr add(uint64_t ms, std::function<void()> cb)
+    {
+        ItemPtr item(new Item);
+        item->next = sylar::GetCurrentMS() + ms;
+        item->cb = cb;
+        sylar::RWMutex::WriteLock lock(m_mutex);
+        m_items.insert(item);
+        return item;
+    }
+
+    void cancel(const ItemPtr &item)
+    {
+        sylar::RWMutex::WriteLock lock(m_mutex);
+        auto it = m_items.find(item);
+        if (it != m_items.end())
+        {
+            m_items.erase(it);
+        }
+    }
+
+private:
+    struct Comparator
+    {
+        bool operator()(const ItemPtr &lhs, const ItemPtr &rhs) const
+        {
+            if (lhs->next != rhs->next)
+            {
+                return lhs->next < rhs->next;
+            }
+            return lhs.get() < rhs.get();
+        }
+    };
+    sylar::RWMutex m_mutex;
+    std::set<ItemPtr, Comparator> m_items;
+};
+
+class BenchTimerManager : public sylar::TimerManager
+{
+protected:
+    void onTimerInsertedAtFront() override
+    {
+    }
+};
+
+size_t s_count = 1000000;
+size_t s_threads = 4;
+std::vector<uint64_t> s_delays;
+
+void Report(const char *name, size_t ops, uint64_t cost_us)
+{
+    SYLAR_LOG_INFO(g_logger) << name << ": ops=" << ops << " cost_us=" << cost_us
+                             << " ns/op=" << (cost_us * 1000.0 / ops);
+}
+
+template <class Add, class Cancel> void bench_single(const char *name, Add add, Cancel cancel)
+{
+    std::string prefix(name);
+    uint64_t start = sylar::GetCurrentUS();
+    for (size_t i = 0; i < s_count; ++i)
+    {
+        add(i);
+    }
+    Report((prefix + " add").c_str(), s_count, sylar::GetCurrentUS() - start);
+    start = sylar::GetCurrentUS();
+    for (size_t i = 0; i < s_count; ++i)
+    {
+        cancel(i);
+    }
+    Report((prefix + " cancel").c_str(), s_count, sylar::GetCurrentUS() - start);
+}
+
+template <class AddCancel> void bench_concurrent(const char *name, AddCancel add_cancel)
+{
+    size_t per_thread = s_count / s_threads;
+    std::vector<std::thread> threads;
+    uint64_t start = sylar::GetCurrentUS();
+    for (size_t t = 0; t < s_threads; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (size_t i = 0; i < per_thread; ++i)
+                {
+                    add_cancel(s_delays[(t * per_thread + i) % s_delays.size()]);
+                }
+            });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    Report(name, per_thread * s_threads, sylar::GetCurrentUS() - start);
+}
+
+void bench_set()
+{
+    SetTimerQueue queue;
+    std::vector<SetTimerQueue::ItemPtr> items(s_count);
+    bench_single(
+        "std::set", [&](size_t i) { items[i] = queue.add(s_delays[i], []() {}); },
+        [&](size_t i) { queue.cancel(items[i]); });
+    for (size_t i = 0; i < s_count; ++i)
+    {
+        items[i] = queue.add(s_delays[i], []() {});
+    }
+    bench_concurrent("std::set concurrent add+cancel",
+                     [&](uint64_t ms) { queue.cancel(queue.add(ms, []() {})); });
+}
+
+void bench_wheel()
+{
+    BenchTimerManager mgr;
+    std::vector<sylar::Timer::ptr> timers(s_count);
+    bench_single(
+        "timing wheel", [&](size_t i) { timers[i] = mgr.addTimer(s_delays[i], []() {}); },
+        [&](size_t i) { timers[i]->cancel(); });
+    for (size_t i = 0; i < s_count; ++i)
+    {
+        timers[i] = mgr.addTimer(s_delays[i], []() {});
+    }
+    bench_concurrent("timing wheel concurrent add+cancel",
+                     [&](uint64_t ms) { mgr.addTimer(ms, []() {})->cancel(); });
+    for (auto &i : timers)
+    {
+        i->cancel();
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    s_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    s_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 4;
+    if (s_count == 0)
+    {
+        s_count = 1;
+    }
+    if (s_threads == 0)
+    {
+        s_threads = 1;
+    }
+    srand(1);
+    s_delays.resize(s_count);
+    for (auto &i : s_delays)
+    {
+        i = 1000 + rand() % 59000;
+    }
+    bench_set();
+    bench_wheel();
+    return 0;
+}
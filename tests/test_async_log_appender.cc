@@ -0,0 +1,401 @@
+#include "sylar/config.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+
+namespace
+{
+
+sylar::Logger::ptr NewLogger(const std::string &name, sylar::LogAppender::ptr appender)
+{
+    sylar::Logger::ptr logger(new sylar::Logger(name));
+    appender->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    return logger;
+}
+
+std::vector<std::string> SplitLines(const std::string &data)
+{
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            end = data.size();
+        }
+        lines.push_back(data.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return lines;
+}
+
+std::string ReadAll(int fd)
+{
+    std::string data;
+    char buf[4096];
+    ssize_t n = 0;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        data.append(buf, n);
+    }
+    return data;
+}
+
+// 多个线程同时写，一条不少，同一线程内顺序不变，write 次数远少于日志条数
+void test_multi_thread()
+{
+    const int threads = 4;
+    const int count = 5000;
+    std::string path = "/tmp/test_async_log_" + std::to_string(getpid()) + ".log";
+    unlink(path.c_str());
+    uint64_t writes = 0;
+    {
+        sylar::AsyncLogAppender::ptr appender(new sylar::AsyncLogAppender(path, 4096));
+        auto logger = NewLogger("async_mt", appender);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([logger, t]() {
+                for (int i = 0; i < count; ++i)
+                {
+                    SYLAR_LOG_INFO(logger) << t << " " << i;
+                }
+            });
+        }
+        for (auto &i : workers)
+        {
+            i.join();
+        }
+        appender->flush();
+        EXPECT_EQ(appender->getDroppedCount(), 0u);
+        writes = appender->getWriteCount();
+    }
+
+    std::ifstream ifs(path);
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::vector<std::string> lines = SplitLines(data);
+    EXPECT_EQ(lines.size(), (size_t)(threads * count));
+    std::vector<int> next(threads, 0);
+    for (auto &l : lines)
+    {
+        int t = -1;
+        int i = -1;
+        if (sscanf(l.c_str(), "%d %d", &t, &i) != 2 || t < 0 || t >= threads)
+        {
+            ++g_failures;
+            SYLAR_LOG_ERROR(g_logger) << "bad line: " << l;
+            break;
+        }
+        EXPECT_EQ(i, next[t]);
+        next[t] = i + 1;
+    }
+    EXPECT_TRUE(writes > 0 && writes < (uint64_t)(threads * count) / 10);
+    unlink(path.c_str());
+}
+
+// 输出卡住（管道没人读）时 DROP 直接丢，写出去的加丢掉的正好是总数
+void test_drop()
+{
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    std::string path = "/proc/self/fd/" + std::to_string(fds[1]);
+    const int count = 2000;
+    std::string data;
+    uint64_t dropped = 0;
+    {
+        sylar::AsyncLogAppender::ptr appender(new sylar::AsyncLogAppender(path, 4096));
+        appender->setOverflowPolicy(sylar::AsyncLogAppender::DROP);
+        auto logger = NewLogger("async_drop", appender);
+        std::string pad(100, 'x');
+        for (int i = 0; i < count; ++i)
+        {
+            SYLAR_LOG_INFO(logger) << i << " " << pad;
+        }
+        dropped = appender->getDroppedCount();
+        EXPECT_TRUE(dropped > 0);
+
+        std::thread reader([&]() { data = ReadAll(fds[0]); });
+        appender->flush();
+        appender.reset();
+        logger.reset();
+        close(fds[1]);
+        reader.join();
+    }
+    close(fds[0]);
+    std::vector<std::string> lines = SplitLines(data);
+    EXPECT_EQ(lines.size() + dropped, (size_t)count);
+    int last = -1;
+    for (auto &l : lines)
+    {
+        int i = atoi(l.c_str());
+        EXPECT_TRUE(i > last);
+        last = i;
+    }
+}
+
+// DROP_BELOW_LEVEL：低级别的丢，WARN 及以上的等到有空间，一条不丢
+void test_drop_below_level()
+{
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    std::string path = "/proc/self/fd/" + std::to_string(fds[1]);
+    // 先把管道塞满，后台线程第一次 write 就卡住，不依赖写日志和后台线程谁快
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    std::string fill(4096, '\n');
+    while (write(fds[1], fill.data(), fill.size()) > 0)
+    {
+    }
+    std::string data;
+    {
+        sylar::AsyncLogAppender::ptr appender(new sylar::AsyncLogAppender(path, 4096));
+        appender->setOverflowPolicy(sylar::AsyncLogAppender::DROP_BELOW_LEVEL);
+        appender->setDropLevel(sylar::LogLevel::WARN);
+        auto logger = NewLogger("async_level", appender);
+        std::string pad(100, 'x');
+        for (int i = 0; i < 2000; ++i)
+        {
+            SYLAR_LOG_DEBUG(logger) << "debug " << i << " " << pad;
+        }
+        uint64_t dropped = appender->getDroppedCount();
+        EXPECT_TRUE(dropped > 0);
+
+        std::atomic<bool> done(false);
+        std::thread writer([&]() {
+            for (int i = 0; i < 200; ++i)
+            {
+                SYLAR_LOG_ERROR(logger) << "error " << i << " " << pad;
+            }
+            done = true;
+        });
+        // 缓冲是满的，ERROR 要等
+        usleep(50 * 1000);
+        EXPECT_TRUE(!done);
+        std::thread reader([&]() { data = ReadAll(fds[0]); });
+        writer.join();
+        appender->flush();
+        EXPECT_EQ(appender->getDroppedCount(), dropped);
+        appender.reset();
+        logger.reset();
+        close(fds[1]);
+        reader.join();
+    }
+    close(fds[0]);
+    int errors = 0;
+    for (auto &l : SplitLines(data))
+    {
+        if (l.compare(0, 6, "error ") == 0)
+        {
+            EXPECT_EQ(atoi(l.c_str() + 6), errors);
+            ++errors;
+        }
+    }
+    EXPECT_EQ(errors, 200);
+}
+
+// 配置里写 AsyncLogAppender，appender 真的加上去了
+void test_config()
+{
+    std::string path = "/tmp/test_async_log_conf_" + std::to_string(getpid()) + ".log";
+    unlink(path.c_str());
+    YAML::Node root = YAML::Load("logs:\n"
+                                 "  - name: async_conf\n"
+                                 "    level: info\n"
+                                 "    formatter: '%m%n'\n"
+                                 "    appenders:\n"
+                                 "      - type: AsyncLogAppender\n"
+                                 "        file: " +
+                                 path +
+                                 "\n"
+                                 "        overflow: drop_below_level\n"
+                                 "        drop_level: ERROR\n"
+                                 "        buffer_size: 10000\n");
+    sylar::Config::LoadFromYaml(root);
+    auto logger = SYLAR_LOG_NAME("async_conf");
+    std::string yaml = logger->toYamlString();
+    EXPECT_TRUE(yaml.find("AsyncLogAppender") != std::string::npos);
+    EXPECT_TRUE(yaml.find("drop_below_level") != std::string::npos);
+    EXPECT_TRUE(yaml.find("16384") != std::string::npos);
+    SYLAR_LOG_INFO(logger) << "from config";
+    SYLAR_LOG_DEBUG(logger) << "filtered";
+
+    // 换掉配置，旧的 appender 析构时把剩下的写完
+    sylar::Config::LoadFromYaml(YAML::Load("logs:\n  - name: async_conf\n    level: info\n"));
+    std::ifstream ifs(path);
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(data, "from config\n");
+    unlink(path.c_str());
+}
+
+// 文件被移走以后后台线程发现 inode 变了，重新打开，后面的日志写到新文件
+void test_reopen_after_rename()
+{
+    std::string path = "/tmp/test_async_log_mv_" + std::to_string(getpid()) + ".log";
+    std::string moved = path + ".1";
+    unlink(path.c_str());
+    unlink(moved.c_str());
+    {
+        sylar::AsyncLogAppender::ptr appender(new sylar::AsyncLogAppender(path));
+        auto logger = NewLogger("async_mv", appender);
+        SYLAR_LOG_INFO(logger) << "before";
+        appender->flush();
+        EXPECT_EQ(rename(path.c_str(), moved.c_str()), 0);
+        // 检查周期是 1 秒
+        usleep(1500 * 1000);
+        SYLAR_LOG_INFO(logger) << "after";
+        appender->flush();
+    }
+    std::ifstream old_file(moved);
+    std::string old_data((std::istreambuf_iterator<char>(old_file)),
+                         std::istreambuf_iterator<char>());
+    std::ifstream new_file(path);
+    std::string new_data((std::istreambuf_iterator<char>(new_file)),
+                         std::istreambuf_iterator<char>());
+    EXPECT_EQ(old_data, "before\n");
+    EXPECT_EQ(new_data, "after\n");
+    unlink(path.c_str());
+    unlink(moved.c_str());
+}
+
+// fork 出来的子进程里后台线程要重新起来：BLOCK 的日志不会卡死，父进程还没写出去的不会写两遍
+void test_fork()
+{
+    const int count = 2000;
+    std::string path = "/tmp/test_async_log_fork_" + std::to_string(getpid()) + ".log";
+    unlink(path.c_str());
+    {
+        sylar::AsyncLogAppender::ptr appender(new sylar::AsyncLogAppender(path, 4096));
+        auto logger = NewLogger("async_fork", appender);
+        SYLAR_LOG_INFO(logger) << "parent before";
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            //后台线程没起来的话会一直等，让它超时失败
+            alarm(10);
+            for (int i = 0; i < count; ++i)
+            {
+                SYLAR_LOG_INFO(logger) << "child " << i;
+            }
+            appender->flush();
+            _exit(appender->getDroppedCount() == 0 ? 0 : 1);
+        }
+        EXPECT_TRUE(pid > 0);
+        int status = -1;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        SYLAR_LOG_INFO(logger) << "parent after";
+        appender->flush();
+    }
+
+    std::ifstream ifs(path);
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    int before = 0;
+    int after = 0;
+    int child = 0;
+    for (auto &l : SplitLines(data))
+    {
+        before += l == "parent before";
+        after += l == "parent after";
+        child += l.compare(0, 6, "child ") == 0;
+    }
+    EXPECT_EQ(before, 1);
+    EXPECT_EQ(after, 1);
+    EXPECT_EQ(child, count);
+    unlink(path.c_str());
+}
+
+// 写日志时让出协程的输出地
+class YieldLogAppender : public sylar::LogAppender
+{
+public:
+    void log(sylar::Logger::ptr, sylar::LogLevel::Level, sylar::LogEvent::ptr) override
+    {
+        ++entered;
+        //开了 hook，只让出当前协程
+        usleep(20 * 1000);
+        ++count;
+    }
+    std::string toYamlString() override
+    {
+        return "";
+    }
+
+    std::atomic<int> entered{0};
+    std::atomic<int> count{0};
+};
+
+// 输出地里让出协程时 logger 不能还锁着：同线程的其他协程要能改 appender 列表，
+// 锁着的话写锁等的是同一个线程上的读锁，永远等不到
+void test_yield_in_appender()
+{
+    std::shared_ptr<YieldLogAppender> appender(new YieldLogAppender);
+    sylar::Logger::ptr logger(new sylar::Logger("yield"));
+    logger->addAppender(appender);
+    std::atomic<bool> changed(false);
+    {
+        sylar::IOManager iom(1, false, "yield");
+        iom.schedule([logger]() { SYLAR_LOG_INFO(logger) << "slow"; });
+        iom.schedule([logger, appender, &changed]() {
+            while (appender->entered == 0)
+            {
+                usleep(1000);
+            }
+            logger->addAppender(sylar::LogAppender::ptr(new sylar::StdoutLogAppender));
+            logger->delAppender(appender);
+            changed = true;
+        });
+    }
+    EXPECT_TRUE(changed.load());
+    EXPECT_EQ(appender->count.load(), 1);
+}
+
+} // namespace
+
+int main()
+{
+    test_multi_thread();
+    test_drop();
+    test_drop_below_level();
+    test_config();
+    test_reopen_after_rename();
+    test_fork();
+    test_yield_in_appender();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+#include "sylar/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+const char *s_pattern = "%d{%Y-%m-%d %H:%M:%S} %t %N %F [%p] [%c] %f:%l %r %m%n";
+std::string s_dir;
+
+// 同样的日志按文本格式记下来，和解码出来的比
+class TextAppender : public sylar::LogAppender
+{
+public:
+    void log(sylar::Logger::ptr logger,
+             sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {
+        std::string str;
+        m_formatter->format(str, level, *event);
+        MutexType::Lock lock(m_mutex);
+        text += str;
+    }
+    std::string toYamlString() override
+    {
+        return "";
+    }
+
+    std::string text;
+};
+
+std::string Decode(const std::string &path, bool *error = nullptr)
+{
+    sylar::LogFormatter formatter(s_pattern);
+    sylar::BinaryLogReader reader;
+    std::string out;
+    if (!reader.open(path))
+    {
+        if (error)
+        {
+            *error = true;
+        }
+        return out;
+    }
+    sylar::LogEvent event;
+    while (reader.next(event))
+    {
+        formatter.format(out, event.getLevel(), event);
+    }
+    if (error)
+    {
+        *error = reader.isError();
+    }
+    return out;
+}
+
+std::vector<std::string> SplitLines(const std::string &data)
+{
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            end = data.size();
+        }
+        lines.push_back(data.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return lines;
+}
+
+std::vector<std::string> ListFiles(const std::string &prefix)
+{
+    std::vector<std::string> files;
+    DIR *d = opendir(s_dir.c_str());
+    if (!d)
+    {
+        return files;
+    }
+    struct dirent *dp = nullptr;
+    while ((dp = readdir(d)) != nullptr)
+    {
+        std::string name = dp->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0)
+        {
+            files.push_back(name);
+        }
+    }
+    closedir(d);
+    return files;
+}
+
+void RemoveFiles(const std::string &prefix)
+{
+    for (auto &i : ListFiles(prefix))
+    {
+        unlink((s_dir + "/" + i).c_str());
+    }
+}
+
+// 多个 logger、多个线程写进同一个文件，解码后按同样的 pattern 输出和文本的一模一样
+void test_roundtrip()
+{
+    std::string path = s_dir + "/roundtrip.bin";
+    sylar::BinaryLogAppender::ptr binary(new sylar::BinaryLogAppender(path));
+    std::shared_ptr<TextAppender> text = std::make_shared<TextAppender>();
+    text->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter(s_pattern)));
+    sylar::Logger::ptr a(new sylar::Logger("bin_a"));
+    sylar::Logger::ptr b(new sylar::Logger("bin_b"));
+    for (auto &i : {a, b})
+    {
+        i->addAppender(binary);
+        i->addAppender(text);
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t)
+    {
+        threads.emplace_back([a, b, t]() {
+            sylar::Thread::SetName("bin_" + std::to_string(t));
+            for (int i = 0; i < 300; ++i)
+            {
+                SYLAR_LOG_INFO(a) << "request " << i << " from " << t;
+                SYLAR_LOG_FMT_WARN(b, "upstream %d failed: %s", i, "timeout");
+            }
+        });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    std::string big(5000, 'q');
+    SYLAR_LOG_ERROR(a) << big;
+    SYLAR_LOG_DEBUG(b) << "";
+    binary->flush();
+
+    // 两个 appender 之间线程交错的顺序可能不同，排好序再比
+    bool error = false;
+    std::vector<std::string> decoded = SplitLines(Decode(path, &error));
+    std::vector<std::string> expected = SplitLines(text->text);
+    EXPECT_TRUE(!error);
+    EXPECT_EQ(decoded.size(), expected.size());
+    std::sort(decoded.begin(), decoded.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_TRUE(decoded == expected);
+
+    // 二进制的比文本的小得多
+    struct stat st;
+    EXPECT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_TRUE((size_t)st.st_size * 2 < text->text.size());
+    RemoveFiles("roundtrip.bin");
+}
+
+// 重新打开、轮转以后每个文件自带定义，可以单独解码；压缩过的也能直接读
+void test_rotate_and_reopen()
+{
+    std::string path = s_dir + "/rotate.bin";
+    sylar::BinaryLogAppender::ptr binary(new sylar::BinaryLogAppender(path));
+    binary->setMaxFiles(10);
+    sylar::Logger::ptr logger(new sylar::Logger("bin_rotate"));
+    logger->addAppender(binary);
+    SYLAR_LOG_INFO(logger) << "first";
+    EXPECT_TRUE(binary->rotate());
+    SYLAR_LOG_INFO(logger) << "second";
+    // 追加到已有内容后面，中间再写一个文件头
+    EXPECT_TRUE(binary->reopen());
+    SYLAR_LOG_INFO(logger) << "third";
+    binary->flush();
+
+    std::string current = Decode(path);
+    EXPECT_TRUE(current.find("second") != std::string::npos);
+    EXPECT_TRUE(current.find("third") != std::string::npos);
+    EXPECT_TRUE(current.find("first") == std::string::npos);
+
+    std::vector<std::string> rotated;
+    for (int i = 0; i < 100; ++i)
+    {
+        rotated = ListFiles("rotate.bin.");
+        if (rotated.size() == 1 && rotated[0].find(".gz") != std::string::npos)
+        {
+            break;
+        }
+        usleep(50 * 1000);
+    }
+    EXPECT_EQ(rotated.size(), 1u);
+    if (rotated.size() == 1)
+    {
+        std::string old = Decode(s_dir + "/" + rotated[0]);
+        EXPECT_TRUE(old.find("first") != std::string::npos);
+        EXPECT_TRUE(old.find("second") == std::string::npos);
+    }
+    RemoveFiles("rotate.bin");
+}
+
+// 最后一条只写了一半算正常结束，不是二进制日志的文件报错
+void test_truncated_and_invalid()
+{
+    std::string path = s_dir + "/truncated.bin";
+    {
+        sylar::BinaryLogAppender::ptr binary(new sylar::BinaryLogAppender(path));
+        sylar::Logger::ptr logger(new sylar::Logger("bin_truncated"));
+        logger->addAppender(binary);
+        SYLAR_LOG_INFO(logger) << "complete";
+        SYLAR_LOG_INFO(logger) << "partial record";
+    }
+    struct stat st;
+    EXPECT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(truncate(path.c_str(), st.st_size - 3), 0);
+    bool error = true;
+    std::string out = Decode(path, &error);
+    EXPECT_TRUE(!error);
+    EXPECT_TRUE(out.find("complete") != std::string::npos);
+    EXPECT_TRUE(out.find("partial") == std::string::npos);
+
+    std::string text_path = s_dir + "/text.log";
+    {
+        std::ofstream ofs(text_path);
+        ofs << "2026-01-01 00:00:00 plain text\n";
+    }
+    error = false;
+    EXPECT_EQ(Decode(text_path, &error), "");
+    EXPECT_TRUE(error);
+    RemoveFiles("truncated.bin");
+    RemoveFiles("text.log");
+}
+
+// 字符串表、调用点表的 id 远超当前表长时报错，不照着它扩表
+void test_corrupt_table_id()
+{
+    std::string path = s_dir + "/corrupt.bin";
+    // 1 是字符串定义，2 是调用点定义，后面跟一个 2^56 的 id
+    const char types[] = {1, 2};
+    for (char type : types)
+    {
+        unlink(path.c_str());
+        {
+            sylar::BinaryLogAppender::ptr binary(new sylar::BinaryLogAppender(path));
+            sylar::Logger::ptr logger(new sylar::Logger("bin_corrupt"));
+            logger->addAppender(binary);
+            SYLAR_LOG_INFO(logger) << "complete";
+        }
+        std::string record(1, type);
+        record.append(8, (char)0x80);
+        record.push_back(1);
+        if (type == 2)
+        {
+            //行号
+            record.push_back(1);
+        }
+        record.push_back(1);
+        record.push_back('x');
+        {
+            std::ofstream ofs(path, std::ios::app | std::ios::binary);
+            ofs << record;
+        }
+        bool error = false;
+        std::string out = Decode(path, &error);
+        EXPECT_TRUE(error);
+        EXPECT_TRUE(out.find("complete") != std::string::npos);
+    }
+    RemoveFiles("corrupt.bin");
+}
+
+} // namespace
+
+int main()
+{
+    s_dir = "/tmp/test_binary_log_" + std::to_string(getpid());
+    mkdir(s_dir.c_str(), 0755);
+    test_roundtrip();
+    test_rotate_and_reopen();
+    test_truncated_and_invalid();
+    test_corrupt_table_id();
+    rmdir(s_dir.c_str());
+    return g_failures.load() == 0 ? 0 : 1;
+}
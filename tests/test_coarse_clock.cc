@@ -0,0 +1,131 @@
+#include "sylar/log.h"
+#include "sylar/iomanager.h"
+#include "sylar/util.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+bool Near(uint64_t a, uint64_t b, uint64_t diff)
+{
+    return a > b ? a - b <= diff : b - a <= diff;
+}
+
+// 没有刷新过的线程直接读时钟
+void test_fallback()
+{
+    EXPECT_TRUE(Near(sylar::CoarseNowMs(), sylar::GetCurrentMS(), 2));
+    EXPECT_TRUE(Near(sylar::CoarseMonoMs(), sylar::GetMonotonicMS(), 2));
+    uint64_t before = sylar::CoarseMonoMs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(sylar::CoarseMonoMs() >= before + 20);
+}
+
+// 刷新之后读的是缓存，直到下次刷新
+void test_refresh()
+{
+    sylar::RefreshCoarseClock();
+    uint64_t mono = sylar::CoarseMonoMs();
+    uint64_t wall = sylar::CoarseNowMs();
+    EXPECT_TRUE(Near(wall, sylar::GetCurrentMS(), 2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(sylar::CoarseMonoMs(), mono);
+    EXPECT_EQ(sylar::CoarseNowMs(), wall);
+
+    // 只刷新单调时钟，墙上时间跟着一起前进
+    sylar::RefreshCoarseClock(false);
+    EXPECT_TRUE(sylar::CoarseMonoMs() >= mono + 30);
+    EXPECT_TRUE(sylar::CoarseNowMs() >= wall + 30);
+    EXPECT_TRUE(Near(sylar::CoarseNowMs(), sylar::GetCurrentMS(), 2));
+
+    sylar::DisableCoarseClock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_TRUE(sylar::CoarseMonoMs() >= mono + 40);
+}
+
+// 调度线程上任务切入时刷新，任务里不让出就一直是同一个值
+void test_iomanager()
+{
+    std::atomic<int> done(0);
+    {
+        sylar::IOManager iom(2, false, "coarse");
+        iom.schedule(
+            [&done]()
+            {
+                uint64_t a = sylar::CoarseMonoMs();
+                EXPECT_TRUE(Near(a, sylar::GetMonotonicMS(), 2));
+                // 忙等，不让出（nanosleep 是 hook 住的）
+                uint64_t end = sylar::GetMonotonicMS() + 30;
+                while (sylar::GetMonotonicMS() < end)
+                {
+                }
+                EXPECT_EQ(sylar::CoarseMonoMs(), a);
+                // hook 住的 usleep 会让出，回来时已经刷新
+                usleep(20 * 1000);
+                uint64_t b = sylar::CoarseMonoMs();
+                EXPECT_TRUE(b >= a + 50);
+                EXPECT_TRUE(Near(b, sylar::GetMonotonicMS(), 2));
+                EXPECT_TRUE(Near(sylar::CoarseNowMs(), sylar::GetCurrentMS(), 2));
+                ++done;
+            });
+        // 来回切换很多次，单调时间不会倒退
+        for (int i = 0; i < 4; ++i)
+        {
+            iom.schedule(
+                [&done]()
+                {
+                    uint64_t last = sylar::CoarseMonoMs();
+                    for (int j = 0; j < 2000; ++j)
+                    {
+                        sylar::Fiber::YieldToReady();
+                        uint64_t now = sylar::CoarseMonoMs();
+                        EXPECT_TRUE(now >= last);
+                        last = now;
+                    }
+                    ++done;
+                });
+        }
+    }
+    EXPECT_EQ(done.load(), 5);
+}
+
+} // namespace
+
+int main()
+{
+    test_fallback();
+    test_refresh();
+    test_iomanager();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+#include "sylar/epoch.h"
+#include "sylar/fd_manager.h"
+#include "sylar/fd_table.h"
+#include "sylar/log.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+std::atomic<int> s_live(0);
+
+struct Item
+{
+    explicit Item(int v) : value(v)
+    {
+        ++s_live;
+    }
+    ~Item()
+    {
+        --s_live;
+    }
+    int value;
+};
+
+void test_table_basic()
+{
+    sylar::FdTable<Item> table;
+    EXPECT_TRUE(table.get(0) == nullptr);
+    EXPECT_TRUE(table.get(-1) == nullptr);
+    EXPECT_TRUE(table.get(1 << 30) == nullptr);
+    EXPECT_TRUE(table.install(-1, nullptr) == nullptr);
+
+    Item *a = new Item(1);
+    Item *b = new Item(2);
+    EXPECT_TRUE(table.install(5, a) == a);
+    // 已经有值时 install 不覆盖，返回原来的
+    EXPECT_TRUE(table.install(5, b) == a);
+    EXPECT_TRUE(table.get(5) == a);
+    // 跨段的 fd
+    EXPECT_TRUE(table.install(5000, b) == b);
+    EXPECT_EQ(table.get(5000)->value, 2);
+    EXPECT_TRUE(table.get(4999) == nullptr);
+
+    int count = 0;
+    table.forEach([&](Item *) { ++count; });
+    EXPECT_EQ(count, 2);
+
+    EXPECT_TRUE(table.exchange(5, nullptr) == a);
+    EXPECT_TRUE(table.get(5) == nullptr);
+    // 段不存在时换成 nullptr 什么也不做
+    EXPECT_TRUE(table.exchange(100000, nullptr) == nullptr);
+    delete a;
+    delete table.exchange(5000, nullptr);
+    EXPECT_EQ(s_live.load(), 0);
+}
+
+void test_epoch_defers_free()
+{
+    Item *item = new Item(7);
+    {
+        sylar::EpochGuard guard;
+        sylar::Epoch::Retire(item);
+        // 本线程还在临界区里，不管推进几次都不能释放
+        for (int i = 0; i < 5; ++i)
+        {
+            sylar::Epoch::Reclaim();
+        }
+        EXPECT_EQ(s_live.load(), 1);
+        EXPECT_EQ(item->value, 7);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        sylar::Epoch::Reclaim();
+    }
+    EXPECT_EQ(s_live.load(), 0);
+}
+
+void test_epoch_other_thread_blocks()
+{
+    std::atomic<int> stage(0);
+    std::thread reader(
+        [&]()
+        {
+            sylar::EpochGuard guard;
+            stage = 1;
+            while (stage.load() != 2)
+            {
+                std::this_thread::yield();
+            }
+        });
+    while (stage.load() != 1)
+    {
+        std::this_thread::yield();
+    }
+    sylar::Epoch::Retire(new Item(3));
+    for (int i = 0; i < 5; ++i)
+    {
+        sylar::Epoch::Reclaim();
+    }
+    EXPECT_EQ(s_live.load(), 1);
+    stage = 2;
+    reader.join();
+    for (int i = 0; i < 3; ++i)
+    {
+        sylar::Epoch::Reclaim();
+    }
+    EXPECT_EQ(s_live.load(), 0);
+}
+
+// 读者不停地查、写者不停地换，读到的对象必须一直有效
+void test_concurrent_replace()
+{
+    const int kFds = 64;
+    sylar::FdTable<Item> table;
+    for (int i = 0; i < kFds; ++i)
+    {
+        table.install(i, new Item(i));
+    }
+    std::atomic<bool> stop(false);
+    std::atomic<int> bad(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back(
+            [&, t]()
+            {
+                unsigned n = t;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    int fd = (n++ * 7) % kFds;
+                    sylar::EpochGuard guard;
+                    Item *item = table.get(fd);
+                    if (item && item->value % kFds != fd)
+                    {
+                        ++bad;
+                    }
+                }
+            });
+    }
+    for (int round = 1; round <= 20000; ++round)
+    {
+        int fd = round % kFds;
+        Item *old = table.exchange(fd, new Item(fd + round * kFds));
+        sylar::Epoch::Retire(old);
+    }
+    stop = true;
+    for (auto &i : readers)
+    {
+        i.join();
+    }
+    EXPECT_EQ(bad.load(), 0);
+    table.forEach([](Item *item) { delete item; });
+    for (int i = 0; i < 3; ++i)
+    {
+        sylar::Epoch::Reclaim();
+    }
+    EXPECT_EQ(s_live.load(), 0);
+}
+
+void test_fd_manager()
+{
+    int sv[2];
+    EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    sylar::FdManager *mgr = sylar::FdMgr::GetInstance();
+    EXPECT_TRUE(!mgr->get(sv[0]));
+    sylar::FdCtx::ptr ctx = mgr->get(sv[0], true);
+    EXPECT_TRUE(ctx && ctx->isSocket());
+    EXPECT_TRUE(mgr->get(sv[0]) == ctx);
+    {
+        sylar::EpochGuard guard;
+        EXPECT_TRUE(mgr->lookup(sv[0]) == ctx.get());
+    }
+    mgr->del(sv[0]);
+    EXPECT_TRUE(!mgr->get(sv[0]));
+    // 删除后已经拿到的 shared_ptr 仍然有效
+    EXPECT_TRUE(ctx->isSocket());
+    close(sv[0]);
+    close(sv[1]);
+}
+
+} // namespace
+
+int main()
+{
+    test_table_basic();
+    test_epoch_defers_free();
+    test_epoch_other_thread_blocks();
+    test_concurrent_replace();
+    test_fd_manager();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+#include "sylar/config.h"
+#include "sylar/fiber.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+
+#include <atomic>
+#include <sched.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+void test_create_and_recycle()
+{
+    auto before = sylar::Fiber::GetPoolStats();
+    int hits = 0;
+    sylar::Fiber::ptr fiber = sylar::Fiber::Create([&hits]() { ++hits; });
+    void *first = fiber.get();
+    EXPECT_EQ(sylar::Fiber::GetPoolStats().misses, before.misses + 1);
+
+    // 还没执行完的协程不进池
+    sylar::Fiber::ptr other = fiber;
+    sylar::Fiber::Recycle(std::move(other));
+    EXPECT_EQ(sylar::Fiber::GetPoolStats().recycled, before.recycled);
+
+    {
+        sylar::IOManager iom(1, true, "fiber_pool_create");
+        iom.schedule(fiber);
+    }
+    EXPECT_EQ(hits, 1);
+    EXPECT_EQ(fiber->getState(), sylar::Fiber::TERM);
+    sylar::Fiber::Recycle(std::move(fiber));
+    EXPECT_TRUE(!fiber);
+    EXPECT_EQ(sylar::Fiber::GetPoolStats().recycled, before.recycled + 1);
+
+    sylar::Fiber::ptr again = sylar::Fiber::Create([&hits]() { ++hits; });
+    EXPECT_EQ((void *)again.get(), first);
+    EXPECT_EQ(again->getState(), sylar::Fiber::INIT);
+    EXPECT_EQ(sylar::Fiber::GetPoolStats().hits, before.hits + 1);
+    {
+        sylar::IOManager iom(1, true, "fiber_pool_again");
+        iom.schedule(again);
+    }
+    EXPECT_EQ(hits, 2);
+}
+
+// 回调让出后原来的cb_fiber会被丢掉，执行结束时要回到池里给后面的回调用
+void test_scheduler_reuses_yielded_callbacks()
+{
+    const int kBatch = 32;
+    sylar::Config::Lookup<uint32_t>("fiber.pool.max_size")->setValue(8);
+    std::atomic<int> done(0);
+    auto before = sylar::Fiber::GetPoolStats();
+    {
+        sylar::IOManager iom(1, false, "fiber_pool");
+        for (int round = 0; round < 2; ++round)
+        {
+            for (int i = 0; i < kBatch; ++i)
+            {
+                iom.schedule(
+                    [&done]()
+                    {
+                        sylar::Fiber::YieldToReady();
+                        ++done;
+                    });
+            }
+            // 前面use_caller的调度器在主线程上打开了hook，这里不能用会被hook的usleep
+            while (done < kBatch * (round + 1))
+            {
+                sched_yield();
+            }
+        }
+    }
+    auto after = sylar::Fiber::GetPoolStats();
+    EXPECT_EQ(done.load(), kBatch * 2);
+    EXPECT_TRUE(after.recycled > before.recycled);
+    EXPECT_TRUE(after.hits >= before.hits + 8);
+    // 池是有上限的
+    EXPECT_TRUE(after.recycled - before.recycled <= (uint64_t)kBatch * 2);
+    EXPECT_TRUE(after.cached <= 8 + before.cached);
+    sylar::Config::Lookup<uint32_t>("fiber.pool.max_size")->setValue(64);
+}
+
+} // namespace
+
+int main()
+{
+    test_create_and_recycle();
+    test_scheduler_reuses_yielded_callbacks();
+    return g_failures.load() == 0 ? 0 : 1;
+}
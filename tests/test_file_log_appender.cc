@@ -0,0 +1,356 @@
+#include "sylar/config.h"
+#include "sylar/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <fstream>
+#include <signal.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utime.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+std::string s_dir;
+
+sylar::Logger::ptr NewLogger(const std::string &name, sylar::LogAppender::ptr appender)
+{
+    sylar::Logger::ptr logger(new sylar::Logger(name));
+    appender->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    return logger;
+}
+
+std::string ReadFile(const std::string &path)
+{
+    std::ifstream ifs(path);
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+// dir 下以 prefix 开头的文件名，排好序
+std::vector<std::string> ListFiles(const std::string &prefix)
+{
+    std::vector<std::string> files;
+    DIR *d = opendir(s_dir.c_str());
+    if (!d)
+    {
+        return files;
+    }
+    struct dirent *dp = nullptr;
+    while ((dp = readdir(d)) != nullptr)
+    {
+        std::string name = dp->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0)
+        {
+            files.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+void RemoveFiles(const std::string &prefix)
+{
+    for (auto &i : ListFiles(prefix))
+    {
+        unlink((s_dir + "/" + i).c_str());
+    }
+}
+
+bool EndsWith(const std::string &str, const std::string &suffix)
+{
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// 文件被外部改名以后 check 发现 inode 变了，后面的日志写到新文件；改名前后写的都在旧文件里
+void test_external_move()
+{
+    std::string path = s_dir + "/moved.log";
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    auto logger = NewLogger("file_moved", appender);
+    SYLAR_LOG_INFO(logger) << "a";
+    EXPECT_EQ(rename(path.c_str(), (path + ".old").c_str()), 0);
+    SYLAR_LOG_INFO(logger) << "b";
+    appender->check();
+    SYLAR_LOG_INFO(logger) << "c";
+    appender->flush();
+    EXPECT_EQ(ReadFile(path + ".old"), "a\nb\n");
+    EXPECT_EQ(ReadFile(path), "c\n");
+
+    // 不再每秒重开截断文件，已有内容保留
+    sylar::FileLogAppender::ptr again(new sylar::FileLogAppender(path));
+    auto logger2 = NewLogger("file_moved2", again);
+    SYLAR_LOG_INFO(logger2) << "d";
+    again->flush();
+    EXPECT_EQ(ReadFile(path), "c\nd\n");
+    RemoveFiles("moved.log");
+}
+
+// 超过 max_size 就轮转，一条不丢，当前文件不超过上限
+void test_size_rotate()
+{
+    std::string path = s_dir + "/size.log";
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    appender->setMaxSize(1000);
+    appender->setCompress(false);
+    auto logger = NewLogger("file_size", appender);
+    const int count = 200;
+    for (int i = 0; i < count; ++i)
+    {
+        SYLAR_LOG_INFO(logger) << "line " << i << " " << std::string(20, 'x');
+    }
+    appender->flush();
+    std::vector<std::string> files = ListFiles("size.log");
+    EXPECT_TRUE(files.size() > 3);
+    struct stat st;
+    EXPECT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_TRUE(st.st_size <= 1000);
+
+    // 轮转出来的按时间戳和序号排，加上当前文件，顺序拼起来就是写入的顺序
+    std::string all;
+    int lines = 0;
+    for (auto &i : files)
+    {
+        if (i != "size.log")
+        {
+            std::string data = ReadFile(s_dir + "/" + i);
+            EXPECT_TRUE(data.size() <= 1000);
+            all += data;
+        }
+    }
+    all += ReadFile(path);
+    for (size_t pos = 0; (pos = all.find('\n', pos)) != std::string::npos; ++pos)
+    {
+        ++lines;
+    }
+    EXPECT_EQ(lines, count);
+    EXPECT_EQ(all.compare(0, 7, "line 0 "), 0);
+    RemoveFiles("size.log");
+}
+
+// 轮转出来的文件在后台压缩，只留 max_files 个
+void test_compress_and_max_files()
+{
+    std::string path = s_dir + "/gz.log";
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    appender->setMaxFiles(2);
+    auto logger = NewLogger("file_gz", appender);
+    for (int i = 0; i < 4; ++i)
+    {
+        SYLAR_LOG_INFO(logger) << "round " << i;
+        EXPECT_TRUE(appender->rotate());
+    }
+    SYLAR_LOG_INFO(logger) << "current";
+    appender->flush();
+
+    std::vector<std::string> rotated;
+    for (int i = 0; i < 100; ++i)
+    {
+        rotated.clear();
+        bool all_gz = true;
+        for (auto &f : ListFiles("gz.log."))
+        {
+            rotated.push_back(f);
+            all_gz = all_gz && EndsWith(f, ".gz");
+        }
+        if (all_gz && rotated.size() == 2)
+        {
+            break;
+        }
+        usleep(50 * 1000);
+    }
+    EXPECT_EQ(rotated.size(), 2u);
+    for (auto &f : rotated)
+    {
+        EXPECT_TRUE(EndsWith(f, ".gz"));
+        std::string data = ReadFile(s_dir + "/" + f);
+        EXPECT_TRUE(data.size() > 2 && (unsigned char)data[0] == 0x1f &&
+                    (unsigned char)data[1] == 0x8b);
+    }
+    EXPECT_EQ(ReadFile(path), "current\n");
+    RemoveFiles("gz.log");
+}
+
+// 按天轮转：上个周期留下的文件在检查时轮转掉，空文件跨周期不轮转
+void test_time_rotate()
+{
+    std::string path = s_dir + "/daily.log";
+    {
+        std::ofstream ofs(path);
+        ofs << "yesterday\n";
+    }
+    struct utimbuf times;
+    times.actime = times.modtime = time(nullptr) - 2 * 24 * 3600;
+    EXPECT_EQ(utime(path.c_str(), &times), 0);
+
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    appender->setRotateInterval(sylar::FileLogAppender::DAILY);
+    appender->setCompress(false);
+    auto logger = NewLogger("file_daily", appender);
+    appender->check();
+    SYLAR_LOG_INFO(logger) << "today";
+    appender->check();
+    appender->flush();
+
+    std::vector<std::string> files = ListFiles("daily.log.");
+    EXPECT_EQ(files.size(), 1u);
+    if (files.size() == 1)
+    {
+        EXPECT_EQ(ReadFile(s_dir + "/" + files[0]), "yesterday\n");
+    }
+    EXPECT_EQ(ReadFile(path), "today\n");
+    RemoveFiles("daily.log");
+}
+
+// SIGHUP 以后后台线程把所有文件重新打开
+void test_sighup()
+{
+    std::string path = s_dir + "/hup.log";
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    auto logger = NewLogger("file_hup", appender);
+    SYLAR_LOG_INFO(logger) << "before";
+    EXPECT_EQ(rename(path.c_str(), (path + ".old").c_str()), 0);
+
+    sylar::FileLogAppender::InstallSighupHandler();
+    raise(SIGHUP);
+    for (int i = 0; i < 100 && access(path.c_str(), F_OK) != 0; ++i)
+    {
+        usleep(20 * 1000);
+    }
+    SYLAR_LOG_INFO(logger) << "after";
+    appender->flush();
+    EXPECT_EQ(ReadFile(path + ".old"), "before\n");
+    EXPECT_EQ(ReadFile(path), "after\n");
+    RemoveFiles("hup.log");
+}
+
+// 配置里的轮转参数传到 appender 上
+void test_config()
+{
+    std::string path = s_dir + "/conf.log";
+    YAML::Node root = YAML::Load("logs:\n"
+                                 "  - name: file_conf\n"
+                                 "    level: info\n"
+                                 "    formatter: '%m%n'\n"
+                                 "    appenders:\n"
+                                 "      - type: FileLogAppender\n"
+                                 "        file: " +
+                                 path +
+                                 "\n"
+                                 "        max_size: 4096\n"
+                                 "        rotate: hourly\n"
+                                 "        max_files: 3\n"
+                                 "        compress: false\n");
+    sylar::Config::LoadFromYaml(root);
+    auto logger = SYLAR_LOG_NAME("file_conf");
+    std::string yaml = logger->toYamlString();
+    EXPECT_TRUE(yaml.find("max_size: 4096") != std::string::npos);
+    EXPECT_TRUE(yaml.find("rotate: hourly") != std::string::npos);
+    EXPECT_TRUE(yaml.find("max_files: 3") != std::string::npos);
+    EXPECT_TRUE(yaml.find("compress: false") != std::string::npos);
+    SYLAR_LOG_INFO(logger) << "from config";
+    // 换掉配置，旧的 appender 析构时把缓冲里的写掉
+    sylar::Config::LoadFromYaml(YAML::Load("logs:\n  - name: file_conf\n    level: info\n"));
+    EXPECT_EQ(ReadFile(path), "from config\n");
+    RemoveFiles("conf.log");
+}
+
+// fork 出来的子进程里后台线程重新起来了：文件被移走能发现，缓冲里的日志不调 flush 也会写出去
+void test_fork_rotator()
+{
+    std::string path = s_dir + "/fork.log";
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    auto logger = NewLogger("file_fork", appender);
+    SYLAR_LOG_INFO(logger) << "parent";
+    appender->flush();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        rename(path.c_str(), (path + ".old").c_str());
+        // 每秒检查一次文件
+        usleep(1500 * 1000);
+        SYLAR_LOG_INFO(logger) << "child";
+        // 每 100ms 刷一次缓冲
+        usleep(500 * 1000);
+        _exit(ReadFile(path) == "child\n" ? 0 : 1);
+    }
+    EXPECT_TRUE(pid > 0);
+    int status = -1;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT_EQ(ReadFile(path + ".old"), "parent\n");
+    RemoveFiles("fork.log");
+}
+
+// fork 之前缓冲写出去，子进程里丢掉继承来的缓冲：父进程的日志只写一遍，子进程的不丢
+void test_fork_buffer()
+{
+    std::string path = s_dir + "/fork_buf.log";
+    sylar::FileLogAppender::ptr appender(new sylar::FileLogAppender(path));
+    auto logger = NewLogger("file_fork_buf", appender);
+    SYLAR_LOG_INFO(logger) << "parent";
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        SYLAR_LOG_INFO(logger) << "child";
+        // 不调 flush，由后台线程写出去
+        usleep(500 * 1000);
+        _exit(0);
+    }
+    EXPECT_TRUE(pid > 0);
+    waitpid(pid, nullptr, 0);
+    appender->flush();
+    EXPECT_EQ(ReadFile(path), "parent\nchild\n");
+    RemoveFiles("fork_buf.log");
+}
+
+} // namespace
+
+int main()
+{
+    s_dir = "/tmp/test_file_log_appender_" + std::to_string(getpid());
+    mkdir(s_dir.c_str(), 0755);
+    test_external_move();
+    test_size_rotate();
+    test_compress_and_max_files();
+    test_time_rotate();
+    test_sighup();
+    test_config();
+    test_fork_rotator();
+    test_fork_buffer();
+    rmdir(s_dir.c_str());
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include "sylar/http/http.h"
+#include "sylar/http/http_header.h"
+#include "sylar/http/http_parser.h"
+#include "sylar/log.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+using sylar::http::HttpHeaders;
+
+// 字面量的哈希在编译期算出来，大小写不影响
+static_assert(HttpHeaders::Hash("Content-Length", 14) == HttpHeaders::Hash("content-length", 14),
+              "hash must ignore case");
+static_assert(sylar::http::HttpHeader::HOST.size == 4, "literal key size");
+
+void test_headers_basic()
+{
+    HttpHeaders h;
+    EXPECT_TRUE(h.empty());
+    h.set("Host", "example.com");
+    h.set("Content-Type", "text/plain");
+    h.set("X-Empty", "");
+    EXPECT_EQ(h.size(), 3u);
+    EXPECT_EQ(h.get("host"), "example.com");
+    EXPECT_EQ(h.get(std::string("CONTENT-TYPE")), "text/plain");
+    EXPECT_EQ(h.get(sylar::http::HttpHeader::HOST), "example.com");
+    EXPECT_EQ(h.get("missing", "def"), "def");
+    std::string v = "x";
+    EXPECT_TRUE(h.has("x-empty", &v));
+    EXPECT_EQ(v, "");
+    EXPECT_TRUE(!h.has("content"));
+
+    // 按插入顺序，保留原始大小写
+    EXPECT_EQ(h.name(0).str(), "Host");
+    EXPECT_EQ(h.name(1).str(), "Content-Type");
+
+    // 同名覆盖：变短原地改，变长追加
+    h.set("HOST", "a.com");
+    EXPECT_EQ(h.size(), 3u);
+    EXPECT_EQ(h.get("host"), "a.com");
+    EXPECT_EQ(h.name(0).str(), "Host");
+    h.set("host", "a-much-longer-host-name.example.com");
+    EXPECT_EQ(h.get("Host"), "a-much-longer-host-name.example.com");
+
+    EXPECT_TRUE(h.del("content-type"));
+    EXPECT_TRUE(!h.del("content-type"));
+    EXPECT_EQ(h.size(), 2u);
+    EXPECT_EQ(h.name(1).str(), "X-Empty");
+
+    h.set("Content-Length", "1234");
+    EXPECT_EQ(h.getAs<uint64_t>(sylar::http::HttpHeader::CONTENT_LENGTH, 0), 1234u);
+    EXPECT_EQ(h.getAs<int>("host", -1), -1);
+    int n = 0;
+    EXPECT_TRUE(!h.checkGetAs("x-empty", n, 7));
+    EXPECT_EQ(n, 7);
+
+    h.clear();
+    EXPECT_TRUE(h.empty());
+    EXPECT_EQ(h.get("host"), "");
+}
+
+// 反复改同一个值，废弃的字节多了会整理缓冲，值不能错
+void test_headers_compact()
+{
+    HttpHeaders h;
+    h.set("A", "1");
+    h.set("B", "2");
+    for (int i = 0; i < 2000; ++i)
+    {
+        h.set("A", std::string(i % 50 + 1, 'a' + i % 26));
+        h.set("C" + std::to_string(i % 7), std::to_string(i));
+        if (i % 3 == 0)
+        {
+            h.del("C" + std::to_string((i + 1) % 7));
+        }
+    }
+    EXPECT_EQ(h.get("a"), std::string(1999 % 50 + 1, 'a' + 1999 % 26));
+    EXPECT_EQ(h.get("b"), "2");
+    EXPECT_EQ(h.get("c4"), "1999");
+}
+
+sylar::http::HttpRequest::ptr Parse(const std::string &data)
+{
+    sylar::http::HttpRequestParser parser;
+    size_t n = parser.execute(data.data(), data.size(), 0);
+    EXPECT_TRUE(parser.isFinished());
+    EXPECT_TRUE(!parser.hasError());
+    auto req = parser.getData();
+    req->setBody(data.substr(n));
+    return req;
+}
+
+void test_parse()
+{
+    auto req = Parse("POST /p?a=1&b=hello+world&c=%E4%B8%AD&d HTTP/1.1\r\n"
+                     "Host: example.com\r\n"
+                     "Connection: keep-alive\r\n"
+                     "Cookie: sid=abc%20; theme=dark;lang=zh\r\n"
+                     "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
+                     "Content-Length: 11\r\n"
+                     "host: dup.example.com\r\n"
+                     "\r\n"
+                     "a=2&e=5%2B1");
+    EXPECT_TRUE(!req->isClose());
+    EXPECT_EQ(req->getHeaders().size(), 5u);
+    EXPECT_EQ(req->getHeader("HOST"), "dup.example.com");
+    EXPECT_EQ(req->getHeaderAs<int>("content-length"), 11);
+
+    // query 里的优先，body 里重复的键不覆盖
+    EXPECT_EQ(req->getParam("a"), "1");
+    EXPECT_EQ(req->getParam("b"), "hello world");
+    EXPECT_EQ(req->getParam("c"), "\xE4\xB8\xAD");
+    EXPECT_TRUE(!req->hasParam("d"));
+    EXPECT_EQ(req->getParamAs<int>("a"), 1);
+    EXPECT_EQ(req->getParam("e"), "5+1");
+    EXPECT_EQ(req->getParams().size(), 4u);
+
+    // cookie 值不做 url 解码
+    EXPECT_EQ(req->getCookie("sid"), "abc%20");
+    EXPECT_EQ(req->getCookie("theme"), "dark");
+    EXPECT_EQ(req->getCookie("lang"), "zh");
+    EXPECT_EQ(req->getCookies().size(), 3u);
+
+    // 输出时 connection 由 m_close 决定
+    req->setBody("");
+    std::string head;
+    req->dumpHead(head);
+    EXPECT_EQ(head, "POST /p?a=1&b=hello+world&c=%E4%B8%AD&d HTTP/1.1\r\n"
+                    "connection: keep-alive\r\n"
+                    "Host:dup.example.com\r\n"
+                    "Cookie:sid=abc%20; theme=dark;lang=zh\r\n"
+                    "Content-Type:application/x-www-form-urlencoded; charset=utf-8\r\n"
+                    "Content-Length:11\r\n"
+                    "\r\n");
+}
+
+// 没访问过之前先设置的参数，懒解析时不会被请求里的覆盖
+void test_lazy_params()
+{
+    sylar::http::HttpRequest req;
+    req.setQuery("a=1&b=2");
+    req.setHeader("Cookie", "k=v");
+    req.setParam("a", "override");
+    req.setCookie("k2", "v2");
+    EXPECT_EQ(req.getParam("a"), "override");
+    EXPECT_EQ(req.getParam("b"), "2");
+    EXPECT_EQ(req.getCookie("k"), "v");
+    EXPECT_EQ(req.getCookie("k2"), "v2");
+    req.delParam("b");
+    EXPECT_TRUE(!req.hasParam("b"));
+
+    // 不是表单的 body 不当参数解析
+    sylar::http::HttpRequest json;
+    json.setHeader("Content-Type", "application/json");
+    json.setBody("a=1");
+    EXPECT_TRUE(json.getParams().empty());
+}
+
+} // namespace
+
+int main()
+{
+    test_headers_basic();
+    test_headers_compact();
+    test_parse();
+    test_lazy_params();
+    return g_failures.load() == 0 ? 0 : 1;
+}
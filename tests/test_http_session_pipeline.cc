@@ -0,0 +1,183 @@
+#include "sylar/http/http_session.h"
+#include "sylar/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// 按给定的分段返回数据，模拟一次 read 只能读到一部分或者一次读到好几个请求
+class ChunkSocket : public sylar::Socket
+{
+public:
+    ChunkSocket(const std::vector<std::string> &chunks)
+        : sylar::Socket(sylar::Socket::IPv4, sylar::Socket::TCP, 0), m_chunks(chunks)
+    {
+        m_isConnected = true;
+    }
+
+    int recv(void *buffer, size_t length, int flags = 0) override
+    {
+        (void)flags;
+        ++reads;
+        if (m_index >= m_chunks.size())
+        {
+            return 0;
+        }
+        std::string &chunk = m_chunks[m_index];
+        size_t n = std::min(length, chunk.size() - m_offset);
+        memcpy(buffer, chunk.data() + m_offset, n);
+        m_offset += n;
+        if (m_offset == chunk.size())
+        {
+            ++m_index;
+            m_offset = 0;
+        }
+        return (int)n;
+    }
+
+    int reads = 0;
+
+private:
+    std::vector<std::string> m_chunks;
+    size_t m_index = 0;
+    size_t m_offset = 0;
+};
+
+std::string Get(const std::string &path)
+{
+    return "GET " + path + " HTTP/1.1\r\nHost: example.com\r\n\r\n";
+}
+
+std::string Post(const std::string &path, const std::string &body)
+{
+    return "POST " + path + " HTTP/1.1\r\nHost: example.com\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// 一次读到三个请求，后两个不能丢
+void test_pipelined_in_one_read()
+{
+    auto sock = std::make_shared<ChunkSocket>(
+        std::vector<std::string>{Get("/a") + Post("/b", "hello") + Get("/c")});
+    sylar::http::HttpSession session(sock);
+    auto a = session.recvRequest();
+    auto b = session.recvRequest();
+    auto c = session.recvRequest();
+    EXPECT_TRUE(a && b && c);
+    if (a && b && c)
+    {
+        EXPECT_EQ(a->getPath(), "/a");
+        EXPECT_EQ(b->getPath(), "/b");
+        EXPECT_EQ(b->getBody(), "hello");
+        EXPECT_EQ(b->getHeader("host"), "example.com");
+        EXPECT_EQ(c->getPath(), "/c");
+    }
+    // 三个请求只用了一次 read
+    EXPECT_EQ(sock->reads, 1);
+    EXPECT_TRUE(!session.recvRequest());
+    EXPECT_EQ((int)session.getLastRecvRequestError(),
+              (int)sylar::http::HttpSessionRecvRequestError::CLIENT_CLOSED);
+}
+
+// 请求头从字段中间断开、请求体跨多次 read、下一个请求的开头跟在请求体后面
+void test_split_across_reads()
+{
+    std::string data = Post("/upload", "0123456789") + Get("/next");
+    std::vector<std::string> chunks;
+    size_t cuts[] = {3, 20, 38, 60, 64};
+    size_t last = 0;
+    for (size_t cut : cuts)
+    {
+        chunks.push_back(data.substr(last, cut - last));
+        last = cut;
+    }
+    chunks.push_back(data.substr(last));
+    sylar::http::HttpSession session(std::make_shared<ChunkSocket>(chunks));
+    auto up = session.recvRequest();
+    auto next = session.recvRequest();
+    EXPECT_TRUE(up && next);
+    if (up && next)
+    {
+        EXPECT_EQ(up->getPath(), "/upload");
+        EXPECT_EQ(up->getHeader("host"), "example.com");
+        EXPECT_EQ(up->getHeader("content-length"), "10");
+        EXPECT_EQ(up->getBody(), "0123456789");
+        EXPECT_EQ(next->getPath(), "/next");
+        EXPECT_EQ(next->getHeader("host"), "example.com");
+    }
+}
+
+// 一个字节一个字节地来
+void test_byte_by_byte()
+{
+    std::string data = Get("/x") + Post("/y", "ab");
+    std::vector<std::string> chunks;
+    for (char c : data)
+    {
+        chunks.push_back(std::string(1, c));
+    }
+    sylar::http::HttpSession session(std::make_shared<ChunkSocket>(chunks));
+    auto x = session.recvRequest();
+    auto y = session.recvRequest();
+    EXPECT_TRUE(x && y);
+    if (x && y)
+    {
+        EXPECT_EQ(x->getPath(), "/x");
+        EXPECT_EQ(y->getPath(), "/y");
+        EXPECT_EQ(y->getBody(), "ab");
+    }
+}
+
+// 请求之后跟着的非 HTTP 数据（比如升级以后的帧）通过 read 原样拿到
+void test_read_drains_buffer()
+{
+    auto sock = std::make_shared<ChunkSocket>(std::vector<std::string>{Get("/ws") + "frame"});
+    sylar::http::HttpSession session(sock);
+    auto req = session.recvRequest();
+    EXPECT_TRUE(req);
+    char buf[16] = {0};
+    EXPECT_EQ(session.readFixSize(buf, 5), 5);
+    EXPECT_EQ(std::string(buf, 5), "frame");
+}
+
+} // namespace
+
+int main()
+{
+    test_pipelined_in_one_read();
+    test_split_across_reads();
+    test_byte_by_byte();
+    test_read_drains_buffer();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+#include "sylar/http/http_server.h"
+#include "sylar/http/http_session.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// 按给定的分段返回数据，发出去的字节都记下来
+class FakeSocket : public sylar::Socket
+{
+public:
+    FakeSocket(const std::vector<std::string> &chunks)
+        : sylar::Socket(sylar::Socket::IPv4, sylar::Socket::TCP, 0), m_chunks(chunks)
+    {
+        m_isConnected = true;
+    }
+
+    int recv(void *buffer, size_t length, int flags = 0) override
+    {
+        (void)flags;
+        if (m_index >= m_chunks.size())
+        {
+            return 0;
+        }
+        std::string &chunk = m_chunks[m_index];
+        size_t n = std::min(length, chunk.size() - m_offset);
+        memcpy(buffer, chunk.data() + m_offset, n);
+        m_offset += n;
+        if (m_offset == chunk.size())
+        {
+            ++m_index;
+            m_offset = 0;
+        }
+        return (int)n;
+    }
+
+    int send(const void *buffer, size_t length, int flags = 0) override
+    {
+        (void)flags;
+        if (fail_send)
+        {
+            return -1;
+        }
+        sent.append((const char *)buffer, length);
+        return (int)length;
+    }
+
+    int send(const iovec *buffers, size_t length, int flags = 0) override
+    {
+        (void)flags;
+        if (fail_send)
+        {
+            return -1;
+        }
+        int total = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            sent.append((const char *)buffers[i].iov_base, buffers[i].iov_len);
+            total += buffers[i].iov_len;
+        }
+        return total;
+    }
+
+    std::string sent;
+    // 置位后 send 都返回 -1，模拟对端断开
+    bool fail_send = false;
+
+private:
+    std::vector<std::string> m_chunks;
+    size_t m_index = 0;
+    size_t m_offset = 0;
+};
+
+std::string Post(const std::string &path, const std::string &body)
+{
+    return "POST " + path +
+           " HTTP/1.1\r\nHost: example.com\r\nConnection: keep-alive\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// 请求体分段读，读不到下一个请求；没读完的请求体在读下一个请求头之前丢掉
+void test_read_body()
+{
+    std::string body(10000, 'x');
+    std::string data = Post("/a", body) + Post("/b", "0123456789") + Post("/c", "tail");
+    std::vector<std::string> chunks;
+    for (size_t i = 0; i < data.size(); i += 777)
+    {
+        chunks.push_back(data.substr(i, 777));
+    }
+    auto sock = std::make_shared<FakeSocket>(chunks);
+    sylar::http::HttpSession session(sock);
+
+    auto a = session.recvRequestHead();
+    EXPECT_TRUE(a);
+    EXPECT_TRUE(a && a->getBody().empty());
+    EXPECT_EQ(session.getBodyLeft(), 10000u);
+    size_t total = 0;
+    char buf[300];
+    int n = 0;
+    while ((n = session.readBody(buf, sizeof(buf))) > 0)
+    {
+        EXPECT_EQ(std::string(buf, n), std::string(n, 'x'));
+        total += n;
+    }
+    EXPECT_EQ(n, 0);
+    EXPECT_EQ(total, 10000u);
+
+    // 只读了一部分
+    auto b = session.recvRequestHead();
+    EXPECT_TRUE(b && b->getPath() == "/b");
+    EXPECT_EQ(session.readBody(buf, 4), 4);
+    EXPECT_EQ(std::string(buf, 4), "0123");
+
+    auto c = session.recvRequest();
+    EXPECT_TRUE(c);
+    if (c)
+    {
+        EXPECT_EQ(c->getPath(), "/c");
+        EXPECT_EQ(c->getBody(), "tail");
+    }
+    EXPECT_TRUE(!session.recvRequestHead());
+}
+
+// 分块发送：头里是 transfer-encoding 没有 content-length，已有的 body 作为第一块
+void test_chunked_response()
+{
+    auto sock = std::make_shared<FakeSocket>(std::vector<std::string>());
+    sylar::http::HttpSession session(sock);
+    sylar::http::HttpResponse::ptr rsp(new sylar::http::HttpResponse(0x11, false));
+    rsp->setBody("first");
+    rsp->setHeader("Content-Length", "5");
+    EXPECT_TRUE(!session.isResponseStarted());
+    EXPECT_TRUE(session.beginChunkedResponse(rsp) > 0);
+    EXPECT_TRUE(session.isResponseStarted());
+    EXPECT_TRUE(session.sendChunk("0123456789abcdefg", 17) > 0);
+    EXPECT_EQ(session.sendChunk("", 0), 0);
+    EXPECT_TRUE(session.endChunkedResponse() > 0);
+    EXPECT_EQ(session.endChunkedResponse(), 0);
+    EXPECT_EQ(sock->sent, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n"
+                          "connection: keep-alive\r\n\r\n"
+                          "5\r\nfirst\r\n11\r\n0123456789abcdefg\r\n0\r\n\r\n");
+
+    // HTTP/1.0 不支持 chunked，body 原样发，靠关连接结束
+    auto old = std::make_shared<FakeSocket>(std::vector<std::string>());
+    sylar::http::HttpSession old_session(old);
+    sylar::http::HttpResponse::ptr rsp10(new sylar::http::HttpResponse(0x10, false));
+    EXPECT_TRUE(old_session.beginChunkedResponse(rsp10) > 0);
+    EXPECT_TRUE(old_session.sendChunk("abc", 3) > 0);
+    EXPECT_EQ(old_session.endChunkedResponse(), 0);
+    EXPECT_TRUE(rsp10->isClose());
+    EXPECT_EQ(old->sent, "HTTP/1.0 200 OK\r\nconnection: close\r\n\r\nabc");
+}
+
+// 分块写到一半失败，之后的块和结束块都不能再发，sendfile 响应头写失败也要记下来
+void test_chunked_write_failed()
+{
+    auto sock = std::make_shared<FakeSocket>(std::vector<std::string>());
+    sylar::http::HttpSession session(sock);
+    sylar::http::HttpResponse::ptr rsp(new sylar::http::HttpResponse(0x11, false));
+    EXPECT_TRUE(session.beginChunkedResponse(rsp) > 0);
+    EXPECT_TRUE(!session.isWriteFailed());
+    sock->fail_send = true;
+    EXPECT_TRUE(session.sendChunk("abc", 3) < 0);
+    EXPECT_TRUE(session.isWriteFailed());
+    sock->fail_send = false;
+    size_t sent = sock->sent.size();
+    EXPECT_TRUE(session.sendChunk("def", 3) < 0);
+    EXPECT_TRUE(session.endChunkedResponse() < 0);
+    EXPECT_EQ(sock->sent.size(), sent);
+
+    auto file_sock = std::make_shared<FakeSocket>(std::vector<std::string>());
+    file_sock->fail_send = true;
+    sylar::http::HttpSession file_session(file_sock);
+    sylar::http::HttpResponse::ptr file_rsp(new sylar::http::HttpResponse(0x11, false));
+    EXPECT_TRUE(file_session.sendFileResponse(file_rsp, -1, 0, 10) < 0);
+    EXPECT_TRUE(file_session.isWriteFailed());
+}
+
+int Connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool WriteAll(int fd, const std::string &data)
+{
+    size_t off = 0;
+    while (off < data.size())
+    {
+        ssize_t n = write(fd, data.data() + off, data.size() - off);
+        if (n <= 0)
+        {
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+// 读到 until 出现为止
+std::string ReadUntil(int fd, const std::string &until)
+{
+    std::string rt;
+    char buf[4096];
+    while (rt.find(until) == std::string::npos)
+    {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        rt.append(buf, n);
+    }
+    return rt;
+}
+
+// 上传的请求体由 servlet 边读边算，响应分块发回去；
+// 同一个连接上接着发的普通请求不受影响
+void test_server_streaming()
+{
+    sylar::IOManager iom(1, false, "stream");
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+    std::atomic<uint64_t> received(0);
+    std::atomic<size_t> max_read(0);
+    sylar::http::FunctionServlet::ptr upload(new sylar::http::FunctionServlet(
+        [&](sylar::http::HttpRequest::ptr req, sylar::http::HttpResponse::ptr rsp,
+            sylar::http::HttpSession::ptr session)
+        {
+            EXPECT_TRUE(req->getBody().empty());
+            char buf[8192];
+            uint64_t sum = 0;
+            int n = 0;
+            while ((n = session->readBody(buf, sizeof(buf))) > 0)
+            {
+                received += n;
+                max_read = std::max(max_read.load(), (size_t)n);
+                for (int i = 0; i < n; ++i)
+                {
+                    sum += (uint8_t)buf[i];
+                }
+            }
+            session->beginChunkedResponse(rsp);
+            std::string s = "sum=" + std::to_string(sum);
+            session->sendChunk(s.data(), s.size());
+            session->sendChunk(";", 1);
+            // 不调用 endChunkedResponse，由服务端补上
+            return 0;
+        }));
+    upload->setStreamBody(true);
+    server->getServletDispatch()->addServlet("/upload", upload);
+    // 只读一部分就返回，剩下的要被服务端丢掉
+    sylar::http::FunctionServlet::ptr partial(new sylar::http::FunctionServlet(
+        [&](sylar::http::HttpRequest::ptr req, sylar::http::HttpResponse::ptr rsp,
+            sylar::http::HttpSession::ptr session)
+        {
+            char c = 0;
+            session->readBody(&c, 1);
+            rsp->setBody(std::string("first=") + c);
+            return 0;
+        }));
+    partial->setStreamBody(true);
+    server->getServletDispatch()->addServlet("/partial", partial);
+    server->getServletDispatch()->addServlet(
+        "/echo",
+        [](sylar::http::HttpRequest::ptr req, sylar::http::HttpResponse::ptr rsp,
+           sylar::http::HttpSession::ptr)
+        {
+            rsp->setBody("echo=" + req->getBody());
+            return 0;
+        });
+
+    auto addr = sylar::Address::LookupAny("127.0.0.1:0");
+    EXPECT_TRUE(server->bind(addr));
+    auto local =
+        std::dynamic_pointer_cast<sylar::IPAddress>(server->getSocks()[0]->getLocalAddress());
+    uint16_t port = local ? local->getPort() : 0;
+    EXPECT_TRUE(server->start());
+
+    int fd = Connect(port);
+    EXPECT_TRUE(fd >= 0);
+    std::string body(1 << 20, '\0');
+    uint64_t sum = 0;
+    for (size_t i = 0; i < body.size(); ++i)
+    {
+        body[i] = (char)(i * 7);
+        sum += (uint8_t)body[i];
+    }
+    EXPECT_TRUE(WriteAll(fd, Post("/upload", body)));
+    std::string rsp = ReadUntil(fd, "0\r\n\r\n");
+    EXPECT_TRUE(rsp.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    std::string expect = "sum=" + std::to_string(sum);
+    char size_line[16];
+    snprintf(size_line, sizeof(size_line), "%zx\r\n", expect.size());
+    EXPECT_TRUE(rsp.find(size_line + expect + "\r\n1\r\n;\r\n0\r\n\r\n") != std::string::npos);
+    EXPECT_EQ(received.load(), body.size());
+    EXPECT_TRUE(max_read.load() <= 8192u);
+
+    EXPECT_TRUE(WriteAll(fd, Post("/partial", "abcdef")));
+    rsp = ReadUntil(fd, "first=a");
+    EXPECT_TRUE(rsp.find("content-length: 7\r\n\r\nfirst=a") != std::string::npos);
+
+    EXPECT_TRUE(WriteAll(fd, Post("/echo", "hi")));
+    rsp = ReadUntil(fd, "echo=hi");
+    EXPECT_TRUE(rsp.find("content-length: 7\r\n\r\necho=hi") != std::string::npos);
+    close(fd);
+
+    server->stop();
+    for (int i = 0; i < 200 && server.use_count() > 1; ++i)
+    {
+        usleep(10 * 1000);
+    }
+    server.reset();
+}
+
+} // namespace
+
+int main()
+{
+    // 服务端提前关连接时客户端的 write 不要被信号杀掉
+    signal(SIGPIPE, SIG_IGN);
+    test_read_body();
+    test_chunked_response();
+    test_chunked_write_failed();
+    test_server_streaming();
+    return g_failures.load() == 0 ? 0 : 1;
+}
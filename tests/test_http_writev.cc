@@ -0,0 +1,197 @@
+#include "sylar/http/http_connection.h"
+#include "sylar/http/http_session.h"
+#include "sylar/log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// 记录每次 sendmsg 的段数和内容，每次最多收 m_limit 个字节，模拟写了一部分
+class CaptureSocket : public sylar::Socket
+{
+public:
+    CaptureSocket(size_t limit)
+        : sylar::Socket(sylar::Socket::IPv4, sylar::Socket::TCP, 0), m_limit(limit)
+    {
+        m_isConnected = true;
+    }
+
+    int send(const void *buffer, size_t length, int flags = 0) override
+    {
+        (void)flags;
+        ++sends;
+        size_t n = std::min(length, m_limit);
+        data.append((const char *)buffer, n);
+        return (int)n;
+    }
+
+    int send(const iovec *buffers, size_t length, int flags = 0) override
+    {
+        (void)flags;
+        ++sendmsgs;
+        maxIovecs = std::max(maxIovecs, length);
+        size_t left = m_limit;
+        for (size_t i = 0; i < length && left > 0; ++i)
+        {
+            size_t n = std::min(buffers[i].iov_len, left);
+            data.append((const char *)buffers[i].iov_base, n);
+            left -= n;
+        }
+        return (int)(m_limit - left);
+    }
+
+    std::string data;
+    int sends = 0;
+    int sendmsgs = 0;
+    size_t maxIovecs = 0;
+
+private:
+    size_t m_limit;
+};
+
+std::string Head(const sylar::http::HttpRequest &req)
+{
+    std::string head;
+    req.dumpHead(head);
+    return head;
+}
+
+std::string Head(const sylar::http::HttpResponse &rsp)
+{
+    std::string head;
+    rsp.dumpHead(head);
+    return head;
+}
+
+// 头部字节和原来 ostream 输出的完全一样
+void test_dump_head()
+{
+    sylar::http::HttpRequest req;
+    req.setMethod(sylar::http::HttpMethod::POST);
+    req.setPath("/upload");
+    req.setQuery("a=1");
+    req.setFragment("frag");
+    req.setHeader("Host", "example.com");
+    EXPECT_EQ(Head(req), "POST /upload?a=1#frag HTTP/1.1\r\nconnection: close\r\n"
+                         "Host:example.com\r\n\r\n");
+    req.setBody("hello");
+    EXPECT_EQ(Head(req), "POST /upload?a=1#frag HTTP/1.1\r\nconnection: close\r\n"
+                         "Host:example.com\r\ncontent-length: 5\r\n\r\n");
+    EXPECT_EQ(Head(req) + req.getBody(), req.toString());
+
+    sylar::http::HttpResponse rsp(0x10, false);
+    rsp.setStatus(sylar::http::HttpStatus::NOT_FOUND);
+    rsp.setHeader("Server", "sylar");
+    rsp.setHeader("Connection", "ignored");
+    EXPECT_EQ(Head(rsp), "HTTP/1.0 404 Not Found\r\nServer: sylar\r\n"
+                         "connection: keep-alive\r\n\r\n");
+    rsp.setReason("Gone Fishing");
+    rsp.setBody(std::string(1234, 'x'));
+    EXPECT_EQ(Head(rsp), "HTTP/1.0 404 Gone Fishing\r\nServer: sylar\r\n"
+                         "connection: keep-alive\r\ncontent-length: 1234\r\n\r\n");
+    EXPECT_EQ(Head(rsp) + rsp.getBody(), rsp.toString());
+
+    // websocket 保留用户自己的 connection 头，不再追加
+    sylar::http::HttpResponse ws;
+    ws.setStatus(sylar::http::HttpStatus::SWITCHING_PROTOCOLS);
+    ws.setWebsocket(true);
+    ws.setHeader("Connection", "Upgrade");
+    EXPECT_EQ(Head(ws), "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\n\r\n");
+    EXPECT_EQ(Head(ws), ws.toString());
+}
+
+// 响应头和 body 分两段一起交给 sendmsg，写了一部分时从断开的地方接着写
+void test_session_writev()
+{
+    sylar::http::HttpResponse::ptr rsp(new sylar::http::HttpResponse);
+    rsp->setHeader("Content-Type", "text/plain");
+    rsp->setBody(std::string(100, 'b'));
+
+    auto sock = std::make_shared<CaptureSocket>(1 << 20);
+    sylar::http::HttpSession session(sock);
+    EXPECT_EQ(session.sendResponse(rsp), (int)rsp->toString().size());
+    EXPECT_EQ(sock->data, rsp->toString());
+    EXPECT_EQ(sock->sendmsgs, 1);
+    EXPECT_EQ(sock->maxIovecs, 2u);
+    EXPECT_EQ(sock->sends, 0);
+
+    auto slow = std::make_shared<CaptureSocket>(7);
+    sylar::http::HttpSession slow_session(slow);
+    EXPECT_EQ(slow_session.sendResponse(rsp), (int)rsp->toString().size());
+    EXPECT_EQ(slow->data, rsp->toString());
+    EXPECT_EQ(slow->sends, 0);
+
+    // 没有 body 只发一段
+    sylar::http::HttpResponse::ptr empty(new sylar::http::HttpResponse);
+    auto one = std::make_shared<CaptureSocket>(1 << 20);
+    sylar::http::HttpSession one_session(one);
+    EXPECT_EQ(one_session.sendResponse(empty), (int)empty->toString().size());
+    EXPECT_EQ(one->maxIovecs, 1u);
+    EXPECT_EQ(one->data, empty->toString());
+}
+
+void test_connection_writev()
+{
+    sylar::http::HttpRequest::ptr req(new sylar::http::HttpRequest);
+    req->setMethod(sylar::http::HttpMethod::PUT);
+    req->setPath("/item");
+    req->setBody("payload");
+
+    auto sock = std::make_shared<CaptureSocket>(5);
+    sylar::http::HttpConnection conn(sock);
+    sylar::http::HttpAttemptOutcome attempt;
+    std::string expect = req->toString();
+    EXPECT_EQ(conn.sendRequest(req, &attempt), (int)expect.size());
+    EXPECT_EQ(sock->data, expect);
+    EXPECT_EQ(sock->sends, 0);
+    EXPECT_EQ(sock->sendmsgs, (int)((expect.size() + 4) / 5));
+    EXPECT_EQ(attempt.request_bytes_sent, expect.size());
+    EXPECT_TRUE(attempt.request_bytes_completed);
+    EXPECT_TRUE(attempt.may_have_submitted);
+
+    // 同一个连接上第二个请求复用格式化缓冲
+    sock->data.clear();
+    req->setBody("");
+    EXPECT_EQ(conn.sendRequest(req), (int)req->toString().size());
+    EXPECT_EQ(sock->data, req->toString());
+}
+
+} // namespace
+
+int main()
+{
+    test_dump_head();
+    test_session_writev();
+    test_connection_writev();
+    return g_failures.load() == 0 ? 0 : 1;
+}
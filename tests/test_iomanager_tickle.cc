@@ -0,0 +1,118 @@
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/util.h"
+
+#include <atomic>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// 线程都空闲时连续提交一批任务，只需要写一次eventfd，其余的tickle都被合并
+void test_tickles_are_coalesced()
+{
+    const int kTasks = 200;
+    std::atomic<int> done(0);
+    uint64_t sent = 0;
+    uint64_t suppressed = 0;
+    {
+        sylar::IOManager iom(2, false, "tickle_coalesce");
+        usleep(50 * 1000);
+        uint64_t sent_before = iom.getTicklesSent();
+        for (int i = 0; i < kTasks; ++i)
+        {
+            iom.schedule([&done]() { ++done; });
+        }
+        while (done < kTasks)
+        {
+            usleep(1000);
+        }
+        sent = iom.getTicklesSent() - sent_before;
+        suppressed = iom.getTicklesSuppressed();
+    }
+    EXPECT_EQ(done.load(), kTasks);
+    EXPECT_TRUE(sent >= 1);
+    EXPECT_TRUE(sent < (uint64_t)kTasks / 4);
+    EXPECT_TRUE(suppressed > 0);
+}
+
+// 指定给某个空闲线程的任务，即使先被别的线程收到唤醒，也要很快转到目标线程上执行，
+// 而不是等目标线程的epoll_wait超时
+void test_pinned_task_wakes_owner()
+{
+    const int kRounds = 20;
+    std::atomic<int> owner(-1);
+    std::atomic<int> done(0);
+    std::atomic<int> wrong_thread(0);
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    {
+        sylar::IOManager iom(4, false, "tickle_pinned");
+        iom.schedule([&owner]() { owner = sylar::GetThreadId(); });
+        while (owner == -1)
+        {
+            usleep(1000);
+        }
+        start = sylar::GetCurrentMS();
+        for (int i = 0; i < kRounds; ++i)
+        {
+            // 让所有线程都回到epoll_wait里
+            usleep(5 * 1000);
+            int target = owner;
+            iom.schedule(
+                [target, &done, &wrong_thread]()
+                {
+                    if (sylar::GetThreadId() != target)
+                    {
+                        ++wrong_thread;
+                    }
+                    ++done;
+                },
+                target);
+            while (done < i + 1 && sylar::GetCurrentMS() - start < 10000)
+            {
+                usleep(1000);
+            }
+        }
+        elapsed = sylar::GetCurrentMS() - start;
+    }
+    EXPECT_EQ(done.load(), kRounds);
+    EXPECT_EQ(wrong_thread.load(), 0);
+    // epoll_wait超时是3秒，只要有一次没叫醒目标线程就会超过这个时间
+    EXPECT_TRUE(elapsed < 2500);
+}
+
+} // namespace
+
+int main()
+{
+    test_tickles_are_coalesced();
+    test_pinned_task_wakes_owner();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+#include "sylar/config.h"
+#include "sylar/fd_manager.h"
+#include "sylar/hook.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/util.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// socketpair 不经过 hook 的 socket()，手动登记到 FdManager 才会走协程化的读写
+void make_pair(int sv[2])
+{
+    int rt = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    EXPECT_EQ(rt, 0);
+    sylar::FdMgr::GetInstance()->get(sv[0], true);
+    sylar::FdMgr::GetInstance()->get(sv[1], true);
+}
+
+void test_epoll_is_default()
+{
+    sylar::IOManager iom(1, false, "uring_default");
+    EXPECT_TRUE(!iom.isUringEnabled());
+}
+
+// 读在数据到来之前挂起协程，写端稍后写入后由完成事件恢复
+void test_blocking_read_write(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    std::string got;
+    std::string gotv;
+    iom.schedule(
+        [&]()
+        {
+            char buf[64] = {0};
+            ssize_t n = recv(sv[0], buf, sizeof(buf), 0);
+            got.assign(buf, n > 0 ? n : 0);
+            char a[3] = {0};
+            char b[8] = {0};
+            iovec iov[2] = {{a, sizeof(a)}, {b, sizeof(b)}};
+            n = readv(sv[0], iov, 2);
+            gotv.assign(a, n >= 3 ? 3 : 0);
+            gotv.append(b, n > 3 ? n - 3 : 0);
+            ++done;
+        });
+    iom.schedule(
+        [&]()
+        {
+            usleep(20 * 1000);
+            send(sv[1], "hello", 5, 0);
+            usleep(20 * 1000);
+            iovec iov[2] = {{(void *)"abc", 3}, {(void *)"defg", 4}};
+            writev(sv[1], iov, 2);
+            ++done;
+        });
+    while (done < 2)
+    {
+        usleep(1000);
+    }
+    EXPECT_EQ(got, std::string("hello"));
+    EXPECT_EQ(gotv, std::string("abcdefg"));
+    iom.schedule(
+        [&]()
+        {
+            close(sv[0]);
+            close(sv[1]);
+            ++done;
+        });
+    while (done < 3)
+    {
+        usleep(1000);
+    }
+}
+
+// 共享栈协程的读缓冲在栈上，挂起后栈会被别的协程占用，要退回 epoll
+void test_shared_stack_falls_back(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    std::string got;
+    uint64_t submitted = iom.getUringSubmitted();
+    sylar::Fiber::ptr reader(new sylar::Fiber(
+        [&]()
+        {
+            char buf[64] = {0};
+            ssize_t n = recv(sv[0], buf, sizeof(buf), 0);
+            got.assign(buf, n > 0 ? n : 0);
+            ++done;
+        },
+        0, false, true));
+    iom.schedule(reader);
+    usleep(20 * 1000);
+    EXPECT_EQ(iom.getUringSubmitted(), submitted);
+    iom.schedule(
+        [&]()
+        {
+            send(sv[1], "hello", 5, 0);
+            ++done;
+        });
+    while (done < 2)
+    {
+        usleep(1000);
+    }
+    EXPECT_EQ(got, std::string("hello"));
+    iom.schedule(
+        [&]()
+        {
+            close(sv[0]);
+            close(sv[1]);
+            ++done;
+        });
+    while (done < 3)
+    {
+        usleep(1000);
+    }
+}
+
+// SO_RCVTIMEO 通过 link timeout 生效
+void test_read_timeout(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    ssize_t n = 0;
+    int err = 0;
+    uint64_t elapsed = 0;
+    iom.schedule(
+        [&]()
+        {
+            timeval tv = {0, 100 * 1000};
+            setsockopt(sv[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            uint64_t start = sylar::GetCurrentMS();
+            char buf[8];
+            n = read(sv[0], buf, sizeof(buf));
+            err = errno;
+            elapsed = sylar::GetCurrentMS() - start;
+            close(sv[0]);
+            close(sv[1]);
+            ++done;
+        });
+    while (!done)
+    {
+        usleep(1000);
+    }
+    EXPECT_EQ(n, (ssize_t)-1);
+    EXPECT_EQ(err, ETIMEDOUT);
+    EXPECT_TRUE(elapsed >= 90);
+    EXPECT_TRUE(elapsed < 1000);
+}
+
+// 关闭正在被读的 fd，读操作被取消并返回 EBADF
+void test_close_cancels_read(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    ssize_t n = 0;
+    int err = 0;
+    iom.schedule(
+        [&]()
+        {
+            char buf[8];
+            n = recv(sv[0], buf, sizeof(buf), 0);
+            err = errno;
+            ++done;
+        });
+    iom.schedule(
+        [&]()
+        {
+            usleep(50 * 1000);
+            close(sv[0]);
+            close(sv[1]);
+        });
+    uint64_t start = sylar::GetCurrentMS();
+    while (!done && sylar::GetCurrentMS() - start < 2000)
+    {
+        usleep(1000);
+    }
+    EXPECT_EQ(done.load(), 1);
+    EXPECT_EQ(n, (ssize_t)-1);
+    EXPECT_EQ(err, EBADF);
+}
+
+// accept 和 connect 也走 io_uring
+void test_accept_connect(sylar::IOManager &iom)
+{
+    std::atomic<int> done(0);
+    std::atomic<int> port(0);
+    std::string got;
+    int connect_rt = -1;
+    iom.schedule(
+        [&]()
+        {
+            int lfd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(lfd, (sockaddr *)&addr, sizeof(addr));
+            listen(lfd, 16);
+            socklen_t len = sizeof(addr);
+            getsockname(lfd, (sockaddr *)&addr, &len);
+            port = ntohs(addr.sin_port);
+            sockaddr_in peer;
+            socklen_t peer_len = sizeof(peer);
+            int cfd = accept(lfd, (sockaddr *)&peer, &peer_len);
+            if (cfd >= 0)
+            {
+                char buf[16] = {0};
+                ssize_t n = read(cfd, buf, sizeof(buf));
+                got.assign(buf, n > 0 ? n : 0);
+                close(cfd);
+            }
+            close(lfd);
+            ++done;
+        });
+    iom.schedule(
+        [&]()
+        {
+            while (!port)
+            {
+                usleep(1000);
+            }
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(port);
+            connect_rt = connect(fd, (sockaddr *)&addr, sizeof(addr));
+            write(fd, "ping", 4);
+            close(fd);
+            ++done;
+        });
+    while (done < 2)
+    {
+        usleep(1000);
+    }
+    EXPECT_EQ(connect_rt, 0);
+    EXPECT_EQ(got, std::string("ping"));
+}
+
+} // namespace
+
+int main()
+{
+    test_epoll_is_default();
+
+    sylar::Config::Lookup<std::string>("iomanager.backend")->setValue("io_uring");
+    sylar::IOManager iom(2, false, "uring");
+    if (!iom.isUringEnabled())
+    {
+        SYLAR_LOG_WARN(g_logger) << "io_uring not available on this kernel, skip";
+        return g_failures.load() == 0 ? 0 : 1;
+    }
+    test_blocking_read_write(iom);
+    test_shared_stack_falls_back(iom);
+    test_read_timeout(iom);
+    test_close_cancels_read(iom);
+    test_accept_connect(iom);
+    EXPECT_TRUE(iom.getUringSubmitted() > 0);
+    return g_failures.load() == 0 ? 0 : 1;
+}
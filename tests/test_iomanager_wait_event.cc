@@ -0,0 +1,309 @@
+#include "sylar/config.h"
+#include "sylar/fd_manager.h"
+#include "sylar/fiber.h"
+#include "sylar/hook.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/util.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+// 只统计指定协程里的内存分配。替换版本不能内联：内联后 GCC 会把配对的 new/free
+// 当成不匹配的分配函数报 -Wmismatched-new-delete
+static std::atomic<uint64_t> g_watch_fiber(0);
+static std::atomic<uint64_t> g_allocs(0);
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    uint64_t watch = g_watch_fiber.load(std::memory_order_relaxed);
+    if (watch && sylar::Fiber::GetFiberId() == watch)
+    {
+        ++g_allocs;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+
+void make_pair(int sv[2])
+{
+    int rt = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    EXPECT_EQ(rt, 0);
+    sylar::FdMgr::GetInstance()->get(sv[0], true);
+    sylar::FdMgr::GetInstance()->get(sv[1], true);
+}
+
+// 主线程没有 hook，关闭前自己把 fd 从 FdMgr 里摘掉，免得下一对 socket 拿到旧的上下文
+void close_pair(int sv[2])
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        sylar::FdMgr::GetInstance()->del(sv[i]);
+        close(sv[i]);
+    }
+}
+
+void set_timeout(int fd, int so, uint64_t ms)
+{
+    timeval tv = {(time_t)(ms / 1000), (suseconds_t)(ms % 1000 * 1000)};
+    setsockopt(fd, SOL_SOCKET, so, &tv, sizeof(tv));
+}
+
+void wait_done(std::atomic<int> &done, int n)
+{
+    uint64_t start = sylar::GetMonotonicMS();
+    while (done < n && sylar::GetMonotonicMS() - start < 5000)
+    {
+        usleep(1000);
+    }
+    EXPECT_EQ(done.load(), n);
+}
+
+// 超时返回 ETIMEDOUT，时间基本准确
+void test_timeout(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    iom.schedule(
+        [&]()
+        {
+            set_timeout(sv[0], SO_RCVTIMEO, 100);
+            char buf[8];
+            for (int i = 0; i < 3; ++i)
+            {
+                uint64_t start = sylar::GetMonotonicMS();
+                ssize_t n = recv(sv[0], buf, sizeof(buf), 0);
+                int err = errno;
+                uint64_t elapsed = sylar::GetMonotonicMS() - start;
+                EXPECT_EQ(n, (ssize_t)-1);
+                EXPECT_EQ(err, ETIMEDOUT);
+                EXPECT_TRUE(elapsed >= 100);
+                EXPECT_TRUE(elapsed < 1000);
+            }
+            close(sv[0]);
+            close(sv[1]);
+            ++done;
+        });
+    wait_done(done, 1);
+}
+
+// 数据在超时之前到达，之前那次等待的定时器不会在下一次等待时误报超时
+void test_data_before_timeout(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    const int kRounds = 200;
+    iom.schedule(
+        [&]()
+        {
+            set_timeout(sv[0], SO_RCVTIMEO, 30);
+            char c = 0;
+            int received = 0;
+            int timeouts = 0;
+            while (received < kRounds)
+            {
+                ssize_t n = recv(sv[0], &c, 1, 0);
+                if (n == 1)
+                {
+                    ++received;
+                }
+                else if (n == -1 && errno == ETIMEDOUT)
+                {
+                    ++timeouts;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            EXPECT_EQ(received, kRounds);
+            EXPECT_EQ(timeouts, 0);
+            ++done;
+        });
+    iom.schedule(
+        [&]()
+        {
+            char c = 'x';
+            for (int i = 0; i < kRounds; ++i)
+            {
+                usleep(200);
+                EXPECT_EQ(send(sv[1], &c, 1, 0), (ssize_t)1);
+            }
+            ++done;
+        });
+    wait_done(done, 2);
+    close_pair(sv);
+}
+
+// 第一次带超时的等待之后，阻塞读和超时都不再分配内存
+void test_no_alloc(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    std::atomic<int> step(0);
+    uint64_t wait_allocs = 0;
+    uint64_t timeout_allocs = 0;
+    iom.schedule(
+        [&]()
+        {
+            set_timeout(sv[0], SO_RCVTIMEO, 1000);
+            char c = 0;
+            // 预热：创建这个 fd 的超时定时器和当前线程的时间轮
+            EXPECT_EQ(send(sv[1], "a", 1, 0), (ssize_t)1);
+            EXPECT_EQ(recv(sv[0], &c, 1, 0), (ssize_t)1);
+            step = 1;
+            EXPECT_EQ(recv(sv[0], &c, 1, 0), (ssize_t)1);
+
+            g_allocs = 0;
+            g_watch_fiber = sylar::Fiber::GetFiberId();
+            for (int i = 0; i < 100; ++i)
+            {
+                step = i + 2;
+                EXPECT_EQ(recv(sv[0], &c, 1, 0), (ssize_t)1);
+            }
+            wait_allocs = g_allocs;
+
+            set_timeout(sv[0], SO_RCVTIMEO, 1);
+            g_allocs = 0;
+            for (int i = 0; i < 50; ++i)
+            {
+                EXPECT_EQ(recv(sv[0], &c, 1, 0), (ssize_t)-1);
+            }
+            timeout_allocs = g_allocs;
+            g_watch_fiber = 0;
+            step = -1;
+            ++done;
+        });
+    iom.schedule(
+        [&]()
+        {
+            // 每次等读协程阻塞之后再写
+            int last = 0;
+            while (step != -1)
+            {
+                int s = step;
+                if (s > last)
+                {
+                    usleep(1000);
+                    EXPECT_EQ(send(sv[1], "b", 1, 0), (ssize_t)1);
+                    last = s;
+                    if (s == 101)
+                    {
+                        break;
+                    }
+                }
+                usleep(100);
+            }
+            ++done;
+        });
+    wait_done(done, 2);
+    EXPECT_EQ(wait_allocs, (uint64_t)0);
+    EXPECT_EQ(timeout_allocs, (uint64_t)0);
+    close_pair(sv);
+}
+
+// 共享栈协程等待期间栈被别的协程挤占，超时结果不能写在它的栈上
+void test_timeout_shared_stack(sylar::IOManager &iom)
+{
+    int sv[2];
+    make_pair(sv);
+    std::atomic<int> done(0);
+    int err = 0;
+    uint64_t elapsed = 0;
+    sylar::Fiber::ptr waiter(new sylar::Fiber(
+        [&]()
+        {
+            set_timeout(sv[0], SO_RCVTIMEO, 100);
+            char buf[8];
+            uint64_t start = sylar::GetMonotonicMS();
+            ssize_t n = recv(sv[0], buf, sizeof(buf), 0);
+            err = n < 0 ? errno : 0;
+            elapsed = sylar::GetMonotonicMS() - start;
+            ++done;
+        },
+        0, false, true));
+    // 只有 1 块共享栈，它一运行就把等待中的协程挤出去，超时的时候栈归它
+    sylar::Fiber::ptr other(new sylar::Fiber(
+        []()
+        {
+            for (int i = 0; i < 50; ++i)
+            {
+                usleep(10 * 1000);
+            }
+        },
+        0, false, true));
+    iom.schedule(waiter);
+    iom.schedule(other);
+    wait_done(done, 1);
+    if (!done)
+    {
+        //超时丢了的话协程还挂着，发点数据放它出来
+        send(sv[1], "x", 1, 0);
+        wait_done(done, 1);
+    }
+    //超时结果丢了的话要等到挤占的协程跑完（500ms）之后的那次等待才能超时
+    EXPECT_EQ(err, ETIMEDOUT);
+    EXPECT_TRUE(elapsed >= 100);
+    EXPECT_TRUE(elapsed < 400);
+    close_pair(sv);
+}
+
+} // namespace
+
+int main()
+{
+    sylar::Config::Lookup<uint32_t>("fiber.shared_stack.count")->setValue(1);
+    // 单线程：测试代码自己在循环里读 errno，协程换线程后 errno 的地址可能被编译器沿用
+    sylar::IOManager iom(1, false, "wait_event");
+    test_timeout(iom);
+    test_data_before_timeout(iom);
+    test_no_alloc(iom);
+    test_timeout_shared_stack(iom);
+    return g_failures.load() == 0 ? 0 : 1;
+}
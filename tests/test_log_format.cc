@@ -0,0 +1,174 @@
+#include "sylar/log.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+
+namespace
+{
+
+// 记下每条格式化好的日志和事件的地址
+class CaptureAppender : public sylar::LogAppender
+{
+public:
+    void log(sylar::Logger::ptr logger,
+             sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {
+        std::string str;
+        m_formatter->format(str, level, *event);
+        lines.push_back(str);
+        events.push_back(event.get());
+    }
+    std::string toYamlString() override
+    {
+        return "";
+    }
+
+    std::vector<std::string> lines;
+    std::vector<const sylar::LogEvent *> events;
+};
+
+sylar::Logger::ptr NewLogger(const std::string &pattern, std::shared_ptr<CaptureAppender> &cap)
+{
+    sylar::Logger::ptr logger(new sylar::Logger("fmt_test"));
+    cap = std::make_shared<CaptureAppender>();
+    cap->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter(pattern)));
+    logger->addAppender(cap);
+    return logger;
+}
+
+// 各个占位符的输出和原来 FormatItem 的一样
+void test_pattern()
+{
+    sylar::Logger::ptr logger(new sylar::Logger("pattern"));
+    sylar::LogEvent::ptr event(new sylar::LogEvent(logger, sylar::LogLevel::WARN, "a/b.cc", 42,
+                                                   7, 1234, 56, 0, "worker_1"));
+    event->getSS() << "hello " << -3;
+
+    sylar::LogFormatter fmt("%d{%Y}%T%t%T%N%T%F%T[%p]%T[%c]%T<%f:%l>%T%r%T%m%n");
+    EXPECT_TRUE(!fmt.isError());
+    struct tm tm;
+    time_t zero = 0;
+    localtime_r(&zero, &tm);
+    std::string year = std::to_string(tm.tm_year + 1900);
+    EXPECT_EQ(fmt.format(logger, sylar::LogLevel::WARN, event),
+              year + "\t1234\tworker_1\t56\t[WARN]\t[pattern]\t<a/b.cc:42>\t7\thello -3\n");
+
+    std::string out = "prefix:";
+    sylar::LogFormatter("%p %% %m").format(out, sylar::LogLevel::ERROR, *event);
+    EXPECT_EQ(out, "prefix:ERROR % hello -3");
+
+    sylar::LogFormatter bad("%m %q");
+    EXPECT_TRUE(bad.isError());
+    EXPECT_EQ(bad.format(logger, sylar::LogLevel::INFO, event), "hello -3 <<error_format %q>>");
+    EXPECT_TRUE(sylar::LogFormatter("%d{%Y").isError());
+}
+
+// 宏里的事件反复使用，上一条改掉的流状态不会带到下一条
+void test_event_reuse()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger("%m", cap);
+    SYLAR_LOG_INFO(logger) << std::hex << 255 << " " << std::fixed << 1.5;
+    SYLAR_LOG_INFO(logger) << 255 << " " << 1.5;
+    SYLAR_LOG_DEBUG(logger) << "x";
+    EXPECT_EQ(cap->lines.size(), 3u);
+    EXPECT_EQ(cap->lines[0], "ff 1.500000");
+    EXPECT_EQ(cap->lines[1], "255 1.5");
+    EXPECT_TRUE(cap->events[0] == cap->events[1]);
+
+    logger->setLevel(sylar::LogLevel::INFO);
+    SYLAR_LOG_DEBUG(logger) << "filtered";
+    EXPECT_EQ(cap->lines.size(), 3u);
+}
+
+// 池里留着的事件不持有 logger，logger 和它的 appender 照常释放
+void test_event_release_logger()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger("%m", cap);
+    SYLAR_LOG_INFO(logger) << "once";
+    std::weak_ptr<sylar::Logger> weak_logger = logger;
+    std::weak_ptr<CaptureAppender> weak_cap = cap;
+    logger.reset();
+    cap.reset();
+    EXPECT_TRUE(weak_logger.expired());
+    EXPECT_TRUE(weak_cap.expired());
+}
+
+std::string Nested(sylar::Logger::ptr logger)
+{
+    SYLAR_LOG_INFO(logger) << "inner";
+    return "outer";
+}
+
+// 参数里又打日志时用池里的另一个事件，两条都完整
+void test_nested()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger("%m", cap);
+    SYLAR_LOG_INFO(logger) << "a " << Nested(logger) << " b";
+    EXPECT_EQ(cap->lines.size(), 2u);
+    if (cap->lines.size() == 2)
+    {
+        EXPECT_EQ(cap->lines[0], "inner");
+        EXPECT_EQ(cap->lines[1], "a outer b");
+        EXPECT_TRUE(cap->events[0] != cap->events[1]);
+    }
+}
+
+// printf 风格，超过栈上缓冲的长度也完整
+void test_fmt()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger("[%p] %m", cap);
+    SYLAR_LOG_FMT_WARN(logger, "%s=%d", "count", 12);
+    std::string big(2000, 'z');
+    SYLAR_LOG_FMT_ERROR(logger, "<%s>", big.c_str());
+    EXPECT_EQ(cap->lines.size(), 2u);
+    if (cap->lines.size() == 2)
+    {
+        EXPECT_EQ(cap->lines[0], "[WARN] count=12");
+        EXPECT_EQ(cap->lines[1], "[ERROR] <" + big + ">");
+    }
+}
+
+} // namespace
+
+int main()
+{
+    test_pattern();
+    test_event_reuse();
+    test_event_release_logger();
+    test_nested();
+    test_fmt();
+    return g_failures.load() == 0 ? 0 : 1;
+}
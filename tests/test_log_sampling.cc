@@ -0,0 +1,202 @@
+#include "sylar/log.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+class CaptureAppender : public sylar::LogAppender
+{
+public:
+    void log(sylar::Logger::ptr logger,
+             sylar::LogLevel::Level level,
+             sylar::LogEvent::ptr event) override
+    {
+        MutexType::Lock lock(m_mutex);
+        lines.push_back(event->getContent());
+    }
+    std::string toYamlString() override
+    {
+        return "";
+    }
+
+    std::vector<std::string> lines;
+};
+
+sylar::Logger::ptr NewLogger(std::shared_ptr<CaptureAppender> &cap)
+{
+    sylar::Logger::ptr logger(new sylar::Logger("sampling"));
+    cap = std::make_shared<CaptureAppender>();
+    logger->addAppender(cap);
+    return logger;
+}
+
+// 放行的日志后面带的被压掉的条数，没有返回 0
+uint64_t Suppressed(const std::string &line)
+{
+    size_t pos = line.find("(suppressed ");
+    return pos == std::string::npos ? 0 : strtoull(line.c_str() + pos + 12, nullptr, 10);
+}
+
+// 每 n 条一条，从第二条开始带上中间压掉的条数
+void test_every_n()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger(cap);
+    for (int i = 0; i < 25; ++i)
+    {
+        SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::WARN, 10) << "upstream failed " << i;
+    }
+    EXPECT_EQ(cap->lines.size(), 3u);
+    if (cap->lines.size() == 3)
+    {
+        EXPECT_EQ(cap->lines[0], "upstream failed 0");
+        EXPECT_EQ(cap->lines[1], "upstream failed 10 (suppressed 9 similar messages)");
+        EXPECT_EQ(cap->lines[2], "upstream failed 20 (suppressed 9 similar messages)");
+    }
+
+    // 级别不够的不计数，也不影响别的调用点
+    logger->setLevel(sylar::LogLevel::ERROR);
+    for (int i = 0; i < 5; ++i)
+    {
+        SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::WARN, 2) << "filtered";
+    }
+    logger->setLevel(sylar::LogLevel::DEBUG);
+    for (int i = 0; i < 3; ++i)
+    {
+        SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::WARN, 2) << "other " << i;
+    }
+    EXPECT_EQ(cap->lines.size(), 5u);
+    if (cap->lines.size() == 5)
+    {
+        EXPECT_EQ(cap->lines[3], "other 0");
+        EXPECT_EQ(cap->lines[4], "other 2 (suppressed 1 similar messages)");
+    }
+}
+
+// 间隔内只放一条，过了间隔再放一条并带上中间的条数
+void test_every_ms()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger(cap);
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            SYLAR_LOG_EVERY_MS(logger, sylar::LogLevel::ERROR, 200) << "round " << round;
+        }
+        usleep(250 * 1000);
+    }
+    EXPECT_EQ(cap->lines.size(), 2u);
+    if (cap->lines.size() == 2)
+    {
+        EXPECT_EQ(cap->lines[0], "round 0");
+        EXPECT_EQ(cap->lines[1], "round 1 (suppressed 4 similar messages)");
+    }
+}
+
+// 令牌桶：先放 burst 条，之后按速率放
+void test_rate_limited()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger(cap);
+    // 两轮走同一个调用点
+    auto hit = [&logger](const char *msg) {
+        SYLAR_LOG_RATE_LIMITED(logger, sylar::LogLevel::WARN, 10, 5) << msg;
+    };
+    for (int i = 0; i < 100; ++i)
+    {
+        hit("burst");
+    }
+    // 整个循环跨过 100ms 时会多攒出一个
+    size_t first = cap->lines.size();
+    EXPECT_TRUE(first >= 5 && first <= 6);
+
+    usleep(250 * 1000);
+    for (int i = 0; i < 100; ++i)
+    {
+        hit("refill");
+    }
+    // 250ms 攒了两个多令牌
+    size_t second = cap->lines.size() - first;
+    EXPECT_TRUE(second >= 2 && second <= 4);
+    if (second > 0)
+    {
+        EXPECT_EQ(cap->lines[first],
+                  "refill (suppressed " + std::to_string(100 - first) + " similar messages)");
+    }
+}
+
+// 多个线程共用一个调用点：放行的条数正好，报出来的压掉的条数不会多
+void test_concurrent()
+{
+    std::shared_ptr<CaptureAppender> cap;
+    auto logger = NewLogger(cap);
+    const int threads = 4;
+    const int count = 10000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([logger]() {
+            for (int i = 0; i < count; ++i)
+            {
+                SYLAR_LOG_EVERY_N(logger, sylar::LogLevel::INFO, 100) << "x";
+            }
+        });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    EXPECT_EQ(cap->lines.size(), (size_t)(threads * count / 100));
+    uint64_t reported = 0;
+    for (auto &l : cap->lines)
+    {
+        reported += Suppressed(l);
+    }
+    uint64_t dropped = threads * count - threads * count / 100;
+    EXPECT_TRUE(reported <= dropped);
+    EXPECT_TRUE(reported + 100 * threads >= dropped);
+}
+
+} // namespace
+
+int main()
+{
+    test_every_n();
+    test_every_ms();
+    test_rate_limited();
+    test_concurrent();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+
+#include <atomic>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+void test_pinned_tasks_run_on_owner()
+{
+    std::atomic<int> done(0);
+    std::atomic<int> wrong_thread(0);
+    {
+        sylar::IOManager iom(4, false, "pinned");
+        for (int i = 0; i < 8; ++i)
+        {
+            iom.schedule(
+                [&iom, &done, &wrong_thread]()
+                {
+                    int owner = sylar::GetThreadId();
+                    for (int k = 0; k < 16; ++k)
+                    {
+                        iom.schedule(
+                            [owner, &done, &wrong_thread]()
+                            {
+                                if (sylar::GetThreadId() != owner)
+                                {
+                                    ++wrong_thread;
+                                }
+                                ++done;
+                            },
+                            owner);
+                    }
+                });
+        }
+    }
+    EXPECT_EQ(done.load(), 8 * 16);
+    EXPECT_EQ(wrong_thread.load(), 0);
+}
+
+// 一个调度线程往自己的本地队列里塞一批任务后一直忙着，空闲线程应该把任务偷过去执行
+void test_idle_threads_steal()
+{
+    const int kTasks = 64;
+    std::atomic<int> done(0);
+    std::atomic<int> stolen(0);
+    {
+        sylar::IOManager iom(4, false, "steal");
+        iom.schedule(
+            [&iom, &done, &stolen]()
+            {
+                int producer = sylar::GetThreadId();
+                for (int i = 0; i < kTasks; ++i)
+                {
+                    iom.schedule(
+                        [producer, &done, &stolen]()
+                        {
+                            if (sylar::GetThreadId() != producer)
+                            {
+                                ++stolen;
+                            }
+                            ++done;
+                        });
+                }
+                // 不让出执行权地忙等，本地队列里的任务只能被别的线程偷走
+                uint64_t deadline = sylar::GetCurrentMS() + 2000;
+                while (done < kTasks && sylar::GetCurrentMS() < deadline)
+                {
+                }
+            });
+    }
+    EXPECT_EQ(done.load(), kTasks);
+    EXPECT_EQ(stolen.load(), kTasks);
+}
+
+void test_external_producers()
+{
+    const int kProducers = 4;
+    const int kTasksPerProducer = 20000;
+    std::atomic<int> done(0);
+    {
+        sylar::IOManager iom(4, false, "producers");
+        std::vector<sylar::Thread::ptr> producers;
+        for (int i = 0; i < kProducers; ++i)
+        {
+            producers.push_back(sylar::Thread::ptr(new sylar::Thread(
+                [&iom, &done]()
+                {
+                    for (int k = 0; k < kTasksPerProducer; ++k)
+                    {
+                        iom.schedule([&done]() { ++done; });
+                    }
+                },
+                "producer_" + std::to_string(i))));
+        }
+        for (auto &i : producers)
+        {
+            i->join();
+        }
+    }
+    EXPECT_EQ(done.load(), kProducers * kTasksPerProducer);
+}
+
+// stop 之后可以再次 start，新线程重新认领本地队列
+void test_restart()
+{
+    std::atomic<int> done(0);
+    sylar::Scheduler sc(2, false, "restart");
+    for (int round = 0; round < 3; ++round)
+    {
+        sc.start();
+        for (int i = 0; i < 100; ++i)
+        {
+            sc.schedule([&done]() { ++done; });
+        }
+        sc.stop();
+        EXPECT_EQ(done.load(), (round + 1) * 100);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    test_pinned_tasks_run_on_owner();
+    test_idle_threads_steal();
+    test_external_producers();
+    test_restart();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+#include "sylar/http/http_server.h"
+#include "sylar/http/servlet.h"
+#include "sylar/http/servlet_router.h"
+#include "sylar/log.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+using sylar::http::Servlet;
+using sylar::http::ServletRouter;
+
+class NamedServlet : public Servlet
+{
+public:
+    NamedServlet(const std::string &name) : Servlet(name)
+    {
+    }
+    int32_t handle(sylar::http::HttpRequest::ptr, sylar::http::HttpResponse::ptr rsp,
+                   sylar::http::HttpSession::ptr) override
+    {
+        rsp->setBody(m_name);
+        return 0;
+    }
+};
+
+Servlet::ptr S(const std::string &name)
+{
+    return std::make_shared<NamedServlet>(name);
+}
+
+std::string Name(const Servlet::ptr &slt)
+{
+    return slt ? slt->getName() : "null";
+}
+
+void test_router_match()
+{
+    ServletRouter router;
+    router.addServlet("/", S("root"));
+    router.addServlet("/api/users", S("users"));
+    router.addServlet("/api/user", S("user"));
+    router.addServlet("/api/user/:id", S("user_id"));
+    router.addServlet("/api/user/:id/posts/:post", S("user_post"));
+    router.addServlet("/api/user/me", S("me"));
+    router.addServlet("/api/:version/status", S("status"));
+    router.addGlobServlet("/static/*", S("static"));
+    router.addGlobServlet("/static/img/*", S("img"));
+    router.addGlobServlet("/api/*", S("api"));
+    router.addGlobServlet("*.php", S("php"));
+    router.addGlobServlet("/f?o", S("foo"));
+
+    EXPECT_EQ(Name(router.match("/")), "root");
+    EXPECT_EQ(Name(router.match("/api/users")), "users");
+    EXPECT_EQ(Name(router.match("/api/user")), "user");
+
+    ServletRouter::Params params;
+    EXPECT_EQ(Name(router.match("/api/user/42", &params)), "user_id");
+    EXPECT_EQ(params.size(), 1u);
+    EXPECT_TRUE(!params.empty() && params[0].first == "id" && params[0].second == "42");
+
+    // 静态段优先于参数段
+    params.clear();
+    EXPECT_EQ(Name(router.match("/api/user/me", &params)), "me");
+    EXPECT_TRUE(params.empty());
+
+    params.clear();
+    EXPECT_EQ(Name(router.match("/api/user/7/posts/99", &params)), "user_post");
+    EXPECT_EQ(params.size(), 2u);
+    EXPECT_TRUE(params.size() == 2 && params[1].first == "post" && params[1].second == "99");
+
+    // 静态分支 /api/user... 走不通时回退到参数段
+    params.clear();
+    EXPECT_EQ(Name(router.match("/api/v2/status", &params)), "status");
+    EXPECT_TRUE(params.size() == 1 && params[0].second == "v2");
+    EXPECT_EQ(Name(router.match("/api/users/status")), "status");
+
+    // 没有精确匹配时用最长的前缀通配，'*' 可以匹配 '/'
+    EXPECT_EQ(Name(router.match("/static/a/b.css")), "static");
+    EXPECT_EQ(Name(router.match("/static/")), "static");
+    EXPECT_EQ(Name(router.match("/static/img/x/y.png")), "img");
+    EXPECT_EQ(Name(router.match("/api/user/1/other")), "api");
+    EXPECT_EQ(Name(router.match("/api/user/")), "api");
+
+    // 其他通配模式交给 fnmatch
+    EXPECT_EQ(Name(router.match("/x/index.php")), "php");
+    EXPECT_EQ(Name(router.match("/foo")), "foo");
+    EXPECT_EQ(Name(router.match("/nothing")), "null");
+    EXPECT_EQ(Name(router.match("")), "null");
+    EXPECT_EQ(Name(router.match("/stati")), "null");
+}
+
+// 边被拆分以后原来的路由还在
+void test_router_split()
+{
+    ServletRouter router;
+    router.addServlet("/abcdef", S("abcdef"));
+    router.addServlet("/abcxyz", S("abcxyz"));
+    router.addServlet("/ab", S("ab"));
+    router.addGlobServlet("/abc*", S("abc*"));
+    router.addGlobServlet("*", S("all"));
+    EXPECT_EQ(Name(router.match("/abcdef")), "abcdef");
+    EXPECT_EQ(Name(router.match("/abcxyz")), "abcxyz");
+    EXPECT_EQ(Name(router.match("/ab")), "ab");
+    EXPECT_EQ(Name(router.match("/abc")), "abc*");
+    EXPECT_EQ(Name(router.match("/abcde")), "abc*");
+    EXPECT_EQ(Name(router.match("/a")), "all");
+}
+
+void test_dispatch()
+{
+    sylar::http::ServletDispatch dispatch;
+    dispatch.addServlet("/item/:id", S("item"));
+    dispatch.addGlobServlet("/sylar/*", S("glob"));
+    EXPECT_EQ(Name(dispatch.getMatchedServlet("/sylar/x")), "glob");
+    EXPECT_EQ(Name(dispatch.getMatchedServlet("/other")), "NotFoundServlet");
+    EXPECT_EQ(Name(dispatch.getServlet("/item/:id")), "item");
+    EXPECT_EQ(Name(dispatch.getGlobServlet("/sylar/*")), "glob");
+
+    sylar::http::HttpRequest::ptr req(new sylar::http::HttpRequest);
+    req->setPath("/item/abc");
+    req->setQuery("id=query&x=1");
+    EXPECT_EQ(Name(dispatch.route(req)), "item");
+    // 路径参数优先于 query 里的同名参数
+    EXPECT_EQ(req->getParam("id"), "abc");
+    EXPECT_EQ(req->getParam("x"), "1");
+
+    dispatch.delGlobServlet("/sylar/*");
+    EXPECT_EQ(Name(dispatch.getMatchedServlet("/sylar/x")), "NotFoundServlet");
+    dispatch.delServlet("/item/:id");
+    EXPECT_EQ(Name(dispatch.getMatchedServlet("/item/abc")), "NotFoundServlet");
+}
+
+// 请求线程不停地匹配，同时另一个线程增删路由
+void test_concurrent_update()
+{
+    sylar::http::ServletDispatch dispatch;
+    dispatch.addServlet("/stable", S("stable"));
+    std::atomic<bool> stop(false);
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back(
+            [&]()
+            {
+                while (!stop)
+                {
+                    if (Name(dispatch.getMatchedServlet("/stable")) != "stable")
+                    {
+                        ++wrong;
+                    }
+                    std::string name = Name(dispatch.getMatchedServlet("/dyn/5"));
+                    if (name != "dyn" && name != "NotFoundServlet")
+                    {
+                        ++wrong;
+                    }
+                }
+            });
+    }
+    for (int i = 0; i < 2000; ++i)
+    {
+        dispatch.addGlobServlet("/dyn/*", S("dyn"));
+        dispatch.addServlet("/r" + std::to_string(i), S("r"));
+        dispatch.delGlobServlet("/dyn/*");
+    }
+    stop = true;
+    for (auto &i : readers)
+    {
+        i.join();
+    }
+    EXPECT_EQ(wrong.load(), 0);
+    EXPECT_EQ(Name(dispatch.getMatchedServlet("/r1999")), "r");
+}
+
+} // namespace
+
+int main()
+{
+    test_router_match();
+    test_router_split();
+    test_dispatch();
+    test_concurrent_update();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+#include "sylar/config.h"
+#include "sylar/fiber.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+const int kFiberCount = 32;
+const int kYieldCount = 20;
+
+// 每个协程在栈上放一段跟自己 id 相关的数据，反复让出，回来后检查数据没有被别的协程踩坏
+void run_fibers(int threads, std::vector<sylar::Fiber::ptr> &fibers, std::atomic<int> &corrupted,
+                std::atomic<int> &moved)
+{
+    sylar::IOManager iom(threads, false, "shared_stack");
+    for (int i = 0; i < kFiberCount; ++i)
+    {
+        fibers.push_back(sylar::Fiber::ptr(new sylar::Fiber(
+            [i, &corrupted, &moved]()
+            {
+                volatile int data[256];
+                for (int k = 0; k < 256; ++k)
+                {
+                    data[k] = i * 1000 + k;
+                }
+                int thread = sylar::GetThreadId();
+                for (int n = 0; n < kYieldCount; ++n)
+                {
+                    sylar::Fiber::YieldToReady();
+                    if (sylar::GetThreadId() != thread)
+                    {
+                        ++moved;
+                    }
+                    for (int k = 0; k < 256; ++k)
+                    {
+                        if (data[k] != i * 1000 + k)
+                        {
+                            ++corrupted;
+                            break;
+                        }
+                    }
+                }
+            },
+            0, false, true)));
+        iom.schedule(fibers.back());
+    }
+}
+
+void test_shared_stack_fibers(int threads)
+{
+    std::vector<sylar::Fiber::ptr> fibers;
+    std::atomic<int> corrupted(0);
+    std::atomic<int> moved(0);
+    run_fibers(threads, fibers, corrupted, moved);
+
+    EXPECT_EQ(corrupted.load(), 0);
+    EXPECT_EQ(moved.load(), 0);
+    for (auto &i : fibers)
+    {
+        EXPECT_TRUE(i->isSharedStack());
+        EXPECT_EQ(i->getState(), sylar::Fiber::TERM);
+        // 结束后共享栈和拷贝出去的缓冲区都已经释放
+        EXPECT_EQ(i->getSavedStackSize(), (size_t)0);
+    }
+}
+
+void test_saved_stack_is_small()
+{
+    std::vector<sylar::Fiber::ptr> fibers;
+    size_t max_saved = 0;
+    {
+        sylar::IOManager iom(1, false, "shared_stack_size");
+        for (int i = 0; i < 4; ++i)
+        {
+            fibers.push_back(sylar::Fiber::ptr(
+                new sylar::Fiber([]() { sylar::Fiber::YieldToHold(); }, 0, false, true)));
+            iom.schedule(fibers.back());
+        }
+        // 4 个协程挤 2 块共享栈，至少有两个被挤出去，拷出去的只是用到的那一小段
+        while (true)
+        {
+            int held = 0;
+            for (auto &i : fibers)
+            {
+                held += i->getState() == sylar::Fiber::HOLD;
+            }
+            if (held == 4)
+            {
+                break;
+            }
+            usleep(1000);
+        }
+        for (auto &i : fibers)
+        {
+            max_saved = std::max(max_saved, i->getSavedStackSize());
+        }
+        for (auto &i : fibers)
+        {
+            iom.schedule(i);
+        }
+    }
+    EXPECT_TRUE(max_saved > 0);
+    EXPECT_TRUE(max_saved < 64 * 1024);
+}
+
+// 一层层往下调用，在最里层让出，回来后每一层都检查自己栈上的值
+__attribute__((noinline)) int nested_call(int depth, int seed)
+{
+    volatile int local = seed * 31 + depth;
+    int sum = 0;
+    if (depth == 0)
+    {
+        sylar::Fiber::YieldToHold();
+    }
+    else
+    {
+        sum = nested_call(depth - 1, seed);
+    }
+    return local == seed * 31 + depth ? sum + 1 : -1000;
+}
+
+void test_evict_nested_frames()
+{
+    const int kDepth = 16;
+    const int kOthers = 8;
+    std::vector<sylar::Fiber::ptr> nested;
+    std::vector<sylar::Fiber::ptr> others;
+    std::vector<int> results(2, 0);
+    {
+        sylar::IOManager iom(1, false, "shared_stack_evict");
+        // 两个协程先占满 2 块共享栈，停在嵌套调用的最里层
+        for (int i = 0; i < 2; ++i)
+        {
+            nested.push_back(sylar::Fiber::ptr(new sylar::Fiber(
+                [i, &results]() { results[i] = nested_call(kDepth, i + 1); }, 0, false, true)));
+            iom.schedule(nested.back());
+        }
+        while (nested[0]->getState() != sylar::Fiber::HOLD ||
+               nested[1]->getState() != sylar::Fiber::HOLD)
+        {
+            usleep(1000);
+        }
+        // 后来的协程第一次运行时只能挤占它们的栈，初始帧不能写在被挤出者还没拷走的栈顶上
+        for (int i = 0; i < kOthers; ++i)
+        {
+            others.push_back(sylar::Fiber::ptr(
+                new sylar::Fiber([]() { nested_call(kDepth, 0); }, 0, false, true)));
+            iom.schedule(others.back());
+        }
+        while (true)
+        {
+            int held = 0;
+            for (auto &i : others)
+            {
+                held += i->getState() == sylar::Fiber::HOLD;
+            }
+            if (held == kOthers)
+            {
+                break;
+            }
+            usleep(1000);
+        }
+        for (auto &i : nested)
+        {
+            iom.schedule(i);
+        }
+        for (auto &i : others)
+        {
+            iom.schedule(i);
+        }
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_EQ(results[i], kDepth + 1);
+        EXPECT_EQ(nested[i]->getState(), sylar::Fiber::TERM);
+        // MainFunc 在最外层帧里持有的引用也要正常释放
+        EXPECT_EQ(nested[i].use_count(), 1L);
+    }
+    for (auto &i : others)
+    {
+        EXPECT_EQ(i->getState(), sylar::Fiber::TERM);
+        EXPECT_EQ(i.use_count(), 1L);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    sylar::Config::Lookup<uint32_t>("fiber.shared_stack.count")->setValue(2);
+    test_shared_stack_fibers(1);
+    test_shared_stack_fibers(2);
+    test_saved_stack_is_small();
+    test_evict_nested_frames();
+    return g_failures.load() == 0 ? 0 : 1;
+}
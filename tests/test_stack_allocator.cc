@@ -0,0 +1,142 @@
+#include "sylar/config.h"
+#include "sylar/fiber.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/stack_allocator.h"
+
+#include <atomic>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+void test_round_size_uses_classes()
+{
+    EXPECT_EQ(sylar::StackAllocator::RoundSize(1), (size_t)64 * 1024);
+    EXPECT_EQ(sylar::StackAllocator::RoundSize(64 * 1024 + 1), (size_t)256 * 1024);
+    EXPECT_EQ(sylar::StackAllocator::RoundSize(1024 * 1024), (size_t)1024 * 1024);
+    // 超过最大档位时只按页取整
+    EXPECT_EQ(sylar::StackAllocator::RoundSize(2 * 1024 * 1024 + 1) % 4096, (size_t)0);
+}
+
+void test_dealloc_recycles_on_same_thread()
+{
+    size_t size = sylar::StackAllocator::RoundSize(100 * 1024);
+    auto before = sylar::StackAllocator::GetStats();
+
+    void *first = sylar::StackAllocator::Alloc(size);
+    EXPECT_TRUE(first != nullptr);
+    EXPECT_EQ(sylar::StackAllocator::GetStats().stacks_live, before.stacks_live + 1);
+    // 栈的整个可用区间都必须可写
+    ((char *)first)[0] = 1;
+    ((char *)first)[size - 1] = 1;
+
+    sylar::StackAllocator::Dealloc(first, size);
+    auto cached = sylar::StackAllocator::GetStats();
+    EXPECT_EQ(cached.stacks_live, before.stacks_live);
+    EXPECT_EQ(cached.stacks_cached, before.stacks_cached + 1);
+
+    void *second = sylar::StackAllocator::Alloc(size);
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(sylar::StackAllocator::GetStats().stacks_cached, before.stacks_cached);
+    sylar::StackAllocator::Dealloc(second, size);
+}
+
+void test_high_water_and_max_cached()
+{
+    auto max_cached = sylar::Config::Lookup<uint32_t>("fiber.stack_pool.max_cached");
+    auto high_water = sylar::Config::Lookup<uint32_t>("fiber.stack_pool.high_water");
+    max_cached->setValue(4);
+    high_water->setValue(2);
+
+    size_t size = sylar::StackAllocator::RoundSize(200 * 1024);
+    std::vector<void *> stacks;
+    for (int i = 0; i < 6; ++i)
+    {
+        stacks.push_back(sylar::StackAllocator::Alloc(size));
+    }
+    auto before = sylar::StackAllocator::GetStats();
+    for (auto &i : stacks)
+    {
+        sylar::StackAllocator::Dealloc(i, size);
+    }
+    auto after = sylar::StackAllocator::GetStats();
+    // 6 个栈里 4 个进缓存，其中 2 个超过 high_water 被 madvise，另外 2 个直接 munmap
+    EXPECT_EQ(after.stacks_cached, before.stacks_cached + 4);
+    EXPECT_EQ(before.bytes_committed - after.bytes_committed, (uint64_t)size * 4);
+
+    max_cached->setValue(64);
+    high_water->setValue(16);
+}
+
+void test_fiber_uses_pooled_stack()
+{
+    std::atomic<int> done(0);
+    {
+        sylar::IOManager iom(1, true, "stack_allocator");
+        for (int i = 0; i < 8; ++i)
+        {
+            iom.schedule(sylar::Fiber::ptr(new sylar::Fiber([&done]() { ++done; }, 64 * 1024)));
+        }
+    }
+    EXPECT_EQ(done.load(), 8);
+    EXPECT_TRUE(sylar::StackAllocator::GetStats().stacks_cached > 0);
+}
+
+// 统计也能当成只读配置项取到，配置文件改不了它
+void test_stats_through_config()
+{
+    sylar::ConfigVarBase::ptr var = sylar::Config::LookupBase("fiber.stack_pool.stats");
+    EXPECT_TRUE(var);
+    if (!var)
+    {
+        return;
+    }
+    void *stack = sylar::StackAllocator::Alloc(64 * 1024);
+    auto stats = sylar::StackAllocator::GetStats();
+    YAML::Node node = YAML::Load(var->toString());
+    EXPECT_EQ(node["stacks_live"].as<uint64_t>(), stats.stacks_live);
+    EXPECT_EQ(node["bytes_committed"].as<uint64_t>(), stats.bytes_committed);
+    EXPECT_TRUE(!var->fromString("stacks_live: 0"));
+    sylar::Config::LoadFromYaml(YAML::Load("fiber:\n  stack_pool:\n    stats: 1"));
+    EXPECT_EQ(YAML::Load(var->toString())["stacks_live"].as<uint64_t>(), stats.stacks_live);
+    sylar::StackAllocator::Dealloc(stack, sylar::StackAllocator::RoundSize(64 * 1024));
+}
+
+} // namespace
+
+int main()
+{
+    test_round_size_uses_classes();
+    test_dealloc_recycles_on_same_thread();
+    test_high_water_and_max_cached();
+    test_fiber_uses_pooled_stack();
+    test_stats_through_config();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+#include "sylar/http/http_session.h"
+#include "sylar/http/static_file_servlet.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+using sylar::http::HttpMethod;
+using sylar::http::HttpRequest;
+using sylar::http::HttpResponse;
+using sylar::http::HttpStatus;
+using sylar::http::StaticFileServlet;
+
+std::string g_root;
+
+void WriteFile(const std::string &name, const std::string &data)
+{
+    std::string path = g_root + "/" + name;
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, data.data(), data.size()) != (ssize_t)data.size())
+    {
+        ++g_failures;
+        SYLAR_LOG_ERROR(g_logger) << "write " << path << " failed";
+    }
+    close(fd);
+}
+
+HttpResponse::ptr Get(StaticFileServlet::ptr slt, const std::string &path,
+                      const std::vector<std::pair<std::string, std::string>> &headers = {},
+                      HttpMethod method = HttpMethod::GET)
+{
+    HttpRequest::ptr req(new HttpRequest);
+    req->setMethod(method);
+    req->setPath(path);
+    for (auto &i : headers)
+    {
+        req->setHeader(i.first, i.second);
+    }
+    HttpResponse::ptr rsp(new HttpResponse);
+    slt->handle(req, rsp, nullptr);
+    return rsp;
+}
+
+// 普通的 GET：内容、类型和校验头
+void test_get()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+    auto rsp = Get(slt, "/static/a.txt");
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    EXPECT_EQ(rsp->getBody(), "hello static file");
+    EXPECT_EQ(rsp->getHeader("Content-Type"), "text/plain; charset=utf-8");
+    EXPECT_EQ(rsp->getHeader("Accept-Ranges"), "bytes");
+    EXPECT_TRUE(!rsp->getHeader("ETag").empty());
+    EXPECT_TRUE(rsp->getHeader("Last-Modified").find(" GMT") != std::string::npos);
+    EXPECT_TRUE(rsp->getHeader("Content-Encoding").empty());
+
+    // 目录用 index.html，prefix 后面不带 '/' 也一样
+    rsp = Get(slt, "/static/");
+    EXPECT_EQ(rsp->getBody(), "<h1>index</h1>");
+    EXPECT_EQ(rsp->getHeader("Content-Type"), "text/html; charset=utf-8");
+    rsp = Get(slt, "/static");
+    EXPECT_EQ(rsp->getBody(), "<h1>index</h1>");
+    rsp = Get(slt, "/static/sub%20dir/x.json");
+    EXPECT_EQ(rsp->getBody(), "{}");
+    EXPECT_EQ(rsp->getHeader("Content-Type"), "application/json");
+
+    EXPECT_EQ((int)Get(slt, "/static/missing.txt")->getStatus(), 404);
+    EXPECT_EQ((int)Get(slt, "/static/sub%20dir")->getStatus(), 404);
+
+    rsp = Get(slt, "/static/a.txt", {}, HttpMethod::POST);
+    EXPECT_EQ((int)rsp->getStatus(), 405);
+    EXPECT_EQ(rsp->getHeader("Allow"), "GET, HEAD");
+
+    // HEAD 只有头，Content-Length 是文件大小
+    rsp = Get(slt, "/static/a.txt", {}, HttpMethod::HEAD);
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    EXPECT_TRUE(rsp->getBody().empty());
+    EXPECT_EQ(rsp->getHeader("Content-Length"), "17");
+}
+
+// 单文件模式下请求路径只是路由，发的总是 root 这个文件
+void test_single_file()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root + "/index.html"));
+    slt->setSingleFile(true);
+    slt->setCacheControl("no-store");
+    for (auto path : {"/demo", "/", "/other/../x"})
+    {
+        auto rsp = Get(slt, path);
+        EXPECT_EQ((int)rsp->getStatus(), 200);
+        EXPECT_EQ(rsp->getBody(), "<h1>index</h1>");
+        EXPECT_EQ(rsp->getHeader("Content-Type"), "text/html; charset=utf-8");
+        EXPECT_EQ(rsp->getHeader("Cache-Control"), "no-store");
+    }
+    slt.reset(new StaticFileServlet(g_root + "/missing.html"));
+    slt->setSingleFile(true);
+    EXPECT_EQ((int)Get(slt, "/demo")->getStatus(), 404);
+}
+
+// 跳出 root 的路径一律拒绝
+void test_traversal()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+    EXPECT_EQ((int)Get(slt, "/static/../secret.txt")->getStatus(), 400);
+    EXPECT_EQ((int)Get(slt, "/static/sub%20dir/../../secret.txt")->getStatus(), 400);
+    EXPECT_EQ((int)Get(slt, "/static/%2e%2e/secret.txt")->getStatus(), 400);
+    EXPECT_EQ((int)Get(slt, "/static/..")->getStatus(), 400);
+    EXPECT_EQ((int)Get(slt, "/static/a.txt%00")->getStatus(), 400);
+    EXPECT_EQ((int)Get(slt, "/staticx/a.txt")->getStatus(), 400);
+    // ".." 只是名字的一部分时不算
+    EXPECT_EQ((int)Get(slt, "/static/..a.txt")->getStatus(), 404);
+}
+
+// If-None-Match / If-Modified-Since 命中时 304，不带 body
+void test_conditional()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+    auto rsp = Get(slt, "/static/a.txt");
+    std::string etag = rsp->getHeader("ETag");
+    std::string lm = rsp->getHeader("Last-Modified");
+
+    rsp = Get(slt, "/static/a.txt", {{"If-None-Match", etag}});
+    EXPECT_EQ((int)rsp->getStatus(), 304);
+    EXPECT_TRUE(rsp->getBody().empty());
+    EXPECT_EQ(rsp->getHeader("ETag"), etag);
+    rsp = Get(slt, "/static/a.txt", {{"If-None-Match", "\"x\", W/" + etag}});
+    EXPECT_EQ((int)rsp->getStatus(), 304);
+    rsp = Get(slt, "/static/a.txt", {{"If-None-Match", "*"}});
+    EXPECT_EQ((int)rsp->getStatus(), 304);
+    rsp = Get(slt, "/static/a.txt", {{"If-None-Match", "\"other\""}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    EXPECT_EQ(rsp->getBody(), "hello static file");
+
+    rsp = Get(slt, "/static/a.txt", {{"If-Modified-Since", lm}});
+    EXPECT_EQ((int)rsp->getStatus(), 304);
+    rsp = Get(slt, "/static/a.txt", {{"If-Modified-Since", "Thu, 01 Jan 1970 00:00:01 GMT"}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    rsp = Get(slt, "/static/a.txt", {{"If-Modified-Since", "garbage"}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    // 两个都有时只看 If-None-Match
+    rsp = Get(slt, "/static/a.txt", {{"If-None-Match", "\"other\""}, {"If-Modified-Since", lm}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+}
+
+// 单段 Range 返回 206，超出文件返回 416，If-Range 不匹配时发整个文件
+void test_range()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+    auto rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=6-11"}});
+    EXPECT_EQ((int)rsp->getStatus(), 206);
+    EXPECT_EQ(rsp->getBody(), "static");
+    EXPECT_EQ(rsp->getHeader("Content-Range"), "bytes 6-11/17");
+
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=13-"}});
+    EXPECT_EQ(rsp->getBody(), "file");
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=-4"}});
+    EXPECT_EQ(rsp->getBody(), "file");
+    EXPECT_EQ(rsp->getHeader("Content-Range"), "bytes 13-16/17");
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=10-1000"}});
+    EXPECT_EQ(rsp->getBody(), "ic file");
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=-100"}});
+    EXPECT_EQ(rsp->getBody(), "hello static file");
+
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=17-"}});
+    EXPECT_EQ((int)rsp->getStatus(), 416);
+    EXPECT_EQ(rsp->getHeader("Content-Range"), "bytes */17");
+
+    // 看不懂的和多段的按整个文件发
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=0-1,3-4"}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    EXPECT_EQ(rsp->getBody(), "hello static file");
+    rsp = Get(slt, "/static/a.txt", {{"Range", "lines=1-2"}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=5-2"}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+
+    std::string etag = rsp->getHeader("ETag");
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=0-4"}, {"If-Range", etag}});
+    EXPECT_EQ((int)rsp->getStatus(), 206);
+    EXPECT_EQ(rsp->getBody(), "hello");
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=0-4"}, {"If-Range", "\"stale\""}});
+    EXPECT_EQ((int)rsp->getStatus(), 200);
+    EXPECT_EQ(rsp->getBody(), "hello static file");
+
+    rsp = Get(slt, "/static/a.txt", {{"Range", "bytes=0-4"}}, HttpMethod::HEAD);
+    EXPECT_EQ((int)rsp->getStatus(), 206);
+    EXPECT_EQ(rsp->getHeader("Content-Length"), "5");
+    EXPECT_TRUE(rsp->getBody().empty());
+}
+
+// 打开 gzip 且客户端接受时发 .gz，没有 .gz 的照常发原文件
+void test_gzip()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+    auto rsp = Get(slt, "/static/app.js", {{"Accept-Encoding", "gzip, br"}});
+    EXPECT_EQ(rsp->getBody(), "plain js");
+    EXPECT_TRUE(rsp->getHeader("Vary").empty());
+
+    slt->setGzip(true);
+    rsp = Get(slt, "/static/app.js", {{"Accept-Encoding", "gzip, br"}});
+    EXPECT_EQ(rsp->getBody(), "gz js");
+    EXPECT_EQ(rsp->getHeader("Content-Encoding"), "gzip");
+    EXPECT_EQ(rsp->getHeader("Content-Type"), "application/javascript; charset=utf-8");
+    EXPECT_EQ(rsp->getHeader("Vary"), "Accept-Encoding");
+    std::string gz_etag = rsp->getHeader("ETag");
+
+    rsp = Get(slt, "/static/app.js");
+    EXPECT_EQ(rsp->getBody(), "plain js");
+    EXPECT_TRUE(rsp->getHeader("Content-Encoding").empty());
+    EXPECT_EQ(rsp->getHeader("Vary"), "Accept-Encoding");
+    EXPECT_TRUE(rsp->getHeader("ETag") != gz_etag);
+
+    rsp = Get(slt, "/static/a.txt", {{"Accept-Encoding", "gzip"}});
+    EXPECT_EQ(rsp->getBody(), "hello static file");
+    EXPECT_TRUE(rsp->getHeader("Content-Encoding").empty());
+}
+
+// 缓存在 ttl 内不重新 stat，过期后发现文件变了换成新内容
+void test_cache()
+{
+    StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+    slt->setCacheTtl(60 * 1000);
+    WriteFile("c.txt", "v1");
+    EXPECT_EQ(Get(slt, "/static/c.txt")->getBody(), "v1");
+    std::string etag = Get(slt, "/static/c.txt")->getHeader("ETag");
+    EXPECT_EQ(slt->getCacheSize(), 1u);
+
+    // 换成新文件，缓存的 fd 还指向旧的
+    unlink((g_root + "/c.txt").c_str());
+    WriteFile("c.txt", "version2");
+    EXPECT_EQ(Get(slt, "/static/c.txt")->getBody(), "v1");
+    EXPECT_EQ(Get(slt, "/static/c.txt")->getHeader("ETag"), etag);
+
+    slt->setCacheTtl(0);
+    auto rsp = Get(slt, "/static/c.txt");
+    EXPECT_EQ(rsp->getBody(), "version2");
+    EXPECT_TRUE(rsp->getHeader("ETag") != etag);
+
+    // 不存在的路径也缓存，文件出现后过了 ttl 能找到
+    slt->setCacheTtl(60 * 1000);
+    EXPECT_EQ((int)Get(slt, "/static/d.txt")->getStatus(), 404);
+    WriteFile("d.txt", "d");
+    EXPECT_EQ((int)Get(slt, "/static/d.txt")->getStatus(), 404);
+    slt->clearCache();
+    EXPECT_EQ(Get(slt, "/static/d.txt")->getBody(), "d");
+
+    slt->setMaxCacheSize(2);
+    Get(slt, "/static/a.txt");
+    Get(slt, "/static/c.txt");
+    EXPECT_TRUE(slt->getCacheSize() <= 2u);
+}
+
+// 经过真正的连接，头用 send 发，内容用 sendfile 发
+void test_sendfile()
+{
+    std::string content;
+    for (int i = 0; i < 300000; ++i)
+    {
+        content.push_back((char)('a' + i % 26));
+    }
+    WriteFile("big.bin", content);
+
+    std::string received;
+    {
+        sylar::IOManager iom(2, false, "static");
+        iom.schedule([&]() {
+            auto addr = sylar::IPv4Address::Create("127.0.0.1", 0);
+            auto listener = sylar::Socket::CreateTCP(addr);
+            EXPECT_TRUE(listener->bind(addr));
+            EXPECT_TRUE(listener->listen());
+            auto local =
+                std::dynamic_pointer_cast<sylar::IPAddress>(listener->getLocalAddress());
+            auto client = sylar::Socket::CreateTCP(addr);
+            addr->setPort(local->getPort());
+            EXPECT_TRUE(client->connect(addr));
+            auto server = listener->accept();
+            EXPECT_TRUE(server);
+            if (!server)
+            {
+                return;
+            }
+            // 对端慢慢读，sendfile 写满发送缓冲后要等可写再继续
+            sylar::IOManager::GetThis()->schedule([client, &received]() {
+                char buf[4096];
+                int n = 0;
+                while ((n = client->recv(buf, sizeof(buf))) > 0)
+                {
+                    received.append(buf, n);
+                }
+                client->close();
+            });
+
+            StaticFileServlet::ptr slt(new StaticFileServlet(g_root, "/static"));
+            sylar::http::HttpSession::ptr session(new sylar::http::HttpSession(server));
+            HttpRequest::ptr req(new HttpRequest);
+            req->setPath("/static/big.bin");
+            HttpResponse::ptr rsp(new HttpResponse);
+            EXPECT_EQ(slt->handle(req, rsp, session), 0);
+            EXPECT_TRUE(session->isResponseStarted());
+            EXPECT_TRUE(rsp->getBody().empty());
+
+            req->setHeader("Range", "bytes=100000-100009");
+            rsp.reset(new HttpResponse);
+            EXPECT_EQ(slt->handle(req, rsp, session), 0);
+            session->close();
+        });
+    }
+
+    size_t head_end = received.find("\r\n\r\n");
+    EXPECT_TRUE(head_end != std::string::npos);
+    if (head_end == std::string::npos)
+    {
+        return;
+    }
+    std::string head = received.substr(0, head_end);
+    EXPECT_TRUE(head.find("HTTP/1.1 200 OK") == 0);
+    EXPECT_TRUE(head.find("Content-Length: 300000") != std::string::npos);
+    EXPECT_TRUE(head.find("application/octet-stream") != std::string::npos);
+    std::string rest = received.substr(head_end + 4);
+    EXPECT_TRUE(rest.compare(0, content.size(), content) == 0);
+
+    rest.erase(0, content.size());
+    head_end = rest.find("\r\n\r\n");
+    EXPECT_TRUE(head_end != std::string::npos);
+    if (head_end == std::string::npos)
+    {
+        return;
+    }
+    EXPECT_TRUE(rest.find("HTTP/1.1 206 Partial Content") == 0);
+    EXPECT_TRUE(rest.find("Content-Range: bytes 100000-100009/300000") != std::string::npos);
+    EXPECT_EQ(rest.substr(head_end + 4), content.substr(100000, 10));
+}
+
+} // namespace
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    char tmpl[] = "/tmp/test_static_file_XXXXXX";
+    if (!mkdtemp(tmpl))
+    {
+        SYLAR_LOG_ERROR(g_logger) << "mkdtemp failed";
+        return 1;
+    }
+    g_root = tmpl;
+    mkdir((g_root + "/sub dir").c_str(), 0755);
+    WriteFile("a.txt", "hello static file");
+    WriteFile("index.html", "<h1>index</h1>");
+    WriteFile("sub dir/x.json", "{}");
+    WriteFile("app.js", "plain js");
+    WriteFile("app.js.gz", "gz js");
+
+    test_get();
+    test_single_file();
+    test_traversal();
+    test_conditional();
+    test_range();
+    test_gzip();
+    test_cache();
+    test_sendfile();
+
+    std::string cmd = "rm -rf '" + g_root + "'";
+    if (system(cmd.c_str()) != 0)
+    {
+        SYLAR_LOG_WARN(g_logger) << "cleanup " << g_root << " failed";
+    }
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/ring_queue.h"
+#include "sylar/task.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+// 统计本线程的堆分配次数，用来确认热路径上没有 malloc
+static thread_local size_t t_allocs = 0;
+
+void *operator new(size_t size)
+{
+    ++t_allocs;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+#pragma GCC diagnostic pop
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+struct Counted
+{
+    static int live;
+    int *hits;
+    Counted(int *h) : hits(h)
+    {
+        ++live;
+    }
+    Counted(Counted &&other) noexcept : hits(other.hits)
+    {
+        ++live;
+    }
+    ~Counted()
+    {
+        --live;
+    }
+    void operator()()
+    {
+        ++*hits;
+    }
+};
+int Counted::live = 0;
+
+void test_task_inline_and_heap()
+{
+    int hits = 0;
+    size_t before = t_allocs;
+    sylar::Task small([&hits]() { ++hits; });
+    EXPECT_EQ(t_allocs, before);
+    EXPECT_TRUE(small.isInline());
+    small();
+    EXPECT_EQ(hits, 1);
+
+    char big_capture[128] = {1};
+    sylar::Task big([&hits, big_capture]() { hits += big_capture[0]; });
+    EXPECT_TRUE(!big.isInline());
+    big();
+    EXPECT_EQ(hits, 2);
+
+    // 移动后原对象为空，被移动的对象照常可以调用
+    sylar::Task moved(std::move(big));
+    EXPECT_TRUE(!big);
+    moved();
+    EXPECT_EQ(hits, 3);
+
+    std::function<void()> empty;
+    EXPECT_TRUE(!sylar::Task(empty));
+    void (*null_fn)() = nullptr;
+    EXPECT_TRUE(!sylar::Task(null_fn));
+}
+
+void test_task_destroys_callable()
+{
+    int hits = 0;
+    {
+        sylar::Task t{Counted(&hits)};
+        EXPECT_EQ(Counted::live, 1);
+        sylar::Task other;
+        other = std::move(t);
+        EXPECT_EQ(Counted::live, 1);
+        other();
+        other = nullptr;
+        EXPECT_EQ(Counted::live, 0);
+        t = Counted(&hits);
+    }
+    EXPECT_EQ(Counted::live, 0);
+    EXPECT_EQ(hits, 1);
+}
+
+void test_ring_queue_wraps_and_grows()
+{
+    sylar::RingQueue<std::unique_ptr<int>> q(4);
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            q.push_back(std::unique_ptr<int>(new int(i)));
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_EQ(*q.front(), i);
+            q.pop_front();
+        }
+    }
+    EXPECT_EQ(q.capacity(), (size_t)4);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        q.push_back(std::unique_ptr<int>(new int(i)));
+    }
+    q.push_front(std::unique_ptr<int>(new int(-1)));
+    EXPECT_EQ(q.size(), (size_t)11);
+    EXPECT_EQ(*q.front(), -1);
+    EXPECT_EQ(*q.back(), 9);
+    q.pop_back();
+    EXPECT_EQ(*q.back(), 8);
+    q.clear();
+    EXPECT_TRUE(q.empty());
+}
+
+void test_queue_steady_state_does_not_allocate()
+{
+    sylar::RingQueue<sylar::Task> q;
+    int hits = 0;
+    std::shared_ptr<int> shared(new int(0));
+    // 先扩容到稳定大小
+    for (int i = 0; i < 64; ++i)
+    {
+        q.push_back(sylar::Task([&hits]() { ++hits; }));
+    }
+    q.clear();
+
+    size_t before = t_allocs;
+    for (int i = 0; i < 1000; ++i)
+    {
+        q.push_back(sylar::Task([&hits, shared]() { ++hits; }));
+        q.push_back(sylar::Task(std::function<void()>()));
+        q.front()();
+        q.pop_front();
+        q.pop_front();
+    }
+    EXPECT_EQ(t_allocs, before);
+    EXPECT_EQ(hits, 1000);
+}
+
+void test_schedule_moves_fiber()
+{
+    std::atomic<int> done(0);
+    {
+        sylar::IOManager iom(1, false, "task_queue");
+        sylar::Fiber::ptr fiber(new sylar::Fiber([&done]() { ++done; }));
+        iom.schedule(std::move(fiber));
+        EXPECT_TRUE(!fiber);
+
+        std::function<void()> cb = [&done]() { ++done; };
+        iom.schedule(cb);
+        EXPECT_TRUE((bool)cb);
+        iom.schedule(std::move(cb));
+        iom.schedule([&done]() { ++done; });
+    }
+    EXPECT_EQ(done.load(), 4);
+}
+
+} // namespace
+
+int main()
+{
+    test_task_inline_and_heap();
+    test_task_destroys_callable();
+    test_ring_queue_wraps_and_grows();
+    test_queue_steady_state_does_not_allocate();
+    test_schedule_moves_fiber();
+    return g_failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+#include "sylar/fd_manager.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/tcp_server.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// 收到什么回什么，对端关闭才结束，连接会一直占着名额
+class EchoServer : public sylar::TcpServer
+{
+public:
+    EchoServer(sylar::IOManager *iom) : sylar::TcpServer(iom, iom)
+    {
+    }
+
+    std::atomic<int> handled{0};
+
+protected:
+    void handleClient(sylar::Socket::ptr client) override
+    {
+        ++handled;
+        char buf[64];
+        int n = 0;
+        while ((n = client->recv(buf, sizeof(buf))) > 0)
+        {
+            client->send(buf, n);
+        }
+        client->close();
+    }
+};
+
+uint16_t GetPort(sylar::TcpServer::ptr server)
+{
+    auto addr =
+        std::dynamic_pointer_cast<sylar::IPAddress>(server->getSocks()[0]->getLocalAddress());
+    return addr ? addr->getPort() : 0;
+}
+
+int Connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 发一个字节等回显，返回读到的字节数，0 表示被服务端关掉，-1 表示超时
+int Ping(int fd)
+{
+    char c = 'x';
+    if (write(fd, &c, 1) != 1)
+    {
+        return 0;
+    }
+    return read(fd, &c, 1);
+}
+
+template <class Pred> bool WaitFor(Pred pred)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        if (pred())
+        {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return pred();
+}
+
+void Shutdown(std::shared_ptr<EchoServer> &server, std::vector<int> &fds)
+{
+    for (int fd : fds)
+    {
+        close(fd);
+    }
+    fds.clear();
+    server->stop();
+    WaitFor([&]() { return server.use_count() == 1; });
+    EXPECT_EQ(server.use_count(), 1);
+    server.reset();
+}
+
+// 启动前已经在 backlog 里排着的连接，一次可读事件就全部取出来
+void test_batch_accept()
+{
+    sylar::IOManager iom(2, false, "accept");
+    std::shared_ptr<EchoServer> server(new EchoServer(&iom));
+    server->setAcceptBatch(8);
+    EXPECT_TRUE(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+    uint16_t port = GetPort(server);
+    std::vector<int> fds;
+    for (int i = 0; i < 20; ++i)
+    {
+        fds.push_back(Connect(port));
+    }
+    EXPECT_TRUE(server->start());
+    for (int fd : fds)
+    {
+        EXPECT_EQ(Ping(fd), 1);
+    }
+    EXPECT_EQ(server->handled.load(), 20);
+    EXPECT_EQ(server->getConnectionCount(), 20u);
+    Shutdown(server, fds);
+}
+
+// 到上限后暂停 accept，有连接结束才接下一个
+void test_max_connections_wait()
+{
+    sylar::IOManager iom(2, false, "accept");
+    std::shared_ptr<EchoServer> server(new EchoServer(&iom));
+    server->setMaxConnections(2);
+    EXPECT_TRUE(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+    uint16_t port = GetPort(server);
+    EXPECT_TRUE(server->start());
+
+    std::vector<int> fds;
+    for (int i = 0; i < 4; ++i)
+    {
+        fds.push_back(Connect(port));
+    }
+    EXPECT_EQ(Ping(fds[0]), 1);
+    EXPECT_EQ(Ping(fds[1]), 1);
+    EXPECT_TRUE(WaitFor([&]() { return server->handled.load() == 2; }));
+    // 第三个连接在 backlog 里，没有被处理
+    usleep(50 * 1000);
+    EXPECT_EQ(server->handled.load(), 2);
+    EXPECT_EQ(server->getConnectionCount(), 2u);
+
+    close(fds[0]);
+    fds.erase(fds.begin());
+    EXPECT_EQ(Ping(fds[1]), 1);
+    EXPECT_EQ(server->handled.load(), 3);
+    EXPECT_EQ(server->getConnectionCount(), 2u);
+    EXPECT_EQ(server->getShedCount(), 0u);
+    Shutdown(server, fds);
+}
+
+// 到上限后新连接接进来直接关掉
+void test_max_connections_shed()
+{
+    sylar::IOManager iom(2, false, "accept");
+    std::shared_ptr<EchoServer> server(new EchoServer(&iom));
+    server->setMaxConnections(1, true);
+    EXPECT_TRUE(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+    uint16_t port = GetPort(server);
+    EXPECT_TRUE(server->start());
+
+    std::vector<int> fds;
+    fds.push_back(Connect(port));
+    EXPECT_EQ(Ping(fds[0]), 1);
+    fds.push_back(Connect(port));
+    EXPECT_TRUE(Ping(fds[1]) <= 0);
+    EXPECT_TRUE(WaitFor([&]() { return server->getShedCount() == 1; }));
+    EXPECT_EQ(server->handled.load(), 1);
+
+    // 名额空出来以后又能正常接
+    close(fds[0]);
+    EXPECT_TRUE(WaitFor([&]() { return server->getConnectionCount() == 0; }));
+    fds.push_back(Connect(port));
+    EXPECT_EQ(Ping(fds.back()), 1);
+    EXPECT_EQ(server->handled.load(), 2);
+    fds.erase(fds.begin());
+    Shutdown(server, fds);
+}
+
+// stop 时为叫醒 accept 协程放出的名额不能带到下一次 start
+void test_max_connections_restart()
+{
+    sylar::IOManager iom(2, false, "accept");
+    std::shared_ptr<EchoServer> server(new EchoServer(&iom));
+    server->setMaxConnections(1, true);
+    for (int round = 0; round < 2; ++round)
+    {
+        EXPECT_TRUE(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+        EXPECT_TRUE(server->start());
+        if (round == 0)
+        {
+            server->stop();
+            // accept 协程退出后只剩这一个引用
+            EXPECT_TRUE(WaitFor([&]() { return server.use_count() == 1; }));
+        }
+    }
+    uint16_t port = GetPort(server);
+    std::vector<int> fds;
+    fds.push_back(Connect(port));
+    EXPECT_EQ(Ping(fds[0]), 1);
+    fds.push_back(Connect(port));
+    EXPECT_TRUE(Ping(fds[1]) <= 0);
+    EXPECT_TRUE(WaitFor([&]() { return server->getShedCount() == 1; }));
+    EXPECT_EQ(server->handled.load(), 1);
+    Shutdown(server, fds);
+}
+
+// accept 出来的 socket 不再立刻取两端地址，用到时才取
+void test_lazy_address()
+{
+    sylar::IPv4Address::ptr any = sylar::IPv4Address::Create("127.0.0.1", 0);
+    auto listener = sylar::Socket::CreateTCP(any);
+    EXPECT_TRUE(listener->bind(any));
+    EXPECT_TRUE(listener->listen());
+    auto local = std::dynamic_pointer_cast<sylar::IPAddress>(listener->getLocalAddress());
+    int fd = Connect(local->getPort());
+    sockaddr_in self;
+    socklen_t len = sizeof(self);
+    getsockname(fd, (sockaddr *)&self, &len);
+
+    // 主线程没开 hook，连接已经在 backlog 里，tryAccept 不会等
+    auto client = listener->tryAccept();
+    EXPECT_TRUE(client);
+    if (client)
+    {
+        std::stringstream ss;
+        client->dump(ss);
+        EXPECT_TRUE(ss.str().find("remote_address") == std::string::npos);
+        auto remote = std::dynamic_pointer_cast<sylar::IPAddress>(client->getRemoteAddress());
+        EXPECT_EQ(remote ? remote->getPort() : 0, ntohs(self.sin_port));
+        sylar::FdMgr::GetInstance()->del(client->getSocket());
+        client->close();
+    }
+    // backlog 空了
+    EXPECT_TRUE(!listener->tryAccept());
+    EXPECT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+    close(fd);
+    sylar::FdMgr::GetInstance()->del(listener->getSocket());
+    listener->close();
+}
+
+} // namespace
+
+int main()
+{
+    test_batch_accept();
+    test_max_connections_wait();
+    test_max_connections_shed();
+    test_max_connections_restart();
+    test_lazy_address();
+    return g_failures.load() == 0 ? 0 : 1;
+}
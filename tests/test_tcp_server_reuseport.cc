@@ -0,0 +1,146 @@
+#include "sylar/log.h"
+#include "sylar/tcp_server.h"
+#include "sylar/thread.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <netinet/in.h>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+// 回一个字节和处理它的线程名，连接上的请求和 accept 应该在同一个 reactor 线程
+class NameServer : public sylar::TcpServer
+{
+public:
+    NameServer() : sylar::TcpServer(nullptr, nullptr)
+    {
+    }
+
+protected:
+    void handleClient(sylar::Socket::ptr client) override
+    {
+        char c = 0;
+        if (client->recv(&c, 1) == 1)
+        {
+            const std::string &name = sylar::Thread::GetName();
+            client->send(name.c_str(), name.size());
+        }
+        client->close();
+    }
+};
+
+std::string Request(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string rt;
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0 && write(fd, "x", 1) == 1)
+    {
+        char buf[64];
+        ssize_t n = 0;
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+        {
+            rt.append(buf, n);
+        }
+    }
+    close(fd);
+    return rt;
+}
+
+void test_reuseport_reactors()
+{
+    std::shared_ptr<NameServer> server(new NameServer);
+    server->setReusePort(4);
+    EXPECT_EQ(server->getReactorCount(), 4u);
+    EXPECT_TRUE(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+
+    // 每个 reactor 一个监听 socket，端口相同
+    auto socks = server->getSocks();
+    EXPECT_EQ(socks.size(), 4u);
+    auto addr = std::dynamic_pointer_cast<sylar::IPAddress>(socks[0]->getLocalAddress());
+    EXPECT_TRUE(addr && addr->getPort() != 0);
+    uint16_t port = addr ? addr->getPort() : 0;
+    for (auto &i : socks)
+    {
+        auto a = std::dynamic_pointer_cast<sylar::IPAddress>(i->getLocalAddress());
+        EXPECT_EQ(a ? a->getPort() : 0, port);
+    }
+
+    EXPECT_TRUE(server->start());
+    std::set<std::string> names;
+    for (int i = 0; i < 64; ++i)
+    {
+        std::string name = Request(port);
+        EXPECT_EQ(name.compare(0, 8, "reactor_"), 0);
+        names.insert(name);
+    }
+    // 内核按四元组在监听 socket 之间分摊，64 个连接不会都落到同一个上
+    EXPECT_TRUE(names.size() > 1);
+
+    server->stop();
+    // 关掉监听 socket 之后 accept 协程退出，放掉它们持有的引用
+    for (int i = 0; i < 200 && server.use_count() > 1; ++i)
+    {
+        usleep(10 * 1000);
+    }
+    EXPECT_EQ(server.use_count(), 1);
+    server.reset();
+}
+
+void test_unix_address_single_socket()
+{
+    std::string path = "/tmp/test_tcp_server_reuseport." + std::to_string(getpid());
+    sylar::TcpServer::ptr server(new NameServer);
+    server->setReusePort(3);
+    EXPECT_TRUE(server->bind(sylar::UnixAddress::ptr(new sylar::UnixAddress(path))));
+    EXPECT_EQ(server->getSocks().size(), 1u);
+    server.reset();
+    unlink(path.c_str());
+}
+
+} // namespace
+
+int main()
+{
+    test_reuseport_reactors();
+    test_unix_address_single_socket();
+    return g_failures.load() == 0 ? 0 : 1;
+}
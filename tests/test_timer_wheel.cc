@@ -0,0 +1,234 @@
+#include "sylar/log.h"
+#include "sylar/timer.h"
+#include "sylar/util.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+static std::atomic<int> g_failures(0);
+
+#define EXPECT_EQ(lhs, rhs)                                                                        \
+    do                                                                                             \
+    {                                                                                              \
+        auto _lhs = (lhs);                                                                         \
+        auto _rhs = (rhs);                                                                         \
+        if (_lhs != _rhs)                                                                          \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_EQ failed: " #lhs "=" << _lhs << " " #rhs "=" \
+                                      << _rhs << " line=" << __LINE__;                             \
+        }                                                                                          \
+    } while (0)
+
+#define EXPECT_TRUE(expr)                                                                          \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(expr))                                                                               \
+        {                                                                                          \
+            ++g_failures;                                                                          \
+            SYLAR_LOG_ERROR(g_logger) << "EXPECT_TRUE failed: " #expr << " line=" << __LINE__;     \
+        }                                                                                          \
+    } while (0)
+
+namespace
+{
+
+class TestTimerManager : public sylar::TimerManager
+{
+public:
+    std::atomic<int> fronts{0};
+
+    // 在当前线程上轮询，直到 deadline 或者没有定时器
+    void pump(uint64_t deadline)
+    {
+        while (hasTimer() && sylar::GetMonotonicMS() < deadline)
+        {
+            std::vector<std::function<void()>> cbs;
+            listExpiredCb(cbs);
+            for (auto &cb : cbs)
+            {
+                cb();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+protected:
+    void onTimerInsertedAtFront() override
+    {
+        ++fronts;
+    }
+};
+
+// 各层的定时器都按时触发：不早于设定时间，也不会晚太多
+void test_fire_accuracy()
+{
+    TestTimerManager mgr;
+    const int kTimers = 2000;
+    std::vector<uint64_t> due(kTimers);
+    std::vector<int64_t> fired(kTimers, -1);
+    std::vector<sylar::Timer::ptr> timers;
+    srand(7);
+    uint64_t start = sylar::GetMonotonicMS();
+    for (int i = 0; i < kTimers; ++i)
+    {
+        // 覆盖第 0 层（<256ms）和第 1 层（<16s）
+        uint64_t ms = i % 10 == 0 ? 0 : rand() % 1500;
+        due[i] = sylar::GetMonotonicMS() + ms;
+        timers.push_back(mgr.addTimer(ms, [i, &fired]() { fired[i] = sylar::GetMonotonicMS(); }));
+    }
+    // 取消三分之一
+    for (int i = 0; i < kTimers; i += 3)
+    {
+        EXPECT_TRUE(timers[i]->cancel());
+        EXPECT_TRUE(!timers[i]->cancel());
+    }
+    mgr.pump(start + 5000);
+    EXPECT_TRUE(!mgr.hasTimer());
+    int early = 0;
+    int late = 0;
+    for (int i = 0; i < kTimers; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            EXPECT_EQ(fired[i], (int64_t)-1);
+            continue;
+        }
+        early += fired[i] < (int64_t)due[i];
+        late += fired[i] > (int64_t)due[i] + 100;
+    }
+    EXPECT_EQ(early, 0);
+    EXPECT_EQ(late, 0);
+    // 已经触发的定时器不能再取消
+    EXPECT_TRUE(!timers[1]->cancel());
+}
+
+// 远期定时器在上层，getNextTimer 给出的等待时间不会超过实际时间
+void test_next_timer()
+{
+    TestTimerManager mgr;
+    EXPECT_EQ(mgr.getNextTimer(), ~0ull);
+    auto far = mgr.addTimer(100 * 1000, []() {});
+    EXPECT_EQ(mgr.fronts.load(), 1);
+    uint64_t next = mgr.getNextTimer();
+    EXPECT_TRUE(next > 0);
+    EXPECT_TRUE(next <= 100 * 1000);
+    // 比正在等的时间更早的定时器要通知空闲线程
+    auto near = mgr.addTimer(10, []() {});
+    EXPECT_EQ(mgr.fronts.load(), 2);
+    next = mgr.getNextTimer();
+    EXPECT_TRUE(next <= 10);
+    // 更晚的不用通知
+    auto later = mgr.addTimer(50 * 1000, []() {});
+    EXPECT_EQ(mgr.fronts.load(), 2);
+    near->cancel();
+    far->cancel();
+    later->cancel();
+    EXPECT_TRUE(!mgr.hasTimer());
+    EXPECT_EQ(mgr.getNextTimer(), ~0ull);
+}
+
+void test_refresh_reset_recurring()
+{
+    TestTimerManager mgr;
+    std::atomic<int> count(0);
+    uint64_t start = sylar::GetMonotonicMS();
+    uint64_t fired_at = 0;
+    auto timer = mgr.addTimer(100, [&]() { fired_at = sylar::GetMonotonicMS(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_TRUE(timer->refresh());
+    mgr.pump(start + 1000);
+    EXPECT_TRUE(fired_at >= start + 160);
+    EXPECT_TRUE(!timer->refresh());
+
+    start = sylar::GetMonotonicMS();
+    fired_at = 0;
+    timer = mgr.addTimer(1000, [&]() { fired_at = sylar::GetMonotonicMS(); });
+    EXPECT_TRUE(timer->reset(50, true));
+    mgr.pump(start + 2000);
+    EXPECT_TRUE(fired_at >= start + 50);
+    EXPECT_TRUE(fired_at < start + 500);
+
+    auto recurring = mgr.addTimer(20, [&]() { ++count; }, true);
+    start = sylar::GetMonotonicMS();
+    while (count < 5 && sylar::GetMonotonicMS() < start + 2000)
+    {
+        mgr.pump(sylar::GetMonotonicMS() + 5);
+    }
+    EXPECT_TRUE(count >= 5);
+    EXPECT_TRUE(recurring->cancel());
+    EXPECT_TRUE(!mgr.hasTimer());
+}
+
+// 多个线程同时加、取消，另一个线程推进时间
+void test_concurrent()
+{
+    TestTimerManager mgr;
+    std::atomic<bool> stop(false);
+    std::atomic<int> fired(0);
+    std::atomic<int> cancelled(0);
+    std::thread expirer(
+        [&]()
+        {
+            while (!stop)
+            {
+                std::vector<std::function<void()>> cbs;
+                mgr.listExpiredCb(cbs);
+                for (auto &cb : cbs)
+                {
+                    cb();
+                }
+                mgr.getNextTimer();
+            }
+        });
+    std::vector<std::thread> threads;
+    std::vector<sylar::Timer::ptr> kept[4];
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&, t]()
+            {
+                for (int i = 0; i < 20000; ++i)
+                {
+                    auto timer = mgr.addTimer(i % 50, [&fired]() { ++fired; });
+                    // 0ms 的定时器可能在取消之前就被推进线程触发了
+                    if (i % 2 && timer->cancel())
+                    {
+                        ++cancelled;
+                    }
+                    else if (i % 100 == 0)
+                    {
+                        kept[t].push_back(timer);
+                    }
+                }
+            });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    uint64_t start = sylar::GetMonotonicMS();
+    while (mgr.hasTimer() && sylar::GetMonotonicMS() < start + 2000)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    expirer.join();
+    EXPECT_TRUE(!mgr.hasTimer());
+    EXPECT_TRUE(cancelled > 4 * 9000);
+    EXPECT_EQ(fired.load() + cancelled.load(), 4 * 20000);
+}
+
+} // namespace
+
+int main()
+{
+    test_fire_accuracy();
+    test_next_timer();
+    test_refresh_reset_recurring();
+    test_concurrent();
+    return g_failures.load() == 0 ? 0 : 1;
+}
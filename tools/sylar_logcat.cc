@@ -0,0 +1,99 @@
+#include "sylar/log.h"
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/**
+ * @brief 把 BinaryLogAppender 写的二进制日志还原成文本
+ *
+ * 用法：sylar_logcat [-p pattern] [-l level] [file ...]
+ *   -p  输出格式，和 LogFormatter 的 pattern 一样，默认用 Logger 的默认格式
+ *   -l  只输出不低于这个级别的日志
+ *   不给文件或者文件名是 "-" 时读标准输入，.gz 压缩过的文件可以直接读
+ */
+
+static void Usage(const char *prog)
+{
+    std::cerr << "usage: " << prog << " [-p pattern] [-l level] [file ...]" << std::endl;
+}
+
+static bool Cat(const std::string &path,
+                const sylar::LogFormatter &formatter,
+                sylar::LogLevel::Level level)
+{
+    sylar::BinaryLogReader reader;
+    if (!reader.open(path))
+    {
+        std::cerr << path << ": " << (reader.isError() ? "not a binary log" : "open failed")
+                  << std::endl;
+        return false;
+    }
+    sylar::LogEvent event;
+    std::string out;
+    while (reader.next(event))
+    {
+        if (event.getLevel() < level)
+        {
+            continue;
+        }
+        formatter.format(out, event.getLevel(), event);
+        if (out.size() >= 64 * 1024)
+        {
+            std::cout.write(out.data(), out.size());
+            out.clear();
+        }
+    }
+    std::cout.write(out.data(), out.size());
+    if (reader.isError())
+    {
+        std::cerr << path << ": corrupted record" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::string pattern = sylar::Logger("logcat").getFormatter()->getPattern();
+    sylar::LogLevel::Level level = sylar::LogLevel::DEBUG;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "p:l:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            pattern = optarg;
+            break;
+        case 'l':
+            level = sylar::LogLevel::fromString(optarg);
+            if (level == sylar::LogLevel::UNKNOW)
+            {
+                std::cerr << "invalid level: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        default:
+            Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    sylar::LogFormatter formatter(pattern);
+    if (formatter.isError())
+    {
+        std::cerr << "invalid pattern: " << pattern << std::endl;
+        return 1;
+    }
+
+    bool ok = true;
+    if (optind >= argc)
+    {
+        ok = Cat("-", formatter, level);
+    }
+    for (int i = optind; i < argc; ++i)
+    {
+        ok = Cat(argv[i], formatter, level) && ok;
+    }
+    std::cout.flush();
+    return ok ? 0 : 1;
+}